@@ -437,7 +437,7 @@ func _add_layer_container(root: Node2D, layers: Array, tilemaps: Array, tileset:
 					continue
 				
 				var tile_value: int = tilemap_data[idx]
-				var tile_index: int = tile_value & 0x7FF
+				var tile_index: int = tile_value & 0xFFF  # bits 0-11; 12-15 = tint
 				
 				if tile_index > 0:  # 0 = empty
 					var atlas_x: int = (tile_index - 1) % TILES_PER_ROW
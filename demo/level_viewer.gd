@@ -115,8 +115,11 @@ func render_level() -> void:
 		push_error("Failed to get tilemap data")
 		return
 	
+	# Non-empty 16x16 chunks (empty regions are never visited)
+	var chunk_data: PackedByteArray = blb.get_layer_chunks(main_layer_idx)
+	
 	# Render the level
-	var level_img := render_layer(tilemap_data, layer_width, layer_height, 
+	var level_img := render_layer(tilemap_data, chunk_data, layer_width, layer_height, 
 		Color8(bg_r, bg_g, bg_b))
 	
 	if level_img:
@@ -138,8 +141,10 @@ func build_tile_cache(tile_count: int) -> void:
 			false, Image.FORMAT_RGBA8, tile_rgba)
 		tile_cache[i] = tile_img
 
-func render_layer(tilemap: PackedByteArray, width: int, height: int, bg_color: Color) -> Image:
+func render_layer(tilemap: PackedByteArray, chunks: PackedByteArray, width: int, height: int, bg_color: Color) -> Image:
 	## Render a layer to an Image using the tile cache.
+	## chunks holds one 16 byte record per non-empty 16x16 chunk
+	## (see BLBArchive.get_layer_chunks); only those cells are visited.
 	
 	# Create output image (16x16 pixels per tile)
 	var img_width := width * 16
@@ -150,27 +155,35 @@ func render_layer(tilemap: PackedByteArray, width: int, height: int, bg_color: C
 	# Parse tilemap (array of u16 values)
 	var tile_count := tilemap.size() / 2
 	
-	for i in range(mini(tile_count, width * height)):
-		var tile_index: int = tilemap.decode_u16(i * 2)
-		
-		# Skip empty tiles
-		if tile_index == 0 or tile_index == 0xFFFF:
-			continue
-		
-		# Get tile image from cache
-		if not tile_cache.has(tile_index):
-			continue
-		
-		var tile_img: Image = tile_cache[tile_index]
-		var tile_size: int = tile_img.get_width()
-		
-		# Calculate position
-		var tx := (i % width) * 16
-		var ty := (i / width) * 16
+	for c in range(chunks.size() / 16):
+		var rec := c * 16
+		var base_x: int = chunks.decode_u16(rec + 0) * 16
+		var base_y: int = chunks.decode_u16(rec + 2) * 16
 		
-		# Blit tile to level image
-		var src_rect := Rect2i(0, 0, tile_size, tile_size)
-		img.blit_rect(tile_img, src_rect, Vector2i(tx, ty))
+		for cy in range(chunks[rec + 5], chunks[rec + 7] + 1):
+			for cx in range(chunks[rec + 4], chunks[rec + 6] + 1):
+				var x := base_x + cx
+				var y := base_y + cy
+				var i := y * width + x
+				if x >= width or y >= height or i >= tile_count:
+					continue
+				
+				var tile_index: int = tilemap.decode_u16(i * 2) & 0xFFF  # bits 0-11; 12-15 = tint
+				
+				# Skip empty tiles
+				if tile_index == 0:
+					continue
+				
+				# Get tile image from cache
+				if not tile_cache.has(tile_index):
+					continue
+				
+				var tile_img: Image = tile_cache[tile_index]
+				var tile_size: int = tile_img.get_width()
+				
+				# Blit tile to level image
+				var src_rect := Rect2i(0, 0, tile_size, tile_size)
+				img.blit_rect(tile_img, src_rect, Vector2i(x * 16, y * 16))
 	
 	return img
 
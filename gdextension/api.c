@@ -12,10 +12,16 @@ GdApi api = {0};
 GdTypeConstructors type_to_variant = {0};
 GdTypeDestructors type_from_variant = {0};
 
-/* Cached destructors */
+/* Cached destructors. Everything here is resolved once in api_init, from
+ * the thread loading the extension, and only read afterwards - method
+ * calls may arrive on any thread. */
 static GDExtensionPtrDestructor string_destructor = NULL;
 static GDExtensionPtrDestructor string_name_destructor = NULL;
 
+/* Cached PackedByteArray constructors/destructors */
+static GDExtensionPtrConstructor packed_byte_array_constructor = NULL;
+static GDExtensionPtrDestructor packed_byte_array_destructor = NULL;
+
 void api_init(GDExtensionInterfaceGetProcAddress p_get_proc_address,
               GDExtensionClassLibraryPtr p_library) {
     
@@ -119,6 +125,16 @@ void api_init(GDExtensionInterfaceGetProcAddress p_get_proc_address,
         string_destructor = get_destructor(GDEXTENSION_VARIANT_TYPE_STRING);
         string_name_destructor = get_destructor(GDEXTENSION_VARIANT_TYPE_STRING_NAME);
     }
+    
+    /* PackedByteArray default constructor and destructor */
+    if (api.variant_get_ptr_constructor) {
+        packed_byte_array_constructor = api.variant_get_ptr_constructor(
+            GDEXTENSION_VARIANT_TYPE_PACKED_BYTE_ARRAY, 0);
+    }
+    if (api.variant_get_ptr_destructor) {
+        packed_byte_array_destructor = api.variant_get_ptr_destructor(
+            GDEXTENSION_VARIANT_TYPE_PACKED_BYTE_ARRAY);
+    }
 }
 
 /* -----------------------------------------------------------------------------
@@ -243,24 +259,7 @@ char* variant_as_cstring(const GdVariant* p_self) {
 /* PackedByteArray size (from Godot extension_api.json, 64-bit) */
 #define GD_PACKED_BYTE_ARRAY_SIZE 16
 
-/* Cached PackedByteArray constructors/destructors */
-static GDExtensionPtrConstructor packed_byte_array_constructor = NULL;
-static GDExtensionPtrDestructor packed_byte_array_destructor = NULL;
-
-static void ensure_packed_byte_array_funcs(void) {
-    if (!packed_byte_array_constructor && api.variant_get_ptr_constructor) {
-        packed_byte_array_constructor = api.variant_get_ptr_constructor(
-            GDEXTENSION_VARIANT_TYPE_PACKED_BYTE_ARRAY, 0);  /* default constructor */
-    }
-    if (!packed_byte_array_destructor && api.variant_get_ptr_destructor) {
-        packed_byte_array_destructor = api.variant_get_ptr_destructor(
-            GDEXTENSION_VARIANT_TYPE_PACKED_BYTE_ARRAY);
-    }
-}
-
 void variant_new_packed_byte_array(GdVariant* r_dest) {
-    ensure_packed_byte_array_funcs();
-    
     if (!packed_byte_array_constructor || !type_to_variant.from_packed_byte_array) {
         variant_new_nil(r_dest);
         return;
@@ -286,8 +285,6 @@ void variant_new_packed_byte_array_from_data(GdVariant* r_dest, const uint8_t* p
         return;
     }
     
-    ensure_packed_byte_array_funcs();
-    
     if (!packed_byte_array_constructor || !type_to_variant.from_packed_byte_array ||
         !api.variant_call || !api.packed_byte_array_operator_index) {
         variant_new_nil(r_dest);
@@ -13,6 +13,8 @@
 #include "gd_helpers.h"
 #include "../src/blb/blb.h"
 #include "../src/level/level.h"
+#include "../src/level/level_cache.h"
+#include "../src/render/render_kernels.h"
 #include "../src/evil_engine.h"
 #include <stdlib.h>
 #include <string.h>
@@ -27,11 +29,23 @@
 
 typedef struct {
     BLBFile blb;
-    LevelContext level;
+    LevelCache* levels;         /* Recently viewed stages, kept loaded */
+    const LevelContext* level;  /* Current stage (acquired from levels) */
     int is_open;
     int level_loaded;
 } BLBArchiveData;
 
+/* Drop the current stage and every cached one - before closing the BLB */
+static void archive_drop_levels(BLBArchiveData* data) {
+    if (data->level_loaded) {
+        LevelCache_Release(data->levels, data->level);
+        data->level = NULL;
+        data->level_loaded = 0;
+    }
+    LevelCache_Destroy(data->levels);
+    data->levels = NULL;
+}
+
 /* -----------------------------------------------------------------------------
  * Constructor / Destructor
  * -------------------------------------------------------------------------- */
@@ -68,9 +82,7 @@ static void blb_archive_free(void* p_class_userdata, GDExtensionClassInstancePtr
     
     if (!data) return;
     
-    if (data->level_loaded) {
-        Level_Unload(&data->level);
-    }
+    archive_drop_levels(data);
     
     if (data->is_open) {
         BLB_Close(&data->blb);
@@ -102,6 +114,7 @@ static void blb_open_call(
     }
     
     /* Close existing if open */
+    archive_drop_levels(data);
     if (data->is_open) {
         BLB_Close(&data->blb);
         data->is_open = 0;
@@ -159,6 +172,7 @@ static void blb_close_call(
     BLBArchiveData* data = (BLBArchiveData*)p_instance;
     
     if (data && data->is_open) {
+        archive_drop_levels(data);
         BLB_Close(&data->blb);
         data->is_open = 0;
     }
@@ -178,6 +192,7 @@ static void blb_close_ptrcall(
     
     BLBArchiveData* data = (BLBArchiveData*)p_instance;
     if (data && data->is_open) {
+        archive_drop_levels(data);
         BLB_Close(&data->blb);
         data->is_open = 0;
     }
@@ -572,6 +587,7 @@ static void blb_get_asset_data_call(
     } else {
         variant_new_packed_byte_array((GdVariant*)r_return);
     }
+    EvilEngine_ReleaseAssetData(&data->blb, asset_data);
 }
 
 static void blb_get_asset_data_ptrcall(
@@ -659,17 +675,19 @@ static void blb_load_level_call(
     int64_t level_index = variant_as_int((const GdVariant*)p_args[0]);
     int64_t stage_index = variant_as_int((const GdVariant*)p_args[1]);
     
-    /* Unload any existing level */
+    /* Hand the current level back - it stays cached for switching back */
     if (data->level_loaded) {
-        Level_Unload(&data->level);
+        LevelCache_Release(data->levels, data->level);
+        data->level = NULL;
         data->level_loaded = 0;
     }
     
-    /* Initialize and load new level */
-    Level_Init(&data->level);
-    int result = Level_Load(&data->level, &data->blb, (u8)level_index, (u8)stage_index);
+    if (!data->levels) {
+        data->levels = LevelCache_Create(&data->blb, 0);
+    }
+    data->level = LevelCache_Acquire(data->levels, (u8)level_index, (u8)stage_index);
     
-    if (result == 0) {
+    if (data->level) {
         data->level_loaded = 1;
         variant_new_bool((GdVariant*)r_return, 1);
     } else {
@@ -714,7 +732,7 @@ static void blb_get_tile_count_call(
         return;
     }
     
-    variant_new_int((GdVariant*)r_return, (int64_t)Level_GetTotalTileCount(&data->level));
+    variant_new_int((GdVariant*)r_return, (int64_t)Level_GetTotalTileCount(data->level));
 }
 
 static void blb_get_tile_count_ptrcall(
@@ -727,7 +745,7 @@ static void blb_get_tile_count_ptrcall(
     (void)p_args;
     BLBArchiveData* data = (BLBArchiveData*)p_instance;
     if (data && data->level_loaded) {
-        *(int64_t*)r_ret = (int64_t)Level_GetTotalTileCount(&data->level);
+        *(int64_t*)r_ret = (int64_t)Level_GetTotalTileCount(data->level);
     } else {
         *(int64_t*)r_ret = 0;
     }
@@ -758,7 +776,7 @@ static void blb_get_layer_count_call(
         return;
     }
     
-    variant_new_int((GdVariant*)r_return, (int64_t)data->level.layer_count);
+    variant_new_int((GdVariant*)r_return, (int64_t)data->level->layer_count);
 }
 
 static void blb_get_layer_count_ptrcall(
@@ -771,7 +789,7 @@ static void blb_get_layer_count_ptrcall(
     (void)p_args;
     BLBArchiveData* data = (BLBArchiveData*)p_instance;
     if (data && data->level_loaded) {
-        *(int64_t*)r_ret = (int64_t)data->level.layer_count;
+        *(int64_t*)r_ret = (int64_t)data->level->layer_count;
     } else {
         *(int64_t*)r_ret = 0;
     }
@@ -803,7 +821,7 @@ static void blb_get_background_color_call(
     }
     
     u8 r, g, b;
-    Level_GetBackgroundColor(&data->level, &r, &g, &b);
+    Level_GetBackgroundColor(data->level, &r, &g, &b);
     
     /* Return as packed RGBA integer */
     u32 rgba = ((u32)r) | ((u32)g << 8) | ((u32)b << 16) | 0xFF000000;
@@ -821,7 +839,7 @@ static void blb_get_background_color_ptrcall(
     BLBArchiveData* data = (BLBArchiveData*)p_instance;
     if (data && data->level_loaded) {
         u8 r, g, b;
-        Level_GetBackgroundColor(&data->level, &r, &g, &b);
+        Level_GetBackgroundColor(data->level, &r, &g, &b);
         u32 rgba = ((u32)r) | ((u32)g << 8) | ((u32)b << 16) | 0xFF000000;
         *(int64_t*)r_ret = (int64_t)rgba;
     } else {
@@ -857,8 +875,8 @@ static void blb_render_tile_call(
     
     /* Get tile data */
     int is_8x8 = 0;
-    const u8* pixels = Level_GetTilePixels(&data->level, (u16)tile_index, &is_8x8);
-    const u16* palette = Level_GetTilePalette(&data->level, (u16)tile_index);
+    const u8* pixels = Level_GetTilePixels(data->level, (u16)tile_index, &is_8x8);
+    const u32* palette = Level_GetTileRGBA(data->level, (u16)tile_index);
     
     if (!pixels || !palette) {
         variant_new_packed_byte_array((GdVariant*)r_return);
@@ -877,22 +895,11 @@ static void blb_render_tile_call(
         return;
     }
     
-    /* Convert indexed pixels to RGBA */
-    for (int i = 0; i < pixel_count; i++) {
-        u8 color_index = pixels[i];
-        u16 psx_color = palette[color_index];
-        u32 rgba = EvilEngine_PSXColorToRGBA(psx_color);
-        
-        /* Handle transparency (color index 0 or PSX color 0x0000) */
-        if (color_index == 0 && psx_color == 0) {
-            rgba = 0; /* Fully transparent */
-        }
-        
-        rgba_data[i * 4 + 0] = (rgba >> 0) & 0xFF;  /* R */
-        rgba_data[i * 4 + 1] = (rgba >> 8) & 0xFF;  /* G */
-        rgba_data[i * 4 + 2] = (rgba >> 16) & 0xFF; /* B */
-        rgba_data[i * 4 + 3] = (rgba >> 24) & 0xFF; /* A */
-    }
+    /* Convert indexed pixels to RGBA via the tile's palette LUT (alpha
+     * policy already applied there). Source rows are 16 bytes apart even
+     * for 8x8 tiles. */
+    RenderKernel_ExpandRect(pixels, 16, palette, rgba_data, (u32)size * 4,
+                            (u32)size, (u32)size, 0);
     
     variant_new_packed_byte_array_from_data((GdVariant*)r_return, rgba_data, rgba_size);
     api.mem_free(rgba_data);
@@ -935,7 +942,7 @@ static void blb_get_tile_size_call(
     }
     
     int64_t tile_index = variant_as_int((const GdVariant*)p_args[0]);
-    u8 flags = Level_GetTileFlags(&data->level, (u16)tile_index);
+    u8 flags = Level_GetTileFlags(data->level, (u16)tile_index);
     
     variant_new_int((GdVariant*)r_return, (flags & 0x02) ? 8 : 16);
 }
@@ -950,7 +957,7 @@ static void blb_get_tile_size_ptrcall(
     BLBArchiveData* data = (BLBArchiveData*)p_instance;
     if (data && data->level_loaded && p_args) {
         int64_t tile_index = *(const int64_t*)p_args[0];
-        u8 flags = Level_GetTileFlags(&data->level, (u16)tile_index);
+        u8 flags = Level_GetTileFlags(data->level, (u16)tile_index);
         *(int64_t*)r_ret = (flags & 0x02) ? 8 : 16;
     } else {
         *(int64_t*)r_ret = 16;
@@ -981,8 +988,8 @@ static void blb_get_layer_tilemap_call(
     }
     
     int64_t layer_index = variant_as_int((const GdVariant*)p_args[0]);
-    const LayerEntry* layer = Level_GetLayer(&data->level, (u32)layer_index);
-    const u16* tilemap = Level_GetLayerTilemap(&data->level, (u32)layer_index);
+    const LayerEntry* layer = Level_GetLayer(data->level, (u32)layer_index);
+    const u16* tilemap = Level_GetLayerTilemap(data->level, (u32)layer_index);
     
     if (!layer || !tilemap) {
         variant_new_packed_byte_array((GdVariant*)r_return);
@@ -1007,6 +1014,91 @@ static void blb_get_layer_tilemap_ptrcall(
     (void)r_ret;
 }
 
+/* -----------------------------------------------------------------------------
+ * Method: get_layer_chunks(layer_index: int) -> PackedByteArray
+ * Get the layer's non-empty 16x16-cell chunks, one 16 byte record each:
+ *   u16 chunk_x, u16 chunk_y, u8 x0, u8 y0, u8 x1, u8 y1 (occupied cells,
+ *   inclusive, relative to the chunk), u16 min_tile, u16 max_tile,
+ *   u16 cell_count, u8 flags (bit 0 occupied, bit 1 opaque), u8 pad.
+ * Empty chunks are omitted, so builders only visit cells that draw.
+ * -------------------------------------------------------------------------- */
+
+#define CHUNK_RECORD_SIZE 16
+
+static void blb_get_layer_chunks_call(
+    void* method_userdata,
+    GDExtensionClassInstancePtr p_instance,
+    const GDExtensionConstVariantPtr* p_args,
+    GDExtensionInt p_argument_count,
+    GDExtensionVariantPtr r_return,
+    GDExtensionCallError* r_error
+) {
+    (void)method_userdata;
+    (void)r_error;
+    
+    BLBArchiveData* data = (BLBArchiveData*)p_instance;
+    
+    if (!data || !data->level_loaded || p_argument_count < 1) {
+        variant_new_packed_byte_array((GdVariant*)r_return);
+        return;
+    }
+    
+    int64_t layer_index = variant_as_int((const GdVariant*)p_args[0]);
+    const LevelLayerChunks* view = Level_GetLayerChunks(data->level, (u32)layer_index);
+    
+    if (!view || view->occupied_count == 0) {
+        variant_new_packed_byte_array((GdVariant*)r_return);
+        return;
+    }
+    
+    size_t size = (size_t)view->occupied_count * CHUNK_RECORD_SIZE;
+    u8* records = (u8*)api.mem_alloc(size);
+    if (!records) {
+        variant_new_packed_byte_array((GdVariant*)r_return);
+        return;
+    }
+    
+    for (u32 i = 0; i < view->occupied_count; i++) {
+        u32 c = view->occupied[i];
+        const LevelChunk* chunk = &view->chunks[c];
+        u16 cx = (u16)(c % view->chunks_x);
+        u16 cy = (u16)(c / view->chunks_x);
+        u8* rec = records + i * CHUNK_RECORD_SIZE;
+        
+        rec[0] = cx & 0xFF;
+        rec[1] = cx >> 8;
+        rec[2] = cy & 0xFF;
+        rec[3] = cy >> 8;
+        rec[4] = chunk->x0;
+        rec[5] = chunk->y0;
+        rec[6] = chunk->x1;
+        rec[7] = chunk->y1;
+        rec[8] = chunk->min_tile & 0xFF;
+        rec[9] = chunk->min_tile >> 8;
+        rec[10] = chunk->max_tile & 0xFF;
+        rec[11] = chunk->max_tile >> 8;
+        rec[12] = chunk->cell_count & 0xFF;
+        rec[13] = chunk->cell_count >> 8;
+        rec[14] = chunk->flags;
+        rec[15] = 0;
+    }
+    
+    variant_new_packed_byte_array_from_data((GdVariant*)r_return, records, size);
+    api.mem_free(records);
+}
+
+static void blb_get_layer_chunks_ptrcall(
+    void* method_userdata,
+    GDExtensionClassInstancePtr p_instance,
+    const GDExtensionConstTypePtr* p_args,
+    GDExtensionTypePtr r_ret
+) {
+    (void)method_userdata;
+    (void)p_instance;
+    (void)p_args;
+    (void)r_ret;
+}
+
 /* -----------------------------------------------------------------------------
  * Method: get_layer_info(layer_index: int) -> Dictionary
  * Get layer metadata.
@@ -1031,7 +1123,7 @@ static void blb_get_layer_info_call(
     }
     
     int64_t layer_index = variant_as_int((const GdVariant*)p_args[0]);
-    const LayerEntry* layer = Level_GetLayer(&data->level, (u32)layer_index);
+    const LayerEntry* layer = Level_GetLayer(data->level, (u32)layer_index);
     
     if (!layer) {
         variant_new_nil((GdVariant*)r_return);
@@ -1196,6 +1288,13 @@ void register_blb_archive_class(GDExtensionClassLibraryPtr p_library) {
         "layer_index", GDEXTENSION_VARIANT_TYPE_INT
     );
     
+    bind_method_1_r(
+        CLASS_NAME, "get_layer_chunks",
+        blb_get_layer_chunks_call, blb_get_layer_chunks_ptrcall,
+        GDEXTENSION_VARIANT_TYPE_PACKED_BYTE_ARRAY,
+        "layer_index", GDEXTENSION_VARIANT_TYPE_INT
+    );
+    
     bind_method_1_r(
         CLASS_NAME, "get_layer_info",
         blb_get_layer_info_call, blb_get_layer_info_ptrcall,
@@ -5,17 +5,20 @@
 #include "class_binding.h"
 #include <string.h>
 
-/* Static empty StringName and String for PropertyInfo fields */
+/* Static empty StringName and String for PropertyInfo fields.
+ * Created by class_binding_init before any class is registered and
+ * read-only until class_binding_deinit. */
 static GdStringName s_empty_sn;
 static GdString s_empty_str;
-static int s_initialized = 0;
 
-static void ensure_empty_strings(void) {
-    if (!s_initialized) {
-        string_name_new(&s_empty_sn, "");
-        string_new(&s_empty_str, "");
-        s_initialized = 1;
-    }
+void class_binding_init(void) {
+    string_name_new(&s_empty_sn, "");
+    string_new(&s_empty_str, "");
+}
+
+void class_binding_deinit(void) {
+    string_name_destroy(&s_empty_sn);
+    string_destroy(&s_empty_str);
 }
 
 /* -----------------------------------------------------------------------------
@@ -79,8 +82,6 @@ void bind_method_0_r(
     GDExtensionClassMethodPtrCall ptrcall_func,
     GDExtensionVariantType return_type
 ) {
-    ensure_empty_strings();
-    
     GdStringName class_sn, method_sn;
     string_name_new(&class_sn, class_name);
     string_name_new(&method_sn, method_name);
@@ -130,8 +131,6 @@ void bind_method_0(
     GDExtensionClassMethodCall call_func,
     GDExtensionClassMethodPtrCall ptrcall_func
 ) {
-    ensure_empty_strings();
-    
     GdStringName class_sn, method_sn;
     string_name_new(&class_sn, class_name);
     string_name_new(&method_sn, method_name);
@@ -175,8 +174,6 @@ void bind_method_1_r(
     const char* arg1_name,
     GDExtensionVariantType arg1_type
 ) {
-    ensure_empty_strings();
-    
     GdStringName class_sn, method_sn, arg1_sn;
     string_name_new(&class_sn, class_name);
     string_name_new(&method_sn, method_name);
@@ -241,8 +238,6 @@ void bind_method_1(
     const char* arg1_name,
     GDExtensionVariantType arg1_type
 ) {
-    ensure_empty_strings();
-    
     GdStringName class_sn, method_sn, arg1_sn;
     string_name_new(&class_sn, class_name);
     string_name_new(&method_sn, method_name);
@@ -301,8 +296,6 @@ void bind_method_2_r(
     const char* arg2_name,
     GDExtensionVariantType arg2_type
 ) {
-    ensure_empty_strings();
-    
     GdStringName class_sn, method_sn, arg1_sn, arg2_sn;
     string_name_new(&class_sn, class_name);
     string_name_new(&method_sn, method_name);
@@ -389,8 +382,6 @@ void bind_method_4_r(
     const char* arg4_name,
     GDExtensionVariantType arg4_type
 ) {
-    ensure_empty_strings();
-    
     GdStringName class_sn, method_sn, arg1_sn, arg2_sn, arg3_sn, arg4_sn;
     string_name_new(&class_sn, class_name);
     string_name_new(&method_sn, method_name);
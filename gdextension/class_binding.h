@@ -11,6 +11,21 @@
 #include <gdextension_interface.h>
 #include "api.h"
 
+/* -----------------------------------------------------------------------------
+ * Setup
+ * -------------------------------------------------------------------------- */
+
+/**
+ * Create the shared empty names used in PropertyInfo. Call once, before
+ * registering any class; the bind_* helpers only read them after that.
+ */
+void class_binding_init(void);
+
+/**
+ * Release what class_binding_init created.
+ */
+void class_binding_deinit(void);
+
 /* -----------------------------------------------------------------------------
  * Method Binding Macros
  * -------------------------------------------------------------------------- */
@@ -44,9 +44,14 @@ static int engine_node_load_blb(EvilEngineNode *node, const char *path) {
     return Game_LoadBLB(&node->game, path) == 0 ? 1 : 0;
 }
 
-/* Load a specific level and stage */
+/* Load a specific level and stage, then start loading the one after it
+ * so walking through the stage exit only swaps contexts */
 static int engine_node_load_level(EvilEngineNode *node, u8 level_index, u8 stage) {
-    return Game_LoadLevel(&node->game, level_index, stage) == 0 ? 1 : 0;
+    if (Game_LoadLevel(&node->game, level_index, stage) != 0) {
+        return 0;
+    }
+    Game_PrefetchNextStage(&node->game);
+    return 1;
 }
 
 /* Process one frame (called from Godot _process) */
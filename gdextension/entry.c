@@ -1,6 +1,7 @@
 #include <gdextension_interface.h>
 #include <stddef.h>
 #include "api.h"
+#include "class_binding.h"
 #include "gd_helpers.h"
 
 /* Platform-specific export macro */
@@ -22,6 +23,7 @@ static void initialize_evil_engine(void *p_userdata, GDExtensionInitializationLe
     
     if (p_level == GDEXTENSION_INITIALIZATION_SCENE) {
         /* Register our classes at scene level */
+        class_binding_init();
         engine_node_register(api.library);
         register_blb_archive_class(api.library);
     }
@@ -30,8 +32,10 @@ static void initialize_evil_engine(void *p_userdata, GDExtensionInitializationLe
 /* Called at each deinitialization level */
 static void deinitialize_evil_engine(void *p_userdata, GDExtensionInitializationLevel p_level) {
     (void)p_userdata;
-    (void)p_level;
-    /* Cleanup if needed */
+    
+    if (p_level == GDEXTENSION_INITIALIZATION_SCENE) {
+        class_binding_deinit();
+    }
 }
 
 /* GDExtension entry point - called by Godot when loading the extension */
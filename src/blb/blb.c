@@ -5,11 +5,27 @@
  * Patterns match the original decompiled Skullmonkeys code.
  */
 
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L     /* mmap, posix_madvise */
+#endif
+
 #include "blb.h"
+#include "blb_cache.h"
+#include "blb_index.h"
+#include "blb_writer.h"
+#include "blb_async.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define BLB_HAVE_MMAP 1
+#endif
+
 /* -----------------------------------------------------------------------------
  * Internal helpers
  * -------------------------------------------------------------------------- */
@@ -37,7 +53,7 @@ static const u8* get_level_entry(const BLBFile* blb, u8 level_index) {
 static int detect_jp_layout(const u8* header) {
     /* PAL: byte[3] at 0xCD0 is A-Z (65-90) - start of code field
      * JP: different layout, byte[3] would be different */
-    u8 byte3 = header[0xCD3];
+    u8 byte3 = header[BLB_OFF_LAYOUT_CODE];
     return !(byte3 >= 65 && byte3 <= 90);
 }
 
@@ -45,16 +61,48 @@ static int detect_jp_layout(const u8* header) {
  * BLB File Operations
  * -------------------------------------------------------------------------- */
 
-int BLB_Open(const char* path, BLBFile* blb) {
-    FILE* f;
-    long size;
-    u8* data;
+#ifdef BLB_HAVE_MMAP
+/* Map the whole file read-only. Returns 0 on success, -1 to fall back. */
+static int open_mapped(const char* path, BLBFile* blb) {
+    struct stat st;
+    void* map;
+    int fd;
     
-    if (!path || !blb) {
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
         return -1;
     }
     
-    memset(blb, 0, sizeof(BLBFile));
+    if (fstat(fd, &st) != 0 || st.st_size < BLB_HEADER_SIZE ||
+        (unsigned long long)st.st_size > 0xFFFFFFFFull) {
+        close(fd);
+        return -1;
+    }
+    
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  /* Mapping keeps its own reference */
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    
+    /* Level loads jump between segments - don't let readahead guess */
+    posix_madvise(map, (size_t)st.st_size, POSIX_MADV_RANDOM);
+    
+    if (BLB_ParseHeader((const u8*)map, (u32)st.st_size, blb) != 0) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    
+    blb->backend = BLB_BACKEND_MMAP;
+    return 0;
+}
+#endif
+
+/* Read the whole file into an owned heap buffer */
+static int open_heap(const char* path, BLBFile* blb) {
+    FILE* f;
+    long size;
+    u8* data;
     
     f = fopen(path, "rb");
     if (!f) {
@@ -87,10 +135,54 @@ int BLB_Open(const char* path, BLBFile* blb) {
     fclose(f);
     
     /* Initialize from memory */
-    return BLB_OpenMem(data, (u32)size, blb);
+    if (BLB_ParseHeader(data, (u32)size, blb) != 0) {
+        free(data);
+        return -1;
+    }
+    
+    blb->backend = BLB_BACKEND_HEAP;
+    return 0;
+}
+
+int BLB_Open(const char* path, BLBFile* blb) {
+    return BLB_OpenEx(path, blb, 0);
+}
+
+int BLB_OpenEx(const char* path, BLBFile* blb, u32 flags) {
+    if (!path || !blb) {
+        return -1;
+    }
+    
+    memset(blb, 0, sizeof(BLBFile));
+    
+#ifdef BLB_HAVE_MMAP
+    if ((flags & BLB_OPEN_NO_MMAP) || open_mapped(path, blb) != 0)
+#endif
+    {
+        if (open_heap(path, blb) != 0) {
+            return -1;
+        }
+    }
+    
+    /* Warm start from <path>.blbidx, else scan (and write it if asked) */
+    blb->index = BLBIndex_Open(blb, path, flags, 0);
+    
+    return 0;
 }
 
 int BLB_OpenMem(const u8* data, u32 size, BLBFile* blb) {
+    if (BLB_ParseHeader(data, size, blb) != 0) {
+        return -1;
+    }
+    
+    /* Resolve every segment TOC once. Failure only costs the fast path. */
+    blb->index = BLBIndex_Create(blb, 0);
+    
+    return 0;
+}
+
+/* Attach data and read counts; no index. */
+int BLB_ParseHeader(const u8* data, u32 size, BLBFile* blb) {
     if (!data || !blb || size < BLB_HEADER_SIZE) {
         return -1;
     }
@@ -98,6 +190,12 @@ int BLB_OpenMem(const u8* data, u32 size, BLBFile* blb) {
     blb->data = (u8*)data;
     blb->size = size;
     blb->header = (u8*)data;
+    blb->backend = BLB_BACKEND_BORROWED;
+    blb->trusted = 0;
+    blb->cache = NULL;
+    blb->index = NULL;
+    blb->writer = NULL;
+    blb->async = NULL;
     
     /* Detect version */
     blb->is_jp = detect_jp_layout(blb->header);
@@ -117,10 +215,122 @@ int BLB_OpenMem(const u8* data, u32 size, BLBFile* blb) {
 }
 
 void BLB_Close(BLBFile* blb) {
-    if (blb && blb->data) {
+    if (!blb || (!blb->data && !blb->cache && !blb->writer)) {
+        return;
+    }
+    
+    /* Loader thread reads through the backend - stop it first */
+    BLBAsync_Destroy(blb->async, blb);
+    BLBIndex_Free(blb->index);
+    BLBWriter_Destroy(blb->writer);
+    
+    switch (blb->backend) {
+    case BLB_BACKEND_PAGED:
+        BLBCache_Destroy(blb->cache);  /* Also owns the header copy */
+        break;
+    case BLB_BACKEND_HEAP:
         free(blb->data);
-        memset(blb, 0, sizeof(BLBFile));
+        break;
+#ifdef BLB_HAVE_MMAP
+    case BLB_BACKEND_MMAP:
+        munmap(blb->data, blb->size);
+        break;
+#endif
+    default:
+        /* Borrowed - caller frees; stream header belongs to the writer */
+        break;
+    }
+    
+    memset(blb, 0, sizeof(BLBFile));
+}
+
+const u8* BLB_AcquireSegment(const BLBFile* blb, u16 sector_offset,
+                             u16 sector_count, u32* out_size) {
+    const u8* segment;
+    u32 avail;
+    
+    if (out_size) *out_size = 0;
+    if (!blb) {
+        return NULL;
+    }
+    
+    if (blb->backend == BLB_BACKEND_PAGED) {
+        u32 size = 0;
+        
+        segment = BLBCache_Acquire(blb->cache, sector_offset, sector_count, &size);
+        if (segment) {
+            BLBIndex_Touch(blb->index, sector_offset, segment, size);
+        }
+        if (out_size) *out_size = size;
+        return segment;
+    }
+    
+    /* Whole file is addressable - nothing to pin */
+    segment = BLB_GetSectorData(blb, sector_offset);
+    if (!segment) {
+        return NULL;
     }
+    
+    BLB_AdviseSegment(blb, sector_offset, sector_count, BLB_ADVISE_WILLNEED);
+    
+    avail = blb->size - (u32)sector_offset * BLB_SECTOR_SIZE;
+    if (out_size) {
+        u32 span = (u32)sector_count * BLB_SECTOR_SIZE;
+        *out_size = (span && span < avail) ? span : avail;
+    }
+    return segment;
+}
+
+void BLB_ReleaseSegment(const BLBFile* blb, const u8* segment) {
+    if (blb && blb->backend == BLB_BACKEND_PAGED) {
+        BLBCache_Release(blb->cache, segment);
+    }
+}
+
+void BLB_GetCacheStats(const BLBFile* blb, u32* out_resident,
+                       u32* out_hits, u32* out_misses) {
+    BLBCache_GetStats(blb && blb->backend == BLB_BACKEND_PAGED ? blb->cache : NULL,
+                      out_resident, out_hits, out_misses);
+}
+
+void BLB_AdviseSegment(const BLBFile* blb, u16 sector_offset, u16 sector_count,
+                       int advice) {
+#ifdef BLB_HAVE_MMAP
+    static const int advice_map[] = {
+        POSIX_MADV_NORMAL, POSIX_MADV_RANDOM, POSIX_MADV_SEQUENTIAL,
+        POSIX_MADV_WILLNEED, POSIX_MADV_DONTNEED
+    };
+    uintptr_t start, end, page;
+    long page_size;
+    
+    if (!blb || blb->backend != BLB_BACKEND_MMAP || sector_count == 0) {
+        return;
+    }
+    if (advice < 0 || advice > BLB_ADVISE_DONTNEED) {
+        return;
+    }
+    
+    start = (uintptr_t)sector_offset * BLB_SECTOR_SIZE;
+    end = start + (uintptr_t)sector_count * BLB_SECTOR_SIZE;
+    if (start >= blb->size) {
+        return;
+    }
+    if (end > blb->size) {
+        end = blb->size;
+    }
+    
+    /* Advice ranges must start on a page boundary */
+    page_size = sysconf(_SC_PAGESIZE);
+    page = page_size > 0 ? (uintptr_t)page_size : 4096;
+    start &= ~(page - 1);
+    
+    posix_madvise(blb->data + start, end - start, advice_map[advice]);
+#else
+    (void)blb;
+    (void)sector_offset;
+    (void)sector_count;
+    (void)advice;
+#endif
 }
 
 /* -----------------------------------------------------------------------------
@@ -266,9 +476,24 @@ const u8* BLB_FindAsset(const BLBFile* blb, const u8* segment_start,
         return NULL;
     }
     
-    /* Read TOC count */
+    /* Indexed segment of an in-memory archive - no scan needed */
+    if (blb->index && blb->data && segment_start >= blb->data &&
+        segment_start < blb->data + blb->size) {
+        u32 rel = (u32)(segment_start - blb->data);
+        
+        if ((rel % BLB_SECTOR_SIZE) == 0 && rel / BLB_SECTOR_SIZE <= 0xFFFF) {
+            const BLBIndexEntry* entry = BLB_LookupAsset(blb, (u16)(rel / BLB_SECTOR_SIZE),
+                                                         asset_id);
+            if (entry || BLB_GetSegmentAssets(blb, (u16)(rel / BLB_SECTOR_SIZE), NULL)) {
+                if (out_size) *out_size = entry ? entry->size : 0;
+                return entry ? segment_start + entry->offset : NULL;
+            }
+        }
+    }
+    
+    /* Read TOC count (already range-checked on a validated archive) */
     count = read_u32(segment_start);
-    if (count > 100) {
+    if (!BLB_IS_TRUSTED(blb) && count > 100) {
         if (out_size) *out_size = 0;
         return NULL;
     }
@@ -336,19 +561,34 @@ const u16* BLB_GetPaletteFromContainer(const u8* palette_data, u8 palette_index,
     return (const u16*)(palette_data + pal_offset);
 }
 
-u32 BLB_PSXColorToRGBA(u16 psx_color) {
-    u8 r, g, b, a;
+const u8* BLB_GetSubAsset(const u8* container, u32 container_size, u32 index,
+                          u32* out_size) {
+    u32 count, entry_size, entry_offset;
+    const u8* sub_toc;
+    
+    if (out_size) *out_size = 0;
+    if (!container || container_size < 4) {
+        return NULL;
+    }
     
-    /* PSX format: 0BBBBBGGGGGRRRRR (5 bits per channel) */
-    r = (psx_color & 0x1F) << 3;          /* Red: bits 0-4 */
-    g = ((psx_color >> 5) & 0x1F) << 3;   /* Green: bits 5-9 */
-    b = ((psx_color >> 10) & 0x1F) << 3;  /* Blue: bits 10-14 */
+    count = read_u32(container);
+    if (index >= count || count > (container_size - 4) / 12) {
+        return NULL;
+    }
     
-    /* Color index 0 is transparent, bit 15 = semi-transparent flag */
-    a = (psx_color == 0) ? 0 : 255;
+    sub_toc = container + 4 + (index * 12);
+    entry_size = read_u32(sub_toc + 4);
+    entry_offset = read_u32(sub_toc + 8);
+    if (entry_offset > container_size || entry_size > container_size - entry_offset) {
+        return NULL;
+    }
     
-    /* Return as 0xAABBGGRR */
-    return ((u32)a << 24) | ((u32)b << 16) | ((u32)g << 8) | r;
+    if (out_size) *out_size = entry_size;
+    return container + entry_offset;
+}
+
+u32 BLB_PSXColorToRGBA(u16 psx_color) {
+    return psx_color_to_rgba(psx_color);
 }
 
 /* -----------------------------------------------------------------------------
@@ -377,20 +617,28 @@ int BLB_ParseSpriteContainer(const u8* sprite_data, u32* out_count) {
 
 const u8* BLB_GetSpriteFromContainer(const u8* sprite_data, u32 sprite_index,
                                      u32* out_sprite_id, u32* out_size) {
+    /* Size unknown - still rejects bad counts and wrapping offsets */
+    return BLB_GetSpriteFromContainerEx(sprite_data, 0xFFFFFFFFu, sprite_index,
+                                        out_sprite_id, out_size);
+}
+
+const u8* BLB_GetSpriteFromContainerEx(const u8* sprite_data, u32 container_size,
+                                       u32 sprite_index, u32* out_sprite_id,
+                                       u32* out_size) {
     u32 count, sprite_id, sprite_size, sprite_offset;
     const u8* toc_entry;
     
-    if (!sprite_data) {
-        if (out_sprite_id) *out_sprite_id = 0;
-        if (out_size) *out_size = 0;
+    if (out_sprite_id) *out_sprite_id = 0;
+    if (out_size) *out_size = 0;
+    
+    if (!sprite_data || container_size < 4) {
         return NULL;
     }
     
-    /* Read TOC count */
+    /* Read TOC count (same limit as BLB_ParseSpriteContainer) */
     count = read_u32(sprite_data);
-    if (sprite_index >= count) {
-        if (out_sprite_id) *out_sprite_id = 0;
-        if (out_size) *out_size = 0;
+    if (count > 500 || sprite_index >= count ||
+        4 + count * 12 > container_size) {
         return NULL;
     }
     
@@ -400,6 +648,12 @@ const u8* BLB_GetSpriteFromContainer(const u8* sprite_data, u32 sprite_index,
     sprite_size = read_u32(toc_entry + 4);
     sprite_offset = read_u32(toc_entry + 8);
     
+    /* Sprite must lie after the TOC and inside the container */
+    if (sprite_offset < 4 + count * 12 || sprite_offset > container_size ||
+        sprite_size > container_size - sprite_offset) {
+        return NULL;
+    }
+    
     if (out_sprite_id) *out_sprite_id = sprite_id;
     if (out_size) *out_size = sprite_size;
     
@@ -496,279 +750,3 @@ const u16* BLB_GetSpritePalette(const u8* sprite_data, u32 palette_offset) {
     /* Palette is 256 colors × 2 bytes = 512 bytes */
     return (const u16*)(sprite_data + palette_offset);
 }
-
-/* -----------------------------------------------------------------------------
- * BLB File Write Operations
- * -------------------------------------------------------------------------- */
-
-BLBFile* BLB_Create(u8 level_count) {
-    BLBFile* blb;
-    u32 total_size;
-    
-    if (level_count == 0 || level_count > BLB_MAX_LEVELS) {
-        return NULL;
-    }
-    
-    blb = (BLBFile*)calloc(1, sizeof(BLBFile));
-    if (!blb) {
-        return NULL;
-    }
-    
-    /* Allocate initial space: header + some sectors */
-    /* Start with 64MB which should be plenty for most BLB files */
-    total_size = 64 * 1024 * 1024;
-    blb->data = (u8*)calloc(1, total_size);
-    if (!blb->data) {
-        free(blb);
-        return NULL;
-    }
-    
-    blb->size = total_size;
-    blb->header = blb->data;
-    blb->level_count = level_count;
-    blb->movie_count = 0;
-    blb->sector_count = 0;
-    blb->is_jp = 0;  /* Default to PAL layout */
-    
-    /* Write counts to header */
-    blb->header[BLB_OFF_LEVEL_COUNT] = level_count;
-    blb->header[BLB_OFF_MOVIE_COUNT] = 0;
-    blb->header[BLB_OFF_SECTOR_COUNT] = 0;
-    
-    return blb;
-}
-
-int BLB_SetLevelMetadata(BLBFile* blb, u8 level_index,
-                         const char* level_id, const char* level_name,
-                         u16 stage_count) {
-    u8* entry;
-    int i;
-    
-    if (!blb || !level_id || !level_name) {
-        return -1;
-    }
-    
-    if (level_index >= blb->level_count) {
-        return -1;
-    }
-    
-    if (stage_count == 0 || stage_count > BLB_MAX_STAGES) {
-        return -1;
-    }
-    
-    /* Get level entry */
-    entry = blb->header + BLB_OFF_LEVEL_TABLE + (level_index * BLB_LEVEL_ENTRY_SIZE);
-    
-    /* Write level ID (4 chars + null) */
-    memset(entry + LEVEL_OFF_LEVEL_ID, 0, 5);
-    for (i = 0; i < 4 && level_id[i]; i++) {
-        entry[LEVEL_OFF_LEVEL_ID + i] = (u8)level_id[i];
-    }
-    
-    /* Write level name (max 20 chars + null) */
-    memset(entry + LEVEL_OFF_LEVEL_NAME, 0, 21);
-    for (i = 0; i < 20 && level_name[i]; i++) {
-        entry[LEVEL_OFF_LEVEL_NAME + i] = (u8)level_name[i];
-    }
-    
-    /* Write stage count */
-    entry[LEVEL_OFF_STAGE_COUNT + 0] = (u8)(stage_count & 0xFF);
-    entry[LEVEL_OFF_STAGE_COUNT + 1] = (u8)((stage_count >> 8) & 0xFF);
-    
-    return 0;
-}
-
-int BLB_WriteSegment(BLBFile* blb, u8 level_index, u8 stage_index,
-                     const u8* segment_data, u32 segment_size,
-                     u8 segment_type) {
-    (void)blb;
-    (void)level_index;
-    (void)stage_index;
-    (void)segment_data;
-    (void)segment_size;
-    (void)segment_type;
-    
-    /* TODO: Implement segment writing
-     * This needs to:
-     * 1. Find next available sector
-     * 2. Write segment data to sectors
-     * 3. Update level entry with sector offset/count
-     * 4. Update BLB file size if needed
-     */
-    return -1;
-}
-
-int BLB_WriteToFile(const BLBFile* blb, const char* path) {
-    FILE* f;
-    
-    if (!blb || !path || !blb->data) {
-        return -1;
-    }
-    
-    f = fopen(path, "wb");
-    if (!f) {
-        return -1;
-    }
-    
-    /* Write entire BLB data */
-    if (fwrite(blb->data, 1, blb->size, f) != blb->size) {
-        fclose(f);
-        return -1;
-    }
-    
-    fclose(f);
-    return 0;
-}
-
-/* -----------------------------------------------------------------------------
- * Segment Building Helpers
- * -------------------------------------------------------------------------- */
-
-int BLB_SegmentBuilder_Init(SegmentBuilder* builder) {
-    if (!builder) {
-        return -1;
-    }
-    
-    memset(builder, 0, sizeof(SegmentBuilder));
-    
-    /* Allocate initial capacity */
-    builder->capacity = 32;
-    builder->entries = (TOCEntry*)calloc(builder->capacity, sizeof(TOCEntry));
-    if (!builder->entries) {
-        return -1;
-    }
-    
-    builder->data_capacity = 1024 * 1024;  /* 1MB initial */
-    builder->data = (u8*)malloc(builder->data_capacity);
-    if (!builder->data) {
-        free(builder->entries);
-        return -1;
-    }
-    
-    builder->asset_count = 0;
-    builder->data_size = 0;
-    
-    return 0;
-}
-
-int BLB_SegmentBuilder_AddAsset(SegmentBuilder* builder, u32 asset_id,
-                                const u8* data, u32 size) {
-    u32 offset;
-    
-    if (!builder || !data) {
-        return -1;
-    }
-    
-    /* Ensure capacity */
-    if (builder->asset_count >= builder->capacity) {
-        u32 new_cap = builder->capacity * 2;
-        TOCEntry* new_entries = (TOCEntry*)realloc(builder->entries, 
-                                                   new_cap * sizeof(TOCEntry));
-        if (!new_entries) {
-            return -1;
-        }
-        builder->entries = new_entries;
-        builder->capacity = new_cap;
-    }
-    
-    /* Calculate offset in segment (after TOC) */
-    /* TOC is: u32 count + TOCEntry array */
-    offset = 4 + (builder->asset_count + 1) * sizeof(TOCEntry);
-    
-    /* Ensure data capacity */
-    while (builder->data_size + size > builder->data_capacity) {
-        u32 new_cap = builder->data_capacity * 2;
-        u8* new_data = (u8*)realloc(builder->data, new_cap);
-        if (!new_data) {
-            return -1;
-        }
-        builder->data = new_data;
-        builder->data_capacity = new_cap;
-    }
-    
-    /* Add TOC entry */
-    builder->entries[builder->asset_count].id = asset_id;
-    builder->entries[builder->asset_count].size = size;
-    builder->entries[builder->asset_count].offset = offset + builder->data_size;
-    
-    /* Copy data */
-    memcpy(builder->data + builder->data_size, data, size);
-    builder->data_size += size;
-    builder->asset_count++;
-    
-    return 0;
-}
-
-u8* BLB_SegmentBuilder_Finalize(SegmentBuilder* builder, u32* out_size) {
-    u8* segment;
-    u32 total_size;
-    u32 toc_size;
-    u32 i;
-    
-    if (!builder || !out_size) {
-        return NULL;
-    }
-    
-    /* Calculate total size */
-    toc_size = 4 + builder->asset_count * sizeof(TOCEntry);
-    total_size = toc_size + builder->data_size;
-    
-    /* Allocate final segment */
-    segment = (u8*)malloc(total_size);
-    if (!segment) {
-        return NULL;
-    }
-    
-    /* Write TOC count */
-    segment[0] = (u8)(builder->asset_count & 0xFF);
-    segment[1] = (u8)((builder->asset_count >> 8) & 0xFF);
-    segment[2] = (u8)((builder->asset_count >> 16) & 0xFF);
-    segment[3] = (u8)((builder->asset_count >> 24) & 0xFF);
-    
-    /* Write TOC entries */
-    for (i = 0; i < builder->asset_count; i++) {
-        u8* entry = segment + 4 + i * sizeof(TOCEntry);
-        const TOCEntry* src = &builder->entries[i];
-        
-        /* Write as little-endian */
-        entry[0] = (u8)(src->id & 0xFF);
-        entry[1] = (u8)((src->id >> 8) & 0xFF);
-        entry[2] = (u8)((src->id >> 16) & 0xFF);
-        entry[3] = (u8)((src->id >> 24) & 0xFF);
-        
-        entry[4] = (u8)(src->size & 0xFF);
-        entry[5] = (u8)((src->size >> 8) & 0xFF);
-        entry[6] = (u8)((src->size >> 16) & 0xFF);
-        entry[7] = (u8)((src->size >> 24) & 0xFF);
-        
-        entry[8] = (u8)(src->offset & 0xFF);
-        entry[9] = (u8)((src->offset >> 8) & 0xFF);
-        entry[10] = (u8)((src->offset >> 16) & 0xFF);
-        entry[11] = (u8)((src->offset >> 24) & 0xFF);
-    }
-    
-    /* Copy asset data */
-    memcpy(segment + toc_size, builder->data, builder->data_size);
-    
-    *out_size = total_size;
-    return segment;
-}
-
-void BLB_SegmentBuilder_Free(SegmentBuilder* builder) {
-    if (!builder) return;
-    
-    if (builder->entries) {
-        free(builder->entries);
-        builder->entries = NULL;
-    }
-    
-    if (builder->data) {
-        free(builder->data);
-        builder->data = NULL;
-    }
-    
-    builder->asset_count = 0;
-    builder->capacity = 0;
-    builder->data_size = 0;
-    builder->data_capacity = 0;
-}
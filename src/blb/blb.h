@@ -18,6 +18,16 @@
  *   0xF32          Movie count (u8)
  * 
  * See docs/blb-data-format.md for complete specification.
+ * 
+ * THREAD SAFETY: functions taking a const BLBFile* only read the handle,
+ * so one open archive can be shared by any number of threads. The paged
+ * cache takes its lock on every acquire and release; the lazily built
+ * asset index of a paged handle takes its lock for each lookup and each
+ * segment it indexes. Mapped and heap handles index eagerly and read the
+ * index without locking. Functions
+ * taking a non-const BLBFile* - open/close, BLB_Validate, the async queue
+ * and the writer - must not overlap with other use of the same handle
+ * unless their comment says otherwise.
  */
 
 #ifndef BLB_H
@@ -42,6 +52,7 @@
 #define BLB_OFF_LEVEL_COUNT     0xF31
 #define BLB_OFF_MOVIE_COUNT     0xF32
 #define BLB_OFF_SECTOR_COUNT    0xF33
+#define BLB_OFF_LAYOUT_CODE     0xCD3   /* sectors[0] code[0]: A-Z on PAL */
 
 /* Level entry field offsets (within 0x70-byte entry) */
 #define LEVEL_OFF_PRIMARY_SECTOR    0x00    /* u16 */
@@ -51,6 +62,7 @@
 #define LEVEL_OFF_ASSET_INDEX       0x0C    /* u8 */
 #define LEVEL_OFF_PASSWORD_FLAG     0x0D    /* u8 */
 #define LEVEL_OFF_STAGE_COUNT       0x0E    /* u16 */
+#define LEVEL_OFF_TERT_SIZES        0x10    /* u16[7], size >> 5 */
 #define LEVEL_OFF_SEC_SECTOR        0x1E    /* u16[7] */
 #define LEVEL_OFF_SEC_COUNT         0x2C    /* u16[7] */
 #define LEVEL_OFF_TERT_SECTOR       0x3A    /* u16[7] */
@@ -89,10 +101,59 @@ typedef struct {
     u32 offset;     /* Offset from segment start */
 } TOCEntry;
 
+/* -----------------------------------------------------------------------------
+ * Asset Index Entry (16 bytes)
+ * 
+ * One TOC entry resolved at open time. item_count is a derived count so
+ * callers don't have to touch the asset itself:
+ *   100        total tiles (16x16 + 8x8 + extra)
+ *   200/400    tilemap / palette sub-TOC count
+ *   600/601    sprite / sound container count
+ *   201/501    layer / entity count (size / record size)
+ *   others     0
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    u32 id;         /* Asset type ID */
+    u32 size;       /* Data size in bytes */
+    u32 offset;     /* Offset from segment start */
+    u32 item_count; /* Derived element count (see above) */
+} BLBIndexEntry;
+
+/**
+ * Derived per-stage counts, straight from the asset index.
+ */
+typedef struct {
+    u32 tile_count;     /* Asset 100 */
+    u32 layer_count;    /* Asset 201 */
+    u32 entity_count;   /* Asset 501 */
+    u32 palette_count;  /* Asset 400 */
+    u32 tilemap_count;  /* Asset 200 */
+    u32 sprite_count;   /* Asset 600 in primary + tertiary */
+    u32 sound_count;    /* Asset 601 in primary + tertiary */
+} BLBStageInfo;
+
 /* -----------------------------------------------------------------------------
  * BLB File Handle
  * -------------------------------------------------------------------------- */
 
+/**
+ * Storage backend behind BLBFile.data.
+ * Decides what BLB_Close has to release.
+ */
+typedef enum {
+    BLB_BACKEND_BORROWED = 0,   /* Caller-owned buffer (BLB_OpenMem) */
+    BLB_BACKEND_HEAP     = 1,   /* malloc'd copy owned by the handle */
+    BLB_BACKEND_MMAP     = 2,   /* Read-only file mapping owned by the handle */
+    BLB_BACKEND_PAGED    = 3,   /* Header only; segments pread on demand */
+    BLB_BACKEND_STREAM   = 4    /* Header only; segments written to a file */
+} BLBBackend;
+
+typedef struct BLBSegmentCache BLBSegmentCache;
+typedef struct BLBIndex BLBIndex;
+typedef struct BLBWriter BLBWriter;
+typedef struct BLBAsyncQueue BLBAsyncQueue;
+
 typedef struct {
     u8*     data;           /* Memory-mapped or loaded file data */
     u32     size;           /* Total file size */
@@ -101,20 +162,69 @@ typedef struct {
     u8      movie_count;    /* Number of movies */
     u8      sector_count;   /* Number of sector entries */
     u8      is_jp;          /* True if JP version (different offsets) */
+    u8      backend;        /* BLBBackend - who owns data */
+    u8      trusted;        /* Set by BLB_Validate when every check passed */
+    BLBSegmentCache* cache; /* Paged backend only (data is NULL) */
+    BLBIndex* index;        /* Per-segment asset index (owned) */
+    BLBWriter* writer;      /* BLB_Create/BLB_CreateStream only (owned) */
+    BLBAsyncQueue* async;   /* Loader thread, created on first async load */
 } BLBFile;
 
+/* BLB_OpenEx flags */
+#define BLB_OPEN_NO_MMAP        0x01    /* Read into a heap buffer instead of mapping */
+#define BLB_OPEN_NO_SIDECAR     0x02    /* Don't read or write <path>.blbidx */
+#define BLB_OPEN_WRITE_SIDECAR  0x04    /* Write <path>.blbidx on a cold start */
+
+/* Sidecar index catalog kept next to the archive */
+#define BLB_SIDECAR_SUFFIX  ".blbidx"
+
+/* BLB_AdviseSegment hints (mirror madvise) */
+#define BLB_ADVISE_NORMAL       0
+#define BLB_ADVISE_RANDOM       1
+#define BLB_ADVISE_SEQUENTIAL   2
+#define BLB_ADVISE_WILLNEED     3
+#define BLB_ADVISE_DONTNEED     4
+
+/* Default resident budget for BLB_OpenPaged (bytes) */
+#define BLB_PAGED_DEFAULT_BUDGET    (16u * 1024 * 1024)
+
+/**
+ * Skip redundant bounds checks on a validated archive.
+ * Release builds only - debug builds always check, so a gap in the
+ * validator shows up as a failed lookup rather than a stray read.
+ */
+#ifdef NDEBUG
+#define BLB_IS_TRUSTED(blb) ((blb) != NULL && (blb)->trusted)
+#else
+#define BLB_IS_TRUSTED(blb) 0
+#endif
+
 /* -----------------------------------------------------------------------------
  * BLB File Operations
  * -------------------------------------------------------------------------- */
 
 /**
  * Open a BLB file and parse the header.
+ * The file is mapped read-only (shared page cache, nothing copied);
+ * platforms without mmap fall back to reading it into the heap.
+ * The asset index is taken from <path>.blbidx when that catalog matches
+ * the archive, otherwise built by scanning. Nothing is written next to
+ * the archive unless BLB_OpenEx is given BLB_OPEN_WRITE_SIDECAR.
  * @param path      Path to GAME.BLB file
  * @param blb       Output BLB file handle
  * @return          0 on success, -1 on error
  */
 int BLB_Open(const char* path, BLBFile* blb);
 
+/**
+ * Open a BLB file with explicit backend flags.
+ * @param path      Path to GAME.BLB file
+ * @param blb       Output BLB file handle
+ * @param flags     BLB_OPEN_* flags (0 = same as BLB_Open)
+ * @return          0 on success, -1 on error
+ */
+int BLB_OpenEx(const char* path, BLBFile* blb, u32 flags);
+
 /**
  * Open a BLB file from memory buffer.
  * @param data      Pointer to BLB data in memory
@@ -126,9 +236,70 @@ int BLB_OpenMem(const u8* data, u32 size, BLBFile* blb);
 
 /**
  * Close a BLB file and free resources.
+ * Heap buffers are freed and mappings unmapped; memory passed to
+ * BLB_OpenMem stays owned by the caller.
+ * No other thread may be using blb, and every segment and LevelContext
+ * taken from it must already be released.
  */
 void BLB_Close(BLBFile* blb);
 
+/**
+ * Open a BLB file in paged mode.
+ * Only the 0x1000-byte header is read up front. Segments are read on
+ * demand through BLB_AcquireSegment and kept in a bounded LRU cache, so
+ * resident memory tracks the stages actually in use.
+ * BLB_GetSectorData returns NULL on paged handles.
+ * 
+ * TOOL-ONLY: Not present in original game (which streams from CD).
+ * 
+ * @param path          Path to GAME.BLB file
+ * @param blb           Output BLB file handle
+ * @param cache_budget  Max bytes of unpinned segments to keep (0 = default)
+ * @return              0 on success, -1 on error
+ */
+int BLB_OpenPaged(const char* path, BLBFile* blb, u32 cache_budget);
+
+/**
+ * Get a pinned pointer to a whole segment (sector run).
+ * The pointer stays valid until the matching BLB_ReleaseSegment, whatever
+ * the backend. Paged handles read the run on a cache miss; mapped handles
+ * get a WILLNEED hint for the run.
+ * 
+ * @param sector_offset     First sector of the segment
+ * @param sector_count      Segment length in sectors (from the level entry)
+ * @param out_size          Output: bytes available at the returned pointer
+ * @return                  Pointer to segment start, or NULL on error
+ */
+const u8* BLB_AcquireSegment(const BLBFile* blb, u16 sector_offset,
+                             u16 sector_count, u32* out_size);
+
+/**
+ * Unpin a segment returned by BLB_AcquireSegment.
+ * segment may also be any pointer into it, e.g. an asset found there.
+ * Paged handles may evict it once the cache is over budget; it is kept
+ * resident otherwise, so re-acquiring is cheap.
+ */
+void BLB_ReleaseSegment(const BLBFile* blb, const u8* segment);
+
+/**
+ * Get paged cache statistics (all zero for other backends).
+ * @param out_resident  Output: bytes currently cached (optional)
+ * @param out_hits      Output: acquire hits (optional)
+ * @param out_misses    Output: acquire misses / reads (optional)
+ */
+void BLB_GetCacheStats(const BLBFile* blb, u32* out_resident,
+                       u32* out_hits, u32* out_misses);
+
+/**
+ * Hint the OS about upcoming access to a sector run.
+ * Only has an effect on the mmap backend, no-op otherwise.
+ * @param sector_offset     First sector of the run
+ * @param sector_count      Number of sectors
+ * @param advice            BLB_ADVISE_* hint
+ */
+void BLB_AdviseSegment(const BLBFile* blb, u16 sector_offset, u16 sector_count,
+                       int advice);
+
 /* -----------------------------------------------------------------------------
  * Header Accessors (match original decompiled patterns)
  * -------------------------------------------------------------------------- */
@@ -230,6 +401,144 @@ const TOCEntry* BLB_GetSegmentTOC(const BLBFile* blb, u16 sector_offset, u32* ou
 const u8* BLB_FindAsset(const BLBFile* blb, const u8* segment_start, 
                         u32 asset_id, u32* out_size);
 
+/* -----------------------------------------------------------------------------
+ * Asset Index (TOOL-ONLY)
+ * 
+ * Built once per archive so lookups don't rescan TOCs. In-memory backends
+ * index every segment at open; the paged backend indexes a segment the
+ * first time it is acquired, so acquire before looking up.
+ * -------------------------------------------------------------------------- */
+
+/**
+ * Get every indexed asset of a segment, in TOC order.
+ * @param sector_offset     First sector of the segment
+ * @param out_count         Output: number of entries
+ * @return                  Entry array, or NULL if segment is unknown/invalid
+ */
+const BLBIndexEntry* BLB_GetSegmentAssets(const BLBFile* blb, u16 sector_offset,
+                                          u32* out_count);
+
+/**
+ * Get derived counts for a level/stage from the index.
+ * Paged handles only know stages whose segments have been acquired
+ * (or that came from a sidecar catalog).
+ * @return  0 on success, -1 if the stage's segments aren't indexed
+ */
+int BLB_GetStageInfo(const BLBFile* blb, u8 level_index, u8 stage_index,
+                     BLBStageInfo* out_info);
+
+/**
+ * Write the asset index to <archive_path>.blbidx.
+ * BLB_OpenEx does this on a cold start with BLB_OPEN_WRITE_SIDECAR.
+ * Lazily indexed paged handles can't be saved.
+ *
+ * The catalog is matched to the archive by size and a hash of what the
+ * index is built from: the header, every segment TOC and the asset
+ * fields behind item_count. File times don't matter, so a fresh checkout
+ * of the same archive reuses it. Every entry is checked to stay inside
+ * its segment's sector run when the catalog is loaded.
+ * @param archive_path  Path of the archive blb was opened from
+ * @return              0 on success, -1 on error
+ */
+int BLB_SaveIndex(const BLBFile* blb, const char* archive_path);
+
+/**
+ * Look up one asset of a segment in O(1).
+ * @param sector_offset     First sector of the segment
+ * @param asset_id          Asset type ID
+ * @return                  Entry, or NULL if not present
+ */
+const BLBIndexEntry* BLB_LookupAsset(const BLBFile* blb, u16 sector_offset,
+                                     u32 asset_id);
+
+/* -----------------------------------------------------------------------------
+ * Archive Validation (TOOL-ONLY)
+ * 
+ * One pass over every level, stage, asset and sub-TOC. An archive that
+ * passes is marked trusted and the hot accessors stop re-checking offsets
+ * on every call (see BLB_IS_TRUSTED).
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    u32 segments_checked;   /* Distinct sector runs visited */
+    u32 segments_failed;
+    u32 assets_checked;     /* Top-level TOC entries */
+    u32 first_bad_sector;   /* First failing segment (0xFFFFFFFF if none) */
+    u32 first_bad_asset;    /* Asset ID that failed there (0 = TOC/header) */
+    u32 thread_count;       /* Workers actually used */
+    u64 bytes_checked;      /* Segment bytes covered */
+    u64 elapsed_us;         /* Wall time of the pass */
+} BLBValidateReport;
+
+/**
+ * Validate the whole archive on worker threads and mark it trusted.
+ * Works on every backend; paged handles read each segment once through
+ * the cache. Call before sharing blb between threads.
+ * @param thread_count  Worker count (0 = one per online CPU)
+ * @param out_report    Optional: counts and timing
+ * @return              0 if everything passed (blb->trusted set), -1 if not
+ */
+int BLB_Validate(BLBFile* blb, u32 thread_count, BLBValidateReport* out_report);
+
+/* -----------------------------------------------------------------------------
+ * Async Segment Loading (TOOL-ONLY)
+ * 
+ * Replaces the original's CD streaming (TickCDStreamBuffer). Requests are
+ * read on a loader thread - pread into the paged cache, or page faults
+ * taken up front for mapped archives - and completions are handed back
+ * only from BLB_PollAsync, so callbacks run on the polling (game) thread.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    u32 request_id;         /* From BLB_LoadSegmentAsync */
+    u8  level_index;
+    u8  stage_index;
+    u8  segment_type;       /* 0=primary, 1=secondary, 2=tertiary */
+    u8  pad;
+    int status;             /* 0 = loaded, -1 = read failed */
+    const u8* data;         /* Pinned segment (NULL on failure) */
+    u32 size;
+} BLBAsyncResult;
+
+/**
+ * Completion callback. Owns the pin on result->data: call
+ * BLB_ReleaseSegment when done with it.
+ */
+typedef void (*BLBAsyncCallback)(BLBFile* blb, const BLBAsyncResult* result, void* user);
+
+/**
+ * Queue a segment read for a level/stage.
+ * With a NULL callback the read only warms the cache and the segment is
+ * released when the completion is polled.
+ * @param segment_type  0=primary, 1=secondary, 2=tertiary
+ * @param callback      Completion callback (may be NULL)
+ * @param user          Passed to callback
+ * Submit from one thread (the one that polls); the loader thread is
+ * created by the first call.
+ * @return              Request id (never 0), or 0 on error
+ */
+u32 BLB_LoadSegmentAsync(BLBFile* blb, u8 level_index, u8 stage_index,
+                         u8 segment_type, BLBAsyncCallback callback, void* user);
+
+/**
+ * Deliver finished requests, running their callbacks in this thread.
+ * Never blocks. Call once per frame.
+ * @return              Number of completions delivered
+ */
+u32 BLB_PollAsync(BLBFile* blb);
+
+/**
+ * Block until every queued request has finished, then deliver them.
+ * @return              Number of completions delivered
+ */
+u32 BLB_WaitAsync(BLBFile* blb);
+
+/**
+ * Requests queued but not yet delivered by a poll.
+ * Safe from any thread.
+ */
+u32 BLB_GetAsyncPending(const BLBFile* blb);
+
 /* -----------------------------------------------------------------------------
  * Palette Parsing
  * -------------------------------------------------------------------------- */
@@ -255,11 +564,24 @@ int BLB_ParsePaletteContainer(const u8* palette_data, u32* out_count);
 const u16* BLB_GetPaletteFromContainer(const u8* palette_data, u8 palette_index, u32* out_size);
 
 /**
- * Convert PSX 15-bit color to RGBA (0xARGB format).
+ * Get one entry of a sub-TOC container (Asset 200/400/600/601).
+ * Every field is checked against container_size.
+ * 
+ * @param container         Container asset data (u32 count + 12-byte entries)
+ * @param container_size    Size of the container asset in bytes
+ * @param index             Entry index (0-based)
+ * @param out_size          Output: entry size in bytes
+ * @return                  Pointer to entry data, or NULL if out of bounds
+ */
+const u8* BLB_GetSubAsset(const u8* container, u32 container_size, u32 index,
+                          u32* out_size);
+
+/**
+ * Convert PSX 15-bit color to RGBA.
  * PSX format: 0BBBBBGGGGGRRRRR (5 bits per channel)
  * 
  * @param psx_color         PSX 15-bit color value
- * @return                  32-bit RGBA color (0xAABBGGRR)
+ * @return                  32-bit RGBA color (0xAABBGGRR), alpha 0 for 0x0000
  */
 u32 BLB_PSXColorToRGBA(u16 psx_color);
 
@@ -330,6 +652,18 @@ int BLB_ParseSpriteContainer(const u8* sprite_data, u32* out_count);
 const u8* BLB_GetSpriteFromContainer(const u8* sprite_data, u32 sprite_index,
                                      u32* out_sprite_id, u32* out_size);
 
+/**
+ * Get a specific sprite from a container of known size.
+ * Same as BLB_GetSpriteFromContainer, but the TOC and the sprite's byte
+ * range are checked against container_size.
+ * 
+ * @param container_size    Size of the Asset 600 data in bytes
+ * @return                  Pointer to sprite data, or NULL if out of bounds
+ */
+const u8* BLB_GetSpriteFromContainerEx(const u8* sprite_data, u32 container_size,
+                                       u32 sprite_index, u32* out_sprite_id,
+                                       u32* out_size);
+
 /**
  * Parse sprite header.
  * 
@@ -383,7 +717,9 @@ const u16* BLB_GetSpritePalette(const u8* sprite_data, u32 palette_offset);
 
 /**
  * Create a new BLB file in memory for writing.
- * The file is allocated with space for the specified number of levels.
+ * Starts as just the header; each BLB_WriteSegment grows the image by
+ * the sectors it uses. The header is PAL layout with no movie or sector
+ * entries until BLB_CopyHeaderTables fills them in.
  * 
  * TOOL-ONLY: Not present in original game.
  * 
@@ -392,6 +728,35 @@ const u16* BLB_GetSpritePalette(const u8* sprite_data, u32 palette_offset);
  */
 BLBFile* BLB_Create(u8 level_count);
 
+/**
+ * Create a new BLB file that streams segments to disk as they are written.
+ * Only the header stays in memory. Output goes to <path>.tmp and is renamed
+ * to path by BLB_WriteToFile; closing the handle before that deletes it.
+ * Segment data can't be read back through the handle.
+ * 
+ * TOOL-ONLY: Not present in original game.
+ * 
+ * @param path          Destination archive path
+ * @param level_count   Number of levels to allocate (1-26)
+ * @return              BLB file handle (free with BLB_Close + free), or NULL
+ */
+BLBFile* BLB_CreateStream(const char* path, u8 level_count);
+
+/**
+ * Start a new archive's header from an existing PAL archive.
+ * Copies the movie table, sector table and playback arrays (which the
+ * game and the PAL/JP detection rely on) plus each level's ID, name and
+ * flags. Sector runs are cleared and filled in by BLB_WriteSegment.
+ * Call right after BLB_Create/BLB_CreateStream.
+ * 
+ * TOOL-ONLY: Not present in original game.
+ * 
+ * @param blb           BLB file handle being written
+ * @param template_blb  Source archive (e.g. the original GAME.BLB)
+ * @return              0 on success, -1 on error
+ */
+int BLB_CopyHeaderTables(BLBFile* blb, const BLBFile* template_blb);
+
 /**
  * Set level metadata in BLB header.
  * This must be called before writing level data.
@@ -411,13 +776,19 @@ int BLB_SetLevelMetadata(BLBFile* blb, u8 level_index,
 
 /**
  * Write segment data to BLB for a specific level and stage.
- * The data will be written to appropriate sectors and the header updated.
+ * The segment gets the next free sector run (padded to whole sectors) and
+ * the level entry is patched: sector and count, plus PRIMARY_SIZE and the
+ * Entry[1] offset for primaries, or TERT_SIZES for tertiaries.
+ * A segment byte-identical to one already written shares that run
+ * instead (see BLB_GetWriteStats).
+ * Secondary/tertiary stages must be below the stage count set by
+ * BLB_SetLevelMetadata.
  * 
  * TOOL-ONLY: Not present in original game.
  * 
- * @param blb               BLB file handle
+ * @param blb               BLB file handle (from BLB_Create/BLB_CreateStream)
  * @param level_index       Level index (0-based)
- * @param stage_index       Stage index (0-based, 0 = primary)
+ * @param stage_index       Stage index (0-based, ignored for primary)
  * @param segment_data      Segment data buffer
  * @param segment_size      Size of segment data in bytes
  * @param segment_type      0=primary, 1=secondary, 2=tertiary
@@ -427,9 +798,36 @@ int BLB_WriteSegment(BLBFile* blb, u8 level_index, u8 stage_index,
                      const u8* segment_data, u32 segment_size,
                      u8 segment_type);
 
+/**
+ * Segment dedup report for an archive being written.
+ * Sizes count whole sectors, i.e. what lands on disk.
+ */
+typedef struct {
+    u32 segments_written;   /* Distinct segments stored */
+    u32 segments_shared;    /* Slots pointed at an identical earlier run */
+    u64 bytes_written;      /* Segment bytes stored */
+    u64 bytes_saved;        /* Bytes the shared slots would have added */
+} BLBWriteStats;
+
+/**
+ * Get the dedup report of a BLB_Create/BLB_CreateStream handle.
+ * 
+ * TOOL-ONLY: Not present in original game.
+ * 
+ * @param blb           BLB file handle
+ * @param out_stats     Receives the report (zeroed on error)
+ * @return              0 on success, -1 if blb isn't being written
+ */
+int BLB_GetWriteStats(const BLBFile* blb, BLBWriteStats* out_stats);
+
 /**
  * Finalize and write BLB to file.
- * This writes the complete BLB archive to disk.
+ * In-memory handles write the header and the sectors in use. Streaming
+ * handles write the header into the temp file, sync it and rename it to
+ * path (NULL = the BLB_CreateStream path); no more segments after that.
+ * If path is on another filesystem, the file is copied to <path>.tmp
+ * beside it first, so the final rename stays atomic.
+ * A <path>.blbidx catalog left from the old file is deleted.
  * 
  * @param blb           BLB file handle
  * @param path          Output file path
@@ -437,20 +835,82 @@ int BLB_WriteSegment(BLBFile* blb, u8 level_index, u8 stage_index,
  */
 int BLB_WriteToFile(const BLBFile* blb, const char* path);
 
+/**
+ * Replace one segment of an existing archive on disk.
+ * Only the new segment's sectors and its 0x70 byte level entry are
+ * written, so cost follows the edit size rather than the archive size.
+ * A segment that fits its old sector run (and isn't shared with another
+ * slot) is rewritten in place; otherwise it is appended and the entry
+ * repointed, leaving the old run as dead space. Every step is synced
+ * before the entry that references it, so an interrupted patch leaves
+ * the archive loading either the old or the new segment. Removes a
+ * stale <path>.blbidx.
+ * 
+ * Close every BLBFile on the archive first, and reopen it afterwards.
+ * The file is rewritten and truncated in place: a BLB_Open mapping
+ * (MAP_SHARED) would see sectors change under it and fault past the new
+ * end, and a paged handle would mix old and new sectors in its cache.
+ * 
+ * TOOL-ONLY: Not present in original game.
+ * 
+ * @param path              Archive path
+ * @param level_index       Level index (0-based)
+ * @param stage_index       Stage index (0-based, ignored for primary)
+ * @param segment_data      New segment bytes
+ * @param segment_size      Size of segment data in bytes
+ * @param segment_type      0=primary, 1=secondary, 2=tertiary
+ * @param out_sector        Receives the segment's sector (may be NULL)
+ * @return                  0 on success, -1 on error
+ */
+int BLB_PatchSegment(const char* path, u8 level_index, u8 stage_index,
+                     const u8* segment_data, u32 segment_size,
+                     u8 segment_type, u32* out_sector);
+
 /* -----------------------------------------------------------------------------
  * Segment Building Helpers
  * -------------------------------------------------------------------------- */
 
+/* Per-asset flags for BLB_SegmentBuilder_AddAssetRef */
+#define BLB_ASSET_OWNED         0x01    /* Builder frees data (malloc'd) */
+#define BLB_ASSET_ALIGN_SECTOR  0x02    /* Start on a 2048 byte boundary (default 4) */
+
+/**
+ * One asset recorded by a segment builder. Bytes are referenced, not
+ * copied, until the segment is emitted.
+ */
+typedef struct {
+    const u8* data;         /* Source bytes */
+    u64 hash;               /* FNV-1a 64 of data, for dedup */
+    u32 flags;              /* BLB_ASSET_* */
+    u32 same_as;            /* Earlier identical asset + 1 (0 = unique) */
+} SegmentAssetRef;
+
+/**
+ * Contiguous run of output bytes in a laid-out segment.
+ */
+typedef struct {
+    const u8* data;
+    u32 size;
+} BLBSegmentPiece;
+
 /**
  * Helper structure for building segment TOCs.
+ * Assets are kept as (pointer, size) references and only gathered when
+ * the segment is emitted, so each byte is copied once, into its final
+ * place.
  */
 typedef struct {
     u32 asset_count;
     u32 capacity;
-    TOCEntry* entries;
-    u8* data;
-    u32 data_size;
-    u32 data_capacity;
+    TOCEntry* entries;      /* Offsets valid after layout */
+    SegmentAssetRef* refs;  /* Parallel to entries */
+    u32 data_size;          /* Unique asset bytes, before alignment */
+    u32 assets_shared;      /* Entries pointing at an earlier copy */
+    u32 bytes_saved;        /* Data bytes those entries didn't add */
+    u8* toc;                /* Serialized TOC (layout) */
+    BLBSegmentPiece* pieces;    /* Gather list (layout) */
+    u32 piece_count;
+    u32 piece_capacity;
 } SegmentBuilder;
 
 /**
@@ -461,7 +921,9 @@ typedef struct {
 int BLB_SegmentBuilder_Init(SegmentBuilder* builder);
 
 /**
- * Add an asset to the segment builder.
+ * Add an asset to the segment builder, copying its bytes.
+ * An asset byte-identical to one already in the segment gets a TOC entry
+ * pointing at the existing copy instead of a second one.
  * @param builder       Segment builder
  * @param asset_id      Asset type ID
  * @param data          Asset data
@@ -471,9 +933,39 @@ int BLB_SegmentBuilder_Init(SegmentBuilder* builder);
 int BLB_SegmentBuilder_AddAsset(SegmentBuilder* builder, u32 asset_id,
                                 const u8* data, u32 size);
 
+/**
+ * Add an asset by reference. Without BLB_ASSET_OWNED, data must stay
+ * valid and unchanged until the segment has been emitted. With it, data
+ * must come from malloc and the builder frees it (also on error).
+ * Dedup applies as for BLB_SegmentBuilder_AddAsset; a duplicate with
+ * BLB_ASSET_ALIGN_SECTOR moves the shared copy to a sector boundary.
+ * @param builder       Segment builder
+ * @param asset_id      Asset type ID
+ * @param data          Asset data
+ * @param size          Asset data size
+ * @param flags         BLB_ASSET_* flags
+ * @return              0 on success, -1 on error
+ */
+int BLB_SegmentBuilder_AddAssetRef(SegmentBuilder* builder, u32 asset_id,
+                                   const u8* data, u32 size, u32 flags);
+
+/**
+ * Lay the segment out: fix every TOC offset (honoring alignment) and
+ * build the gather list - TOC first, then asset bytes and zero padding in
+ * file order. The list stays valid until the builder changes.
+ * 
+ * @param builder       Segment builder
+ * @param out_pieces    Output: gather list
+ * @param out_count     Output: pieces in the list
+ * @return              Total segment size, or 0 on error
+ */
+u32 BLB_SegmentBuilder_Layout(SegmentBuilder* builder,
+                              const BLBSegmentPiece** out_pieces, u32* out_count);
+
 /**
  * Finalize the segment and get the output buffer.
- * Caller must free the returned buffer.
+ * Caller must free the returned buffer. Prefer BLB_WriteSegmentFromBuilder
+ * or BLB_SegmentBuilder_WriteFd when the segment only goes to disk.
  * 
  * @param builder       Segment builder
  * @param out_size      Output: total segment size
@@ -482,7 +974,35 @@ int BLB_SegmentBuilder_AddAsset(SegmentBuilder* builder, u32 asset_id,
 u8* BLB_SegmentBuilder_Finalize(SegmentBuilder* builder, u32* out_size);
 
 /**
- * Free segment builder resources.
+ * Write the segment to a file descriptor without assembling it in memory
+ * (writev where available).
+ * 
+ * @param builder       Segment builder
+ * @param fd            Open file descriptor, written at its current position
+ * @param out_size      Output: bytes written (may be NULL)
+ * @return              0 on success, -1 on error
+ */
+int BLB_SegmentBuilder_WriteFd(SegmentBuilder* builder, int fd, u32* out_size);
+
+/**
+ * Write a builder's segment straight into an archive being written.
+ * Same placement, dedup and level entry update as BLB_WriteSegment; the
+ * asset bytes are gathered directly into the archive output.
+ * 
+ * TOOL-ONLY: Not present in original game.
+ * 
+ * @param blb               BLB file handle (from BLB_Create/BLB_CreateStream)
+ * @param level_index       Level index (0-based)
+ * @param stage_index       Stage index (0-based, ignored for primary)
+ * @param builder           Segment builder
+ * @param segment_type      0=primary, 1=secondary, 2=tertiary
+ * @return                  0 on success, -1 on error
+ */
+int BLB_WriteSegmentFromBuilder(BLBFile* blb, u8 level_index, u8 stage_index,
+                                SegmentBuilder* builder, u8 segment_type);
+
+/**
+ * Free segment builder resources, including owned asset data.
  * @param builder       Segment builder to free
  */
 void BLB_SegmentBuilder_Free(SegmentBuilder* builder);
@@ -0,0 +1,311 @@
+/**
+ * blb_async.c - Asynchronous segment loading
+ *
+ * One loader thread per BLBFile takes requests in submission order and
+ * acquires the segment through the normal backend: paged handles pread
+ * the run into the segment cache, mapped/heap handles touch every page
+ * so the faults are taken off the game thread. Finished requests wait on
+ * a completion list until BLB_PollAsync hands them to their callbacks.
+ *
+ * The original game streamed level data from CD in TickCDStreamBuffer at
+ * the top of every frame; Game_Tick polls here in that slot.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#include "blb.h"
+#include "blb_async.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define ASYNC_PAGE_SIZE     4096
+
+/* -----------------------------------------------------------------------------
+ * Queue structures
+ * -------------------------------------------------------------------------- */
+
+typedef struct AsyncRequest {
+    struct AsyncRequest* next;
+    BLBAsyncCallback callback;
+    void*   user;
+    u16     sector;
+    u16     sector_count;
+    BLBAsyncResult result;
+} AsyncRequest;
+
+struct BLBAsyncQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;       /* Loader: work queued or stopping */
+    pthread_cond_t  idle;       /* Waiters: a request finished */
+    pthread_t       thread;
+    const BLBFile*  blb;
+    AsyncRequest*   queue_head; /* Submitted, not started */
+    AsyncRequest*   queue_tail;
+    AsyncRequest*   done_head;  /* Finished, not delivered */
+    AsyncRequest*   done_tail;
+    u32     in_flight;          /* Queued + being read */
+    u32     pending;            /* Submitted, not delivered */
+    u32     next_id;
+    int     stop;
+};
+
+/* -----------------------------------------------------------------------------
+ * Loader thread
+ * -------------------------------------------------------------------------- */
+
+/* Fault in a resident run so the first real access doesn't stall */
+static void touch_pages(const u8* data, u32 size) {
+    volatile u8 sink = 0;
+    u32 i;
+
+    for (i = 0; i < size; i += ASYNC_PAGE_SIZE) {
+        sink ^= data[i];
+    }
+    (void)sink;
+}
+
+static void* loader_main(void* arg) {
+    BLBAsyncQueue* queue = (BLBAsyncQueue*)arg;
+
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        AsyncRequest* req;
+        const u8* data;
+        u32 size = 0;
+
+        while (!queue->queue_head && !queue->stop) {
+            pthread_cond_wait(&queue->wake, &queue->lock);
+        }
+        if (queue->stop) {
+            break;
+        }
+
+        req = queue->queue_head;
+        queue->queue_head = req->next;
+        if (!queue->queue_head) {
+            queue->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        /* Read outside the lock; the cache does its own locking */
+        data = BLB_AcquireSegment(queue->blb, req->sector, req->sector_count, &size);
+        if (data && queue->blb->backend != BLB_BACKEND_PAGED) {
+            touch_pages(data, size);
+        }
+        req->result.data = data;
+        req->result.size = data ? size : 0;
+        req->result.status = data ? 0 : -1;
+        req->next = NULL;
+
+        pthread_mutex_lock(&queue->lock);
+        if (queue->done_tail) {
+            queue->done_tail->next = req;
+        } else {
+            queue->done_head = req;
+        }
+        queue->done_tail = req;
+        queue->in_flight--;
+        pthread_cond_broadcast(&queue->idle);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+static BLBAsyncQueue* create_queue(const BLBFile* blb) {
+    BLBAsyncQueue* queue = (BLBAsyncQueue*)calloc(1, sizeof(BLBAsyncQueue));
+
+    if (!queue) {
+        return NULL;
+    }
+    queue->blb = blb;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->wake, NULL);
+    pthread_cond_init(&queue->idle, NULL);
+
+    if (pthread_create(&queue->thread, NULL, loader_main, queue) != 0) {
+        pthread_cond_destroy(&queue->idle);
+        pthread_cond_destroy(&queue->wake);
+        pthread_mutex_destroy(&queue->lock);
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+/* Detach the completion list and run it. Caller must not hold the lock. */
+static u32 deliver(BLBFile* blb, BLBAsyncQueue* queue) {
+    AsyncRequest* req;
+    u32 delivered = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    req = queue->done_head;
+    queue->done_head = NULL;
+    queue->done_tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+
+    while (req) {
+        AsyncRequest* next = req->next;
+
+        if (req->callback) {
+            req->callback(blb, &req->result, req->user);
+        } else if (req->result.data) {
+            BLB_ReleaseSegment(blb, req->result.data);  /* Warm-only */
+        }
+
+        pthread_mutex_lock(&queue->lock);
+        queue->pending--;
+        pthread_mutex_unlock(&queue->lock);
+
+        free(req);
+        req = next;
+        delivered++;
+    }
+    return delivered;
+}
+
+/* -----------------------------------------------------------------------------
+ * Async Segment Loading
+ * -------------------------------------------------------------------------- */
+
+u32 BLB_LoadSegmentAsync(BLBFile* blb, u8 level_index, u8 stage_index,
+                         u8 segment_type, BLBAsyncCallback callback, void* user) {
+    BLBAsyncQueue* queue;
+    AsyncRequest* req;
+    u16 sector, sector_count;
+    u32 id;
+
+    if (!blb || level_index >= blb->level_count || segment_type > 2 || blb->writer) {
+        return 0;
+    }
+
+    /* Resolve the run now, on the caller's thread - the header is not shared */
+    switch (segment_type) {
+    case 0:
+        sector = BLB_GetPrimarySectorOffset(blb, level_index);
+        sector_count = BLB_GetPrimarySectorCount(blb, level_index);
+        break;
+    case 1:
+        if (stage_index >= BLB_GetStageCount(blb, level_index)) return 0;
+        sector = BLB_GetSecondarySectorOffset(blb, level_index, stage_index);
+        sector_count = BLB_GetSecondarySectorCount(blb, level_index, stage_index);
+        break;
+    default:
+        if (stage_index >= BLB_GetStageCount(blb, level_index)) return 0;
+        sector = BLB_GetTertiarySectorOffset(blb, level_index, stage_index);
+        sector_count = BLB_GetTertiarySectorCount(blb, level_index, stage_index);
+        break;
+    }
+    if (sector_count == 0) {
+        return 0;
+    }
+
+    if (!blb->async) {
+        blb->async = create_queue(blb);
+        if (!blb->async) {
+            return 0;
+        }
+    }
+    queue = blb->async;
+
+    req = (AsyncRequest*)calloc(1, sizeof(AsyncRequest));
+    if (!req) {
+        return 0;
+    }
+    req->callback = callback;
+    req->user = user;
+    req->sector = sector;
+    req->sector_count = sector_count;
+    req->result.level_index = level_index;
+    req->result.stage_index = stage_index;
+    req->result.segment_type = segment_type;
+
+    pthread_mutex_lock(&queue->lock);
+    id = ++queue->next_id;
+    if (id == 0) {
+        id = ++queue->next_id;
+    }
+    req->result.request_id = id;
+    if (queue->queue_tail) {
+        queue->queue_tail->next = req;
+    } else {
+        queue->queue_head = req;
+    }
+    queue->queue_tail = req;
+    queue->in_flight++;
+    queue->pending++;
+    pthread_cond_signal(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+
+    return id;
+}
+
+u32 BLB_PollAsync(BLBFile* blb) {
+    if (!blb || !blb->async) {
+        return 0;
+    }
+    return deliver(blb, blb->async);
+}
+
+u32 BLB_WaitAsync(BLBFile* blb) {
+    BLBAsyncQueue* queue;
+
+    if (!blb || !blb->async) {
+        return 0;
+    }
+    queue = blb->async;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->in_flight > 0) {
+        pthread_cond_wait(&queue->idle, &queue->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return deliver(blb, queue);
+}
+
+u32 BLB_GetAsyncPending(const BLBFile* blb) {
+    u32 pending;
+
+    if (!blb || !blb->async) {
+        return 0;
+    }
+    pthread_mutex_lock(&blb->async->lock);
+    pending = blb->async->pending;
+    pthread_mutex_unlock(&blb->async->lock);
+    return pending;
+}
+
+void BLBAsync_Destroy(BLBAsyncQueue* queue, const BLBFile* blb) {
+    AsyncRequest* req;
+
+    if (!queue) {
+        return;
+    }
+
+    /* Loader finishes the read in progress, then exits */
+    pthread_mutex_lock(&queue->lock);
+    queue->stop = 1;
+    pthread_cond_signal(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+    pthread_join(queue->thread, NULL);
+
+    /* Never started */
+    while ((req = queue->queue_head) != NULL) {
+        queue->queue_head = req->next;
+        free(req);
+    }
+    /* Finished but never polled */
+    while ((req = queue->done_head) != NULL) {
+        queue->done_head = req->next;
+        if (req->result.data) {
+            BLB_ReleaseSegment(blb, req->result.data);
+        }
+        free(req);
+    }
+
+    pthread_cond_destroy(&queue->idle);
+    pthread_cond_destroy(&queue->wake);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue);
+}
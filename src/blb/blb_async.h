@@ -0,0 +1,22 @@
+/**
+ * blb_async.h - Asynchronous segment loading (internal)
+ *
+ * Shared between blb.c and blb_async.c only. Public entry points are
+ * BLB_LoadSegmentAsync / BLB_PollAsync / BLB_WaitAsync in blb.h.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#ifndef BLB_ASYNC_H
+#define BLB_ASYNC_H
+
+#include "blb.h"
+
+/**
+ * Stop the loader thread and drop everything still queued. Completed
+ * results that were never polled have their segments released; their
+ * callbacks are not run.
+ */
+void BLBAsync_Destroy(BLBAsyncQueue* queue, const BLBFile* blb);
+
+#endif /* BLB_ASYNC_H */
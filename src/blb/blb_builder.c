@@ -0,0 +1,400 @@
+/**
+ * blb_builder.c - Segment builder
+ *
+ * Collects assets for one segment as (pointer, size) references and lays
+ * the segment out only when it is emitted: a TOC (u32 count + 12 byte
+ * entries) followed by the asset bytes, each aligned to 4 bytes or a
+ * sector. The result is a gather list, so the bytes can go straight into
+ * the archive writer or a writev instead of being assembled first.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* writev */
+#endif
+
+#include "blb.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX             16
+#endif
+
+#define TOC_ENTRY_BYTES     12
+
+static const u8 zero_pad[BLB_SECTOR_SIZE];
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+static void write_u32(u8* ptr, u32 value) {
+    ptr[0] = (u8)(value & 0xFF);
+    ptr[1] = (u8)((value >> 8) & 0xFF);
+    ptr[2] = (u8)((value >> 16) & 0xFF);
+    ptr[3] = (u8)((value >> 24) & 0xFF);
+}
+
+/* FNV-1a 64 */
+static u64 hash_bytes(const u8* data, u32 size) {
+    u64 h = 0xCBF29CE484222325ull;
+    u32 i;
+
+    for (i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static int grow_entries(SegmentBuilder* builder) {
+    u32 new_cap = builder->capacity * 2;
+    TOCEntry* new_entries;
+    SegmentAssetRef* new_refs;
+
+    new_entries = (TOCEntry*)realloc(builder->entries, new_cap * sizeof(TOCEntry));
+    if (!new_entries) {
+        return -1;
+    }
+    builder->entries = new_entries;
+
+    new_refs = (SegmentAssetRef*)realloc(builder->refs, new_cap * sizeof(SegmentAssetRef));
+    if (!new_refs) {
+        return -1;
+    }
+    builder->refs = new_refs;
+    builder->capacity = new_cap;
+    return 0;
+}
+
+/* Earlier asset with identical bytes, or -1 */
+static int find_duplicate(const SegmentBuilder* builder, u64 hash,
+                          const u8* data, u32 size) {
+    u32 i;
+
+    for (i = 0; i < builder->asset_count; i++) {
+        const SegmentAssetRef* ref = &builder->refs[i];
+        if (ref->same_as == 0 && ref->hash == hash && builder->entries[i].size == size &&
+            (size == 0 || memcmp(ref->data, data, size) == 0)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int add_piece(SegmentBuilder* builder, const u8* data, u32 size) {
+    if (builder->piece_count >= builder->piece_capacity) {
+        u32 new_cap = builder->piece_capacity ? builder->piece_capacity * 2 : 16;
+        BLBSegmentPiece* new_pieces = (BLBSegmentPiece*)realloc(builder->pieces,
+                                                  new_cap * sizeof(BLBSegmentPiece));
+        if (!new_pieces) {
+            return -1;
+        }
+        builder->pieces = new_pieces;
+        builder->piece_capacity = new_cap;
+    }
+    builder->pieces[builder->piece_count].data = data;
+    builder->pieces[builder->piece_count].size = size;
+    builder->piece_count++;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Segment Building Helpers
+ * -------------------------------------------------------------------------- */
+
+int BLB_SegmentBuilder_Init(SegmentBuilder* builder) {
+    if (!builder) {
+        return -1;
+    }
+
+    memset(builder, 0, sizeof(SegmentBuilder));
+
+    /* Allocate initial capacity */
+    builder->capacity = 32;
+    builder->entries = (TOCEntry*)calloc(builder->capacity, sizeof(TOCEntry));
+    builder->refs = (SegmentAssetRef*)calloc(builder->capacity, sizeof(SegmentAssetRef));
+    if (!builder->entries || !builder->refs) {
+        free(builder->entries);
+        free(builder->refs);
+        return -1;
+    }
+
+    return 0;
+}
+
+int BLB_SegmentBuilder_AddAssetRef(SegmentBuilder* builder, u32 asset_id,
+                                   const u8* data, u32 size, u32 flags) {
+    SegmentAssetRef* ref;
+    u64 hash;
+    int dup;
+
+    if (!builder || !builder->entries || (!data && size > 0)) {
+        if (flags & BLB_ASSET_OWNED) free((void*)data);
+        return -1;
+    }
+
+    /* Ensure capacity */
+    if (builder->asset_count >= builder->capacity && grow_entries(builder) != 0) {
+        if (flags & BLB_ASSET_OWNED) free((void*)data);
+        return -1;
+    }
+
+    builder->entries[builder->asset_count].id = asset_id;
+    builder->entries[builder->asset_count].size = size;
+    builder->entries[builder->asset_count].offset = 0;
+
+    ref = &builder->refs[builder->asset_count];
+    hash = hash_bytes(data, size);
+    dup = find_duplicate(builder, hash, data, size);
+
+    if (dup >= 0) {
+        /* Identical bytes already in the segment - share them, on the
+         * stricter alignment of the two */
+        if (flags & BLB_ASSET_OWNED) free((void*)data);
+        builder->refs[dup].flags |= flags & BLB_ASSET_ALIGN_SECTOR;
+        ref->data = builder->refs[dup].data;
+        ref->hash = hash;
+        ref->flags = 0;
+        ref->same_as = (u32)dup + 1;
+        builder->assets_shared++;
+        builder->bytes_saved += size;
+    } else {
+        ref->data = data;
+        ref->hash = hash;
+        ref->flags = flags;
+        ref->same_as = 0;
+        builder->data_size += size;
+    }
+
+    builder->asset_count++;
+    builder->piece_count = 0;   /* Layout is stale */
+    return 0;
+}
+
+int BLB_SegmentBuilder_AddAsset(SegmentBuilder* builder, u32 asset_id,
+                                const u8* data, u32 size) {
+    u8* copy;
+
+    if (!builder || !builder->entries || !data) {
+        return -1;
+    }
+
+    /* Only copy bytes the segment doesn't already hold */
+    if (find_duplicate(builder, hash_bytes(data, size), data, size) >= 0) {
+        return BLB_SegmentBuilder_AddAssetRef(builder, asset_id, data, size, 0);
+    }
+
+    copy = (u8*)malloc(size ? size : 1);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, data, size);
+    return BLB_SegmentBuilder_AddAssetRef(builder, asset_id, copy, size, BLB_ASSET_OWNED);
+}
+
+u32 BLB_SegmentBuilder_Layout(SegmentBuilder* builder,
+                              const BLBSegmentPiece** out_pieces, u32* out_count) {
+    u32 toc_size, offset, i;
+    u8* toc;
+
+    if (out_pieces) *out_pieces = NULL;
+    if (out_count) *out_count = 0;
+    if (!builder || !builder->entries || builder->asset_count > 0x0FFFFFFF) {
+        return 0;
+    }
+
+    toc_size = 4 + builder->asset_count * TOC_ENTRY_BYTES;
+    toc = (u8*)realloc(builder->toc, toc_size);
+    if (!toc) {
+        return 0;
+    }
+    builder->toc = toc;
+    builder->piece_count = 0;
+    if (add_piece(builder, toc, toc_size) != 0) {
+        return 0;
+    }
+
+    /* Place unique assets in order; duplicates take their original's offset */
+    offset = toc_size;
+    for (i = 0; i < builder->asset_count; i++) {
+        const SegmentAssetRef* ref = &builder->refs[i];
+        TOCEntry* entry = &builder->entries[i];
+        u32 align, pad;
+
+        if (ref->same_as) {
+            entry->offset = builder->entries[ref->same_as - 1].offset;
+            continue;
+        }
+
+        align = (ref->flags & BLB_ASSET_ALIGN_SECTOR) ? BLB_SECTOR_SIZE : 4;
+        pad = (align - offset % align) % align;
+        if (offset + pad < offset || offset + pad + entry->size < offset + pad) {
+            builder->piece_count = 0;
+            return 0;
+        }
+        if (pad && add_piece(builder, zero_pad, pad) != 0) {
+            builder->piece_count = 0;
+            return 0;
+        }
+        offset += pad;
+
+        entry->offset = offset;
+        if (entry->size && add_piece(builder, ref->data, entry->size) != 0) {
+            builder->piece_count = 0;
+            return 0;
+        }
+        offset += entry->size;
+    }
+
+    /* TOC last, now that every offset is known */
+    write_u32(toc, builder->asset_count);
+    for (i = 0; i < builder->asset_count; i++) {
+        u8* dst = toc + 4 + i * TOC_ENTRY_BYTES;
+        write_u32(dst, builder->entries[i].id);
+        write_u32(dst + 4, builder->entries[i].size);
+        write_u32(dst + 8, builder->entries[i].offset);
+    }
+
+    if (out_pieces) *out_pieces = builder->pieces;
+    if (out_count) *out_count = builder->piece_count;
+    return offset;
+}
+
+u8* BLB_SegmentBuilder_Finalize(SegmentBuilder* builder, u32* out_size) {
+    const BLBSegmentPiece* pieces;
+    u32 piece_count, total_size, pos, i;
+    u8* segment;
+
+    if (!builder || !out_size) {
+        return NULL;
+    }
+
+    total_size = BLB_SegmentBuilder_Layout(builder, &pieces, &piece_count);
+    if (total_size == 0) {
+        return NULL;
+    }
+
+    segment = (u8*)malloc(total_size);
+    if (!segment) {
+        return NULL;
+    }
+
+    pos = 0;
+    for (i = 0; i < piece_count; i++) {
+        memcpy(segment + pos, pieces[i].data, pieces[i].size);
+        pos += pieces[i].size;
+    }
+
+    *out_size = total_size;
+    return segment;
+}
+
+int BLB_SegmentBuilder_WriteFd(SegmentBuilder* builder, int fd, u32* out_size) {
+    const BLBSegmentPiece* pieces;
+    u32 piece_count, total_size, i;
+
+    if (out_size) *out_size = 0;
+    if (fd < 0) {
+        return -1;
+    }
+
+    total_size = BLB_SegmentBuilder_Layout(builder, &pieces, &piece_count);
+    if (total_size == 0) {
+        return -1;
+    }
+
+#ifdef _WIN32
+    for (i = 0; i < piece_count; i++) {
+        if (_write(fd, pieces[i].data, pieces[i].size) != (int)pieces[i].size) {
+            return -1;
+        }
+    }
+#else
+    {
+        struct iovec iov[IOV_MAX < 64 ? IOV_MAX : 64];
+        u32 skip = 0;   /* Bytes of pieces[i] already written */
+
+        i = 0;
+        while (i < piece_count) {
+            u32 n = 0;
+            ssize_t written;
+
+            while (n < sizeof(iov) / sizeof(iov[0]) && i + n < piece_count) {
+                iov[n].iov_base = (void*)(pieces[i + n].data + (n == 0 ? skip : 0));
+                iov[n].iov_len = pieces[i + n].size - (n == 0 ? skip : 0);
+                n++;
+            }
+
+            written = writev(fd, iov, (int)n);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return -1;
+            }
+
+            /* Advance past whatever a short write covered */
+            while (written > 0 && i < piece_count) {
+                u32 left = pieces[i].size - skip;
+                if ((size_t)written >= left) {
+                    written -= (ssize_t)left;
+                    skip = 0;
+                    i++;
+                } else {
+                    skip += (u32)written;
+                    written = 0;
+                }
+            }
+        }
+    }
+#endif
+
+    if (out_size) *out_size = total_size;
+    return 0;
+}
+
+void BLB_SegmentBuilder_Free(SegmentBuilder* builder) {
+    u32 i;
+
+    if (!builder) return;
+
+    if (builder->refs) {
+        for (i = 0; i < builder->asset_count; i++) {
+            if (builder->refs[i].flags & BLB_ASSET_OWNED) {
+                free((void*)builder->refs[i].data);
+            }
+        }
+        free(builder->refs);
+        builder->refs = NULL;
+    }
+
+    if (builder->entries) {
+        free(builder->entries);
+        builder->entries = NULL;
+    }
+
+    free(builder->toc);
+    free(builder->pieces);
+    builder->toc = NULL;
+    builder->pieces = NULL;
+
+    builder->asset_count = 0;
+    builder->capacity = 0;
+    builder->data_size = 0;
+    builder->assets_shared = 0;
+    builder->bytes_saved = 0;
+    builder->piece_count = 0;
+    builder->piece_capacity = 0;
+}
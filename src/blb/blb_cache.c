@@ -0,0 +1,351 @@
+/**
+ * blb_cache.c - Paged BLB backend
+ *
+ * Keeps only the header resident and reads segment sector runs on demand
+ * into a small LRU cache. Acquired segments are pinned so LevelContext can
+ * hold plain pointers into them; unpinned ones stay cached until the byte
+ * budget forces them out.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* pread */
+#endif
+
+#include "blb.h"
+#include "blb_cache.h"
+#include "blb_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+/* -----------------------------------------------------------------------------
+ * Cache structures
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    u8*     data;           /* Segment buffer (malloc'd) */
+    u32     size;           /* Bytes in data */
+    u32     last_use;       /* LRU tick */
+    u32     pins;           /* Outstanding acquires */
+    u16     sector;         /* Key: first sector */
+    u16     count;          /* Key: sector count */
+} CacheEntry;
+
+struct BLBSegmentCache {
+    pthread_mutex_t lock;
+#ifdef _WIN32
+    FILE*   file;           /* No pread - seek+read under lock */
+#else
+    int     fd;
+#endif
+    u32     file_size;
+    u32     budget;         /* Max resident bytes before evicting */
+    u32     resident;       /* Bytes held by entries */
+    u32     hits;
+    u32     misses;
+    u32     tick;
+    CacheEntry* entries;
+    u32     entry_count;
+    u32     entry_capacity;
+    u8      header[BLB_HEADER_SIZE];
+};
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+/* Read size bytes at offset. Returns 0 on success, -1 on short read. */
+static int read_at(BLBSegmentCache* cache, u8* dst, u32 size, u32 offset) {
+#ifdef _WIN32
+    int ok;
+
+    pthread_mutex_lock(&cache->lock);
+    ok = fseek(cache->file, (long)offset, SEEK_SET) == 0 &&
+         fread(dst, 1, size, cache->file) == size;
+    pthread_mutex_unlock(&cache->lock);
+    return ok ? 0 : -1;
+#else
+    while (size > 0) {
+        ssize_t n = pread(cache->fd, dst, size, (off_t)offset);
+        if (n <= 0) {
+            return -1;
+        }
+        dst += n;
+        offset += (u32)n;
+        size -= (u32)n;
+    }
+    return 0;
+#endif
+}
+
+/* Find entry by key. Caller holds lock. */
+static CacheEntry* find_entry(BLBSegmentCache* cache, u16 sector, u16 count) {
+    u32 i;
+
+    for (i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].sector == sector && cache->entries[i].count == count) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Evict unpinned entries, oldest first, until within budget. Caller holds lock. */
+static void evict_to_budget(BLBSegmentCache* cache) {
+    while (cache->resident > cache->budget) {
+        CacheEntry* victim = NULL;
+        u32 i;
+
+        for (i = 0; i < cache->entry_count; i++) {
+            CacheEntry* e = &cache->entries[i];
+            if (e->pins == 0 && (!victim || e->last_use < victim->last_use)) {
+                victim = e;
+            }
+        }
+
+        if (!victim) {
+            return;  /* Everything pinned - allowed to overshoot */
+        }
+
+        cache->resident -= victim->size;
+        free(victim->data);
+        *victim = cache->entries[--cache->entry_count];
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Cache Operations
+ * -------------------------------------------------------------------------- */
+
+const u8* BLBCache_Acquire(BLBSegmentCache* cache, u16 sector_offset,
+                           u16 sector_count, u32* out_size) {
+    CacheEntry* entry;
+    u32 offset, size;
+    u8* data;
+
+    if (out_size) *out_size = 0;
+    if (!cache || sector_count == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    entry = find_entry(cache, sector_offset, sector_count);
+    if (entry) {
+        entry->pins++;
+        entry->last_use = ++cache->tick;
+        cache->hits++;
+        if (out_size) *out_size = entry->size;
+        data = entry->data;
+        pthread_mutex_unlock(&cache->lock);
+        return data;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    /* Miss - read the run without holding the lock */
+    offset = (u32)sector_offset * BLB_SECTOR_SIZE;
+    if (offset >= cache->file_size) {
+        return NULL;
+    }
+    size = (u32)sector_count * BLB_SECTOR_SIZE;
+    if (size > cache->file_size - offset) {
+        size = cache->file_size - offset;  /* Last segment may be short */
+    }
+
+    data = (u8*)malloc(size);
+    if (!data) {
+        return NULL;
+    }
+    if (read_at(cache, data, size, offset) != 0) {
+        free(data);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    /* Another thread may have loaded it meanwhile */
+    entry = find_entry(cache, sector_offset, sector_count);
+    if (entry) {
+        free(data);
+        entry->pins++;
+        entry->last_use = ++cache->tick;
+        cache->hits++;
+        if (out_size) *out_size = entry->size;
+        data = entry->data;
+        pthread_mutex_unlock(&cache->lock);
+        return data;
+    }
+
+    if (cache->entry_count >= cache->entry_capacity) {
+        u32 new_cap = cache->entry_capacity ? cache->entry_capacity * 2 : 16;
+        CacheEntry* new_entries = (CacheEntry*)realloc(cache->entries,
+                                                       new_cap * sizeof(CacheEntry));
+        if (!new_entries) {
+            pthread_mutex_unlock(&cache->lock);
+            free(data);
+            return NULL;
+        }
+        cache->entries = new_entries;
+        cache->entry_capacity = new_cap;
+    }
+
+    entry = &cache->entries[cache->entry_count++];
+    entry->data = data;
+    entry->size = size;
+    entry->sector = sector_offset;
+    entry->count = sector_count;
+    entry->pins = 1;
+    entry->last_use = ++cache->tick;
+    cache->resident += size;
+    cache->misses++;
+
+    evict_to_budget(cache);
+    pthread_mutex_unlock(&cache->lock);
+
+    if (out_size) *out_size = size;
+    return data;
+}
+
+void BLBCache_Release(BLBSegmentCache* cache, const u8* segment) {
+    u32 i, j;
+
+    if (!cache || !segment) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    for (i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].data == segment) {
+            break;
+        }
+    }
+    /* Not a segment start: the entry it points into (an asset pointer) */
+    for (j = 0; i == cache->entry_count && j < cache->entry_count; j++) {
+        const u8* data = cache->entries[j].data;
+
+        if (segment >= data && segment <= data + cache->entries[j].size) {
+            i = j;
+        }
+    }
+    if (i < cache->entry_count && cache->entries[i].pins > 0) {
+        cache->entries[i].pins--;
+    }
+    evict_to_budget(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void BLBCache_Destroy(BLBSegmentCache* cache) {
+    u32 i;
+
+    if (!cache) {
+        return;
+    }
+
+    for (i = 0; i < cache->entry_count; i++) {
+        free(cache->entries[i].data);
+    }
+    free(cache->entries);
+
+#ifdef _WIN32
+    if (cache->file) fclose(cache->file);
+#else
+    if (cache->fd >= 0) close(cache->fd);
+#endif
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void BLBCache_GetStats(BLBSegmentCache* cache, u32* out_resident,
+                       u32* out_hits, u32* out_misses) {
+    if (!cache) {
+        if (out_resident) *out_resident = 0;
+        if (out_hits) *out_hits = 0;
+        if (out_misses) *out_misses = 0;
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if (out_resident) *out_resident = cache->resident;
+    if (out_hits) *out_hits = cache->hits;
+    if (out_misses) *out_misses = cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/* -----------------------------------------------------------------------------
+ * BLB Paged Open
+ * -------------------------------------------------------------------------- */
+
+int BLB_OpenPaged(const char* path, BLBFile* blb, u32 cache_budget) {
+    BLBSegmentCache* cache;
+    long size;
+
+    if (!path || !blb) {
+        return -1;
+    }
+
+    memset(blb, 0, sizeof(BLBFile));
+
+    cache = (BLBSegmentCache*)calloc(1, sizeof(BLBSegmentCache));
+    if (!cache) {
+        return -1;
+    }
+
+#ifdef _WIN32
+    cache->file = fopen(path, "rb");
+    if (!cache->file) {
+        free(cache);
+        return -1;
+    }
+    fseek(cache->file, 0, SEEK_END);
+    size = ftell(cache->file);
+    fseek(cache->file, 0, SEEK_SET);
+#else
+    {
+        struct stat st;
+
+        cache->fd = open(path, O_RDONLY);
+        if (cache->fd < 0) {
+            free(cache);
+            return -1;
+        }
+        size = fstat(cache->fd, &st) == 0 ? (long)st.st_size : -1;
+    }
+#endif
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    if (size < BLB_HEADER_SIZE || (unsigned long)size > 0xFFFFFFFFul) {
+        BLBCache_Destroy(cache);
+        return -1;
+    }
+
+    cache->file_size = (u32)size;
+    cache->budget = cache_budget ? cache_budget : BLB_PAGED_DEFAULT_BUDGET;
+
+    if (read_at(cache, cache->header, BLB_HEADER_SIZE, 0) != 0 ||
+        BLB_ParseHeader(cache->header, BLB_HEADER_SIZE, blb) != 0) {
+        BLBCache_Destroy(cache);
+        memset(blb, 0, sizeof(BLBFile));
+        return -1;
+    }
+
+    /* Header parsed - now detach data so sector access goes through cache */
+    blb->data = NULL;
+    blb->size = cache->file_size;
+    blb->backend = BLB_BACKEND_PAGED;
+    blb->cache = cache;
+    
+    /* Sidecar catalog if present, else index each segment on first acquire */
+    blb->index = BLBIndex_Open(blb, path, 0, 1);
+
+    return 0;
+}
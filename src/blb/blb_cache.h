@@ -0,0 +1,47 @@
+/**
+ * blb_cache.h - Paged BLB segment cache (internal)
+ *
+ * Shared between blb.c and blb_cache.c only. Public entry points are
+ * BLB_OpenPaged / BLB_AcquireSegment / BLB_ReleaseSegment in blb.h.
+ *
+ * TOOL-ONLY: The original game streams segments from CD into fixed
+ * buffers; this is the desktop equivalent.
+ */
+
+#ifndef BLB_CACHE_H
+#define BLB_CACHE_H
+
+#include "blb.h"
+
+/**
+ * Attach a header buffer to blb and read its counts, without building an
+ * index (blb.c). The paged backend indexes lazily instead.
+ * @return  0 on success, -1 on error
+ */
+int BLB_ParseHeader(const u8* data, u32 size, BLBFile* blb);
+
+/**
+ * Acquire a segment through the cache (reads on miss).
+ * @return  Pinned pointer, or NULL on read error
+ */
+const u8* BLBCache_Acquire(BLBSegmentCache* cache, u16 sector_offset,
+                           u16 sector_count, u32* out_size);
+
+/**
+ * Drop one pin on the entry owning segment: its start, or any pointer
+ * into it (such as an asset found in it).
+ */
+void BLBCache_Release(BLBSegmentCache* cache, const u8* segment);
+
+/**
+ * Close the file and free every cached segment and the header copy.
+ */
+void BLBCache_Destroy(BLBSegmentCache* cache);
+
+/**
+ * Read statistics (any output may be NULL).
+ */
+void BLBCache_GetStats(BLBSegmentCache* cache, u32* out_resident,
+                       u32* out_hits, u32* out_misses);
+
+#endif /* BLB_CACHE_H */
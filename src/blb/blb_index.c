@@ -0,0 +1,927 @@
+/**
+ * blb_index.c - Per-segment asset index
+ *
+ * Resolves every segment TOC referenced by the level table into flat
+ * records: a sector -> segment hash, and per segment a fixed slot table
+ * mapping asset ID -> TOC entry. BLB_LookupAsset is then two array reads
+ * instead of a TOC walk.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* mmap */
+#endif
+
+#include "blb.h"
+#include "blb_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/* Sanity limit shared with BLB_FindAsset */
+#define MAX_TOC_ENTRIES     100
+
+/* Sidecar catalog format */
+#define SIDECAR_MAGIC       "BLBIDX\0\0"
+#define SIDECAR_VERSION     3
+#define SIDECAR_ENDIAN      0x01020304u
+
+/**
+ * Sidecar file header (56 bytes). The three arrays follow, each at an
+ * 8-byte aligned offset, exactly as they sit in memory - the file is
+ * mapped and used in place.
+ *
+ * The catalog is keyed by what it was built from: the 0x1000-byte header
+ * (every segment's sector and count), each segment TOC the level table
+ * references, and the leading bytes of each asset that derive_count
+ * reads. The same archive on another checkout reuses it whatever its
+ * mtime; an edit to anything else in the archive can't change the index.
+ * That is a few hundred small reads, not a pass over the whole file.
+ */
+typedef struct {
+    char magic[8];
+    u32  version;
+    u32  endian;            /* SIDECAR_ENDIAN as written by this host */
+    u64  content_hash;      /* FNV-1a 64, see hash_archive */
+    u32  blb_size;
+    u32  level_count;
+    u32  segment_count;
+    u32  entry_count;
+    u32  hash_size;
+    u32  segments_offset;
+    u32  entries_offset;
+    u32  hash_offset;
+} SidecarHeader;
+
+struct BLBIndex {
+    BLBIndexSegment* segments;
+    u32     segment_count;
+    BLBIndexEntry* entries;     /* Eager: one array, segments point into it */
+    u32     entry_count;
+    u32     entry_capacity;
+    BLBIndexEntry** lazy;       /* Lazy: one array per segment */
+    u16*    hash;               /* Sector -> segment index + 1 */
+    u32     hash_mask;
+    pthread_mutex_t lock;       /* Lazy: guards segment state and entries */
+    u8*     block;              /* Sidecar: arrays live in here */
+    u32     block_size;
+    int     block_mapped;       /* block is an mmap, not malloc */
+};
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+static u16 read_u16(const u8* ptr) {
+    return (u16)ptr[0] | ((u16)ptr[1] << 8);
+}
+
+static u32 read_u32(const u8* ptr) {
+    return (u32)ptr[0] | ((u32)ptr[1] << 8) |
+           ((u32)ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+/* Slot for an asset ID, or -1 if it doesn't fit the table */
+static int asset_slot(u32 asset_id) {
+    u32 group = asset_id / 100;
+    u32 sub = asset_id % 100;
+
+    if (group < 1 || group > 8 || sub >= 8) {
+        return -1;
+    }
+    return (int)((group - 1) * 8 + sub);
+}
+
+/* Element count an asset implies (see BLBIndexEntry) */
+static u32 derive_count(const BLBIndexEntry* entry, const u8* data) {
+    switch (entry->id) {
+    case ASSET_TILE_HEADER:
+        /* count_16x16 + count_8x8 + count_extra at 0x10-0x15 */
+        if (entry->size < 0x16) return 0;
+        return (u32)read_u16(data + 0x10) + read_u16(data + 0x12) + read_u16(data + 0x14);
+    case ASSET_TILEMAP_CONTAINER:
+    case ASSET_PALETTE_CONTAINER:
+    case ASSET_GEOMETRY:
+    case ASSET_AUDIO_SAMPLES:
+        return entry->size >= 4 ? read_u32(data) : 0;
+    case ASSET_LAYER_ENTRIES:
+        return entry->size / 92;    /* sizeof(LayerEntry) */
+    case ASSET_ENTITIES:
+        return entry->size / 24;    /* sizeof(EntityDef) */
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Bytes a segment's TOC entries may address: its sector run, cut at the
+ * end of the archive. A zero count runs to the end, as in
+ * BLB_AcquireSegment.
+ */
+static u32 segment_limit(u32 archive_size, u32 start, u16 sector_count) {
+    u32 avail = start < archive_size ? archive_size - start : 0;
+    u32 span = (u32)sector_count * BLB_SECTOR_SIZE;
+
+    return (span && span < avail) ? span : avail;
+}
+
+static u32 hash_sector(u16 sector) {
+    return ((u32)sector * 2654435761u) >> 16;
+}
+
+/* Find or insert a segment record. Returns index, or -1 if table full. */
+static int add_segment(BLBIndex* index, u32 max_segments, u16 sector, u16 count) {
+    u32 h = hash_sector(sector) & index->hash_mask;
+    BLBIndexSegment* seg;
+
+    while (index->hash[h]) {
+        if (index->segments[index->hash[h] - 1].sector == sector) {
+            return index->hash[h] - 1;
+        }
+        h = (h + 1) & index->hash_mask;
+    }
+
+    if (index->segment_count >= max_segments) {
+        return -1;
+    }
+
+    seg = &index->segments[index->segment_count];
+    memset(seg, 0, sizeof(*seg));
+    seg->sector = sector;
+    seg->sector_count = count;
+    seg->state = BLB_SEG_UNINDEXED;
+    index->hash[h] = (u16)(++index->segment_count);
+    return (int)index->segment_count - 1;
+}
+
+/**
+ * Parse a segment TOC into out[] (room for MAX_TOC_ENTRIES).
+ * avail = bytes readable from segment start.
+ * Returns entry count, or -1 if the TOC or any entry is out of bounds.
+ */
+static int parse_toc(const u8* segment, u32 avail, BLBIndexEntry* out) {
+    u32 count, i;
+
+    if (avail < 4) {
+        return -1;
+    }
+
+    count = read_u32(segment);
+    if (count > MAX_TOC_ENTRIES || 4 + count * 12 > avail) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        const u8* e = segment + 4 + i * 12;
+        BLBIndexEntry* entry = &out[i];
+
+        entry->id = read_u32(e + 0);
+        entry->size = read_u32(e + 4);
+        entry->offset = read_u32(e + 8);
+        entry->item_count = 0;
+
+        if (entry->offset > avail || entry->size > avail - entry->offset) {
+            return -1;
+        }
+
+        entry->item_count = derive_count(entry, segment + entry->offset);
+    }
+
+    return (int)count;
+}
+
+/* Fill slot table from the segment's entries */
+static void fill_slots(BLBIndexSegment* seg, const BLBIndexEntry* entries) {
+    u32 i;
+
+    memset(seg->slot, 0, sizeof(seg->slot));
+    for (i = 0; i < seg->entry_count; i++) {
+        int slot = asset_slot(entries[i].id);
+        /* First match wins, same as a linear TOC scan */
+        if (slot >= 0 && seg->slot[slot] == 0) {
+            seg->slot[slot] = (u8)(i + 1);
+        }
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Index Operations
+ * -------------------------------------------------------------------------- */
+
+BLBIndex* BLBIndex_Create(const BLBFile* blb, int lazy) {
+    BLBIndex* index;
+    BLBIndexEntry scratch[MAX_TOC_ENTRIES];
+    u32 max_segments, hash_size, i;
+    u8 level;
+
+    if (!blb) {
+        return NULL;
+    }
+
+    index = (BLBIndex*)calloc(1, sizeof(BLBIndex));
+    if (!index) {
+        return NULL;
+    }
+
+    /* One primary plus a secondary/tertiary pair per stage, per level */
+    max_segments = (u32)blb->level_count * (1 + 2 * BLB_MAX_STAGES);
+    hash_size = 64;
+    while (hash_size < max_segments * 2) {
+        hash_size <<= 1;
+    }
+
+    index->segments = (BLBIndexSegment*)calloc(max_segments ? max_segments : 1,
+                                               sizeof(BLBIndexSegment));
+    index->hash = (u16*)calloc(hash_size, sizeof(u16));
+    index->hash_mask = hash_size - 1;
+    pthread_mutex_init(&index->lock, NULL);
+
+    if (!index->segments || !index->hash) {
+        BLBIndex_Free(index);
+        return NULL;
+    }
+
+    /* Register every sector run the level table references */
+    for (level = 0; level < blb->level_count; level++) {
+        u16 stages = BLB_GetStageCount(blb, level);
+        u8 stage;
+
+        if (stages > BLB_MAX_STAGES) {
+            stages = BLB_MAX_STAGES;
+        }
+
+        add_segment(index, max_segments,
+                    BLB_GetPrimarySectorOffset(blb, level),
+                    BLB_GetPrimarySectorCount(blb, level));
+
+        for (stage = 0; stage < stages; stage++) {
+            add_segment(index, max_segments,
+                        BLB_GetSecondarySectorOffset(blb, level, stage),
+                        BLB_GetSecondarySectorCount(blb, level, stage));
+            add_segment(index, max_segments,
+                        BLB_GetTertiarySectorOffset(blb, level, stage),
+                        BLB_GetTertiarySectorCount(blb, level, stage));
+        }
+    }
+
+    if (lazy) {
+        index->lazy = (BLBIndexEntry**)calloc(index->segment_count ? index->segment_count : 1,
+                                              sizeof(BLBIndexEntry*));
+        if (!index->lazy) {
+            BLBIndex_Free(index);
+            return NULL;
+        }
+        return index;
+    }
+
+    /* Eager: whole archive is addressable, read every TOC now */
+    for (i = 0; i < index->segment_count; i++) {
+        BLBIndexSegment* seg = &index->segments[i];
+        u32 start = (u32)seg->sector * BLB_SECTOR_SIZE;
+        int count;
+
+        seg->state = BLB_SEG_INVALID;
+        if (start < BLB_HEADER_SIZE || start >= blb->size) {
+            continue;
+        }
+
+        /* The paged backend reads only the run, so the index must not
+         * reach past it either */
+        count = parse_toc(blb->data + start,
+                          segment_limit(blb->size, start, seg->sector_count), scratch);
+        if (count < 0) {
+            continue;
+        }
+
+        if (index->entry_count + (u32)count > index->entry_capacity) {
+            u32 new_cap = index->entry_capacity ? index->entry_capacity * 2 : 1024;
+            BLBIndexEntry* new_entries;
+
+            while (new_cap < index->entry_count + (u32)count) {
+                new_cap *= 2;
+            }
+            new_entries = (BLBIndexEntry*)realloc(index->entries,
+                                                  new_cap * sizeof(BLBIndexEntry));
+            if (!new_entries) {
+                BLBIndex_Free(index);
+                return NULL;
+            }
+            index->entries = new_entries;
+            index->entry_capacity = new_cap;
+        }
+
+        if (count > 0) {
+            memcpy(index->entries + index->entry_count, scratch,
+                   (size_t)count * sizeof(BLBIndexEntry));
+        }
+        seg->first_entry = index->entry_count;
+        seg->entry_count = (u16)count;
+        seg->state = BLB_SEG_INDEXED;
+        index->entry_count += (u32)count;
+        fill_slots(seg, index->entries + seg->first_entry);
+    }
+
+    return index;
+}
+
+void BLBIndex_Touch(BLBIndex* index, u16 sector, const u8* segment, u32 size) {
+    BLBIndexEntry scratch[MAX_TOC_ENTRIES];
+    BLBIndexSegment* seg;
+    BLBIndexEntry* entries;
+    int count;
+
+    if (!index || !index->lazy || !segment) {
+        return;
+    }
+
+    seg = (BLBIndexSegment*)BLBIndex_FindSegment(index, sector);
+    if (!seg) {
+        return;  /* Not referenced by the level table */
+    }
+
+    pthread_mutex_lock(&index->lock);
+    if (seg->state != BLB_SEG_UNINDEXED) {
+        pthread_mutex_unlock(&index->lock);
+        return;
+    }
+
+    seg->state = BLB_SEG_INVALID;
+    count = parse_toc(segment, size, scratch);
+    if (count >= 0) {
+        entries = (BLBIndexEntry*)malloc((count ? count : 1) * sizeof(BLBIndexEntry));
+        if (entries) {
+            memcpy(entries, scratch, (size_t)count * sizeof(BLBIndexEntry));
+            index->lazy[seg - index->segments] = entries;
+            seg->entry_count = (u16)count;
+            fill_slots(seg, entries);
+            seg->state = BLB_SEG_INDEXED;
+        } else {
+            seg->state = BLB_SEG_UNINDEXED;  /* Retry next acquire */
+        }
+    }
+    pthread_mutex_unlock(&index->lock);
+}
+
+const BLBIndexSegment* BLBIndex_FindSegment(const BLBIndex* index, u16 sector) {
+    u32 h;
+
+    if (!index) {
+        return NULL;
+    }
+
+    h = hash_sector(sector) & index->hash_mask;
+    while (index->hash[h]) {
+        const BLBIndexSegment* seg = &index->segments[index->hash[h] - 1];
+        if (seg->sector == sector) {
+            return seg;
+        }
+        h = (h + 1) & index->hash_mask;
+    }
+    return NULL;
+}
+
+const BLBIndexEntry* BLBIndex_GetEntries(const BLBIndex* index,
+                                         const BLBIndexSegment* seg) {
+    const BLBIndexEntry* entries = NULL;
+
+    if (!index || !seg) {
+        return NULL;
+    }
+    if (index->lazy) {
+        /* BLBIndex_Touch may be filling seg on another thread. Once seen
+         * indexed under the lock, a segment never changes again. */
+        pthread_mutex_lock(&((BLBIndex*)index)->lock);
+        if (seg->state == BLB_SEG_INDEXED) {
+            entries = index->lazy[seg - index->segments];
+        }
+        pthread_mutex_unlock(&((BLBIndex*)index)->lock);
+        return entries;
+    }
+    if (seg->state != BLB_SEG_INDEXED) {
+        return NULL;
+    }
+    return index->entries + seg->first_entry;
+}
+
+void BLBIndex_Free(BLBIndex* index) {
+    u32 i;
+
+    if (!index) {
+        return;
+    }
+
+    if (index->lazy) {
+        for (i = 0; i < index->segment_count; i++) {
+            free(index->lazy[i]);
+        }
+        free(index->lazy);
+    }
+
+    if (index->block) {
+        /* Arrays point into the sidecar block */
+#ifndef _WIN32
+        if (index->block_mapped) {
+            munmap(index->block, index->block_size);
+        } else
+#endif
+        {
+            free(index->block);
+        }
+    } else {
+        free(index->entries);
+        free(index->segments);
+        free(index->hash);
+    }
+    pthread_mutex_destroy(&index->lock);
+    free(index);
+}
+
+/* -----------------------------------------------------------------------------
+ * Public lookups
+ * -------------------------------------------------------------------------- */
+
+const BLBIndexEntry* BLB_GetSegmentAssets(const BLBFile* blb, u16 sector_offset,
+                                          u32* out_count) {
+    const BLBIndexSegment* seg;
+    const BLBIndexEntry* entries;
+
+    seg = BLBIndex_FindSegment(blb ? blb->index : NULL, sector_offset);
+    entries = BLBIndex_GetEntries(blb ? blb->index : NULL, seg);
+
+    if (out_count) *out_count = entries ? seg->entry_count : 0;
+    return entries;
+}
+
+const BLBIndexEntry* BLB_LookupAsset(const BLBFile* blb, u16 sector_offset,
+                                     u32 asset_id) {
+    const BLBIndexSegment* seg;
+    const BLBIndexEntry* entries;
+    int slot;
+    u32 i;
+
+    seg = BLBIndex_FindSegment(blb ? blb->index : NULL, sector_offset);
+    entries = BLBIndex_GetEntries(blb ? blb->index : NULL, seg);
+    if (!entries) {
+        return NULL;
+    }
+
+    slot = asset_slot(asset_id);
+    if (slot >= 0) {
+        return seg->slot[slot] ? &entries[seg->slot[slot] - 1] : NULL;
+    }
+
+    /* Unusual ID - fall back to scanning this segment */
+    for (i = 0; i < seg->entry_count; i++) {
+        if (entries[i].id == asset_id) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+int BLB_GetStageInfo(const BLBFile* blb, u8 level_index, u8 stage_index,
+                     BLBStageInfo* out_info) {
+    const BLBIndexEntry* e;
+    u16 primary, secondary, tertiary;
+
+    if (!blb || !out_info || stage_index >= BLB_GetStageCount(blb, level_index)) {
+        return -1;
+    }
+
+    memset(out_info, 0, sizeof(BLBStageInfo));
+
+    primary = BLB_GetPrimarySectorOffset(blb, level_index);
+    secondary = BLB_GetSecondarySectorOffset(blb, level_index, stage_index);
+    tertiary = BLB_GetTertiarySectorOffset(blb, level_index, stage_index);
+
+    if (!BLB_GetSegmentAssets(blb, primary, NULL) ||
+        !BLB_GetSegmentAssets(blb, secondary, NULL) ||
+        !BLB_GetSegmentAssets(blb, tertiary, NULL)) {
+        return -1;
+    }
+
+    if ((e = BLB_LookupAsset(blb, secondary, ASSET_TILE_HEADER)) != NULL)
+        out_info->tile_count = e->item_count;
+    if ((e = BLB_LookupAsset(blb, secondary, ASSET_PALETTE_CONTAINER)) != NULL)
+        out_info->palette_count = e->item_count;
+    if ((e = BLB_LookupAsset(blb, tertiary, ASSET_LAYER_ENTRIES)) != NULL)
+        out_info->layer_count = e->item_count;
+    if ((e = BLB_LookupAsset(blb, tertiary, ASSET_ENTITIES)) != NULL)
+        out_info->entity_count = e->item_count;
+    if ((e = BLB_LookupAsset(blb, tertiary, ASSET_TILEMAP_CONTAINER)) != NULL)
+        out_info->tilemap_count = e->item_count;
+
+    /* Sprites and sounds can live in either primary or tertiary */
+    if ((e = BLB_LookupAsset(blb, primary, ASSET_GEOMETRY)) != NULL)
+        out_info->sprite_count += e->item_count;
+    if ((e = BLB_LookupAsset(blb, tertiary, ASSET_GEOMETRY)) != NULL)
+        out_info->sprite_count += e->item_count;
+    if ((e = BLB_LookupAsset(blb, primary, ASSET_AUDIO_SAMPLES)) != NULL)
+        out_info->sound_count += e->item_count;
+    if ((e = BLB_LookupAsset(blb, tertiary, ASSET_AUDIO_SAMPLES)) != NULL)
+        out_info->sound_count += e->item_count;
+
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Sidecar Catalog
+ * -------------------------------------------------------------------------- */
+
+static u64 fnv1a(u64 h, const u8* data, u32 size) {
+    u32 i;
+
+    for (i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static u32 align8(u32 value) {
+    return (value + 7) & ~7u;
+}
+
+/* Copy archive bytes from memory, or from file for the paged backend */
+static int read_archive(const BLBFile* blb, FILE* file, u32 offset, u8* dst, u32 size) {
+    if (offset > blb->size || size > blb->size - offset) {
+        return -1;
+    }
+    if (blb->data) {
+        memcpy(dst, blb->data + offset, size);
+        return 0;
+    }
+    if (!file || fseek(file, (long)offset, SEEK_SET) != 0 ||
+        fread(dst, 1, size, file) != size) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Fold one segment's TOC and the head of each asset into h */
+static u64 hash_segment(const BLBFile* blb, FILE* file, u16 sector, u16 sector_count, u64 h) {
+    u8 toc[4 + MAX_TOC_ENTRIES * 12];
+    u8 head[0x16];              /* Covers every field derive_count reads */
+    u32 start = (u32)sector * BLB_SECTOR_SIZE;
+    u32 limit = segment_limit(blb->size, start, sector_count);
+    u32 count, i;
+
+    if (limit < 4 || read_archive(blb, file, start, toc, 4) != 0) {
+        return h;
+    }
+    count = read_u32(toc);
+    if (count > MAX_TOC_ENTRIES || 4 + count * 12 > limit ||
+        read_archive(blb, file, start + 4, toc + 4, count * 12) != 0) {
+        return fnv1a(h, toc, 4);
+    }
+    h = fnv1a(h, toc, 4 + count * 12);
+
+    for (i = 0; i < count; i++) {
+        const u8* e = toc + 4 + i * 12;
+        u32 size = read_u32(e + 4);
+        u32 offset = read_u32(e + 8);
+        u32 n = size < sizeof(head) ? size : (u32)sizeof(head);
+
+        if (offset <= limit && n <= limit - offset &&
+            read_archive(blb, file, start + offset, head, n) == 0) {
+            h = fnv1a(h, head, n);
+        }
+    }
+    return h;
+}
+
+/* Hash the header and every segment the level table references */
+static u64 hash_archive(const BLBFile* blb, FILE* file) {
+    u64 h = fnv1a(0xCBF29CE484222325ull, blb->header, BLB_HEADER_SIZE);
+    u8 level;
+
+    for (level = 0; level < blb->level_count; level++) {
+        u16 stages = BLB_GetStageCount(blb, level);
+        u8 stage;
+
+        if (stages > BLB_MAX_STAGES) {
+            stages = BLB_MAX_STAGES;
+        }
+        h = hash_segment(blb, file, BLB_GetPrimarySectorOffset(blb, level),
+                         BLB_GetPrimarySectorCount(blb, level), h);
+        for (stage = 0; stage < stages; stage++) {
+            h = hash_segment(blb, file, BLB_GetSecondarySectorOffset(blb, level, stage),
+                             BLB_GetSecondarySectorCount(blb, level, stage), h);
+            h = hash_segment(blb, file, BLB_GetTertiarySectorOffset(blb, level, stage),
+                             BLB_GetTertiarySectorCount(blb, level, stage), h);
+        }
+    }
+    return h;
+}
+
+/* Build the expected sidecar key for an archive. Returns -1 if unreadable. */
+static int make_key(const BLBFile* blb, const char* archive_path, SidecarHeader* key) {
+    FILE* file = NULL;
+
+    /* Paged handles hold only the header; read the TOCs from the file */
+    if (!blb->data && !(file = fopen(archive_path, "rb"))) {
+        return -1;
+    }
+
+    memset(key, 0, sizeof(*key));
+    memcpy(key->magic, SIDECAR_MAGIC, 8);
+    key->version = SIDECAR_VERSION;
+    key->endian = SIDECAR_ENDIAN;
+    key->content_hash = hash_archive(blb, file);
+    key->blb_size = blb->size;
+    key->level_count = blb->level_count;
+
+    if (file) {
+        fclose(file);
+    }
+    return 0;
+}
+
+/* Check a loaded catalog against the archive and itself. */
+static int validate_sidecar(const u8* block, u32 size, const SidecarHeader* key) {
+    const SidecarHeader* hdr = (const SidecarHeader*)block;
+    const BLBIndexSegment* segments;
+    const BLBIndexEntry* entries;
+    const u16* hash;
+    u32 i, j;
+
+    if (size < sizeof(SidecarHeader) ||
+        memcmp(hdr->magic, key->magic, 8) != 0 ||
+        hdr->version != key->version || hdr->endian != key->endian ||
+        hdr->content_hash != key->content_hash ||
+        hdr->blb_size != key->blb_size || hdr->level_count != key->level_count) {
+        return -1;
+    }
+
+    /* Arrays must be aligned, in bounds, and the hash must have a free slot */
+    if ((hdr->segments_offset | hdr->entries_offset | hdr->hash_offset) & 7 ||
+        hdr->segment_count > 0xFFFF ||
+        hdr->hash_size <= hdr->segment_count || (hdr->hash_size & (hdr->hash_size - 1)) ||
+        hdr->segments_offset > size ||
+        hdr->segment_count > (size - hdr->segments_offset) / sizeof(BLBIndexSegment) ||
+        hdr->entries_offset > size ||
+        hdr->entry_count > (size - hdr->entries_offset) / sizeof(BLBIndexEntry) ||
+        hdr->hash_offset > size ||
+        hdr->hash_size > (size - hdr->hash_offset) / sizeof(u16)) {
+        return -1;
+    }
+
+    segments = (const BLBIndexSegment*)(block + hdr->segments_offset);
+    entries = (const BLBIndexEntry*)(block + hdr->entries_offset);
+    hash = (const u16*)(block + hdr->hash_offset);
+
+    for (i = 0; i < hdr->hash_size; i++) {
+        if (hash[i] > hdr->segment_count) return -1;
+    }
+
+    /* Every indexed asset has to stay inside its segment's sector run */
+    for (i = 0; i < hdr->segment_count; i++) {
+        const BLBIndexSegment* seg = &segments[i];
+        u32 start = (u32)seg->sector * BLB_SECTOR_SIZE;
+        u32 limit = segment_limit(hdr->blb_size, start, seg->sector_count);
+
+        if (seg->state == BLB_SEG_INVALID) continue;
+        if (seg->state != BLB_SEG_INDEXED || start >= hdr->blb_size ||
+            seg->first_entry > hdr->entry_count ||
+            seg->entry_count > hdr->entry_count - seg->first_entry) {
+            return -1;
+        }
+        for (j = 0; j < BLB_INDEX_SLOTS; j++) {
+            if (seg->slot[j] > seg->entry_count) return -1;
+        }
+        for (j = 0; j < seg->entry_count; j++) {
+            const BLBIndexEntry* e = &entries[seg->first_entry + j];
+            if (e->offset > limit || e->size > limit - e->offset) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Read or map a whole file. Returns NULL if missing/unreadable. */
+static u8* load_file(const char* path, u32* out_size, int* out_mapped) {
+#ifndef _WIN32
+    struct stat st;
+    void* map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SidecarHeader) ||
+        st.st_size > 0x7FFFFFFF) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    *out_size = (u32)st.st_size;
+    *out_mapped = 1;
+    return (u8*)map;
+#else
+    FILE* f;
+    long size;
+    u8* data;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < (long)sizeof(SidecarHeader) || !(data = (u8*)malloc(size))) {
+        fclose(f);
+        return NULL;
+    }
+    if (fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *out_size = (u32)size;
+    *out_mapped = 0;
+    return data;
+#endif
+}
+
+static void unload_file(u8* data, u32 size, int mapped) {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(data, size);
+        return;
+    }
+#endif
+    (void)size;
+    (void)mapped;
+    free(data);
+}
+
+/* Map a catalog that matches key. Returns NULL if absent or stale. */
+static BLBIndex* load_sidecar(const char* sidecar_path, const SidecarHeader* key) {
+    const SidecarHeader* hdr;
+    BLBIndex* index;
+    u32 size = 0;
+    int mapped = 0;
+    u8* block;
+
+    block = load_file(sidecar_path, &size, &mapped);
+    if (!block) {
+        return NULL;
+    }
+
+    if (validate_sidecar(block, size, key) != 0) {
+        unload_file(block, size, mapped);
+        return NULL;
+    }
+
+    index = (BLBIndex*)calloc(1, sizeof(BLBIndex));
+    if (!index) {
+        unload_file(block, size, mapped);
+        return NULL;
+    }
+
+    hdr = (const SidecarHeader*)block;
+    index->block = block;
+    index->block_size = size;
+    index->block_mapped = mapped;
+    index->segments = (BLBIndexSegment*)(block + hdr->segments_offset);
+    index->segment_count = hdr->segment_count;
+    index->entries = (BLBIndexEntry*)(block + hdr->entries_offset);
+    index->entry_count = hdr->entry_count;
+    index->entry_capacity = hdr->entry_count;
+    index->hash = (u16*)(block + hdr->hash_offset);
+    index->hash_mask = hdr->hash_size - 1;
+    pthread_mutex_init(&index->lock, NULL);
+    return index;
+}
+
+/* Write index to sidecar_path via a temp file + rename. */
+static int save_sidecar(const BLBIndex* index, const char* sidecar_path,
+                        const SidecarHeader* key) {
+    static const u8 zeros[8] = {0};
+    SidecarHeader hdr;
+    char tmp_path[1024];
+    FILE* f;
+    int ok;
+
+    if (!index || index->lazy || strlen(sidecar_path) + 5 > sizeof(tmp_path)) {
+        return -1;  /* Lazy indexes are incomplete */
+    }
+
+    hdr = *key;
+    hdr.segment_count = index->segment_count;
+    hdr.entry_count = index->entry_count;
+    hdr.hash_size = index->hash_mask + 1;
+    hdr.segments_offset = align8(sizeof(SidecarHeader));
+    hdr.entries_offset = align8(hdr.segments_offset +
+                                hdr.segment_count * sizeof(BLBIndexSegment));
+    hdr.hash_offset = align8(hdr.entries_offset +
+                             hdr.entry_count * sizeof(BLBIndexEntry));
+
+    sprintf(tmp_path, "%s.tmp", sidecar_path);
+    f = fopen(tmp_path, "wb");
+    if (!f) {
+        return -1;
+    }
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+         fwrite(zeros, 1, hdr.segments_offset - sizeof(hdr), f) ==
+             hdr.segments_offset - sizeof(hdr) &&
+         (hdr.segment_count == 0 ||
+          fwrite(index->segments, sizeof(BLBIndexSegment), hdr.segment_count, f) ==
+              hdr.segment_count) &&
+         fwrite(zeros, 1, hdr.entries_offset - (hdr.segments_offset +
+                hdr.segment_count * sizeof(BLBIndexSegment)), f) ==
+             hdr.entries_offset - (hdr.segments_offset +
+                hdr.segment_count * sizeof(BLBIndexSegment)) &&
+         (hdr.entry_count == 0 ||
+          fwrite(index->entries, sizeof(BLBIndexEntry), hdr.entry_count, f) ==
+              hdr.entry_count) &&
+         fwrite(zeros, 1, hdr.hash_offset - (hdr.entries_offset +
+                hdr.entry_count * sizeof(BLBIndexEntry)), f) ==
+             hdr.hash_offset - (hdr.entries_offset +
+                hdr.entry_count * sizeof(BLBIndexEntry)) &&
+         fwrite(index->hash, sizeof(u16), hdr.hash_size, f) == hdr.hash_size;
+
+    if (fclose(f) != 0 || !ok) {
+        remove(tmp_path);
+        return -1;
+    }
+
+#ifdef _WIN32
+    remove(sidecar_path);   /* rename() won't replace on Windows */
+#endif
+    if (rename(tmp_path, sidecar_path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/* "<archive_path>.blbidx" into buf. Returns -1 if it doesn't fit. */
+static int sidecar_path_for(const char* archive_path, char* buf, size_t buf_size) {
+    size_t len = strlen(archive_path);
+
+    if (len + sizeof(BLB_SIDECAR_SUFFIX) > buf_size) {
+        return -1;
+    }
+    memcpy(buf, archive_path, len);
+    memcpy(buf + len, BLB_SIDECAR_SUFFIX, sizeof(BLB_SIDECAR_SUFFIX));
+    return 0;
+}
+
+BLBIndex* BLBIndex_Open(const BLBFile* blb, const char* archive_path,
+                        u32 flags, int lazy) {
+    SidecarHeader key;
+    char sidecar[1024];
+    BLBIndex* index;
+    int use_sidecar;
+
+    use_sidecar = archive_path && !(flags & BLB_OPEN_NO_SIDECAR) &&
+                  sidecar_path_for(archive_path, sidecar, sizeof(sidecar)) == 0 &&
+                  make_key(blb, archive_path, &key) == 0;
+
+    if (use_sidecar) {
+        index = load_sidecar(sidecar, &key);
+        if (index) {
+            return index;
+        }
+    }
+
+    index = BLBIndex_Create(blb, lazy);
+
+    /* Opt-in, best effort - a read-only directory just means no warm start */
+    if (index && use_sidecar && !lazy && (flags & BLB_OPEN_WRITE_SIDECAR)) {
+        save_sidecar(index, sidecar, &key);
+    }
+    return index;
+}
+
+int BLB_SaveIndex(const BLBFile* blb, const char* archive_path) {
+    SidecarHeader key;
+    char sidecar[1024];
+
+    if (!blb || !blb->index || !archive_path ||
+        sidecar_path_for(archive_path, sidecar, sizeof(sidecar)) != 0 ||
+        make_key(blb, archive_path, &key) != 0) {
+        return -1;
+    }
+    return save_sidecar(blb->index, sidecar, &key);
+}
@@ -0,0 +1,83 @@
+/**
+ * blb_index.h - Per-segment asset index (internal)
+ *
+ * Shared between blb.c, blb_cache.c and blb_index.c only. Lookups are
+ * exposed through BLB_GetSegmentAssets / BLB_LookupAsset in blb.h.
+ *
+ * Layout is flat (no pointers between records) so the same arrays can be
+ * written out and mapped back in as a sidecar catalog.
+ *
+ * TOOL-ONLY: The original game scans the TOC in GetAssetPointer-style
+ * loops; this replaces the scans for the desktop tools.
+ */
+
+#ifndef BLB_INDEX_H
+#define BLB_INDEX_H
+
+#include "blb.h"
+
+/* Asset ID -> slot: (id / 100 - 1) * 8 + id % 100, for ids 100..799 with
+ * id % 100 < 8. Every known asset type fits; others fall back to a scan. */
+#define BLB_INDEX_SLOTS     64
+
+/* Segment states */
+#define BLB_SEG_UNINDEXED   0   /* Paged: TOC not read yet */
+#define BLB_SEG_INDEXED     1
+#define BLB_SEG_INVALID     2   /* TOC failed sanity checks */
+
+/**
+ * One distinct sector run referenced by the level table (80 bytes).
+ */
+typedef struct {
+    u16 sector;                 /* First sector */
+    u16 sector_count;           /* Length from the level entry */
+    u32 first_entry;            /* Index of first BLBIndexEntry */
+    u16 entry_count;            /* TOC entry count */
+    u8  state;                  /* BLB_SEG_* */
+    u8  pad;
+    u32 reserved;
+    u8  slot[BLB_INDEX_SLOTS];  /* Slot -> local entry index + 1 (0 = absent) */
+} BLBIndexSegment;
+
+/**
+ * Build an index for blb.
+ * @param lazy      Only register segments; TOCs are read by BLBIndex_Touch
+ * @return          Index, or NULL on allocation failure
+ */
+BLBIndex* BLBIndex_Create(const BLBFile* blb, int lazy);
+
+/**
+ * Get an index for an archive opened from archive_path.
+ * Maps <archive_path>.blbidx if it matches the archive; otherwise builds
+ * the index, and with BLB_OPEN_WRITE_SIDECAR (unless lazy) writes the
+ * catalog for next time.
+ * @param flags     BLB_OPEN_NO_SIDECAR skips the catalog entirely
+ */
+BLBIndex* BLBIndex_Open(const BLBFile* blb, const char* archive_path,
+                        u32 flags, int lazy);
+
+/**
+ * Index a segment from its loaded bytes if not done yet (paged backend).
+ * Safe to call from several threads.
+ */
+void BLBIndex_Touch(BLBIndex* index, u16 sector, const u8* segment, u32 size);
+
+/**
+ * Find the segment record starting at sector, or NULL.
+ */
+const BLBIndexSegment* BLBIndex_FindSegment(const BLBIndex* index, u16 sector);
+
+/**
+ * Get the entry array for a segment record, or NULL if not indexed.
+ * Lazy indexes take the lock, so a non-NULL result also makes the
+ * record's entry_count and slots safe to read.
+ */
+const BLBIndexEntry* BLBIndex_GetEntries(const BLBIndex* index,
+                                         const BLBIndexSegment* seg);
+
+/**
+ * Free an index and everything it owns.
+ */
+void BLBIndex_Free(BLBIndex* index);
+
+#endif /* BLB_INDEX_H */
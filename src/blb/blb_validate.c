@@ -0,0 +1,571 @@
+/**
+ * blb_validate.c - Whole-archive validation pass
+ *
+ * Checks every segment the level table references exactly once: the TOC,
+ * each asset's size against the counts that describe it, every sub-TOC,
+ * and the offsets inside sprite containers. Segments are independent, so
+ * they are handed out to worker threads from a shared counter.
+ *
+ * Checks are written against what the accessors dereference - if an
+ * archive passes, the BLB_IS_TRUSTED fast paths can't read out of bounds.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* clock_gettime */
+#endif
+
+#include "blb.h"
+#include "blb_index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/* Sanity limits shared with the accessors */
+#define MAX_TOC_ENTRIES     100     /* BLB_FindAsset */
+#define MAX_PALETTES        256     /* BLB_ParsePaletteContainer */
+#define MAX_SPRITE_ANIMS    100     /* BLB_ParseSpriteHeader */
+#define MAX_FRAME_DIM       512     /* BLB_GetSpriteFrameMetadata */
+
+#define PALETTE_BYTES       512     /* 256 x u16 */
+#define TILE_HEADER_SIZE    0x24    /* sizeof(TileHeader) */
+#define LAYER_ENTRY_SIZE    92      /* sizeof(LayerEntry) */
+#define SPRITE_FRAME_SIZE   36      /* SpriteFrame */
+#define MAX_WORKERS         64
+
+/* Segment roles (a sector run can be referenced as both) */
+#define ROLE_PRIMARY        0x01
+#define ROLE_STAGE          0x02    /* Secondary or tertiary */
+
+typedef struct {
+    u16     sector;
+    u16     count;
+    u8      roles;
+    u8      failed;
+    u16     pad;
+    u32     bad_asset;      /* Asset ID that failed (0 = TOC/segment) */
+    u32     assets;         /* TOC entries checked */
+    u32     bytes;          /* Segment size */
+} ValidateJob;
+
+typedef struct {
+    const BLBFile*  blb;
+    ValidateJob*    jobs;
+    u32             job_count;
+    u32             next;   /* Next job to hand out */
+    pthread_mutex_t lock;
+} ValidateQueue;
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+static u16 read_u16(const u8* ptr) {
+    return (u16)ptr[0] | ((u16)ptr[1] << 8);
+}
+
+static u32 read_u32(const u8* ptr) {
+    return (u32)ptr[0] | ((u32)ptr[1] << 8) |
+           ((u32)ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+static u64 now_us(void) {
+#ifdef _WIN32
+    return (u64)clock() * 1000000u / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000u + (u64)ts.tv_nsec / 1000u;
+#endif
+}
+
+static u32 default_thread_count(void) {
+#if !defined(_WIN32) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (u32)n : 1;
+#else
+    return 4;
+#endif
+}
+
+/* True if [offset, offset + length) lies inside size bytes */
+static int in_bounds(u64 offset, u64 length, u32 size) {
+    return offset <= size && length <= size - offset;
+}
+
+/*
+ * Register a sector run once. Returns -1 if the run is empty or outside
+ * the file: Level_Load acquires every run of a stage, and an empty one
+ * would be read as the rest of the archive (or not at all when paged).
+ */
+static int add_job(ValidateJob* jobs, u32* job_count, const BLBFile* blb,
+                   u16 sector, u16 count, u8 role) {
+    u32 i;
+
+    if (count == 0 ||
+        (u32)sector * BLB_SECTOR_SIZE < BLB_HEADER_SIZE ||
+        (u32)sector * BLB_SECTOR_SIZE >= blb->size) {
+        return -1;
+    }
+
+    for (i = 0; i < *job_count; i++) {
+        if (jobs[i].sector == sector && jobs[i].count == count) {
+            jobs[i].roles |= role;
+            return 0;
+        }
+    }
+
+    memset(&jobs[*job_count], 0, sizeof(ValidateJob));
+    jobs[*job_count].sector = sector;
+    jobs[*job_count].count = count;
+    jobs[*job_count].roles = role;
+    (*job_count)++;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Asset checks (0 = ok, -1 = bad)
+ * -------------------------------------------------------------------------- */
+
+/* Every sub-TOC entry lies inside the container and is at least min_size */
+static int check_sub_toc(const u8* data, u32 size, u32 max_count, u32 min_size) {
+    u32 count, i, entry_size;
+
+    if (size < 4) {
+        return -1;
+    }
+    count = read_u32(data);
+    if (count > max_count) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        if (!BLB_GetSubAsset(data, size, i, &entry_size) || entry_size < min_size) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* One RLE frame: command table, pixel run and row count stay in bounds */
+static int check_rle_frame(const u8* sprite, u32 size, u64 rle_start, u16 height) {
+    u32 cmd_count, i, newlines = 0;
+    u64 pixels = 0;
+
+    if (!in_bounds(rle_start, 2, size)) {
+        return -1;
+    }
+    cmd_count = read_u16(sprite + rle_start);
+    if (!in_bounds(rle_start + 2, (u64)cmd_count * 2, size)) {
+        return -1;
+    }
+
+    for (i = 0; i < cmd_count; i++) {
+        u16 cmd = read_u16(sprite + rle_start + 2 + i * 2);
+        if (cmd & 0x8000) {
+            newlines++;     /* DecodeRLESprite advances one row */
+        }
+        pixels += cmd & 0xFF;
+    }
+
+    if (height > 0 && newlines >= height) {
+        return -1;
+    }
+    return in_bounds(rle_start + 2 + (u64)cmd_count * 2, pixels, size) ? 0 : -1;
+}
+
+/* One sprite: header, animations, frame metadata, palette and RLE data */
+static int check_sprite(const u8* sprite, u32 size) {
+    u32 anim_count, frame_meta, rle_base, palette_offset, a;
+
+    if (size < 12) {
+        return -1;
+    }
+    anim_count = read_u16(sprite + 0);
+    frame_meta = read_u16(sprite + 2);
+    rle_base = read_u32(sprite + 4);
+    palette_offset = read_u32(sprite + 8);
+
+    if (anim_count > MAX_SPRITE_ANIMS || !in_bounds(12, (u64)anim_count * 12, size)) {
+        return -1;
+    }
+    /* Zero means no embedded palette (see SpriteContext) */
+    if (palette_offset && !in_bounds(palette_offset, PALETTE_BYTES, size)) {
+        return -1;
+    }
+
+    for (a = 0; a < anim_count; a++) {
+        const u8* anim = sprite + 12 + a * 12;
+        u32 frame_count = read_u16(anim + 4);
+        u32 first = read_u16(anim + 6);
+        u32 f;
+
+        if (!in_bounds(frame_meta + (u64)first * SPRITE_FRAME_SIZE,
+                       (u64)frame_count * SPRITE_FRAME_SIZE, size)) {
+            return -1;
+        }
+
+        for (f = first; f < first + frame_count; f++) {
+            const u8* frame = sprite + frame_meta + f * SPRITE_FRAME_SIZE;
+            u16 width = read_u16(frame + 10);
+            u16 height = read_u16(frame + 12);
+
+            if (width > MAX_FRAME_DIM || height > MAX_FRAME_DIM) {
+                return -1;
+            }
+            if (check_rle_frame(sprite, size, (u64)rle_base + read_u32(frame + 32),
+                                height) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int check_sprite_container(const u8* data, u32 size) {
+    u32 count, i, sprite_size, sprite_id;
+
+    if (BLB_ParseSpriteContainer(data, &count) != 0) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        const u8* sprite = BLB_GetSpriteFromContainerEx(data, size, i,
+                                                        &sprite_id, &sprite_size);
+        if (!sprite || check_sprite(sprite, sprite_size) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Check one segment's bytes. Cross-asset rules (tile counts, palette
+ * indices, layer sizes) only involve assets of the same segment.
+ * Returns 0, or -1 with job->bad_asset set.
+ */
+static int check_segment(const u8* seg, u32 size, ValidateJob* job) {
+    const u8* asset[BLB_INDEX_SLOTS];
+    u32 asset_size[BLB_INDEX_SLOTS];
+    u32 count, toc_end, i;
+
+#define SLOT(id)    (((id) / 100 - 1) * 8 + (id) % 100)
+#define FAIL(id)    do { job->bad_asset = (id); return -1; } while (0)
+
+    memset(asset, 0, sizeof(asset));
+    memset(asset_size, 0, sizeof(asset_size));
+
+    if (size < 4) {
+        FAIL(0);
+    }
+    count = read_u32(seg);
+    if (count > MAX_TOC_ENTRIES) {
+        FAIL(0);
+    }
+    toc_end = 4 + count * 12;
+    if (toc_end > size) {
+        FAIL(0);
+    }
+
+    /* Top-level TOC */
+    for (i = 0; i < count; i++) {
+        const u8* toc = seg + 4 + i * 12;
+        u32 id = read_u32(toc + 0);
+        u32 asset_len = read_u32(toc + 4);
+        u32 offset = read_u32(toc + 8);
+
+        if (!in_bounds(offset, asset_len, size)) {
+            FAIL(id);
+        }
+        job->assets++;
+
+        /* First occurrence wins, as in BLB_FindAsset */
+        if (id >= 100 && id < 900 && id % 100 < 8 && !asset[SLOT(id)]) {
+            asset[SLOT(id)] = seg + offset;
+            asset_size[SLOT(id)] = asset_len;
+        }
+    }
+
+    /* Containers */
+    if (asset[SLOT(ASSET_PALETTE_CONTAINER)] &&
+        check_sub_toc(asset[SLOT(ASSET_PALETTE_CONTAINER)],
+                      asset_size[SLOT(ASSET_PALETTE_CONTAINER)],
+                      MAX_PALETTES, PALETTE_BYTES) != 0) {
+        FAIL(ASSET_PALETTE_CONTAINER);
+    }
+    if (asset[SLOT(ASSET_TILEMAP_CONTAINER)] &&
+        check_sub_toc(asset[SLOT(ASSET_TILEMAP_CONTAINER)],
+                      asset_size[SLOT(ASSET_TILEMAP_CONTAINER)], 0xFFFFFFFFu, 0) != 0) {
+        FAIL(ASSET_TILEMAP_CONTAINER);
+    }
+    if (asset[SLOT(ASSET_AUDIO_SAMPLES)] &&
+        check_sub_toc(asset[SLOT(ASSET_AUDIO_SAMPLES)],
+                      asset_size[SLOT(ASSET_AUDIO_SAMPLES)], 0xFFFFFFFFu, 0) != 0) {
+        FAIL(ASSET_AUDIO_SAMPLES);
+    }
+    if (asset[SLOT(ASSET_GEOMETRY)]) {
+        /* Primary 600 is world geometry; stage 600 is the sprite container */
+        const u8* data = asset[SLOT(ASSET_GEOMETRY)];
+        u32 len = asset_size[SLOT(ASSET_GEOMETRY)];
+
+        if (check_sub_toc(data, len, 0xFFFFFFFFu, 0) != 0 ||
+            ((job->roles & ROLE_STAGE) && check_sprite_container(data, len) != 0)) {
+            FAIL(ASSET_GEOMETRY);
+        }
+    }
+
+    /* Tile data against the tile header counts */
+    if (asset[SLOT(ASSET_TILE_HEADER)]) {
+        const u8* hdr = asset[SLOT(ASSET_TILE_HEADER)];
+        u32 count_16, small, total;
+
+        if (asset_size[SLOT(ASSET_TILE_HEADER)] < TILE_HEADER_SIZE) {
+            FAIL(ASSET_TILE_HEADER);
+        }
+        count_16 = read_u16(hdr + 0x10);
+        small = (u32)read_u16(hdr + 0x12) + read_u16(hdr + 0x14);
+        total = count_16 + small;
+
+        /* 8x8 and extra tiles both use the 128-byte stride */
+        if (asset[SLOT(ASSET_TILE_PIXELS)] &&
+            asset_size[SLOT(ASSET_TILE_PIXELS)] < count_16 * 256 + small * 128) {
+            FAIL(ASSET_TILE_PIXELS);
+        }
+        if (asset[SLOT(ASSET_TILE_FLAGS)] && asset_size[SLOT(ASSET_TILE_FLAGS)] < total) {
+            FAIL(ASSET_TILE_FLAGS);
+        }
+        if (asset[SLOT(ASSET_PALETTE_INDICES)]) {
+            const u8* indices = asset[SLOT(ASSET_PALETTE_INDICES)];
+
+            if (asset_size[SLOT(ASSET_PALETTE_INDICES)] < total) {
+                FAIL(ASSET_PALETTE_INDICES);
+            }
+            if (asset[SLOT(ASSET_PALETTE_CONTAINER)]) {
+                u32 palettes = read_u32(asset[SLOT(ASSET_PALETTE_CONTAINER)]);
+                for (i = 0; i < total; i++) {
+                    if (indices[i] >= palettes) {
+                        FAIL(ASSET_PALETTE_INDICES);
+                    }
+                }
+            }
+        }
+    }
+
+    /* Each layer's tilemap holds width * height entries */
+    if (asset[SLOT(ASSET_LAYER_ENTRIES)] && asset[SLOT(ASSET_TILEMAP_CONTAINER)]) {
+        const u8* layers = asset[SLOT(ASSET_LAYER_ENTRIES)];
+        const u8* tilemaps = asset[SLOT(ASSET_TILEMAP_CONTAINER)];
+        u32 tilemaps_size = asset_size[SLOT(ASSET_TILEMAP_CONTAINER)];
+        u32 layer_count = asset_size[SLOT(ASSET_LAYER_ENTRIES)] / LAYER_ENTRY_SIZE;
+        u32 tilemap_count = read_u32(tilemaps);
+
+        for (i = 0; i < layer_count && i < tilemap_count; i++) {
+            const u8* layer = layers + i * LAYER_ENTRY_SIZE;
+            u32 tilemap_size;
+
+            BLB_GetSubAsset(tilemaps, tilemaps_size, i, &tilemap_size);
+            if ((u32)read_u16(layer + 4) * read_u16(layer + 6) * 2 > tilemap_size) {
+                FAIL(ASSET_LAYER_ENTRIES);
+            }
+        }
+    }
+
+    /* Tile attribute grid: u16 x, y, width, height then one byte per cell */
+    if (asset[SLOT(ASSET_TILE_ATTRS)]) {
+        const u8* attrs = asset[SLOT(ASSET_TILE_ATTRS)];
+        u32 len = asset_size[SLOT(ASSET_TILE_ATTRS)];
+
+        if (len < 8 || (u32)read_u16(attrs + 4) * read_u16(attrs + 6) > len - 8) {
+            FAIL(ASSET_TILE_ATTRS);
+        }
+    }
+
+#undef FAIL
+#undef SLOT
+    return 0;
+}
+
+/* The index must agree with the raw TOC (it may come from a sidecar) */
+static int check_index(const BLBFile* blb, const u8* seg, u16 sector) {
+    const BLBIndexEntry* entries;
+    u32 count, i;
+
+    entries = BLB_GetSegmentAssets(blb, sector, &count);
+    if (!entries) {
+        return 0;   /* Not indexed - accessors scan the raw TOC */
+    }
+    if (count != read_u32(seg)) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        const u8* toc = seg + 4 + i * 12;
+        if (entries[i].id != read_u32(toc + 0) ||
+            entries[i].size != read_u32(toc + 4) ||
+            entries[i].offset != read_u32(toc + 8)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void validate_job(const BLBFile* blb, ValidateJob* job) {
+    const u8* seg;
+    u32 size;
+
+    seg = BLB_AcquireSegment(blb, job->sector, job->count, &size);
+    if (!seg) {
+        job->failed = 1;
+        return;
+    }
+    job->bytes = size;
+
+    if (check_segment(seg, size, job) != 0) {
+        job->failed = 1;
+    } else if (check_index(blb, seg, job->sector) != 0) {
+        job->bad_asset = 0;
+        job->failed = 1;
+    }
+
+    BLB_ReleaseSegment(blb, seg);
+}
+
+static void* validate_worker(void* arg) {
+    ValidateQueue* queue = (ValidateQueue*)arg;
+
+    for (;;) {
+        u32 i;
+
+        pthread_mutex_lock(&queue->lock);
+        i = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (i >= queue->job_count) {
+            break;
+        }
+        validate_job(queue->blb, &queue->jobs[i]);
+    }
+    return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ * Validation
+ * -------------------------------------------------------------------------- */
+
+int BLB_Validate(BLBFile* blb, u32 thread_count, BLBValidateReport* out_report) {
+    BLBValidateReport report;
+    ValidateQueue queue;
+    pthread_t workers[MAX_WORKERS];
+    u32 started = 0, max_jobs, i;
+    int header_ok = 1;
+    u64 start;
+    u8 level;
+
+    memset(&report, 0, sizeof(report));
+    report.first_bad_sector = 0xFFFFFFFFu;
+    if (out_report) *out_report = report;
+
+    if (!blb || !blb->header) {
+        return -1;
+    }
+    blb->trusted = 0;
+    start = now_us();
+
+    /* Level table: stage counts and sector runs */
+    memset(&queue, 0, sizeof(queue));
+    queue.blb = blb;
+    max_jobs = (u32)blb->level_count * (1 + 2 * BLB_MAX_STAGES);
+    queue.jobs = (ValidateJob*)calloc(max_jobs ? max_jobs : 1, sizeof(ValidateJob));
+    if (!queue.jobs) {
+        return -1;
+    }
+
+    if (blb->level_count > BLB_MAX_LEVELS) {
+        header_ok = 0;
+    }
+    for (level = 0; header_ok && level < blb->level_count; level++) {
+        u16 stages = BLB_GetStageCount(blb, level);
+        u8 stage;
+
+        if (stages > BLB_MAX_STAGES ||
+            add_job(queue.jobs, &queue.job_count, blb,
+                    BLB_GetPrimarySectorOffset(blb, level),
+                    BLB_GetPrimarySectorCount(blb, level), ROLE_PRIMARY) != 0) {
+            header_ok = 0;
+            break;
+        }
+        for (stage = 0; stage < stages; stage++) {
+            if (add_job(queue.jobs, &queue.job_count, blb,
+                        BLB_GetSecondarySectorOffset(blb, level, stage),
+                        BLB_GetSecondarySectorCount(blb, level, stage), ROLE_STAGE) != 0 ||
+                add_job(queue.jobs, &queue.job_count, blb,
+                        BLB_GetTertiarySectorOffset(blb, level, stage),
+                        BLB_GetTertiarySectorCount(blb, level, stage), ROLE_STAGE) != 0) {
+                header_ok = 0;
+                break;
+            }
+        }
+    }
+
+    if (!header_ok) {
+        free(queue.jobs);
+        report.segments_failed = 1;
+        report.first_bad_sector = 0;    /* The header itself */
+        report.elapsed_us = now_us() - start;
+        if (out_report) *out_report = report;
+        return -1;
+    }
+
+    /* Segments on workers; fall back to this thread if none start */
+    if (thread_count == 0) {
+        thread_count = default_thread_count();
+    }
+    if (thread_count > MAX_WORKERS) thread_count = MAX_WORKERS;
+    if (thread_count > queue.job_count) thread_count = queue.job_count;
+
+    pthread_mutex_init(&queue.lock, NULL);
+    for (i = 0; i < thread_count; i++) {
+        if (pthread_create(&workers[i], NULL, validate_worker, &queue) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        validate_worker(&queue);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+
+    /* Totals; first failure in level-table order */
+    report.thread_count = started ? started : 1;
+    for (i = 0; i < queue.job_count; i++) {
+        const ValidateJob* job = &queue.jobs[i];
+
+        report.segments_checked++;
+        report.assets_checked += job->assets;
+        report.bytes_checked += job->bytes;
+        if (job->failed) {
+            if (report.segments_failed == 0) {
+                report.first_bad_sector = job->sector;
+                report.first_bad_asset = job->bad_asset;
+            }
+            report.segments_failed++;
+        }
+    }
+    report.elapsed_us = now_us() - start;
+    free(queue.jobs);
+
+    if (out_report) *out_report = report;
+    if (report.segments_failed != 0) {
+        return -1;
+    }
+
+    blb->trusted = 1;
+    return 0;
+}
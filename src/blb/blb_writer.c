@@ -0,0 +1,943 @@
+/**
+ * blb_writer.c - BLB archive writer
+ *
+ * Sector allocator for building archives. Segments are placed back to
+ * back from the first sector after the header, each padded to a sector
+ * boundary, and the level table entry is patched as each one lands.
+ *
+ * Two targets share the allocator:
+ * - BLB_Create grows a heap image as segments are added
+ * - BLB_CreateStream writes each segment straight to <path>.tmp and only
+ *   keeps the 0x1000 byte header in memory; BLB_WriteToFile writes the
+ *   header last and renames the file into place
+ *
+ * Segments are content-addressed: a segment whose bytes match one already
+ * written reuses that sector run instead of being stored again, so stages
+ * that ship the same secondary/tertiary share one copy on disk.
+ *
+ * Patch mode (BLB_PatchSegment) replaces one segment of an existing
+ * archive, touching only that segment's sectors and its level entry.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* fileno, fsync, pread, pwrite */
+#endif
+
+#include "blb.h"
+#include "blb_cache.h"
+#include "blb_writer.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+/* Largest tertiary segment LEVEL_OFF_TERT_SIZES can describe */
+#define MAX_TERT_SIZE       (0xFFFFu << 5)
+
+/* A sector run already in the output, keyed by content */
+typedef struct {
+    u64     hash;           /* FNV-1a 64 of the segment bytes */
+    u32     size;           /* Segment bytes (without padding) */
+    u16     sector;
+    u16     sector_count;
+} WrittenRun;
+
+struct BLBWriter {
+    FILE*   file;           /* Streaming: temp output (NULL = in-memory) */
+    char*   path;           /* Streaming: destination */
+    char*   tmp_path;       /* Streaming: file being written */
+    u32     capacity;       /* In-memory: bytes allocated at blb->data */
+    u32     next_sector;    /* Allocator: first free sector */
+    int     failed;         /* Sticky write error */
+    int     finished;       /* Streaming: header written, file renamed */
+    WrittenRun* runs;       /* Dedup table, one per distinct segment */
+    u32     run_count;
+    u32     run_capacity;
+    BLBWriteStats stats;
+    u8      header[BLB_HEADER_SIZE];    /* Streaming: header until finish */
+};
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+static u32 read_u32(const u8* ptr) {
+    return (u32)ptr[0] | ((u32)ptr[1] << 8) |
+           ((u32)ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+static void write_u16(u8* ptr, u16 value) {
+    ptr[0] = (u8)(value & 0xFF);
+    ptr[1] = (u8)((value >> 8) & 0xFF);
+}
+
+static void write_u32(u8* ptr, u32 value) {
+    ptr[0] = (u8)(value & 0xFF);
+    ptr[1] = (u8)((value >> 8) & 0xFF);
+    ptr[2] = (u8)((value >> 16) & 0xFF);
+    ptr[3] = (u8)((value >> 24) & 0xFF);
+}
+
+static BLBFile* create_handle(u8 level_count) {
+    BLBFile* blb;
+    
+    if (level_count == 0 || level_count > BLB_MAX_LEVELS) {
+        return NULL;
+    }
+    
+    blb = (BLBFile*)calloc(1, sizeof(BLBFile));
+    if (!blb) {
+        return NULL;
+    }
+    
+    blb->writer = (BLBWriter*)calloc(1, sizeof(BLBWriter));
+    if (!blb->writer) {
+        free(blb);
+        return NULL;
+    }
+    
+    blb->writer->next_sector = BLB_HEADER_SIZE / BLB_SECTOR_SIZE;
+    blb->size = BLB_HEADER_SIZE;
+    blb->level_count = level_count;
+    blb->movie_count = 0;
+    blb->sector_count = 0;
+    blb->is_jp = 0;  /* Default to PAL layout */
+    return blb;
+}
+
+/* Counts, plus a PAL code in the unused sectors[0] so a header written
+ * without BLB_CopyHeaderTables isn't read back as a JP layout */
+static void write_counts(BLBFile* blb) {
+    blb->header[BLB_OFF_LEVEL_COUNT] = blb->level_count;
+    blb->header[BLB_OFF_MOVIE_COUNT] = 0;
+    blb->header[BLB_OFF_SECTOR_COUNT] = 0;
+    memcpy(blb->header + BLB_OFF_LAYOUT_CODE, "NONE", 5);
+}
+
+/* Segment type/stage must exist in the entry and the size be describable */
+static int check_segment_slot(const u8* entry, u8 segment_type, u8 stage_index,
+                              u32 segment_size) {
+    u16 stage_count = (u16)(entry[LEVEL_OFF_STAGE_COUNT] |
+                            (entry[LEVEL_OFF_STAGE_COUNT + 1] << 8));
+    
+    if (segment_type > 2 ||
+        (segment_type != 0 && (stage_index >= stage_count || stage_index >= BLB_MAX_STAGES))) {
+        return -1;
+    }
+    if (segment_type == 2 && segment_size > MAX_TERT_SIZE) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Point a level entry's segment slot at a sector run.
+ * Primaries also carry PRIMARY_SIZE and the Entry[1] (Asset 601) offset
+ * the game reads from the header; tertiaries carry TERT_SIZES.
+ * head is the start of the segment (at least its TOC).
+ */
+static void set_segment_run(u8* entry, u8 segment_type, u8 stage_index,
+                            u16 sector, u16 sector_count,
+                            const u8* head, u32 head_size, u32 segment_size) {
+    switch (segment_type) {
+    case 0:
+        write_u16(entry + LEVEL_OFF_PRIMARY_SECTOR, sector);
+        write_u16(entry + LEVEL_OFF_PRIMARY_COUNT, sector_count);
+        write_u32(entry + LEVEL_OFF_PRIMARY_SIZE, segment_size);
+        if (head_size >= 28 && read_u32(head) >= 2) {
+            write_u32(entry + LEVEL_OFF_ENTRY1_OFFSET, read_u32(head + 4 + 12 + 8));
+        }
+        break;
+    case 1:
+        write_u16(entry + LEVEL_OFF_SEC_SECTOR + stage_index * 2, sector);
+        write_u16(entry + LEVEL_OFF_SEC_COUNT + stage_index * 2, sector_count);
+        break;
+    default:
+        write_u16(entry + LEVEL_OFF_TERT_SECTOR + stage_index * 2, sector);
+        write_u16(entry + LEVEL_OFF_TERT_COUNT + stage_index * 2, sector_count);
+        /* Stored in 32-byte units, rounded up so the game never under-allocates */
+        write_u16(entry + LEVEL_OFF_TERT_SIZES + stage_index * 2,
+                  (u16)((segment_size + 31) >> 5));
+        break;
+    }
+}
+
+/* FNV-1a 64 over a gather list, as if it were one buffer */
+static u64 hash_pieces(const BLBSegmentPiece* pieces, u32 piece_count) {
+    u64 h = 0xCBF29CE484222325ull;
+    u32 i, j;
+    
+    for (i = 0; i < piece_count; i++) {
+        for (j = 0; j < pieces[i].size; j++) {
+            h ^= pieces[i].data[j];
+            h *= 0x100000001B3ull;
+        }
+    }
+    return h;
+}
+
+/**
+ * Append a gathered segment of size bytes plus zero padding to the next
+ * sector boundary. In-memory images grow by doubling and each piece is
+ * copied once into place; streams go straight to disk.
+ */
+static int append_sectors(BLBFile* blb, const BLBSegmentPiece* pieces, u32 piece_count,
+                          u32 size, u32 sector_count) {
+    static const u8 zeros[BLB_SECTOR_SIZE] = {0};
+    BLBWriter* writer = blb->writer;
+    u32 start = writer->next_sector * BLB_SECTOR_SIZE;
+    u32 end = start + sector_count * BLB_SECTOR_SIZE;
+    u32 pos, i;
+    
+    if (writer->file) {
+        for (i = 0; i < piece_count; i++) {
+            if (fwrite(pieces[i].data, 1, pieces[i].size, writer->file) != pieces[i].size) {
+                writer->failed = 1;
+                return -1;
+            }
+        }
+        if (fwrite(zeros, 1, end - start - size, writer->file) != end - start - size) {
+            writer->failed = 1;
+            return -1;
+        }
+    } else {
+        if (end > writer->capacity) {
+            u32 new_cap = writer->capacity;
+            u8* new_data;
+            
+            while (new_cap < end) {
+                new_cap = new_cap > 0x7FFFFFFFu ? end : new_cap * 2;
+            }
+            new_data = (u8*)realloc(blb->data, new_cap);
+            if (!new_data) {
+                return -1;
+            }
+            blb->data = new_data;
+            blb->header = new_data;
+            writer->capacity = new_cap;
+        }
+        pos = start;
+        for (i = 0; i < piece_count; i++) {
+            memcpy(blb->data + pos, pieces[i].data, pieces[i].size);
+            pos += pieces[i].size;
+        }
+        memset(blb->data + start + size, 0, end - start - size);
+    }
+    
+    writer->next_sector += sector_count;
+    blb->size = end;
+    return 0;
+}
+
+/* Byte-compare a candidate run; the hash only narrows the search */
+static int run_matches(BLBFile* blb, const WrittenRun* run,
+                       const BLBSegmentPiece* pieces, u32 piece_count) {
+    BLBWriter* writer = blb->writer;
+    u8 chunk[BLB_SECTOR_SIZE];
+    u32 offset = (u32)run->sector * BLB_SECTOR_SIZE;
+    u32 i, done;
+    int same = 1;
+    
+    if (!writer->file) {
+        for (i = 0; i < piece_count && same; i++) {
+            same = memcmp(blb->data + offset, pieces[i].data, pieces[i].size) == 0;
+            offset += pieces[i].size;
+        }
+        return same;
+    }
+    
+    /* Streaming: read the run back, then return to the append position */
+    if (fflush(writer->file) != 0 || fseek(writer->file, (long)offset, SEEK_SET) != 0) {
+        writer->failed = 1;
+        return 0;
+    }
+    for (i = 0; i < piece_count && same; i++) {
+        for (done = 0; same && done < pieces[i].size; ) {
+            u32 n = pieces[i].size - done;
+            if (n > BLB_SECTOR_SIZE) n = BLB_SECTOR_SIZE;
+            if (fread(chunk, 1, n, writer->file) != n) {
+                writer->failed = 1;
+                same = 0;
+                break;
+            }
+            same = memcmp(chunk, pieces[i].data + done, n) == 0;
+            done += n;
+        }
+    }
+    if (fseek(writer->file, 0, SEEK_END) != 0) {
+        writer->failed = 1;
+    }
+    return same && !writer->failed;
+}
+
+/* Find a written run with identical content */
+static const WrittenRun* find_run(BLBFile* blb, u64 hash, u32 size,
+                                  const BLBSegmentPiece* pieces, u32 piece_count) {
+    BLBWriter* writer = blb->writer;
+    u32 i;
+    
+    for (i = 0; i < writer->run_count; i++) {
+        const WrittenRun* run = &writer->runs[i];
+        if (run->hash == hash && run->size == size &&
+            run_matches(blb, run, pieces, piece_count)) {
+            return run;
+        }
+    }
+    return NULL;
+}
+
+static int add_run(BLBWriter* writer, u64 hash, u32 size, u16 sector, u16 sector_count) {
+    WrittenRun* run;
+    
+    if (writer->run_count >= writer->run_capacity) {
+        u32 new_cap = writer->run_capacity ? writer->run_capacity * 2 : 32;
+        WrittenRun* new_runs = (WrittenRun*)realloc(writer->runs, new_cap * sizeof(WrittenRun));
+        if (!new_runs) {
+            return -1;
+        }
+        writer->runs = new_runs;
+        writer->run_capacity = new_cap;
+    }
+    
+    run = &writer->runs[writer->run_count++];
+    run->hash = hash;
+    run->size = size;
+    run->sector = sector;
+    run->sector_count = sector_count;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * BLB File Write Operations
+ * -------------------------------------------------------------------------- */
+
+BLBFile* BLB_Create(u8 level_count) {
+    BLBFile* blb = create_handle(level_count);
+    
+    if (!blb) {
+        return NULL;
+    }
+    
+    /* Header only - segments grow the image as they are written */
+    blb->data = (u8*)calloc(1, BLB_HEADER_SIZE);
+    if (!blb->data) {
+        BLBWriter_Destroy(blb->writer);
+        free(blb);
+        return NULL;
+    }
+    
+    blb->writer->capacity = BLB_HEADER_SIZE;
+    blb->header = blb->data;
+    blb->backend = BLB_BACKEND_HEAP;
+    write_counts(blb);
+    
+    return blb;
+}
+
+BLBFile* BLB_CreateStream(const char* path, u8 level_count) {
+    BLBFile* blb;
+    BLBWriter* writer;
+    
+    if (!path) {
+        return NULL;
+    }
+    
+    blb = create_handle(level_count);
+    if (!blb) {
+        return NULL;
+    }
+    writer = blb->writer;
+    
+    writer->path = (char*)malloc(strlen(path) + 1);
+    writer->tmp_path = (char*)malloc(strlen(path) + 5);
+    if (!writer->path || !writer->tmp_path) {
+        BLBWriter_Destroy(writer);
+        free(blb);
+        return NULL;
+    }
+    strcpy(writer->path, path);
+    sprintf(writer->tmp_path, "%s.tmp", path);
+    
+    /* Reserve the header; the real one is written by BLB_WriteToFile */
+    writer->file = fopen(writer->tmp_path, "w+b");  /* Read back for dedup */
+    if (!writer->file ||
+        fwrite(writer->header, 1, BLB_HEADER_SIZE, writer->file) != BLB_HEADER_SIZE) {
+        BLBWriter_Destroy(writer);
+        free(blb);
+        return NULL;
+    }
+    
+    blb->data = NULL;   /* Nothing addressable until finished */
+    blb->header = writer->header;
+    blb->backend = BLB_BACKEND_STREAM;
+    write_counts(blb);
+    
+    return blb;
+}
+
+int BLB_SetLevelMetadata(BLBFile* blb, u8 level_index,
+                         const char* level_id, const char* level_name,
+                         u16 stage_count) {
+    u8* entry;
+    int i;
+    
+    if (!blb || !level_id || !level_name) {
+        return -1;
+    }
+    
+    if (level_index >= blb->level_count) {
+        return -1;
+    }
+    
+    if (stage_count == 0 || stage_count > BLB_MAX_STAGES) {
+        return -1;
+    }
+    
+    /* Get level entry */
+    entry = blb->header + BLB_OFF_LEVEL_TABLE + (level_index * BLB_LEVEL_ENTRY_SIZE);
+    
+    /* Write level ID (4 chars + null) */
+    memset(entry + LEVEL_OFF_LEVEL_ID, 0, 5);
+    for (i = 0; i < 4 && level_id[i]; i++) {
+        entry[LEVEL_OFF_LEVEL_ID + i] = (u8)level_id[i];
+    }
+    
+    /* Write level name (max 20 chars + null) */
+    memset(entry + LEVEL_OFF_LEVEL_NAME, 0, 21);
+    for (i = 0; i < 20 && level_name[i]; i++) {
+        entry[LEVEL_OFF_LEVEL_NAME + i] = (u8)level_name[i];
+    }
+    
+    /* Write stage count */
+    entry[LEVEL_OFF_STAGE_COUNT + 0] = (u8)(stage_count & 0xFF);
+    entry[LEVEL_OFF_STAGE_COUNT + 1] = (u8)((stage_count >> 8) & 0xFF);
+    
+    return 0;
+}
+
+int BLB_CopyHeaderTables(BLBFile* blb, const BLBFile* template_blb) {
+    u8 level;
+    
+    if (!blb || !blb->writer || blb->writer->finished ||
+        !template_blb || !template_blb->header || template_blb->is_jp) {
+        return -1;
+    }
+    
+    memcpy(blb->header, template_blb->header, BLB_HEADER_SIZE);
+    
+    /* Keep level metadata, drop the template's sector runs */
+    for (level = 0; level < BLB_MAX_LEVELS; level++) {
+        u8* entry = blb->header + BLB_OFF_LEVEL_TABLE + (level * BLB_LEVEL_ENTRY_SIZE);
+        
+        memset(entry + LEVEL_OFF_PRIMARY_SECTOR, 0, LEVEL_OFF_ASSET_INDEX);
+        memset(entry + LEVEL_OFF_TERT_SIZES, 0, LEVEL_OFF_LEVEL_ID - LEVEL_OFF_TERT_SIZES);
+    }
+    
+    blb->header[BLB_OFF_LEVEL_COUNT] = blb->level_count;
+    blb->movie_count = template_blb->movie_count;
+    blb->sector_count = template_blb->sector_count;
+    return 0;
+}
+
+/* Place one segment given as a gather list and point its slot at it */
+static int write_pieces(BLBFile* blb, u8 level_index, u8 stage_index,
+                        const BLBSegmentPiece* pieces, u32 piece_count,
+                        u32 segment_size, u8 segment_type) {
+    BLBWriter* writer;
+    const WrittenRun* run;
+    u8* entry;
+    u32 sector, sector_count;
+    u64 hash;
+    
+    if (!blb || !blb->writer || !pieces || piece_count == 0 || segment_size == 0) {
+        return -1;
+    }
+    writer = blb->writer;
+    if (writer->failed || writer->finished || level_index >= blb->level_count) {
+        return -1;
+    }
+    
+    /* Stage segments need BLB_SetLevelMetadata first */
+    entry = blb->header + BLB_OFF_LEVEL_TABLE + (level_index * BLB_LEVEL_ENTRY_SIZE);
+    if (check_segment_slot(entry, segment_type, stage_index, segment_size) != 0) {
+        return -1;
+    }
+    
+    sector_count = (segment_size + BLB_SECTOR_SIZE - 1) / BLB_SECTOR_SIZE;
+    
+    /* Same bytes already written - point this slot at that run */
+    hash = hash_pieces(pieces, piece_count);
+    run = find_run(blb, hash, segment_size, pieces, piece_count);
+    if (writer->failed) {
+        return -1;
+    }
+    if (run) {
+        set_segment_run(entry, segment_type, stage_index, run->sector, run->sector_count,
+                        pieces[0].data, pieces[0].size, segment_size);
+        writer->stats.segments_shared++;
+        writer->stats.bytes_saved += (u64)sector_count * BLB_SECTOR_SIZE;
+        return 0;
+    }
+    
+    /* Allocate: next free run, sector numbers are u16 in the level table */
+    sector = writer->next_sector;
+    if (sector + sector_count > 0xFFFF) {
+        return -1;
+    }
+    
+    if (add_run(writer, hash, segment_size, (u16)sector, (u16)sector_count) != 0) {
+        return -1;
+    }
+    if (append_sectors(blb, pieces, piece_count, segment_size, sector_count) != 0) {
+        writer->run_count--;
+        return -1;
+    }
+    writer->stats.segments_written++;
+    writer->stats.bytes_written += (u64)sector_count * BLB_SECTOR_SIZE;
+    
+    /* append_sectors may have moved an in-memory header */
+    entry = blb->header + BLB_OFF_LEVEL_TABLE + (level_index * BLB_LEVEL_ENTRY_SIZE);
+    set_segment_run(entry, segment_type, stage_index, (u16)sector, (u16)sector_count,
+                    pieces[0].data, pieces[0].size, segment_size);
+    
+    return 0;
+}
+
+int BLB_WriteSegment(BLBFile* blb, u8 level_index, u8 stage_index,
+                     const u8* segment_data, u32 segment_size,
+                     u8 segment_type) {
+    BLBSegmentPiece piece;
+    
+    if (!segment_data) {
+        return -1;
+    }
+    piece.data = segment_data;
+    piece.size = segment_size;
+    return write_pieces(blb, level_index, stage_index, &piece, 1,
+                        segment_size, segment_type);
+}
+
+int BLB_WriteSegmentFromBuilder(BLBFile* blb, u8 level_index, u8 stage_index,
+                                SegmentBuilder* builder, u8 segment_type) {
+    const BLBSegmentPiece* pieces;
+    u32 piece_count, segment_size;
+    
+    segment_size = BLB_SegmentBuilder_Layout(builder, &pieces, &piece_count);
+    if (segment_size == 0) {
+        return -1;
+    }
+    return write_pieces(blb, level_index, stage_index, pieces, piece_count,
+                        segment_size, segment_type);
+}
+
+int BLB_GetWriteStats(const BLBFile* blb, BLBWriteStats* out_stats) {
+    if (!out_stats) {
+        return -1;
+    }
+    memset(out_stats, 0, sizeof(BLBWriteStats));
+    if (!blb || !blb->writer) {
+        return -1;
+    }
+    *out_stats = blb->writer->stats;
+    return 0;
+}
+
+/* Delete <path>.blbidx: its key can't tell a rewritten archive apart */
+static void remove_sidecar(const char* path) {
+    char* sidecar = (char*)malloc(strlen(path) + sizeof(BLB_SIDECAR_SUFFIX));
+    
+    if (sidecar) {
+        sprintf(sidecar, "%s%s", path, BLB_SIDECAR_SUFFIX);
+        remove(sidecar);
+        free(sidecar);
+    }
+}
+
+/*
+ * Copy a finished temp file to <dest>.tmp, next to dest, and rename that
+ * into place. Used when the temp file can't be renamed to dest directly
+ * (dest on another filesystem: EXDEV).
+ */
+static int publish_copy(const char* src_path, const char* dest) {
+    char* stage_path;
+    FILE* src;
+    FILE* dst;
+    u8 buf[64 * 1024];
+    size_t n;
+    int ok;
+    
+    stage_path = (char*)malloc(strlen(dest) + 5);
+    if (!stage_path) {
+        return -1;
+    }
+    sprintf(stage_path, "%s.tmp", dest);
+    
+    src = fopen(src_path, "rb");
+    dst = src ? fopen(stage_path, "wb") : NULL;
+    ok = src && dst;
+    while (ok && (n = fread(buf, 1, sizeof(buf), src)) > 0) {
+        ok = fwrite(buf, 1, n, dst) == n;
+    }
+    ok = ok && !ferror(src) && fflush(dst) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(dst)) == 0;
+#endif
+    if (dst) ok = (fclose(dst) == 0) && ok;
+    if (src) fclose(src);
+    
+#ifdef _WIN32
+    if (ok) remove(dest);   /* rename() won't replace on Windows */
+#endif
+    if (!ok || rename(stage_path, dest) != 0) {
+        remove(stage_path);
+        free(stage_path);
+        return -1;
+    }
+    free(stage_path);
+    return 0;
+}
+
+int BLB_WriteToFile(const BLBFile* blb, const char* path) {
+    BLBWriter* writer;
+    const char* dest;
+    FILE* f;
+    int ok;
+    
+    if (!blb) {
+        return -1;
+    }
+    
+    /* Streaming: segments are on disk already, add the header and publish */
+    writer = blb->writer;
+    if (writer && writer->file) {
+        if (writer->failed || writer->finished) {
+            return -1;
+        }
+        dest = path ? path : writer->path;
+        
+        ok = fseek(writer->file, 0, SEEK_SET) == 0 &&
+             fwrite(writer->header, 1, BLB_HEADER_SIZE, writer->file) == BLB_HEADER_SIZE &&
+             fflush(writer->file) == 0;
+#ifndef _WIN32
+        ok = ok && fsync(fileno(writer->file)) == 0;
+#endif
+        ok = (fclose(writer->file) == 0) && ok;
+        writer->file = NULL;
+        writer->finished = 1;
+        
+        if (!ok) {
+            writer->failed = 1;
+            remove(writer->tmp_path);
+            return -1;
+        }
+#ifdef _WIN32
+        remove(dest);   /* rename() won't replace on Windows */
+#endif
+        if (rename(writer->tmp_path, dest) != 0 &&
+            publish_copy(writer->tmp_path, dest) != 0) {
+            writer->failed = 1;
+            remove(writer->tmp_path);
+            return -1;
+        }
+        remove(writer->tmp_path);   /* Left behind by publish_copy */
+        remove_sidecar(dest);
+        return 0;
+    }
+    
+    if (!path || !blb->data) {
+        return -1;
+    }
+    
+    f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    
+    /* Header plus the sectors actually used (size tracks the allocator) */
+    if (fwrite(blb->data, 1, blb->size, f) != blb->size) {
+        fclose(f);
+        return -1;
+    }
+    
+    /* fclose flushes - a full disk shows up here */
+    if (fclose(f) != 0) {
+        return -1;
+    }
+    remove_sidecar(path);
+    return 0;
+}
+
+void BLBWriter_Destroy(BLBWriter* writer) {
+    if (!writer) {
+        return;
+    }
+    
+    if (writer->file) {
+        fclose(writer->file);
+        remove(writer->tmp_path);   /* Never finished - not an archive */
+    }
+    free(writer->runs);
+    free(writer->path);
+    free(writer->tmp_path);
+    free(writer);
+}
+
+/* -----------------------------------------------------------------------------
+ * Patch Mode
+ *
+ * The level entry is the commit point. New bytes are always complete on
+ * disk before an entry points at them, so a crash at any step leaves an
+ * archive that loads either the old or the new segment:
+ *
+ *   fits, unshared:  copy to scratch past EOF -> entry to scratch ->
+ *                    copy over old run -> entry back -> truncate scratch
+ *   otherwise:       append at EOF -> entry to new run
+ *
+ * Each step is followed by an fsync. A flip rewrites only the 0x70 byte
+ * level entry.
+ * -------------------------------------------------------------------------- */
+
+#ifdef _WIN32
+#define PATCH_OPEN_FLAGS    (_O_RDWR | _O_BINARY)
+#define file_open           _open
+#define file_close          _close
+#else
+#define PATCH_OPEN_FLAGS    O_RDWR
+#define file_open           open
+#define file_close          close
+#endif
+
+static int file_read_at(int fd, u8* dst, u32 size, u32 offset) {
+#ifdef _WIN32
+    return (_lseek(fd, (long)offset, SEEK_SET) == (long)offset &&
+            _read(fd, dst, size) == (int)size) ? 0 : -1;
+#else
+    while (size > 0) {
+        ssize_t n = pread(fd, dst, size, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        dst += n;
+        offset += (u32)n;
+        size -= (u32)n;
+    }
+    return 0;
+#endif
+}
+
+static int file_write_at(int fd, const u8* src, u32 size, u32 offset) {
+#ifdef _WIN32
+    return (_lseek(fd, (long)offset, SEEK_SET) == (long)offset &&
+            _write(fd, src, size) == (int)size) ? 0 : -1;
+#else
+    while (size > 0) {
+        ssize_t n = pwrite(fd, src, size, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        src += n;
+        offset += (u32)n;
+        size -= (u32)n;
+    }
+    return 0;
+#endif
+}
+
+static int file_sync(int fd) {
+#ifdef _WIN32
+    return _commit(fd);
+#else
+    return fsync(fd);
+#endif
+}
+
+static int file_truncate(int fd, u32 size) {
+#ifdef _WIN32
+    return _chsize(fd, (long)size);
+#else
+    return ftruncate(fd, (off_t)size);
+#endif
+}
+
+/* Write a segment padded to whole sectors at sector, then sync */
+static int write_run(int fd, u32 sector, const u8* data, u32 size, u32 sector_count) {
+    static const u8 zeros[BLB_SECTOR_SIZE] = {0};
+    u32 offset = sector * BLB_SECTOR_SIZE;
+    u32 pad = sector_count * BLB_SECTOR_SIZE - size;
+    
+    if (file_write_at(fd, data, size, offset) != 0 ||
+        (pad && file_write_at(fd, zeros, pad, offset + size) != 0)) {
+        return -1;
+    }
+    return file_sync(fd);
+}
+
+/* Commit point: rewrite one level entry in the on-disk header */
+static int flip_entry(int fd, const u8* header, u8 level_index) {
+    u32 offset = BLB_OFF_LEVEL_TABLE + (u32)level_index * BLB_LEVEL_ENTRY_SIZE;
+    
+    if (file_write_at(fd, header + offset, BLB_LEVEL_ENTRY_SIZE, offset) != 0) {
+        return -1;
+    }
+    return file_sync(fd);
+}
+
+/* Does any other slot of the level table load this sector run? */
+static int run_is_shared(const BLBFile* blb, u8 level_index, u8 stage_index,
+                         u8 segment_type, u16 sector) {
+    u8 level, stage;
+    
+    for (level = 0; level < blb->level_count; level++) {
+        u16 stages = BLB_GetStageCount(blb, level);
+        
+        if (stages > BLB_MAX_STAGES) {
+            stages = BLB_MAX_STAGES;
+        }
+        if (BLB_GetPrimarySectorOffset(blb, level) == sector &&
+            !(segment_type == 0 && level == level_index)) {
+            return 1;
+        }
+        for (stage = 0; stage < stages; stage++) {
+            int self = level == level_index && stage == stage_index;
+            
+            if (BLB_GetSecondarySectorOffset(blb, level, stage) == sector &&
+                !(segment_type == 1 && self)) {
+                return 1;
+            }
+            if (BLB_GetTertiarySectorOffset(blb, level, stage) == sector &&
+                !(segment_type == 2 && self)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int BLB_PatchSegment(const char* path, u8 level_index, u8 stage_index,
+                     const u8* segment_data, u32 segment_size,
+                     u8 segment_type, u32* out_sector) {
+    BLBFile blb;
+    u8 header[BLB_HEADER_SIZE];
+    u8* entry;
+    u32 file_size, end_sector, new_count;
+    u16 old_sector, old_count;
+    int fd, in_place, result = -1;
+    
+    if (out_sector) *out_sector = 0;
+    if (!path || !segment_data || segment_size == 0) {
+        return -1;
+    }
+    
+    fd = file_open(path, PATCH_OPEN_FLAGS);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < BLB_HEADER_SIZE ||
+            (unsigned long)st.st_size > 0xFFFFFFFFul) {
+            file_close(fd);
+            return -1;
+        }
+        file_size = (u32)st.st_size;
+    }
+    
+    /* Header only - the rest of the archive is never read, so parse it
+     * without an asset index or sidecar */
+    if (file_read_at(fd, header, BLB_HEADER_SIZE, 0) != 0 ||
+        BLB_ParseHeader(header, BLB_HEADER_SIZE, &blb) != 0) {
+        file_close(fd);
+        return -1;
+    }
+    
+    if (level_index >= blb.level_count) {
+        goto done;
+    }
+    entry = header + BLB_OFF_LEVEL_TABLE + (level_index * BLB_LEVEL_ENTRY_SIZE);
+    if (check_segment_slot(entry, segment_type, stage_index, segment_size) != 0) {
+        goto done;
+    }
+    
+    switch (segment_type) {
+    case 0:
+        old_sector = BLB_GetPrimarySectorOffset(&blb, level_index);
+        old_count = BLB_GetPrimarySectorCount(&blb, level_index);
+        break;
+    case 1:
+        old_sector = BLB_GetSecondarySectorOffset(&blb, level_index, stage_index);
+        old_count = BLB_GetSecondarySectorCount(&blb, level_index, stage_index);
+        break;
+    default:
+        old_sector = BLB_GetTertiarySectorOffset(&blb, level_index, stage_index);
+        old_count = BLB_GetTertiarySectorCount(&blb, level_index, stage_index);
+        break;
+    }
+    
+    new_count = (segment_size + BLB_SECTOR_SIZE - 1) / BLB_SECTOR_SIZE;
+    end_sector = (file_size + BLB_SECTOR_SIZE - 1) / BLB_SECTOR_SIZE;
+    if (end_sector + new_count > 0xFFFF) {
+        goto done;
+    }
+    
+    in_place = old_count >= new_count &&
+               (u32)old_sector * BLB_SECTOR_SIZE >= BLB_HEADER_SIZE &&
+               (u32)(old_sector + old_count) <= end_sector &&
+               !run_is_shared(&blb, level_index, stage_index, segment_type, old_sector);
+    
+    /* New bytes past EOF first; entry points there once they're durable */
+    if (write_run(fd, end_sector, segment_data, segment_size, new_count) != 0) {
+        goto done;
+    }
+    set_segment_run(entry, segment_type, stage_index, (u16)end_sector, (u16)new_count,
+                    segment_data, segment_size, segment_size);
+    if (flip_entry(fd, header, level_index) != 0) {
+        goto done;
+    }
+    
+    if (in_place) {
+        /* Old run is unreferenced now - overwrite it, point back, drop scratch */
+        if (write_run(fd, old_sector, segment_data, segment_size, new_count) != 0) {
+            goto done;
+        }
+        set_segment_run(entry, segment_type, stage_index, old_sector, (u16)new_count,
+                        segment_data, segment_size, segment_size);
+        if (flip_entry(fd, header, level_index) != 0) {
+            goto done;
+        }
+        if (file_truncate(fd, file_size) == 0) {
+            file_sync(fd);
+        }
+    }
+    
+    if (out_sector) *out_sector = in_place ? old_sector : end_sector;
+    result = 0;
+    
+done:
+    BLB_Close(&blb);
+    file_close(fd);
+    
+    /* Any catalog for the old layout is stale now */
+    if (result == 0) {
+        remove_sidecar(path);
+    }
+    return result;
+}
@@ -0,0 +1,23 @@
+/**
+ * blb_writer.h - BLB archive writer state (internal)
+ *
+ * Shared between blb.c and blb_writer.c only. Public entry points are
+ * BLB_Create / BLB_CreateStream / BLB_WriteSegment / BLB_WriteToFile
+ * in blb.h.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#ifndef BLB_WRITER_H
+#define BLB_WRITER_H
+
+#include "blb.h"
+
+/**
+ * Free writer state. An unfinished streaming writer deletes its
+ * temporary output, so a half-written archive never appears at the
+ * destination path.
+ */
+void BLBWriter_Destroy(BLBWriter* writer);
+
+#endif /* BLB_WRITER_H */
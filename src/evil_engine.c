@@ -5,9 +5,37 @@
  * This wraps the internal BLB and level code with a clean public interface.
  */
 
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* sysconf */
+#endif
+
 #include "evil_engine.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define MAX_LOAD_WORKERS    64
+
+/* Shared by EvilEngine_LoadLevels workers */
+typedef struct {
+    const BLBFile*  blb;
+    const int*      level_indices;
+    const int*      stage_indices;
+    LevelContext**  out_levels;
+    u32             count;
+    u32             next;       /* Next request to hand out */
+    u32             loaded;
+    pthread_mutex_t lock;
+} LoadQueue;
+
+static u32 read_u32(const u8* ptr) {
+    return (u32)ptr[0] | ((u32)ptr[1] << 8) |
+           ((u32)ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
 
 /* -----------------------------------------------------------------------------
  * BLB File Operations (READ)
@@ -34,6 +62,32 @@ int EvilEngine_OpenBLB(const char* path, BLBFile** out_blb) {
     return 0;
 }
 
+int EvilEngine_OpenBLBPaged(const char* path, unsigned int cache_budget,
+                            BLBFile** out_blb) {
+    BLBFile* blb;
+    
+    if (!path || !out_blb) {
+        return -1;
+    }
+    
+    blb = (BLBFile*)calloc(1, sizeof(BLBFile));
+    if (!blb) {
+        return -1;
+    }
+    
+    if (BLB_OpenPaged(path, blb, (u32)cache_budget) != 0) {
+        free(blb);
+        return -1;
+    }
+    
+    *out_blb = blb;
+    return 0;
+}
+
+int EvilEngine_ValidateBLB(BLBFile* blb, int thread_count, BLBValidateReport* out_report) {
+    return BLB_Validate(blb, thread_count > 0 ? (u32)thread_count : 0, out_report);
+}
+
 void EvilEngine_CloseBLB(BLBFile* blb) {
     if (!blb) return;
     BLB_Close(blb);
@@ -89,6 +143,121 @@ void EvilEngine_UnloadLevel(LevelContext* level) {
     free(level);
 }
 
+static u32 default_thread_count(void) {
+#if !defined(_WIN32) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (u32)n : 1;
+#else
+    return 4;
+#endif
+}
+
+static void* load_worker(void* arg) {
+    LoadQueue* queue = (LoadQueue*)arg;
+    
+    for (;;) {
+        LevelContext* level = NULL;
+        u32 i;
+        
+        pthread_mutex_lock(&queue->lock);
+        i = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        
+        if (i >= queue->count) {
+            break;
+        }
+        
+        /* Decode on the worker so the caller gets read-only contexts */
+        if (EvilEngine_LoadLevel(queue->blb, queue->level_indices[i],
+                                 queue->stage_indices[i], &level) == 0 &&
+            Level_DecodeAll(level) != 0) {
+            EvilEngine_UnloadLevel(level);
+            level = NULL;
+        }
+        queue->out_levels[i] = level;
+        
+        if (level) {
+            pthread_mutex_lock(&queue->lock);
+            queue->loaded++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+    return NULL;
+}
+
+int EvilEngine_LoadLevels(const BLBFile* blb, const int* level_indices,
+                          const int* stage_indices, int count, int thread_count,
+                          LevelContext** out_levels) {
+    LoadQueue queue;
+    pthread_t workers[MAX_LOAD_WORKERS];
+    u32 threads, started = 0, i;
+    
+    if (!blb || !level_indices || !stage_indices || !out_levels || count < 0) {
+        return -1;
+    }
+    
+    memset(&queue, 0, sizeof(queue));
+    queue.blb = blb;
+    queue.level_indices = level_indices;
+    queue.stage_indices = stage_indices;
+    queue.out_levels = out_levels;
+    queue.count = (u32)count;
+    for (i = 0; i < queue.count; i++) {
+        out_levels[i] = NULL;
+    }
+    
+    /* Requests on workers; fall back to this thread if none start */
+    threads = thread_count > 0 ? (u32)thread_count : default_thread_count();
+    if (threads > MAX_LOAD_WORKERS) threads = MAX_LOAD_WORKERS;
+    if (threads > queue.count) threads = queue.count;
+    
+    pthread_mutex_init(&queue.lock, NULL);
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, load_worker, &queue) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        load_worker(&queue);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+    
+    return (int)queue.loaded;
+}
+
+int EvilEngine_CreateLevelCache(const BLBFile* blb, u64 budget, LevelCache** out_cache) {
+    if (!out_cache) {
+        return -1;
+    }
+    *out_cache = LevelCache_Create(blb, budget);
+    return *out_cache ? 0 : -1;
+}
+
+int EvilEngine_AcquireLevel(LevelCache* cache, int level_index, int stage_index,
+                            const LevelContext** out_level) {
+    if (!cache || !out_level || level_index < 0 || stage_index < 0) {
+        return -1;
+    }
+    *out_level = LevelCache_Acquire(cache, (u8)level_index, (u8)stage_index);
+    return *out_level ? 0 : -1;
+}
+
+void EvilEngine_ReleaseLevel(LevelCache* cache, const LevelContext* level) {
+    LevelCache_Release(cache, level);
+}
+
+void EvilEngine_DestroyLevelCache(LevelCache* cache) {
+    LevelCache_Destroy(cache);
+}
+
+u64 EvilEngine_GetLevelFootprint(const LevelContext* level) {
+    return Level_GetFootprint(level);
+}
+
 /* -----------------------------------------------------------------------------
  * Data Accessors (READ)
  * -------------------------------------------------------------------------- */
@@ -224,9 +393,11 @@ const unsigned short* EvilEngine_GetSpritePalette(const unsigned char* sprite_da
 
 const unsigned char* EvilEngine_GetAssetData(const BLBFile* blb, int level_index, int stage_index,
                                              int segment_type, unsigned int asset_id, int* out_size) {
-    u16 sector_offset;
+    u16 sector_offset, sector_count;
+    const BLBIndexEntry* entry;
     const u8* segment_data;
     const u8* asset_data;
+    u32 segment_size = 0;
     u32 size = 0;
     
     if (!blb) {
@@ -238,75 +409,171 @@ const unsigned char* EvilEngine_GetAssetData(const BLBFile* blb, int level_index
     if (segment_type == 0) {
         /* Primary */
         sector_offset = BLB_GetPrimarySectorOffset(blb, (u8)level_index);
+        sector_count = BLB_GetPrimarySectorCount(blb, (u8)level_index);
     } else if (segment_type == 1) {
         /* Secondary */
         sector_offset = BLB_GetSecondarySectorOffset(blb, (u8)level_index, (u8)stage_index);
+        sector_count = BLB_GetSecondarySectorCount(blb, (u8)level_index, (u8)stage_index);
     } else if (segment_type == 2) {
         /* Tertiary */
         sector_offset = BLB_GetTertiarySectorOffset(blb, (u8)level_index, (u8)stage_index);
+        sector_count = BLB_GetTertiarySectorCount(blb, (u8)level_index, (u8)stage_index);
     } else {
         if (out_size) *out_size = 0;
         return NULL;
     }
     
-    segment_data = BLB_GetSectorData(blb, sector_offset);
+    segment_data = BLB_AcquireSegment(blb, sector_offset, sector_count, &segment_size);
     if (!segment_data) {
         if (out_size) *out_size = 0;
         return NULL;
     }
     
-    asset_data = BLB_FindAsset(blb, segment_data, asset_id, &size);
-    if (out_size) *out_size = (int)size;
+    /* O(1) through the asset index. A segment the index rejected points
+     * outside its run, so it isn't scanned raw either. */
+    entry = BLB_LookupAsset(blb, sector_offset, asset_id);
+    if (entry) {
+        asset_data = segment_data + entry->offset;
+        size = entry->size;
+    } else if (blb->index) {
+        asset_data = NULL;
+    } else {
+        /* No index (writer handles): the entry must fit what was acquired */
+        asset_data = NULL;
+        if (segment_size >= 4 && read_u32(segment_data) <= (segment_size - 4) / 12) {
+            asset_data = BLB_FindAsset(blb, segment_data, asset_id, &size);
+        }
+        if (asset_data && ((u32)(asset_data - segment_data) > segment_size ||
+                           size > segment_size - (u32)(asset_data - segment_data))) {
+            asset_data = NULL;
+        }
+    }
+    if (out_size) *out_size = asset_data ? (int)size : 0;
+    
+    /* The segment stays pinned until EvilEngine_ReleaseAssetData, so a
+     * paged handle can't evict it from under the caller */
+    if (!asset_data) {
+        BLB_ReleaseSegment(blb, segment_data);
+    }
     
     return asset_data;
 }
 
+void EvilEngine_ReleaseAssetData(const BLBFile* blb, const unsigned char* asset_data) {
+    if (blb && asset_data) {
+        BLB_ReleaseSegment(blb, asset_data);
+    }
+}
+
 /* -----------------------------------------------------------------------------
  * BLB File Operations (WRITE)
- * TODO: Implement in Phase 2
  * -------------------------------------------------------------------------- */
 
 int EvilEngine_CreateBLB(int level_count, BLBFile** out_blb) {
-    (void)level_count;
-    (void)out_blb;
-    /* TODO: Implement BLB creation */
-    return -1;
+    BLBFile* blb;
+    
+    if (!out_blb || level_count <= 0 || level_count > BLB_MAX_LEVELS) {
+        return -1;
+    }
+    
+    blb = BLB_Create((u8)level_count);
+    if (!blb) {
+        return -1;
+    }
+    
+    *out_blb = blb;
+    return 0;
+}
+
+int EvilEngine_CreateBLBStream(const char* path, int level_count, BLBFile** out_blb) {
+    BLBFile* blb;
+    
+    if (!path || !out_blb || level_count <= 0 || level_count > BLB_MAX_LEVELS) {
+        return -1;
+    }
+    
+    blb = BLB_CreateStream(path, (u8)level_count);
+    if (!blb) {
+        return -1;
+    }
+    
+    *out_blb = blb;
+    return 0;
+}
+
+int EvilEngine_CopyHeaderTables(BLBFile* blb, const BLBFile* template_blb) {
+    return BLB_CopyHeaderTables(blb, template_blb);
 }
 
 int EvilEngine_SetLevelMetadata(BLBFile* blb, int level_index,
                                 const char* level_id, const char* level_name,
                                 int stage_count) {
-    (void)blb;
-    (void)level_index;
-    (void)level_id;
-    (void)level_name;
-    (void)stage_count;
-    /* TODO: Implement metadata setting */
-    return -1;
+    if (!blb || level_index < 0 || stage_count <= 0) {
+        return -1;
+    }
+    return BLB_SetLevelMetadata(blb, (u8)level_index, level_id, level_name,
+                                (u16)stage_count);
 }
 
 int EvilEngine_WriteLevelData(BLBFile* blb, int level_index, int stage_index,
                               const u8* primary_data, u32 primary_size,
                               const u8* secondary_data, u32 secondary_size,
                               const u8* tertiary_data, u32 tertiary_size) {
-    (void)blb;
-    (void)level_index;
-    (void)stage_index;
-    (void)primary_data;
-    (void)primary_size;
-    (void)secondary_data;
-    (void)secondary_size;
-    (void)tertiary_data;
-    (void)tertiary_size;
-    /* TODO: Implement level data writing */
-    return -1;
+    if (!blb || level_index < 0 || stage_index < 0) {
+        return -1;
+    }
+    
+    /* Each segment is optional - a level's primary is usually written once */
+    if (primary_data && primary_size > 0 &&
+        BLB_WriteSegment(blb, (u8)level_index, (u8)stage_index,
+                         primary_data, primary_size, 0) != 0) {
+        return -1;
+    }
+    if (secondary_data && secondary_size > 0 &&
+        BLB_WriteSegment(blb, (u8)level_index, (u8)stage_index,
+                         secondary_data, secondary_size, 1) != 0) {
+        return -1;
+    }
+    if (tertiary_data && tertiary_size > 0 &&
+        BLB_WriteSegment(blb, (u8)level_index, (u8)stage_index,
+                         tertiary_data, tertiary_size, 2) != 0) {
+        return -1;
+    }
+    return 0;
 }
 
 int EvilEngine_SaveBLB(const BLBFile* blb, const char* path) {
-    (void)blb;
-    (void)path;
-    /* TODO: Implement BLB save */
-    return -1;
+    return BLB_WriteToFile(blb, path);
+}
+
+int EvilEngine_GetBLBWriteStats(const BLBFile* blb, BLBWriteStats* out_stats) {
+    return BLB_GetWriteStats(blb, out_stats);
+}
+
+int EvilEngine_PatchLevelData(const char* path, int level_index, int stage_index,
+                              const u8* primary_data, u32 primary_size,
+                              const u8* secondary_data, u32 secondary_size,
+                              const u8* tertiary_data, u32 tertiary_size) {
+    if (!path || level_index < 0 || stage_index < 0) {
+        return -1;
+    }
+    
+    if (primary_data && primary_size > 0 &&
+        BLB_PatchSegment(path, (u8)level_index, (u8)stage_index,
+                         primary_data, primary_size, 0, NULL) != 0) {
+        return -1;
+    }
+    if (secondary_data && secondary_size > 0 &&
+        BLB_PatchSegment(path, (u8)level_index, (u8)stage_index,
+                         secondary_data, secondary_size, 1, NULL) != 0) {
+        return -1;
+    }
+    if (tertiary_data && tertiary_size > 0 &&
+        BLB_PatchSegment(path, (u8)level_index, (u8)stage_index,
+                         tertiary_data, tertiary_size, 2, NULL) != 0) {
+        return -1;
+    }
+    return 0;
 }
 
 /* -----------------------------------------------------------------------------
@@ -8,6 +8,12 @@
  * - BLB file operations (reading/writing archive files)
  * - Level operations (loading/saving level data)
  * - Data accessors (querying level structures)
+ * 
+ * Thread safety: read functions on an open archive (const BLBFile*) and
+ * level loading are reentrant - any number of threads can load and read
+ * their own levels from one shared handle. Opening, closing, validating
+ * and writing an archive, and level caches, need exclusive access; each
+ * function below says where it differs from that default.
  */
 
 #ifndef EVIL_ENGINE_H
@@ -16,6 +22,7 @@
 #include "psx/types.h"
 #include "blb/blb.h"
 #include "level/level.h"
+#include "level/level_cache.h"
 
 /* -----------------------------------------------------------------------------
  * BLB File Operations (READ)
@@ -29,8 +36,31 @@
  */
 int EvilEngine_OpenBLB(const char* path, BLBFile** out_blb);
 
+/**
+ * Open a BLB archive in paged mode (header only, segments read on demand).
+ * @param path          Path to GAME.BLB file
+ * @param cache_budget  Bytes of released segments to keep cached (0 = default)
+ * @param out_blb       Output BLB file handle (free with EvilEngine_CloseBLB)
+ * @return              0 on success, -1 on error
+ */
+int EvilEngine_OpenBLBPaged(const char* path, unsigned int cache_budget,
+                            BLBFile** out_blb);
+
+/**
+ * Validate every level, stage and asset of an archive on worker threads.
+ * On success the handle is marked trusted and release builds skip the
+ * per-call offset checks in the tile/palette/tilemap accessors.
+ * Needs exclusive access to blb: run it before sharing the handle.
+ * @param blb           BLB file handle
+ * @param thread_count  Worker threads (0 = one per CPU)
+ * @param out_report    Optional: counts and elapsed time
+ * @return              0 if the archive passed, -1 otherwise
+ */
+int EvilEngine_ValidateBLB(BLBFile* blb, int thread_count, BLBValidateReport* out_report);
+
 /**
  * Close a BLB archive and free resources.
+ * Needs exclusive access; unload every level loaded from it first.
  * @param blb       BLB file handle to close
  */
 void EvilEngine_CloseBLB(BLBFile* blb);
@@ -64,6 +94,7 @@ const char* EvilEngine_GetLevelID(const BLBFile* blb, int index);
 
 /**
  * Load a level and stage from BLB.
+ * Thread-safe: concurrent loads may share blb.
  * @param blb           BLB file handle
  * @param level_index   Level index (0-25)
  * @param stage_index   Stage index (0-6)
@@ -79,6 +110,61 @@ int EvilEngine_LoadLevel(const BLBFile* blb, int level_index, int stage_index,
  */
 void EvilEngine_UnloadLevel(LevelContext* level);
 
+/**
+ * Load several stages at once on worker threads sharing one archive,
+ * e.g. for batch export or thumbnails. Each returned context has its lazy
+ * tables decoded already, so it can be handed to any thread as-is.
+ * @param blb           BLB file handle (shared read-only by the workers)
+ * @param level_indices Level index per request
+ * @param stage_indices Stage index per request
+ * @param count         Number of requests
+ * @param thread_count  Worker threads (0 = one per CPU)
+ * @param out_levels    Output: count contexts in request order, NULL where
+ *                      the load failed (free each with EvilEngine_UnloadLevel)
+ * @return              Number of stages loaded, or -1 on bad arguments
+ */
+int EvilEngine_LoadLevels(const BLBFile* blb, const int* level_indices,
+                          const int* stage_indices, int count, int thread_count,
+                          LevelContext** out_levels);
+
+/**
+ * Create a cache of loaded stages for flipping between them.
+ * A cache is not thread-safe: use one per thread, or lock around it.
+ * @param blb           BLB file handle (must outlive the cache)
+ * @param budget        Bytes to keep before evicting (0 = default)
+ * @param out_cache     Output cache (free with EvilEngine_DestroyLevelCache)
+ * @return              0 on success, -1 on error
+ */
+int EvilEngine_CreateLevelCache(const BLBFile* blb, u64 budget, LevelCache** out_cache);
+
+/**
+ * Get a level and stage through the cache, loading it on a miss.
+ * @param cache         Level cache
+ * @param level_index   Level index (0-25)
+ * @param stage_index   Stage index (0-6)
+ * @param out_level     Output level context (release with EvilEngine_ReleaseLevel)
+ * @return              0 on success, -1 on error
+ */
+int EvilEngine_AcquireLevel(LevelCache* cache, int level_index, int stage_index,
+                            const LevelContext** out_level);
+
+/**
+ * Hand a level from EvilEngine_AcquireLevel back to its cache.
+ */
+void EvilEngine_ReleaseLevel(LevelCache* cache, const LevelContext* level);
+
+/**
+ * Destroy a level cache and every stage it holds.
+ */
+void EvilEngine_DestroyLevelCache(LevelCache* cache);
+
+/**
+ * Get memory held by a loaded level beyond its BLB segments.
+ * @param level         Level context
+ * @return              Bytes reserved in the level's arena
+ */
+u64 EvilEngine_GetLevelFootprint(const LevelContext* level);
+
 /* -----------------------------------------------------------------------------
  * Data Accessors (READ)
  * -------------------------------------------------------------------------- */
@@ -252,11 +338,19 @@ const unsigned short* EvilEngine_GetSpritePalette(const unsigned char* sprite_da
  * @param segment_type  0=primary, 1=secondary, 2=tertiary
  * @param asset_id      Asset type ID
  * @param out_size      Output: asset size in bytes
- * @return              Pointer to asset data, or NULL if not found
+ * @return              Pointer to asset data, or NULL if not found.
+ *                      Its segment stays pinned (paged handles can't evict
+ *                      it) until EvilEngine_ReleaseAssetData.
  */
 const unsigned char* EvilEngine_GetAssetData(const BLBFile* blb, int level_index, int stage_index,
                                              int segment_type, unsigned int asset_id, int* out_size);
 
+/**
+ * Release asset data returned by EvilEngine_GetAssetData.
+ * The pointer must not be used afterwards. NULL is ignored.
+ */
+void EvilEngine_ReleaseAssetData(const BLBFile* blb, const unsigned char* asset_data);
+
 /* -----------------------------------------------------------------------------
  * BLB File Operations (WRITE)
  * -------------------------------------------------------------------------- */
@@ -269,6 +363,26 @@ const unsigned char* EvilEngine_GetAssetData(const BLBFile* blb, int level_index
  */
 int EvilEngine_CreateBLB(int level_count, BLBFile** out_blb);
 
+/**
+ * Create a new BLB archive that is written to disk as segments are added.
+ * Memory use stays at the header size; the archive appears at path once
+ * EvilEngine_SaveBLB succeeds.
+ * @param path          Destination archive path
+ * @param level_count   Number of levels to allocate (1-26)
+ * @param out_blb       Output BLB file handle (free with EvilEngine_CloseBLB)
+ * @return              0 on success, -1 on error
+ */
+int EvilEngine_CreateBLBStream(const char* path, int level_count, BLBFile** out_blb);
+
+/**
+ * Copy header tables (movies, sectors, level names) from an existing
+ * archive into one being written. Call before writing any level data.
+ * @param blb           BLB file handle being written
+ * @param template_blb  Archive to copy from
+ * @return              0 on success, -1 on error
+ */
+int EvilEngine_CopyHeaderTables(BLBFile* blb, const BLBFile* template_blb);
+
 /**
  * Set level metadata in BLB header.
  * @param blb           BLB file handle
@@ -284,10 +398,12 @@ int EvilEngine_SetLevelMetadata(BLBFile* blb, int level_index,
 
 /**
  * Write level segment data to BLB.
+ * Each segment is optional (NULL/0 skips it); write a level's primary once
+ * and the secondary/tertiary once per stage.
  * @param blb               BLB file handle
  * @param level_index       Level index (0-based)
  * @param stage_index       Stage index (0-based)
- * @param primary_data      Primary segment data
+ * @param primary_data      Primary segment data (can be NULL)
  * @param primary_size      Primary segment size in bytes
  * @param secondary_data    Secondary segment data (can be NULL)
  * @param secondary_size    Secondary segment size in bytes
@@ -303,11 +419,42 @@ int EvilEngine_WriteLevelData(BLBFile* blb, int level_index, int stage_index,
 /**
  * Finalize and write BLB to file.
  * @param blb           BLB file handle
- * @param path          Output file path
+ * @param path          Output file path (streaming handles: NULL = creation path)
  * @return              0 on success, -1 on error
  */
 int EvilEngine_SaveBLB(const BLBFile* blb, const char* path);
 
+/**
+ * Get how many segments were stored vs shared with an identical earlier
+ * segment, and the bytes sharing saved.
+ * @param blb           BLB file handle being written
+ * @param out_stats     Output report
+ * @return              0 on success, -1 on error
+ */
+int EvilEngine_GetBLBWriteStats(const BLBFile* blb, BLBWriteStats* out_stats);
+
+/**
+ * Patch segments of an existing archive on disk without rewriting it.
+ * Each segment is optional (NULL/0 leaves it untouched). Segments that
+ * fit their old sector run are rewritten in place, larger ones appended.
+ * Close every handle on the archive first (the file is rewritten and
+ * truncated under any mapping) and reopen it afterwards.
+ * @param path              Archive path
+ * @param level_index       Level index (0-based)
+ * @param stage_index       Stage index (0-based)
+ * @param primary_data      New primary segment (can be NULL)
+ * @param primary_size      Primary segment size in bytes
+ * @param secondary_data    New secondary segment (can be NULL)
+ * @param secondary_size    Secondary segment size in bytes
+ * @param tertiary_data     New tertiary segment (can be NULL)
+ * @param tertiary_size     Tertiary segment size in bytes
+ * @return                  0 on success, -1 on error
+ */
+int EvilEngine_PatchLevelData(const char* path, int level_index, int stage_index,
+                              const u8* primary_data, u32 primary_size,
+                              const u8* secondary_data, u32 secondary_size,
+                              const u8* tertiary_data, u32 tertiary_size);
+
 /* -----------------------------------------------------------------------------
  * Level Operations (WRITE)
  * -------------------------------------------------------------------------- */
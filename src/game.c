@@ -5,12 +5,17 @@
  */
 
 #include "game.h"
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 /* -----------------------------------------------------------------------------
  * Internal Helpers
  * -------------------------------------------------------------------------- */
 
+static void stream_release(GameState* state);
+static void prefetch_cancel(GameState* state);
+
 static void entity_init(Entity* entity) {
     memset(entity, 0, sizeof(Entity));
 }
@@ -25,6 +30,14 @@ static Entity* entity_alloc(GameState* state) {
     return e;
 }
 
+/* O(1): entity_alloc clears each slot as it hands it out, so nothing
+ * past entity_pool_next needs wiping */
+static void entity_pool_reset(GameState* state) {
+    state->active_entity_head = NULL;
+    state->render_entity_head = NULL;
+    state->entity_pool_next = 0;
+}
+
 static void entity_add_to_list(Entity** head, Entity* entity) {
     entity->next = *head;
     entity->prev = NULL;
@@ -74,6 +87,8 @@ void Game_Init(GameState* state) {
 
 int Game_LoadBLB(GameState* state, const char* path) {
     if (state->blb_loaded) {
+        prefetch_cancel(state);
+        stream_release(state);
         BLB_Close(&state->blb);
         state->blb_loaded = 0;
     }
@@ -90,25 +105,58 @@ int Game_LoadBLB(GameState* state, const char* path) {
  * Based on InitializeAndLoadLevel at 0x8007D1D0
  * -------------------------------------------------------------------------- */
 
-int Game_LoadLevel(GameState* state, u8 level_index, u8 stage_index) {
-    if (!state->blb_loaded) {
-        return -1;
-    }
-    
-    /* Unload previous level */
-    Level_Unload(&state->level);
-    
-    /* Clear entities */
-    state->active_entity_head = NULL;
-    state->render_entity_head = NULL;
-    state->entity_pool_next = 0;
-    memset(state->entity_pool, 0, sizeof(state->entity_pool));
+/* Stage prefetch: Level_Load runs on its own thread into level_next */
+struct GamePrefetch {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    LevelContext* out;
+    const BLBFile* blb;
+    u8 level_index;
+    u8 stage_index;
+    u8 done;
+    s8 result;
+};
+
+static void* prefetch_main(void* arg) {
+    GamePrefetch* prefetch = (GamePrefetch*)arg;
+    int result;
+    
+    /* Only reads the archive; segment cache and index lock for themselves */
+    result = Level_Load(prefetch->out, prefetch->blb,
+                        prefetch->level_index, prefetch->stage_index);
+    
+    pthread_mutex_lock(&prefetch->lock);
+    prefetch->result = (s8)result;
+    prefetch->done = 1;
+    pthread_mutex_unlock(&prefetch->lock);
+    return NULL;
+}
+
+/* Wait for the prefetch thread and free it; level_next is left as loaded */
+static int prefetch_join(GameState* state) {
+    GamePrefetch* prefetch = state->prefetch;
+    int result;
     
-    /* Load new level */
-    if (Level_Load(&state->level, &state->blb, level_index, stage_index) != 0) {
+    if (!prefetch) {
         return -1;
     }
-    
+    pthread_join(prefetch->thread, NULL);
+    result = prefetch->result;
+    pthread_mutex_destroy(&prefetch->lock);
+    free(prefetch);
+    state->prefetch = NULL;
+    return result;
+}
+
+static void prefetch_cancel(GameState* state) {
+    if (state->prefetch) {
+        prefetch_join(state);
+        Level_Unload(&state->level_next);
+    }
+}
+
+/* Settle state on the level just made current */
+static void level_enter(GameState* state, u8 level_index, u8 stage_index) {
     state->level_index = level_index;
     state->stage_index = stage_index;
     state->mode = GAME_MODE_LEVEL;
@@ -125,10 +173,215 @@ int Game_LoadLevel(GameState* state, u8 level_index, u8 stage_index) {
     
     /* Spawn player */
     Game_SpawnPlayer(state);
+}
+
+int Game_LoadLevel(GameState* state, u8 level_index, u8 stage_index) {
+    GamePrefetch* prefetch = state->prefetch;
+    
+    if (!state->blb_loaded) {
+        return -1;
+    }
+    
+    /* Clear entities - their defs point into the outgoing level */
+    entity_pool_reset(state);
+    
+    if (prefetch && prefetch->level_index == level_index &&
+        prefetch->stage_index == stage_index) {
+        if (prefetch_join(state) == 0) {
+            /* Swap buffers, then drop the old stage from the back slot */
+            LevelContext old = state->level;
+            state->level = state->level_next;
+            state->level_next = old;
+            Level_Unload(&state->level_next);
+            
+            level_enter(state, level_index, stage_index);
+            return 0;
+        }
+        Level_Unload(&state->level_next);  /* Failed - load it here instead */
+    }
+    
+    /* Unload previous level */
+    Level_Unload(&state->level);
+    
+    /* Load new level */
+    if (Level_Load(&state->level, &state->blb, level_index, stage_index) != 0) {
+        return -1;
+    }
+    
+    level_enter(state, level_index, stage_index);
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Stage Prefetch
+ * TOOL-ONLY: the next stage is loaded into the back LevelContext on a
+ * worker thread, so a stage exit costs a swap instead of a Level_Load.
+ * -------------------------------------------------------------------------- */
+
+int Game_PrefetchLevel(GameState* state, u8 level_index, u8 stage_index) {
+    GamePrefetch* prefetch;
+    
+    if (!state->blb_loaded || level_index >= BLB_GetLevelCount(&state->blb) ||
+        stage_index >= BLB_GetStageCount(&state->blb, level_index)) {
+        return -1;
+    }
+    
+    if (state->prefetch && state->prefetch->level_index == level_index &&
+        state->prefetch->stage_index == stage_index) {
+        return 0;
+    }
+    prefetch_cancel(state);
     
+    prefetch = (GamePrefetch*)calloc(1, sizeof(GamePrefetch));
+    if (!prefetch) {
+        return -1;
+    }
+    prefetch->out = &state->level_next;
+    prefetch->blb = &state->blb;
+    prefetch->level_index = level_index;
+    prefetch->stage_index = stage_index;
+    pthread_mutex_init(&prefetch->lock, NULL);
+    
+    if (pthread_create(&prefetch->thread, NULL, prefetch_main, prefetch) != 0) {
+        pthread_mutex_destroy(&prefetch->lock);
+        free(prefetch);
+        return -1;
+    }
+    state->prefetch = prefetch;
     return 0;
 }
 
+int Game_PrefetchNextStage(GameState* state) {
+    u32 level_index = state->level_index;
+    u32 stage_index = (u32)state->stage_index + 1;
+    
+    if (!state->blb_loaded || state->mode != GAME_MODE_LEVEL) {
+        return -1;
+    }
+    
+    /* Past the last stage - first stage of the next level */
+    if (stage_index >= BLB_GetStageCount(&state->blb, (u8)level_index)) {
+        level_index++;
+        stage_index = 0;
+    }
+    if (level_index >= BLB_GetLevelCount(&state->blb)) {
+        return -1;
+    }
+    return Game_PrefetchLevel(state, (u8)level_index, (u8)stage_index);
+}
+
+int Game_GetPrefetchStatus(const GameState* state) {
+    GamePrefetch* prefetch = state->prefetch;
+    int status;
+    
+    if (!prefetch) {
+        return 0;
+    }
+    pthread_mutex_lock(&prefetch->lock);
+    status = prefetch->done ? (prefetch->result == 0 ? 1 : -1) : 0;
+    pthread_mutex_unlock(&prefetch->lock);
+    return status;
+}
+
+/* -----------------------------------------------------------------------------
+ * Async Level Loading
+ * Stands in for TickCDStreamBuffer: the original streamed the next stage
+ * from CD during play; here the segments are read on the BLB loader
+ * thread and the switch happens once all three are resident.
+ * -------------------------------------------------------------------------- */
+
+static void stream_release(GameState* state) {
+    int i;
+    
+    for (i = 0; i < 3; i++) {
+        if (state->stream_segment[i]) {
+            BLB_ReleaseSegment(&state->blb, state->stream_segment[i]);
+            state->stream_segment[i] = NULL;
+        }
+        state->stream_request[i] = 0;
+    }
+    state->stream_active = 0;
+    state->stream_failed = 0;
+}
+
+static void stream_complete(BLBFile* blb, const BLBAsyncResult* result, void* user) {
+    GameState* state = (GameState*)user;
+    u8 kind = result->segment_type;
+    
+    /* Superseded request - just drop the pin */
+    if (!state->stream_active || state->stream_request[kind] != result->request_id) {
+        if (result->data) {
+            BLB_ReleaseSegment(blb, result->data);
+        }
+        return;
+    }
+    
+    state->stream_request[kind] = 0;
+    state->stream_segment[kind] = result->data;
+    if (result->status != 0) {
+        state->stream_failed = 1;
+    }
+}
+
+/* Sectors in a segment run; 0 means there is nothing to stream */
+static u16 stream_sector_count(const BLBFile* blb, u8 level_index, u8 stage_index, u8 kind) {
+    switch (kind) {
+    case 0:  return BLB_GetPrimarySectorCount(blb, level_index);
+    case 1:  return BLB_GetSecondarySectorCount(blb, level_index, stage_index);
+    default: return BLB_GetTertiarySectorCount(blb, level_index, stage_index);
+    }
+}
+
+int Game_LoadLevelAsync(GameState* state, u8 level_index, u8 stage_index) {
+    u8 kind;
+    
+    if (!state->blb_loaded || level_index >= state->blb.level_count ||
+        stage_index >= BLB_GetStageCount(&state->blb, level_index)) {
+        return -1;
+    }
+    
+    stream_release(state);
+    state->stream_level = level_index;
+    state->stream_stage = stage_index;
+    state->stream_active = 1;
+    
+    for (kind = 0; kind < 3; kind++) {
+        /* An empty run (a stage without tertiary data) is valid for
+         * Level_Load but can't be queued - leave it with no request */
+        if (stream_sector_count(&state->blb, level_index, stage_index, kind) == 0) {
+            continue;
+        }
+        state->stream_request[kind] = BLB_LoadSegmentAsync(&state->blb, level_index, stage_index,
+                                                           kind, stream_complete, state);
+        if (state->stream_request[kind] == 0) {
+            stream_release(state);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int Game_TickCDStreamBuffer(GameState* state) {
+    int result;
+    
+    if (!state->blb_loaded) {
+        return 0;
+    }
+    
+    BLB_PollAsync(&state->blb);
+    
+    if (!state->stream_active ||
+        state->stream_request[0] || state->stream_request[1] || state->stream_request[2]) {
+        return 0;
+    }
+    
+    /* Everything landed - Level_Load now finds the segments resident */
+    result = state->stream_failed ? -1 :
+             (Game_LoadLevel(state, state->stream_level, state->stream_stage) == 0 ? 1 : -1);
+    stream_release(state);
+    return result;
+}
+
 /* -----------------------------------------------------------------------------
  * Input Processing
  * Based on UpdateInputState at 0x800259d4
@@ -218,7 +471,8 @@ void Game_Tick(GameState* state, u16 p1_buttons, u16 p2_buttons) {
         return;
     }
     
-    /* 1. CD streaming (skip - no CD in reimplementation) */
+    /* 1. CD streaming - deliver async segment reads */
+    Game_TickCDStreamBuffer(state);
     
     /* 2-3. Input processing */
     Game_UpdateInput(&state->input_p1, p1_buttons);
@@ -347,8 +601,10 @@ Entity* Game_GetPlayer(GameState* state) {
 }
 
 void Game_Shutdown(GameState* state) {
+    prefetch_cancel(state);
     Level_Unload(&state->level);
     if (state->blb_loaded) {
+        stream_release(state);
         BLB_Close(&state->blb);
         state->blb_loaded = 0;
     }
@@ -7,7 +7,7 @@
  * Based on main() at 0x800828b0 in Skullmonkeys PAL.
  * 
  * Game Loop Order (from Ghidra decompilation):
- * 1. TickCDStreamBuffer() - Stream CD data (we skip - no CD)
+ * 1. TickCDStreamBuffer() - Stream CD data (we poll async BLB reads)
  * 2. PadRead(1) - Read controller ports
  * 3. UpdateInputState(P1, P2) - Process button presses/releases
  * 4. [Mode Callback] - Execute current game mode handler
@@ -107,6 +107,9 @@ typedef enum {
 
 typedef void (*ModeCallback)(struct GameState* state);
 
+/* Background stage load in flight (Game_PrefetchLevel) - game.c only */
+typedef struct GamePrefetch GamePrefetch;
+
 /* -----------------------------------------------------------------------------
  * GameState - Main game state structure
  * Based on g_GameStateBase at 0x8009DC40
@@ -127,11 +130,17 @@ typedef struct GameState {
     Entity* active_entity_head;     /* +0x1C: Active entities */
     Entity* render_entity_head;     /* +0x20: Render order list */
     Entity entity_pool[ENTITY_MAX_ACTIVE];
-    u32 entity_pool_next;
+    u32 entity_pool_next;           /* Slots past this are free (cleared on alloc) */
     
     /* Level data (offset 0x84 = LevelDataContext) */
     LevelContext level;
     
+    /* Back buffer: next stage, loaded on the prefetch thread and swapped
+     * with level by Game_LoadLevel. Owned by that thread while
+     * prefetch is set and not finished. */
+    LevelContext level_next;
+    GamePrefetch* prefetch;
+    
     /* BLB archive */
     BLBFile blb;
     int blb_loaded;
@@ -140,6 +149,14 @@ typedef struct GameState {
     u8 level_index;
     u8 stage_index;
     
+    /* Async stage load in flight (Game_LoadLevelAsync), polled in step 1 */
+    u32 stream_request[3];          /* Primary/secondary/tertiary, 0 = landed */
+    const u8* stream_segment[3];    /* Pinned until the load is applied */
+    u8 stream_level;
+    u8 stream_stage;
+    u8 stream_active;
+    u8 stream_failed;
+    
     /* Sliding window state machine (offset 0x60 in LevelDataContext) */
     u8 header_offset;
     
@@ -180,9 +197,56 @@ int Game_LoadBLB(GameState* state, const char* path);
 /**
  * Load a level.
  * Equivalent to InitializeAndLoadLevel at 0x8007D1D0.
+ * A matching Game_PrefetchLevel is swapped in instead of loading; if it
+ * is still running this waits for it.
  */
 int Game_LoadLevel(GameState* state, u8 level_index, u8 stage_index);
 
+/**
+ * Start loading a stage on a background thread while the current one
+ * keeps running. The next Game_LoadLevel for the same stage swaps it in
+ * without calling Level_Load. Replaces (waits for and drops) any other
+ * prefetch. state must not move while a prefetch is in flight.
+ * 
+ * TOOL-ONLY: The original game loads stages synchronously.
+ * 
+ * @return 0 if started (or already prefetching that stage), -1 on error
+ */
+int Game_PrefetchLevel(GameState* state, u8 level_index, u8 stage_index);
+
+/**
+ * Prefetch the stage after the current one: the next stage of this level,
+ * or stage 0 of the next level after the last stage.
+ * @return 0 if started, -1 if there is no next stage or on error
+ */
+int Game_PrefetchNextStage(GameState* state);
+
+/**
+ * Check whether the prefetched stage has finished loading.
+ * @return 1 if it can be swapped in without waiting, 0 if still loading
+ *         (or nothing prefetched), -1 if its load failed
+ */
+int Game_GetPrefetchStatus(const GameState* state);
+
+/**
+ * Start loading a level without blocking.
+ * The stage's segments are read in the background while the current
+ * level keeps running; Game_TickCDStreamBuffer switches to the new level
+ * once all of them are resident (empty runs are skipped). Replaces any
+ * load still in flight.
+ * @return 0 if the reads were queued, -1 on error
+ */
+int Game_LoadLevelAsync(GameState* state, u8 level_index, u8 stage_index);
+
+/**
+ * Step 1 of the game loop: collect finished segment reads and apply a
+ * pending Game_LoadLevelAsync once everything has arrived.
+ * Equivalent slot to TickCDStreamBuffer in main().
+ * @return 1 if a level was switched to this call, -1 if a pending load
+ *         failed, 0 otherwise
+ */
+int Game_TickCDStreamBuffer(GameState* state);
+
 /**
  * Process input.
  * Equivalent to UpdateInputState at 0x800259d4.
@@ -14,9 +14,14 @@
 
 #include "level.h"
 #include "level_export.h"  /* Tool-only export functions */
+#include "level_collision.h"
 #include <stdlib.h>
 #include <string.h>
 
+/* Per-tile table bytes: palette and RGBA pointers, pixel offset, size class,
+ * flags, coverage */
+#define TILE_TABLE_BYTES    (sizeof(const u16*) + sizeof(const u32*) + sizeof(u32) + 3)
+
 /* -----------------------------------------------------------------------------
  * Internal helpers
  * -------------------------------------------------------------------------- */
@@ -38,6 +43,519 @@ static u16 get_effective_secondary_sector(const BLBFile* blb, u8 level_index, u8
     return BLB_GetSecondarySectorOffset(blb, level_index, stage_index);
 }
 
+/* Asset ID to its LevelDataContext slot, or -1 if the game ignores it */
+static int slot_for_asset(u32 asset_id, int primary) {
+    if (primary) {
+        /* LevelDataParser only keeps these from the primary TOC */
+        switch (asset_id) {
+        case ASSET_GEOMETRY:        return LEVEL_SLOT_PRIMARY_GEOMETRY;
+        case ASSET_AUDIO_SAMPLES:   return LEVEL_SLOT_PRIMARY_AUDIO;
+        case ASSET_PALETTE:         return LEVEL_SLOT_PRIMARY_AUDIO_META;
+        default:                    return -1;
+        }
+    }
+    
+    switch (asset_id) {
+    case ASSET_TILE_HEADER:         return LEVEL_SLOT_TILE_HEADER;
+    case ASSET_TILE_HEADER_101:     return LEVEL_SLOT_VRAM_CONFIG;
+    case ASSET_TILEMAP_CONTAINER:   return LEVEL_SLOT_TILEMAPS;
+    case ASSET_LAYER_ENTRIES:       return LEVEL_SLOT_LAYERS;
+    case ASSET_TILE_PIXELS:         return LEVEL_SLOT_TILE_PIXELS;
+    case ASSET_PALETTE_INDICES:     return LEVEL_SLOT_PALETTE_INDICES;
+    case ASSET_TILE_FLAGS:          return LEVEL_SLOT_TILE_FLAGS;
+    case ASSET_PALETTE_CONTAINER:   return LEVEL_SLOT_PALETTES;
+    case ASSET_PALETTE_ANIM:        return LEVEL_SLOT_PALETTE_ANIM;
+    case ASSET_ANIMATED_TILES:      return LEVEL_SLOT_ANIMATED_TILES;
+    case ASSET_TILE_ATTRS:          return LEVEL_SLOT_TILE_ATTRS;
+    case ASSET_ANIM_OFFSETS:        return LEVEL_SLOT_ANIM_OFFSETS;
+    case ASSET_VEHICLE_DATA:        return LEVEL_SLOT_VEHICLE_DATA;
+    case ASSET_ENTITIES:            return LEVEL_SLOT_ENTITIES;
+    case ASSET_VRAM_RECTS:          return LEVEL_SLOT_VRAM_RECTS;
+    case ASSET_GEOMETRY:            return LEVEL_SLOT_GEOMETRY;
+    case ASSET_AUDIO_SAMPLES:       return LEVEL_SLOT_AUDIO_SAMPLES;
+    case ASSET_PALETTE:             return LEVEL_SLOT_AUDIO_META;
+    case ASSET_SPU_SAMPLES:         return LEVEL_SLOT_SPU_SAMPLES;
+    default:                        return -1;
+    }
+}
+
+/* Store one TOC entry into its LevelContext slot */
+static void assign_asset(LevelContext* ctx, const u8* data, u32 asset_id,
+                         u32 size, u32 item_count, int primary) {
+    int slot = slot_for_asset(asset_id, primary);
+    
+    if (slot < 0) {
+        return;
+    }
+    ctx->assets[slot].data = data;
+    ctx->assets[slot].size = size;
+    if (primary) {
+        return;
+    }
+    
+    switch (asset_id) {
+    /* SECONDARY segment (tile data) */
+    case ASSET_TILE_HEADER:         /* 100 */
+        ctx->tile_header = (const TileHeader*)data;
+        break;
+    case ASSET_TILE_PIXELS:         /* 300: 8bpp indexed */
+        ctx->tile_pixels = data;
+        break;
+    case ASSET_PALETTE_INDICES:     /* 301 */
+        ctx->palette_indices = data;
+        break;
+    case ASSET_TILE_FLAGS:          /* 302 */
+        ctx->tile_flags = data;
+        break;
+    case ASSET_PALETTE_CONTAINER:   /* 400: sub-TOC, first u32 is count */
+        ctx->palette_container = data;
+        ctx->palette_count = item_count;
+        ctx->palette_container_size = size;
+        break;
+    
+    /* TERTIARY segment (layers, entities) */
+    case ASSET_TILEMAP_CONTAINER:   /* 200: sub-TOC, first u32 is count */
+        ctx->tilemap_container = data;
+        ctx->tilemap_count = item_count;
+        ctx->tilemap_container_size = size;
+        break;
+    case ASSET_LAYER_ENTRIES:       /* 201 */
+        ctx->layer_entries = (const LayerEntry*)data;
+        ctx->layer_count = size / sizeof(LayerEntry);
+        break;
+    case ASSET_ENTITIES:            /* 501 */
+        ctx->entities = (const EntityDef*)data;
+        ctx->entity_count = size / sizeof(EntityDef);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Fill context slots from one segment in a single TOC pass.
+ * Uses the archive's asset index; falls back to the raw TOC if the
+ * segment isn't indexed, skipping entries that leave the segment's
+ * size bytes. Returns -1 if the TOC is unusable.
+ */
+static int assign_segment_assets(LevelContext* ctx, const u8* segment, u32 segment_size,
+                                 u16 sector, int primary) {
+    const BLBIndexEntry* entries;
+    u32 count, i;
+    
+    entries = BLB_GetSegmentAssets(ctx->blb, sector, &count);
+    if (entries) {
+        for (i = 0; i < count; i++) {
+            assign_asset(ctx, segment + entries[i].offset, entries[i].id,
+                         entries[i].size, entries[i].item_count, primary);
+        }
+        return 0;
+    }
+    
+    /* An index rejects a whole segment for one bad entry; keep the rest */
+    count = segment_size >= 4 ? read_u32(segment) : 0xFFFFFFFF;
+    if (count > 100 || 4 + count * 12 > segment_size) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        const u8* toc = segment + 4 + i * 12;
+        u32 id = read_u32(toc + 0);
+        u32 size = read_u32(toc + 4);
+        u32 offset = read_u32(toc + 8);
+        const u8* data = segment + offset;
+        
+        if (offset > segment_size || size > segment_size - offset) {
+            continue;
+        }
+        /* Only the sub-TOC containers need their counts */
+        assign_asset(ctx, data, id, size,
+                     ((id == ASSET_PALETTE_CONTAINER || id == ASSET_TILEMAP_CONTAINER) &&
+                      size >= 4) ? read_u32(data) : 0, primary);
+    }
+    return 0;
+}
+
+/* Entries in a sub-TOC container, capped by what its size can hold */
+static u32 container_count(const LevelAsset* asset) {
+    u32 count;
+    
+    if (!asset->data || asset->size < 4) {
+        return 0;
+    }
+    count = read_u32(asset->data);
+    return count < (asset->size - 4) / 12 ? count : (asset->size - 4) / 12;
+}
+
+/* Upper bound on what the lazy decoders below will allocate */
+static u64 lazy_table_bytes(const LevelContext* ctx) {
+    const LevelAsset* a = ctx->assets;
+    
+    return (u64)(container_count(&a[LEVEL_SLOT_GEOMETRY]) +
+                 container_count(&a[LEVEL_SLOT_PRIMARY_GEOMETRY])) * sizeof(LevelSprite) +
+           (u64)(container_count(&a[LEVEL_SLOT_AUDIO_SAMPLES]) +
+                 container_count(&a[LEVEL_SLOT_PRIMARY_AUDIO])) * sizeof(LevelSample) +
+           a[LEVEL_SLOT_PALETTE_ANIM].size + a[LEVEL_SLOT_ANIMATED_TILES].size +
+           4 * LEVEL_ARENA_ALIGN;
+}
+
+/* Bytes for the collision class bitplanes */
+static u64 collision_plane_bytes(const LevelCollision* col) {
+    u64 row_words = ((u64)col->width + 63) >> 6;
+    
+    return row_words * (u64)col->height * LEVEL_COLLISION_CLASS_COUNT * sizeof(u64);
+}
+
+/**
+ * Size the arena from what the stage will derive: the tile tables, every
+ * addressable palette as RGBA (twice if semi-transparent), the layer
+ * chunks, the collision bitplanes and the lazy tables. Anything
+ * beyond this chains another chunk, so the estimate only has to be close.
+ */
+static u64 estimate_arena_size(const LevelContext* ctx) {
+    u32 palettes = ctx->palette_count < 256 ? ctx->palette_count : 256;
+    
+    u64 chunk_bytes = (u64)ctx->layer_count * (sizeof(LevelLayerChunks) + LEVEL_ARENA_ALIGN);
+    u32 l;
+    
+    for (l = 0; l < ctx->layer_count; l++) {
+        const LayerEntry* layer = &ctx->layer_entries[l];
+        chunk_bytes += (u64)((layer->width + LEVEL_CHUNK_SIZE - 1) >> LEVEL_CHUNK_SHIFT) *
+                       ((layer->height + LEVEL_CHUNK_SIZE - 1) >> LEVEL_CHUNK_SHIFT) *
+                       (sizeof(LevelChunk) + sizeof(u32));
+    }
+    
+    return (u64)ctx->total_tiles * TILE_TABLE_BYTES +
+           (u64)palettes * 256 * sizeof(u32) * 2 + LEVEL_ARENA_ALIGN * 2 +
+           chunk_bytes +
+           collision_plane_bytes(&ctx->collision) + LEVEL_ARENA_ALIGN +
+           lazy_table_bytes(ctx) +
+           LEVEL_ARENA_MIN_CHUNK;
+}
+
+/* Asset 302 bit 1 decides the size when present, else the tile range */
+static int tile_is_8x8(const LevelContext* ctx, u32 tile) {
+    return ctx->tile_flags ? (ctx->lut_flags[tile] & 0x02) != 0 : ctx->lut_is_8x8[tile];
+}
+
+/**
+ * Classify a tile by the alpha of its RGBA LUT over the pixels it renders:
+ * all 16x16, or the top-left 8x8 of its 16-byte rows. Needs lut_rgba and
+ * lut_flags filled in.
+ */
+static u8 tile_coverage(const LevelContext* ctx, u32 tile) {
+    const u32* lut = ctx->lut_rgba[tile];
+    const u8* pixels;
+    u32 offset = ctx->lut_pixel_offset[tile];
+    u32 size, x, y;
+    u32 solid = 0, clear = 0;
+    
+    size = tile_is_8x8(ctx, tile) ? 8 : 16;
+    if (!lut || !ctx->tile_pixels ||
+        offset + (size - 1) * 16 + size > ctx->assets[LEVEL_SLOT_TILE_PIXELS].size) {
+        return LEVEL_TILE_MIXED;
+    }
+    
+    pixels = ctx->tile_pixels + offset;
+    for (y = 0; y < size; y++, pixels += 16) {
+        for (x = 0; x < size; x++) {
+            u32 alpha = lut[pixels[x]] >> 24;
+            
+            solid += alpha == 0xFF;
+            clear += alpha == 0;
+        }
+    }
+    if (solid == size * size) return LEVEL_TILE_SOLID;
+    if (clear == size * size) return LEVEL_TILE_CLEAR;
+    return LEVEL_TILE_MIXED;
+}
+
+/**
+ * Build the per-tile lookup tables from the tile header, Asset 301/302 and
+ * the palette container. Palettes are resolved through the bounds-checked
+ * sub-TOC once per palette, so a bad Asset 301 entry costs a NULL slot
+ * here rather than a check on every lookup. Tiles past the end of a short
+ * Asset 301/302 get palette 0 and flags 0.
+ */
+static int build_tile_tables(LevelContext* ctx) {
+    const u16* palettes[256];
+    u32 count = ctx->total_tiles;
+    u32 count_16x16 = ctx->tile_header->count_16x16;
+    u32 palette_count = ctx->palette_count < 256 ? ctx->palette_count : 256;
+    u32 index_count = ctx->palette_indices ? ctx->assets[LEVEL_SLOT_PALETTE_INDICES].size : 0;
+    u32 flag_count = ctx->tile_flags ? ctx->assets[LEVEL_SLOT_TILE_FLAGS].size : 0;
+    u32* rgba = NULL;
+    u32* rgba_semi = NULL;
+    u8* block;
+    u8 palette;
+    u32 i;
+    
+    if (count == 0) {
+        return 0;
+    }
+    
+    /* Pointers first so every array stays naturally aligned */
+    block = (u8*)Level_Alloc(ctx, count * (u32)TILE_TABLE_BYTES);
+    if (!block) {
+        return -1;
+    }
+    ctx->lut_palette = (const u16**)block;
+    ctx->lut_rgba = (const u32**)(block + (size_t)count * sizeof(const u16*));
+    ctx->lut_pixel_offset = (u32*)(ctx->lut_rgba + count);
+    ctx->lut_is_8x8 = (u8*)(ctx->lut_pixel_offset + count);
+    ctx->lut_flags = ctx->lut_is_8x8 + count;
+    ctx->lut_coverage = ctx->lut_flags + count;
+    
+    for (i = 0; i < 256; i++) {
+        u32 size = 0;
+        const u8* palette = ctx->palette_container ?
+            BLB_GetSubAsset(ctx->palette_container, ctx->palette_container_size, i, &size) : NULL;
+        palettes[i] = (palette && size >= 512) ? (const u16*)palette : NULL;
+    }
+    
+    /* Every palette converted once; the semi variant only if a tile uses it */
+    if (palette_count > 0) {
+        int any_semi = 0;
+        
+        for (i = 0; i < count && i < flag_count; i++) {
+            any_semi |= ctx->tile_flags[i] & 0x01;
+        }
+        rgba = (u32*)Level_Alloc(ctx, palette_count * 256 * (u32)sizeof(u32));
+        if (any_semi) {
+            rgba_semi = (u32*)Level_Alloc(ctx, palette_count * 256 * (u32)sizeof(u32));
+        }
+        if (!rgba || (any_semi && !rgba_semi)) {
+            return -1;
+        }
+        for (i = 0; i < palette_count; i++) {
+            if (!palettes[i]) {
+                memset(rgba + i * 256, 0, 256 * sizeof(u32));
+                if (rgba_semi) memset(rgba_semi + i * 256, 0, 256 * sizeof(u32));
+                continue;
+            }
+            psx_palette_to_rgba((const u8*)palettes[i], 0, rgba + i * 256);
+            if (rgba_semi) {
+                psx_palette_to_rgba((const u8*)palettes[i], PSX_RGBA_SEMI, rgba_semi + i * 256);
+            }
+        }
+    }
+    ctx->palette_rgba = rgba;
+    ctx->palette_rgba_semi = rgba_semi;
+    ctx->palette_rgba_count = palette_count;
+    
+    for (i = 0; i < count; i++) {
+        if (i < count_16x16) {
+            /* 16x16 tile: 256 bytes each (16 rows x 16 bytes) */
+            ctx->lut_is_8x8[i] = 0;
+            ctx->lut_pixel_offset[i] = i * 256;
+        } else {
+            /* 8x8 tile: 128 bytes each (8 rows x 16 bytes, only first 8 cols used) */
+            ctx->lut_is_8x8[i] = 1;
+            ctx->lut_pixel_offset[i] = count_16x16 * 256 + (i - count_16x16) * 128;
+        }
+        palette = i < index_count ? ctx->palette_indices[i] : 0;
+        ctx->lut_palette[i] = ctx->palette_indices ? palettes[palette] : NULL;
+        ctx->lut_flags[i] = i < flag_count ? ctx->tile_flags[i] : 0;
+        ctx->lut_rgba[i] = NULL;
+        if (ctx->lut_palette[i] && palette < palette_count) {
+            const u32* base = (ctx->lut_flags[i] & 0x01) ? rgba_semi : rgba;
+            ctx->lut_rgba[i] = base + palette * 256;
+        }
+        ctx->lut_coverage[i] = tile_coverage(ctx, i);
+    }
+    
+    return 0;
+}
+
+/**
+ * Whether every cell of a chunk holds a solid 16x16 tile, so it hides
+ * whatever is behind it. Needs lut_coverage filled in.
+ */
+static int chunk_is_opaque(const LevelContext* ctx, const LayerEntry* layer,
+                           const u16* tilemap, u32 base_x, u32 base_y) {
+    u32 w = layer->width - base_x < LEVEL_CHUNK_SIZE ? layer->width - base_x : LEVEL_CHUNK_SIZE;
+    u32 h = layer->height - base_y < LEVEL_CHUNK_SIZE ? layer->height - base_y : LEVEL_CHUNK_SIZE;
+    u32 x, y;
+    
+    for (y = 0; y < h; y++) {
+        const u16* row = tilemap + (base_y + y) * layer->width + base_x;
+        for (x = 0; x < w; x++) {
+            u16 tile = TILEMAP_TILE(row[x]);
+            
+            if (tile == 0 || tile > ctx->total_tiles ||
+                ctx->lut_coverage[tile - 1] != LEVEL_TILE_SOLID ||
+                tile_is_8x8(ctx, tile - 1)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Split each layer's tilemap into LEVEL_CHUNK_SIZE square chunks with
+ * occupancy, cell bounds, tile range and an opaque bit. Layers without
+ * a usable tilemap get an empty (0x0) view.
+ */
+static int build_layer_chunks(LevelContext* ctx) {
+    LevelLayerChunks* views;
+    u32 l;
+    
+    if (ctx->layer_count == 0) {
+        return 0;
+    }
+    
+    views = (LevelLayerChunks*)Level_Alloc(ctx, ctx->layer_count * (u32)sizeof(LevelLayerChunks));
+    if (!views) {
+        return -1;
+    }
+    memset(views, 0, ctx->layer_count * sizeof(LevelLayerChunks));
+    ctx->layer_chunks = views;
+    
+    for (l = 0; l < ctx->layer_count; l++) {
+        const LayerEntry* layer = &ctx->layer_entries[l];
+        const u16* tilemap = Level_GetLayerTilemap(ctx, l);
+        LevelLayerChunks* view = &views[l];
+        LevelChunk* chunks;
+        u32* occupied;
+        u32 total, c;
+        
+        if (!tilemap || layer->width == 0 || layer->height == 0) {
+            continue;
+        }
+        
+        view->chunks_x = (u16)((layer->width + LEVEL_CHUNK_SIZE - 1) >> LEVEL_CHUNK_SHIFT);
+        view->chunks_y = (u16)((layer->height + LEVEL_CHUNK_SIZE - 1) >> LEVEL_CHUNK_SHIFT);
+        total = (u32)view->chunks_x * view->chunks_y;
+        
+        chunks = (LevelChunk*)Level_Alloc(ctx, total * (u32)(sizeof(LevelChunk) + sizeof(u32)));
+        if (!chunks) {
+            return -1;
+        }
+        occupied = (u32*)(chunks + total);
+        
+        for (c = 0; c < total; c++) {
+            LevelChunk* chunk = &chunks[c];
+            u32 base_x = (c % view->chunks_x) << LEVEL_CHUNK_SHIFT;
+            u32 base_y = (c / view->chunks_x) << LEVEL_CHUNK_SHIFT;
+            u32 w = layer->width - base_x < LEVEL_CHUNK_SIZE ? layer->width - base_x : LEVEL_CHUNK_SIZE;
+            u32 h = layer->height - base_y < LEVEL_CHUNK_SIZE ? layer->height - base_y : LEVEL_CHUNK_SIZE;
+            u32 x, y;
+            
+            memset(chunk, 0, sizeof(LevelChunk));
+            chunk->x0 = LEVEL_CHUNK_SIZE;
+            chunk->y0 = LEVEL_CHUNK_SIZE;
+            
+            for (y = 0; y < h; y++) {
+                const u16* row = tilemap + (base_y + y) * layer->width + base_x;
+                for (x = 0; x < w; x++) {
+                    u16 tile = TILEMAP_TILE(row[x]);
+                    
+                    if (tile == 0) {
+                        continue;
+                    }
+                    if (chunk->cell_count == 0 || tile < chunk->min_tile) chunk->min_tile = tile;
+                    if (tile > chunk->max_tile) chunk->max_tile = tile;
+                    if (x < chunk->x0) chunk->x0 = (u8)x;
+                    if (y < chunk->y0) chunk->y0 = (u8)y;
+                    if (x > chunk->x1) chunk->x1 = (u8)x;
+                    chunk->y1 = (u8)y;
+                    chunk->cell_count++;
+                }
+            }
+            
+            if (chunk->cell_count == 0) {
+                chunk->x0 = chunk->y0 = 0;
+                continue;
+            }
+            chunk->flags = LEVEL_CHUNK_OCCUPIED |
+                (chunk_is_opaque(ctx, layer, tilemap, base_x, base_y) ? LEVEL_CHUNK_OPAQUE : 0);
+            occupied[view->occupied_count++] = c;
+        }
+        
+        view->chunks = chunks;
+        view->occupied = occupied;
+    }
+    
+    return 0;
+}
+
+/**
+ * Resolve the Asset 500 collision grid, as InitTileAttributeState @
+ * 0x80024cf4 does. A grid that doesn't fit its asset is dropped (all
+ * queries read empty) rather than failing the load.
+ */
+static void load_collision(LevelContext* ctx) {
+    const LevelAsset* asset = &ctx->assets[LEVEL_SLOT_TILE_ATTRS];
+    LevelCollision* col = &ctx->collision;
+    u32 width, height;
+    
+    memset(col, 0, sizeof(LevelCollision));
+    if (!asset->data || asset->size < 8) {
+        return;
+    }
+    
+    width = read_u16(asset->data + 4);
+    height = read_u16(asset->data + 6);
+    if ((u64)width * height > asset->size - 8) {
+        return;
+    }
+    
+    col->data = asset->data + 8;
+    col->offset_x = read_u16(asset->data + 0);
+    col->offset_y = read_u16(asset->data + 2);
+    col->width = (s32)width;
+    col->height = (s32)height;
+}
+
+/**
+ * Pack the collision grid into one bitset per attribute class so span
+ * queries can test a row 64 cells at a time. A grid too large to pack
+ * keeps working through the byte grid, without the span queries.
+ */
+static int build_collision_planes(LevelContext* ctx) {
+    LevelCollision* col = &ctx->collision;
+    u64 bytes = collision_plane_bytes(col);
+    u32 row_words = ((u32)col->width + 63) >> 6;
+    u32 plane_words = row_words * (u32)col->height;
+    u8 classes[256];
+    u64* planes;
+    u32 x, y, a;
+    
+    if (!col->data || bytes == 0 || bytes > 0xFFFFFFFFu) {
+        return 0;
+    }
+    
+    planes = (u64*)Level_Alloc(ctx, (u32)bytes);
+    if (!planes) {
+        return -1;
+    }
+    memset(planes, 0, (size_t)bytes);
+    
+    for (a = 0; a < 256; a++) {
+        classes[a] = (u8)LevelCollision_GetClasses((u8)a);
+    }
+    for (y = 0; y < (u32)col->height; y++) {
+        const u8* row = col->data + y * (u32)col->width;
+        u64* words = planes + y * row_words;
+        
+        for (x = 0; x < (u32)col->width; x++) {
+            u32 c = classes[row[x]];
+            u32 plane;
+            
+            for (plane = 0; c; plane++, c >>= 1) {
+                if (c & 1) {
+                    words[plane * plane_words + (x >> 6)] |= (u64)1 << (x & 63);
+                }
+            }
+        }
+    }
+    
+    col->planes = planes;
+    col->row_words = row_words;
+    col->plane_words = plane_words;
+    return 0;
+}
+
 /* -----------------------------------------------------------------------------
  * Level Operations
  * -------------------------------------------------------------------------- */
@@ -50,17 +568,19 @@ void Level_Init(LevelContext* ctx) {
 
 void Level_Unload(LevelContext* ctx) {
     if (ctx) {
-        /* All pointers point into BLB mmapped data, nothing to free */
-        /* Just reset the context */
+        /* Asset pointers point into the segments - only unpin those */
+        if (ctx->blb) {
+            BLB_ReleaseSegment(ctx->blb, ctx->primary_data);
+            BLB_ReleaseSegment(ctx->blb, ctx->secondary_data);
+            BLB_ReleaseSegment(ctx->blb, ctx->tertiary_data);
+        }
+        LevelArena_Free(&ctx->arena);
         memset(ctx, 0, sizeof(LevelContext));
     }
 }
 
 int Level_Load(LevelContext* ctx, const BLBFile* blb, u8 level_index, u8 stage_index) {
     u16 primary_sector, secondary_sector, tertiary_sector;
-    u32 toc_count;
-    u32 asset_size;
-    const u8* palette_toc;
     
     if (!ctx || !blb) {
         return -1;
@@ -86,24 +606,36 @@ int Level_Load(LevelContext* ctx, const BLBFile* blb, u8 level_index, u8 stage_i
     secondary_sector = get_effective_secondary_sector(blb, level_index, stage_index);
     tertiary_sector = BLB_GetTertiarySectorOffset(blb, level_index, stage_index);
     
-    /* Get segment base pointers */
-    ctx->primary_data = BLB_GetSectorData(blb, primary_sector);
-    ctx->secondary_data = BLB_GetSectorData(blb, secondary_sector);
-    ctx->tertiary_data = BLB_GetSectorData(blb, tertiary_sector);
+    /* Get segment base pointers - only these three runs are touched */
+    ctx->primary_data = BLB_AcquireSegment(blb, primary_sector,
+        BLB_GetPrimarySectorCount(blb, level_index), &ctx->primary_size);
+    ctx->secondary_data = BLB_AcquireSegment(blb, secondary_sector,
+        BLB_GetSecondarySectorCount(blb, level_index, stage_index), &ctx->secondary_size);
+    ctx->tertiary_data = BLB_AcquireSegment(blb, tertiary_sector,
+        BLB_GetTertiarySectorCount(blb, level_index, stage_index), &ctx->tertiary_size);
     
     if (!ctx->primary_data || !ctx->secondary_data || !ctx->tertiary_data) {
+        Level_Unload(ctx);
         return -1;
     }
     
     /* ---------------------------------------------------------------------
-     * Load from SECONDARY segment (tile data)
+     * Single pass over each segment's indexed TOC
      * --------------------------------------------------------------------- */
     
-    /* Asset 100: Tile Header */
-    ctx->tile_header = (const TileHeader*)BLB_FindAsset(
-        blb, ctx->secondary_data, ASSET_TILE_HEADER, NULL);
+    /* Primary only feeds the sprite/audio slots - a bad TOC leaves them empty */
+    (void)assign_segment_assets(ctx, ctx->primary_data, ctx->primary_size, primary_sector, 1);
+    
+    if (assign_segment_assets(ctx, ctx->secondary_data, ctx->secondary_size,
+                              secondary_sector, 0) != 0 ||
+        assign_segment_assets(ctx, ctx->tertiary_data, ctx->tertiary_size,
+                              tertiary_sector, 0) != 0) {
+        Level_Unload(ctx);
+        return -1;
+    }
     
     if (!ctx->tile_header) {
+        Level_Unload(ctx);
         return -1;
     }
     
@@ -112,126 +644,372 @@ int Level_Load(LevelContext* ctx, const BLBFile* blb, u8 level_index, u8 stage_i
                        ctx->tile_header->count_8x8 + 
                        ctx->tile_header->count_extra;
     
-    /* Asset 300: Tile Pixels (8bpp indexed) */
-    ctx->tile_pixels = BLB_FindAsset(
-        blb, ctx->secondary_data, ASSET_TILE_PIXELS, NULL);
-    
-    /* Asset 301: Palette Indices */
-    ctx->palette_indices = BLB_FindAsset(
-        blb, ctx->secondary_data, ASSET_PALETTE_INDICES, NULL);
+    /* Grid first: the arena estimate sizes its bitplanes from it */
+    load_collision(ctx);
     
-    /* Asset 302: Tile Flags */
-    ctx->tile_flags = BLB_FindAsset(
-        blb, ctx->secondary_data, ASSET_TILE_FLAGS, NULL);
-    
-    /* Asset 400: Palette Container */
-    ctx->palette_container = BLB_FindAsset(
-        blb, ctx->secondary_data, ASSET_PALETTE_CONTAINER, &asset_size);
+    if (LevelArena_Init(&ctx->arena, estimate_arena_size(ctx)) != 0 ||
+        build_tile_tables(ctx) != 0 ||
+        build_layer_chunks(ctx) != 0 ||
+        build_collision_planes(ctx) != 0) {
+        Level_Unload(ctx);
+        return -1;
+    }
     
-    if (ctx->palette_container) {
-        /* Palette container has sub-TOC: first u32 is count */
-        ctx->palette_count = read_u32(ctx->palette_container);
+    if (!ctx->entities || ctx->entity_count == 0) {
+        /* Fallback to count from tile header */
+        ctx->entity_count = ctx->tile_header->entity_count;
     }
     
-    /* ---------------------------------------------------------------------
-     * Load from TERTIARY segment (layers, entities)
-     * --------------------------------------------------------------------- */
+    return 0;
+}
+
+void* Level_Alloc(LevelContext* ctx, u32 size) {
+    if (!ctx) {
+        return NULL;
+    }
+    return LevelArena_Alloc(&ctx->arena, size, LEVEL_ARENA_ALIGN);
+}
+
+u64 Level_GetFootprint(const LevelContext* ctx) {
+    return ctx ? ctx->arena.capacity : 0;
+}
+
+u32 Level_GetTotalTileCount(const LevelContext* ctx) {
+    return ctx ? ctx->total_tiles : 0;
+}
+
+const u8* Level_GetTilePixels(const LevelContext* ctx, u16 tile_index, int* out_is_8x8) {
+    if (!ctx || !ctx->tile_pixels || tile_index >= ctx->total_tiles) {
+        if (out_is_8x8) *out_is_8x8 = 0;
+        return NULL;
+    }
     
-    /* Asset 200: Tilemap Container */
-    ctx->tilemap_container = BLB_FindAsset(
-        blb, ctx->tertiary_data, ASSET_TILEMAP_CONTAINER, NULL);
+    /* Offset and size class precomputed by Level_Load */
+    if (out_is_8x8) *out_is_8x8 = ctx->lut_is_8x8[tile_index];
+    return ctx->tile_pixels + ctx->lut_pixel_offset[tile_index];
+}
+
+const u16* Level_GetTilePalette(const LevelContext* ctx, u16 tile_index) {
+    if (!ctx || tile_index >= ctx->total_tiles) {
+        return NULL;
+    }
     
-    /* Asset 201: Layer Entries */
-    ctx->layer_entries = (const LayerEntry*)BLB_FindAsset(
-        blb, ctx->tertiary_data, ASSET_LAYER_ENTRIES, &asset_size);
+    /* Resolved and bounds-checked once by Level_Load */
+    return ctx->lut_palette[tile_index];
+}
+
+const u32* Level_GetTileRGBA(const LevelContext* ctx, u16 tile_index) {
+    if (!ctx || tile_index >= ctx->total_tiles) {
+        return NULL;
+    }
+    return ctx->lut_rgba[tile_index];
+}
+
+u8 Level_GetTileFlags(const LevelContext* ctx, u16 tile_index) {
+    if (!ctx || tile_index >= ctx->total_tiles) {
+        return 0;
+    }
+    return ctx->lut_flags[tile_index];
+}
+
+u8 Level_GetTileCoverage(const LevelContext* ctx, u16 tile_index) {
+    if (!ctx || tile_index >= ctx->total_tiles) {
+        return LEVEL_TILE_MIXED;
+    }
+    return ctx->lut_coverage[tile_index];
+}
+
+int Level_SetPalette(LevelContext* ctx, u8 palette_index, const u16* colors) {
+    u32* rgba;
+    u32* rgba_semi;
+    u32 l, i;
     
-    if (ctx->layer_entries && asset_size > 0) {
-        ctx->layer_count = asset_size / sizeof(LayerEntry);
+    if (!ctx || !colors || !ctx->palette_rgba || palette_index >= ctx->palette_rgba_count) {
+        return -1;
     }
     
-    /* Asset 501: Entity Definitions */
-    ctx->entities = (const EntityDef*)BLB_FindAsset(
-        blb, ctx->tertiary_data, ASSET_ENTITIES, &asset_size);
+    /* The LUTs are arena memory Level_Load filled; only the views are const */
+    rgba = (u32*)ctx->palette_rgba + palette_index * 256;
+    rgba_semi = ctx->palette_rgba_semi ? (u32*)ctx->palette_rgba_semi + palette_index * 256 : NULL;
+    psx_palette_to_rgba((const u8*)colors, 0, rgba);
+    if (rgba_semi) {
+        psx_palette_to_rgba((const u8*)colors, PSX_RGBA_SEMI, rgba_semi);
+    }
     
-    if (ctx->entities && asset_size > 0) {
-        ctx->entity_count = asset_size / sizeof(EntityDef);
-    } else if (ctx->tile_header) {
-        /* Fallback to count from tile header */
-        ctx->entity_count = ctx->tile_header->entity_count;
+    /* New colours can make a tile solid or clear, and a chunk opaque or not */
+    for (i = 0; i < ctx->total_tiles; i++) {
+        if (ctx->lut_rgba[i] == rgba || (rgba_semi && ctx->lut_rgba[i] == rgba_semi)) {
+            ctx->lut_coverage[i] = tile_coverage(ctx, i);
+        }
+    }
+    for (l = 0; ctx->layer_chunks && l < ctx->layer_count; l++) {
+        const LevelLayerChunks* view = &ctx->layer_chunks[l];
+        const LayerEntry* layer = &ctx->layer_entries[l];
+        const u16* tilemap = Level_GetLayerTilemap(ctx, l);
+        
+        for (i = 0; tilemap && i < view->occupied_count; i++) {
+            u32 c = view->occupied[i];
+            LevelChunk* chunk = (LevelChunk*)&view->chunks[c];
+            u32 base_x = (c % view->chunks_x) << LEVEL_CHUNK_SHIFT;
+            u32 base_y = (c / view->chunks_x) << LEVEL_CHUNK_SHIFT;
+            
+            chunk->flags = LEVEL_CHUNK_OCCUPIED |
+                (chunk_is_opaque(ctx, layer, tilemap, base_x, base_y) ? LEVEL_CHUNK_OPAQUE : 0);
+        }
     }
     
     return 0;
 }
 
-u32 Level_GetTotalTileCount(const LevelContext* ctx) {
-    return ctx ? ctx->total_tiles : 0;
+/* -----------------------------------------------------------------------------
+ * Asset Slot Access (TOOL-ONLY)
+ * -------------------------------------------------------------------------- */
+
+/* Append one Asset 600 bank, keeping the table sorted by id. Insertion
+ * is stable, so the bank added first wins lookups on duplicate ids. */
+static u32 add_sprite_bank(LevelSprite* sprites, u32 count, const LevelAsset* bank) {
+    u32 n = container_count(bank);
+    u32 i;
+    
+    for (i = 0; i < n; i++) {
+        LevelSprite entry;
+        u32 j;
+        
+        entry.data = BLB_GetSubAsset(bank->data, bank->size, i, &entry.size);
+        if (!entry.data) {
+            continue;
+        }
+        entry.id = read_u32(bank->data + 4 + i * 12);
+        
+        j = count;
+        while (j > 0 && sprites[j - 1].id > entry.id) {
+            sprites[j] = sprites[j - 1];
+            j--;
+        }
+        sprites[j] = entry;
+        count++;
+    }
+    return count;
 }
 
-const u8* Level_GetTilePixels(const LevelContext* ctx, u16 tile_index, int* out_is_8x8) {
-    u32 offset;
-    int is_8x8;
+static u32 add_sample_bank(LevelSample* samples, u32 count, const LevelAsset* bank,
+                           const LevelAsset* meta, u8 primary) {
+    u32 n = container_count(bank);
+    u32 i;
     
-    if (!ctx || !ctx->tile_pixels || !ctx->tile_header) {
-        if (out_is_8x8) *out_is_8x8 = 0;
+    for (i = 0; i < n; i++) {
+        LevelSample* sample = &samples[count];
+        
+        sample->data = BLB_GetSubAsset(bank->data, bank->size, i, &sample->size);
+        if (!sample->data) {
+            continue;
+        }
+        sample->id = read_u32(bank->data + 4 + i * 12);
+        
+        /* Asset 602: 4 bytes per sample, volume then pan */
+        if (meta->data && (u64)(i + 1) * 4 <= meta->size) {
+            sample->volume = read_u16(meta->data + i * 4);
+            sample->pan = read_u16(meta->data + i * 4 + 2);
+        } else {
+            sample->volume = 0x3FFF;
+            sample->pan = 0;
+        }
+        sample->primary = primary;
+        memset(sample->_pad, 0, sizeof(sample->_pad));
+        count++;
+    }
+    return count;
+}
+
+const u8* Level_GetAsset(const LevelContext* ctx, LevelAssetSlot slot, u32* out_size) {
+    if (out_size) *out_size = 0;
+    if (!ctx || (u32)slot >= LEVEL_SLOT_COUNT) {
         return NULL;
     }
+    if (out_size) *out_size = ctx->assets[slot].size;
+    return ctx->assets[slot].data;
+}
+
+const LevelSprite* Level_GetSprites(const LevelContext* ctx, u32* out_count) {
+    LevelContext* memo = (LevelContext*)ctx;   /* Memoization only */
     
-    if (tile_index >= ctx->total_tiles) {
-        if (out_is_8x8) *out_is_8x8 = 0;
+    if (out_count) *out_count = 0;
+    if (!ctx) {
         return NULL;
     }
     
-    /* Check if this is a 16x16 or 8x8 tile */
-    if (tile_index < ctx->tile_header->count_16x16) {
-        /* 16x16 tile: 256 bytes each (16 rows × 16 bytes) */
-        is_8x8 = 0;
-        offset = tile_index * 256;
-    } else {
-        /* 8x8 tile: 128 bytes each (8 rows × 16 bytes, only first 8 cols used) */
-        is_8x8 = 1;
-        offset = ctx->tile_header->count_16x16 * 256 + 
-                 (tile_index - ctx->tile_header->count_16x16) * 128;
+    if (!(ctx->lazy_decoded & LEVEL_LAZY_SPRITES)) {
+        const LevelAsset* primary = &ctx->assets[LEVEL_SLOT_PRIMARY_GEOMETRY];
+        const LevelAsset* stage = &ctx->assets[LEVEL_SLOT_GEOMETRY];
+        u32 max = container_count(primary) + container_count(stage);
+        LevelSprite* sprites = NULL;
+        u32 count = 0;
+        
+        if (max > 0) {
+            sprites = (LevelSprite*)Level_Alloc(memo, max * (u32)sizeof(LevelSprite));
+            if (!sprites) {
+                return NULL;    /* Not memoized - try again next call */
+            }
+            count = add_sprite_bank(sprites, 0, primary);
+            count = add_sprite_bank(sprites, count, stage);
+        }
+        memo->sprites = sprites;
+        memo->sprite_count = count;
+        memo->lazy_decoded |= LEVEL_LAZY_SPRITES;
     }
     
-    if (out_is_8x8) *out_is_8x8 = is_8x8;
-    return ctx->tile_pixels + offset;
+    if (out_count) *out_count = ctx->sprite_count;
+    return ctx->sprites;
 }
 
-const u16* Level_GetTilePalette(const LevelContext* ctx, u16 tile_index) {
-    u8 palette_index;
-    u32 sub_toc_count;
-    const u8* sub_toc;
-    u32 palette_offset;
+const u8* Level_FindSprite(const LevelContext* ctx, u32 sprite_id, u32* out_size) {
+    const LevelSprite* sprites;
+    u32 count, lo, hi;
+    
+    if (out_size) *out_size = 0;
+    sprites = Level_GetSprites(ctx, &count);
+    if (!sprites) {
+        return NULL;
+    }
     
-    if (!ctx || !ctx->palette_container || !ctx->palette_indices) {
+    /* Lower bound, so the first (primary) of equal ids is found */
+    lo = 0;
+    hi = count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (sprites[mid].id < sprite_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo >= count || sprites[lo].id != sprite_id) {
         return NULL;
     }
     
-    if (tile_index >= ctx->total_tiles) {
+    if (out_size) *out_size = sprites[lo].size;
+    return sprites[lo].data;
+}
+
+const LevelSample* Level_GetSamples(const LevelContext* ctx, u32* out_count) {
+    LevelContext* memo = (LevelContext*)ctx;   /* Memoization only */
+    
+    if (out_count) *out_count = 0;
+    if (!ctx) {
         return NULL;
     }
     
-    /* Get palette index for this tile */
-    palette_index = ctx->palette_indices[tile_index];
+    if (!(ctx->lazy_decoded & LEVEL_LAZY_SAMPLES)) {
+        const LevelAsset* a = ctx->assets;
+        u32 max = container_count(&a[LEVEL_SLOT_PRIMARY_AUDIO]) +
+                  container_count(&a[LEVEL_SLOT_AUDIO_SAMPLES]);
+        LevelSample* samples = NULL;
+        u32 count = 0;
+        
+        if (max > 0) {
+            samples = (LevelSample*)Level_Alloc(memo, max * (u32)sizeof(LevelSample));
+            if (!samples) {
+                return NULL;
+            }
+            count = add_sample_bank(samples, 0, &a[LEVEL_SLOT_PRIMARY_AUDIO],
+                                    &a[LEVEL_SLOT_PRIMARY_AUDIO_META], 1);
+            count = add_sample_bank(samples, count, &a[LEVEL_SLOT_AUDIO_SAMPLES],
+                                    &a[LEVEL_SLOT_AUDIO_META], 0);
+        }
+        memo->samples = samples;
+        memo->sample_count = count;
+        memo->lazy_decoded |= LEVEL_LAZY_SAMPLES;
+    }
+    
+    if (out_count) *out_count = ctx->sample_count;
+    return ctx->samples;
+}
+
+const LevelPaletteAnim* Level_GetPaletteAnims(const LevelContext* ctx, u32* out_count) {
+    LevelContext* memo = (LevelContext*)ctx;   /* Memoization only */
     
-    /* Read sub-TOC from palette container */
-    sub_toc_count = read_u32(ctx->palette_container);
-    if (palette_index >= sub_toc_count) {
+    if (out_count) *out_count = 0;
+    if (!ctx) {
         return NULL;
     }
     
-    /* Sub-TOC entries are 12 bytes each (same as TOCEntry) */
-    sub_toc = ctx->palette_container + 4 + (palette_index * 12);
-    palette_offset = read_u32(sub_toc + 8);  /* Offset is at +8 */
+    if (!(ctx->lazy_decoded & LEVEL_LAZY_PALETTE_ANIM)) {
+        const LevelAsset* asset = &ctx->assets[LEVEL_SLOT_PALETTE_ANIM];
+        LevelPaletteAnim* anims = NULL;
+        u32 count = asset->data ? asset->size / 4 : 0;
+        u32 i;
+        
+        if (count > 0) {
+            anims = (LevelPaletteAnim*)Level_Alloc(memo, count * (u32)sizeof(LevelPaletteAnim));
+            if (!anims) {
+                return NULL;
+            }
+            for (i = 0; i < count; i++) {
+                const u8* src = asset->data + i * 4;
+                anims[i].enabled = src[0];
+                anims[i].start_index = src[1];
+                anims[i].end_index = src[2] >= src[1] ? src[2] : src[1];
+                anims[i].speed = src[3];
+            }
+        }
+        memo->palette_anims = anims;
+        memo->palette_anim_count = count;
+        memo->lazy_decoded |= LEVEL_LAZY_PALETTE_ANIM;
+    }
     
-    return (const u16*)(ctx->palette_container + palette_offset);
+    if (out_count) *out_count = ctx->palette_anim_count;
+    return ctx->palette_anims;
 }
 
-u8 Level_GetTileFlags(const LevelContext* ctx, u16 tile_index) {
-    if (!ctx || !ctx->tile_flags || tile_index >= ctx->total_tiles) {
+u32 Level_GetAnimatedTile(const LevelContext* ctx, u16 tile_index) {
+    LevelContext* memo = (LevelContext*)ctx;   /* Memoization only */
+    u32 static_count;
+    
+    if (!ctx || !ctx->tile_header || tile_index == 0) {
         return 0;
     }
-    return ctx->tile_flags[tile_index];
+    
+    if (!(ctx->lazy_decoded & LEVEL_LAZY_ANIMATED_TILES)) {
+        const LevelAsset* asset = &ctx->assets[LEVEL_SLOT_ANIMATED_TILES];
+        u32* entries = NULL;
+        u32 count = asset->data ? asset->size / 4 : 0;
+        u32 i;
+        
+        if (count > 0) {
+            entries = (u32*)Level_Alloc(memo, count * (u32)sizeof(u32));
+            if (!entries) {
+                return 0;
+            }
+            for (i = 0; i < count; i++) {
+                entries[i] = read_u32(asset->data + i * 4);
+            }
+        }
+        memo->animated_tiles = entries;
+        memo->animated_tile_count = count;
+        memo->lazy_decoded |= LEVEL_LAZY_ANIMATED_TILES;
+    }
+    
+    /* Animated tiles follow the 16x16 and 8x8 ranges */
+    static_count = (u32)ctx->tile_header->count_16x16 + ctx->tile_header->count_8x8;
+    if ((u32)tile_index - 1 < static_count ||
+        (u32)tile_index - 1 - static_count >= ctx->animated_tile_count) {
+        return 0;
+    }
+    return ctx->animated_tiles[tile_index - 1 - static_count];
+}
+
+int Level_DecodeAll(const LevelContext* ctx) {
+    u32 count;
+    
+    if (!ctx) {
+        return -1;
+    }
+    Level_GetSprites(ctx, &count);
+    Level_GetSamples(ctx, &count);
+    Level_GetPaletteAnims(ctx, &count);
+    Level_GetAnimatedTile(ctx, 1);
+    
+    return (ctx->lazy_decoded & LEVEL_LAZY_ALL) == LEVEL_LAZY_ALL ? 0 : -1;
 }
 
 const LayerEntry* Level_GetLayer(const LevelContext* ctx, u32 layer_index) {
@@ -243,7 +1021,6 @@ const LayerEntry* Level_GetLayer(const LevelContext* ctx, u32 layer_index) {
 
 const u16* Level_GetLayerTilemap(const LevelContext* ctx, u32 layer_index) {
     const u8* tilemap_toc;
-    u32 toc_count;
     u32 tilemap_offset;
     
     if (!ctx || !ctx->tilemap_container || layer_index >= ctx->layer_count) {
@@ -251,11 +1028,23 @@ const u16* Level_GetLayerTilemap(const LevelContext* ctx, u32 layer_index) {
     }
     
     /* Tilemap container has sub-TOC */
-    toc_count = read_u32(ctx->tilemap_container);
-    if (layer_index >= toc_count) {
+    if (layer_index >= ctx->tilemap_count) {
         return NULL;
     }
     
+    /* Validated archives have every tilemap sized for its layer */
+    if (!BLB_IS_TRUSTED(ctx->blb)) {
+        const LayerEntry* layer = &ctx->layer_entries[layer_index];
+        u32 tilemap_size;
+        const u8* tilemap = BLB_GetSubAsset(ctx->tilemap_container,
+                                            ctx->tilemap_container_size,
+                                            layer_index, &tilemap_size);
+        if (!tilemap || (u32)layer->width * layer->height * 2 > tilemap_size) {
+            return NULL;
+        }
+        return (const u16*)tilemap;
+    }
+    
     /* Read offset from sub-TOC (12 bytes per entry) */
     tilemap_toc = ctx->tilemap_container + 4 + (layer_index * 12);
     tilemap_offset = read_u32(tilemap_toc + 8);
@@ -263,6 +1052,14 @@ const u16* Level_GetLayerTilemap(const LevelContext* ctx, u32 layer_index) {
     return (const u16*)(ctx->tilemap_container + tilemap_offset);
 }
 
+const LevelLayerChunks* Level_GetLayerChunks(const LevelContext* ctx, u32 layer_index) {
+    if (!ctx || !ctx->layer_chunks || layer_index >= ctx->layer_count ||
+        !ctx->layer_chunks[layer_index].chunks) {
+        return NULL;
+    }
+    return &ctx->layer_chunks[layer_index];
+}
+
 void Level_GetBackgroundColor(const LevelContext* ctx, u8* r, u8* g, u8* b) {
     if (!ctx || !ctx->tile_header) {
         if (r) *r = 0;
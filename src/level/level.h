@@ -13,6 +13,12 @@
  * EXPORT/PACKING FUNCTIONS are in level_export.h (tool-only, not in game).
  * 
  * Original LevelDataContext is at GameState + 0x84 (0x8009DCC4 in PAL).
+ * 
+ * THREAD SAFETY: Level_Load only reads the archive, so separate contexts
+ * can be loaded and used on separate threads against one shared BLBFile.
+ * A loaded context can be read from several threads at once, except that
+ * Level_Alloc and the first call to each lazily decoded accessor write
+ * into it; Level_DecodeAll does those writes up front.
  */
 
 #ifndef LEVEL_H
@@ -21,6 +27,7 @@
 #include "../psx/types.h"
 #include "../psx/libgpu.h"
 #include "../blb/blb.h"
+#include "level_arena.h"
 
 /* -----------------------------------------------------------------------------
  * Tile Header (Asset 100) - 36 bytes
@@ -156,6 +163,160 @@ typedef struct {
     u16 padding3;
 } EntityDef;
 
+/* -----------------------------------------------------------------------------
+ * Asset Slots (TOOL-ONLY)
+ * 
+ * Every LevelDataContext slot (see level_accessors.h), in the original
+ * word order. Level_Load resolves each to a (pointer, size) pair into the
+ * pinned segments; nothing is decoded until it is asked for.
+ * -------------------------------------------------------------------------- */
+
+typedef enum {
+    LEVEL_SLOT_TILE_HEADER = 0,     /* [1]  Asset 100 */
+    LEVEL_SLOT_VRAM_CONFIG,         /* [2]  Asset 101 */
+    LEVEL_SLOT_TILEMAPS,            /* [3]  Asset 200 */
+    LEVEL_SLOT_LAYERS,              /* [4]  Asset 201 */
+    LEVEL_SLOT_TILE_PIXELS,         /* [5]  Asset 300 */
+    LEVEL_SLOT_PALETTE_INDICES,     /* [6]  Asset 301 */
+    LEVEL_SLOT_TILE_FLAGS,          /* [7]  Asset 302 */
+    LEVEL_SLOT_PALETTES,            /* [8]  Asset 400 */
+    LEVEL_SLOT_PALETTE_ANIM,        /* [9]  Asset 401 */
+    LEVEL_SLOT_ANIMATED_TILES,      /* [10] Asset 303 */
+    LEVEL_SLOT_TILE_ATTRS,          /* [11] Asset 500 */
+    LEVEL_SLOT_ANIM_OFFSETS,        /* [12] Asset 503 */
+    LEVEL_SLOT_VEHICLE_DATA,        /* [13] Asset 504 */
+    LEVEL_SLOT_ENTITIES,            /* [14] Asset 501 */
+    LEVEL_SLOT_VRAM_RECTS,          /* [15] Asset 502 */
+    LEVEL_SLOT_GEOMETRY,            /* [16] Asset 600 (tertiary sprites) */
+    LEVEL_SLOT_AUDIO_SAMPLES,       /* [18] Asset 601 */
+    LEVEL_SLOT_AUDIO_META,          /* [20] Asset 602 */
+    LEVEL_SLOT_SPU_SAMPLES,         /* [21] Asset 700 (unused by the game) */
+    LEVEL_SLOT_PRIMARY_GEOMETRY,    /* [28] Asset 600 in primary */
+    LEVEL_SLOT_PRIMARY_AUDIO,       /* [29] Asset 601 in primary */
+    LEVEL_SLOT_PRIMARY_AUDIO_META,  /* [31] Asset 602 in primary */
+    LEVEL_SLOT_COUNT
+} LevelAssetSlot;
+
+typedef struct {
+    const u8*   data;               /* Into a pinned segment, NULL if absent */
+    u32         size;
+} LevelAsset;
+
+/* One entry of a sprite bank (Asset 600) */
+typedef struct {
+    u32         id;
+    u32         size;
+    const u8*   data;               /* SpriteHeader */
+} LevelSprite;
+
+/* One sound from Asset 601, with its Asset 602 mix settings */
+typedef struct {
+    u32         id;
+    u32         size;
+    const u8*   data;               /* SPU ADPCM */
+    u16         volume;             /* 0-0x3FFF, 0x3FFF without Asset 602 */
+    u16         pan;                /* 0 = center */
+    u8          primary;            /* 1 if from the primary segment bank */
+    u8          _pad[3];
+} LevelSample;
+
+/* Asset 401: colour cycling for one palette */
+typedef struct {
+    u8          enabled;
+    u8          start_index;        /* First colour */
+    u8          end_index;          /* Last colour, >= start_index */
+    u8          speed;
+} LevelPaletteAnim;
+
+/* -----------------------------------------------------------------------------
+ * Tile Collision (Asset 500)
+ * 
+ * Header: u16 offset_x, offset_y, width, height, then width*height
+ * attribute bytes, row-major. InitTileAttributeState @ 0x80024cf4 copies
+ * the header into GameState +0x68..+0x72; Level_Load does the same here,
+ * widened so queries need no conversions, and packs each attribute class
+ * into a bitplane so span and column scans test 64 cells per load.
+ * Queries: level_collision.h.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    const u8*   data;           /* +0x68: attribute grid, NULL if absent */
+    s32         offset_x;       /* +0x6C: grid origin in tiles */
+    s32         offset_y;       /* +0x6E */
+    s32         width;          /* +0x70: grid size in tiles */
+    s32         height;         /* +0x72 */
+    
+    /* TOOL-ONLY: one row-major bitset per attribute class, bit x of row y
+     * set when cell (x, y) is in the class; see level_collision.h */
+    const u64*  planes;         /* LEVEL_COLLISION_CLASS_COUNT planes, NULL if absent */
+    u32         row_words;      /* u64 words per row: ceil(width / 64) */
+    u32         plane_words;    /* row_words * height */
+} LevelCollision;
+
+/* -----------------------------------------------------------------------------
+ * Tilemap Entry (Asset 200) - u16 per cell
+ * Based on RenderTilemapSprites16x16 @ 0x8001713c:
+ *   tile_idx = tile_entry & 0xFFF; color_idx = (tile_entry >> 12) & 0xF;
+ * -------------------------------------------------------------------------- */
+
+#define TILEMAP_TILE_MASK           0x0FFF  /* Bits 0-11: tile index, 1-based, 0 = empty */
+#define TILEMAP_TINT_SHIFT          12      /* Bits 12-15: index into LayerEntry.color_tints */
+#define TILEMAP_TINT_MASK           0x0F
+
+#define TILEMAP_TILE(entry)         ((u16)((entry) & TILEMAP_TILE_MASK))
+#define TILEMAP_TINT(entry)         ((u8)(((entry) >> TILEMAP_TINT_SHIFT) & TILEMAP_TINT_MASK))
+
+/* -----------------------------------------------------------------------------
+ * Tile Coverage (TOOL-ONLY)
+ * 
+ * Level_Load classifies every tile by the alpha of its RGBA pixels, so
+ * layer renderers can copy solid tiles row by row, skip clear ones and
+ * only test alpha per pixel for the rest.
+ * -------------------------------------------------------------------------- */
+
+#define LEVEL_TILE_MIXED            0       /* Some clear pixels, or no pixels/palette */
+#define LEVEL_TILE_SOLID            1       /* Every pixel has alpha 0xFF */
+#define LEVEL_TILE_CLEAR            2       /* Every pixel has alpha 0: draws nothing */
+
+/* -----------------------------------------------------------------------------
+ * Tilemap Chunks (TOOL-ONLY)
+ * 
+ * Level_Load splits every layer's tilemap into LEVEL_CHUNK_SIZE square
+ * chunks and records which of them hold anything, so renderers and
+ * exporters can skip the empty ones. Parallax backdrops are mostly empty.
+ * -------------------------------------------------------------------------- */
+
+#define LEVEL_CHUNK_SHIFT           4
+#define LEVEL_CHUNK_SIZE            (1 << LEVEL_CHUNK_SHIFT)    /* Cells per side */
+
+#define LEVEL_CHUNK_OCCUPIED        0x01    /* At least one non-zero cell */
+#define LEVEL_CHUNK_OPAQUE          0x02    /* Every cell is a LEVEL_TILE_SOLID 16x16 tile */
+
+typedef struct {
+    u16 min_tile;           /* Tile indices used (1-based), 0 if empty */
+    u16 max_tile;
+    u16 cell_count;         /* Non-empty cells */
+    u8  x0, y0;             /* Occupied cells within the chunk, inclusive */
+    u8  x1, y1;
+    u8  flags;              /* LEVEL_CHUNK_* */
+    u8  _pad;
+} LevelChunk;
+
+typedef struct {
+    u16 chunks_x;           /* Columns: ceil(width / LEVEL_CHUNK_SIZE) */
+    u16 chunks_y;
+    u32 occupied_count;
+    const LevelChunk* chunks;   /* chunks_x * chunks_y, row-major */
+    const u32* occupied;        /* Indices of occupied chunks, row-major */
+} LevelLayerChunks;
+
+/* Bits in LevelContext.lazy_decoded */
+#define LEVEL_LAZY_SPRITES          0x01
+#define LEVEL_LAZY_SAMPLES          0x02
+#define LEVEL_LAZY_PALETTE_ANIM     0x04
+#define LEVEL_LAZY_ANIMATED_TILES   0x08
+#define LEVEL_LAZY_ALL              0x0F
+
 /* -----------------------------------------------------------------------------
  * Level Context
  * 
@@ -172,10 +333,13 @@ typedef struct {
     u8              stage_index;
     u16             _pad;
     
-    /* Segment base pointers */
+    /* Segment base pointers (pinned via BLB_AcquireSegment) */
     const u8*       primary_data;
     const u8*       secondary_data;
     const u8*       tertiary_data;
+    u32             primary_size;
+    u32             secondary_size;
+    u32             tertiary_size;
     
     /* Tile Header (Asset 100) */
     const TileHeader* tile_header;
@@ -188,9 +352,12 @@ typedef struct {
     /* Palette data (Asset 400 container) */
     const u8*       palette_container;
     u32             palette_count;
+    u32             palette_container_size;
     
     /* Layer data */
     const u8*       tilemap_container;  /* Asset 200 */
+    u32             tilemap_count;      /* Sub-TOC entries in Asset 200 */
+    u32             tilemap_container_size;
     const LayerEntry* layer_entries;    /* Asset 201 */
     u32             layer_count;
     
@@ -201,6 +368,46 @@ typedef struct {
     /* Computed values */
     u32             total_tiles;        /* 16x16 + 8x8 + extra */
     
+    /* Every LevelDataContext slot, resolved but not decoded (TOOL-ONLY) */
+    LevelAsset      assets[LEVEL_SLOT_COUNT];
+    
+    /* Owns everything derived from the stage (TOOL-ONLY) */
+    LevelArena      arena;
+    
+    /* Per-tile lookup tables, indexed by 0-based tile (TOOL-ONLY).
+     * Built once by Level_Load in the arena, so the tile accessors
+     * are a single indexed load instead of a TOC walk. */
+    const u16**     lut_palette;        /* Palette, NULL if Asset 301 index is bad */
+    const u32**     lut_rgba;           /* Its RGBA LUT (semi variant for Asset 302 bit 0) */
+    u32*            lut_pixel_offset;   /* Byte offset into tile_pixels */
+    u8*             lut_is_8x8;         /* 1 past count_16x16 (128-byte tiles) */
+    u8*             lut_flags;          /* Asset 302 byte, 0 if the asset is missing */
+    u8*             lut_coverage;       /* LEVEL_TILE_*, over the size it renders at */
+    
+    /* Asset 400 palettes as RGBA LUTs, u32[palette_rgba_count * 256],
+     * built by Level_Load (TOOL-ONLY). Alpha policy: psx/types.h. */
+    const u32*      palette_rgba;       /* No flags; bad palettes stay all-transparent */
+    const u32*      palette_rgba_semi;  /* PSX_RGBA_SEMI, NULL if no tile is semi-transparent */
+    u32             palette_rgba_count; /* min(palette_count, 256) */
+    
+    /* Per-layer chunk occupancy, [layer_count] (TOOL-ONLY) */
+    const LevelLayerChunks* layer_chunks;
+    
+    /* Asset 500 collision grid, resolved by Level_Load */
+    LevelCollision  collision;
+    
+    /* Decoded on first access and memoized in the arena (TOOL-ONLY).
+     * Use the Level_Get* accessors below rather than reading these. */
+    u32             lazy_decoded;       /* LEVEL_LAZY_* done so far */
+    const LevelSprite* sprites;         /* Sorted by id, primary bank first */
+    u32             sprite_count;
+    const LevelSample* samples;         /* Primary bank, then the stage's */
+    u32             sample_count;
+    const LevelPaletteAnim* palette_anims;
+    u32             palette_anim_count;
+    const u32*      animated_tiles;     /* Asset 303 entries, host order */
+    u32             animated_tile_count;
+    
 } LevelContext;
 
 /* -----------------------------------------------------------------------------
@@ -214,6 +421,7 @@ void Level_Init(LevelContext* ctx);
 
 /**
  * Unload level data and free resources.
+ * Releases the segment pins taken by Level_Load and the level arena.
  */
 void Level_Unload(LevelContext* ctx);
 
@@ -228,6 +436,21 @@ void Level_Unload(LevelContext* ctx);
  */
 int Level_Load(LevelContext* ctx, const BLBFile* blb, u8 level_index, u8 stage_index);
 
+/**
+ * Allocate data derived from a loaded stage out of its arena.
+ * Lives until Level_Unload; never free it individually.
+ * Not thread-safe: one caller per context at a time.
+ * 
+ * @return              LEVEL_ARENA_ALIGN-aligned memory, uninitialised, or NULL
+ */
+void* Level_Alloc(LevelContext* ctx, u32 size);
+
+/**
+ * Get bytes reserved for data derived from the stage (arena capacity).
+ * Segment bytes are not included - they belong to the BLB cache.
+ */
+u64 Level_GetFootprint(const LevelContext* ctx);
+
 /**
  * Get total tile count (16x16 + 8x8 + extra).
  */
@@ -252,6 +475,17 @@ const u8* Level_GetTilePixels(const LevelContext* ctx, u16 tile_index, int* out_
  */
 const u16* Level_GetTilePalette(const LevelContext* ctx, u16 tile_index);
 
+/**
+ * Get the RGBA lookup table for a tile's palette (TOOL-ONLY).
+ * Built by Level_Load; picks the semi-transparent variant for tiles
+ * with Asset 302 bit 0, so a pixel is lut[index] with no further rules.
+ * 
+ * @param ctx           Level context
+ * @param tile_index    Tile index (0-based)
+ * @return              u32[256] 0xAABBGGRR, or NULL if the tile has no palette
+ */
+const u32* Level_GetTileRGBA(const LevelContext* ctx, u16 tile_index);
+
 /**
  * Get tile flags for rendering.
  * Bit 0: semi-transparent
@@ -260,6 +494,86 @@ const u16* Level_GetTilePalette(const LevelContext* ctx, u16 tile_index);
  */
 u8 Level_GetTileFlags(const LevelContext* ctx, u16 tile_index);
 
+/**
+ * Get a tile's coverage class (TOOL-ONLY).
+ * @param tile_index    Tile index (0-based)
+ * @return              LEVEL_TILE_*, LEVEL_TILE_MIXED if out of range
+ */
+u8 Level_GetTileCoverage(const LevelContext* ctx, u16 tile_index);
+
+/**
+ * Replace a palette's colours in the RGBA LUTs, e.g. for a colour cycling
+ * step (TOOL-ONLY). Tiles drawn with it pick the new colours up through
+ * Level_GetTileRGBA, and their coverage and the chunks' opaque bits are
+ * recomputed. Level_GetTilePalette still returns the archive colours.
+ * Renderers that cache expanded tiles must be invalidated afterwards
+ * (RenderFrame_InvalidatePalette).
+ *
+ * @param ctx           Level context
+ * @param palette_index Asset 301 palette index
+ * @param colors        256 PSX 15-bit colours
+ * @return              0 on success, -1 if the stage has no such LUT
+ */
+int Level_SetPalette(LevelContext* ctx, u8 palette_index, const u16* colors);
+
+/* -----------------------------------------------------------------------------
+ * Asset Slot Access (TOOL-ONLY)
+ * 
+ * Level_GetAsset is a plain lookup. The others decode their asset on the
+ * first call and return the memoized table afterwards, so a stage only
+ * pays for what its caller touches. Decoding writes into the context:
+ * don't make the first call for one context from two threads at once, or
+ * call Level_DecodeAll before sharing it.
+ * -------------------------------------------------------------------------- */
+
+/**
+ * Decode every lazily built table now. Afterwards all accessors only read
+ * the context, so it can be shared between threads without locking.
+ * @return              0 on success, -1 if an allocation failed
+ */
+int Level_DecodeAll(const LevelContext* ctx);
+
+/**
+ * Get any LevelDataContext slot as (pointer, size).
+ * @param out_size      Output: asset size (optional)
+ * @return              Asset data, or NULL if the stage doesn't have it
+ */
+const u8* Level_GetAsset(const LevelContext* ctx, LevelAssetSlot slot, u32* out_size);
+
+/**
+ * Get every sprite from both Asset 600 banks, sorted by id.
+ * @param out_count     Output: sprite count
+ */
+const LevelSprite* Level_GetSprites(const LevelContext* ctx, u32* out_count);
+
+/**
+ * Find a sprite by id. The primary bank wins, as in FindSpriteInTOC.
+ * @param out_size      Output: sprite data size (optional)
+ * @return              SpriteHeader data, or NULL if not found
+ */
+const u8* Level_FindSprite(const LevelContext* ctx, u32 sprite_id, u32* out_size);
+
+/**
+ * Get every sound from the Asset 601 banks with its Asset 602 settings.
+ * @param out_count     Output: sample count
+ */
+const LevelSample* Level_GetSamples(const LevelContext* ctx, u32* out_count);
+
+/**
+ * Get the Asset 401 colour cycling entry for each palette.
+ * @param out_count     Output: entry count (normally palette_count)
+ */
+const LevelPaletteAnim* Level_GetPaletteAnims(const LevelContext* ctx, u32* out_count);
+
+/**
+ * Get the Asset 303 entry for an animated tile.
+ * Matches GetAnimatedTileData @ 0x8007b658: only tiles past the 16x16 and
+ * 8x8 ranges are animated.
+ * @param tile_index    Tile index (1-based, as in tilemaps)
+ * @return              Animation entry, or 0 if the tile isn't animated
+ */
+u32 Level_GetAnimatedTile(const LevelContext* ctx, u16 tile_index);
+
 /**
  * Get layer entry by index.
  */
@@ -268,11 +582,17 @@ const LayerEntry* Level_GetLayer(const LevelContext* ctx, u32 layer_index);
 /**
  * Get tilemap data for a layer.
  * Returns pointer to width*height u16 values.
- * Each u16: bits 0-10 = tile index (1-based, 0=transparent)
- *           bits 12-15 = color tint selector
+ * Each u16 is a tilemap entry: TILEMAP_TILE() and TILEMAP_TINT().
  */
 const u16* Level_GetLayerTilemap(const LevelContext* ctx, u32 layer_index);
 
+/**
+ * Get a layer's chunked view, built by Level_Load.
+ * Visit occupied[] instead of every cell to skip empty regions.
+ * @return              Chunks, or NULL if the layer has no usable tilemap
+ */
+const LevelLayerChunks* Level_GetLayerChunks(const LevelContext* ctx, u32 layer_index);
+
 /**
  * Get background color from tile header.
  */
@@ -0,0 +1,116 @@
+/**
+ * level_arena.c - Per-stage bump allocator
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#include "level_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct LevelArenaChunk {
+    LevelArenaChunk* next;  /* Older chunk */
+    u64     size;           /* Usable bytes after the header */
+    u64     used;
+};
+
+/* Chunk header rounded up so the payload keeps the arena alignment */
+#define CHUNK_HEADER \
+    ((sizeof(LevelArenaChunk) + LEVEL_ARENA_ALIGN - 1) & ~(size_t)(LEVEL_ARENA_ALIGN - 1))
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+static u8* chunk_data(LevelArenaChunk* chunk) {
+    return (u8*)chunk + CHUNK_HEADER;
+}
+
+static LevelArenaChunk* add_chunk(LevelArena* arena, u64 size) {
+    LevelArenaChunk* chunk;
+
+    if (size > (u64)((size_t)-1) - CHUNK_HEADER) {
+        return NULL;
+    }
+    chunk = (LevelArenaChunk*)malloc(CHUNK_HEADER + (size_t)size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = arena->head;
+    chunk->size = size;
+    chunk->used = 0;
+
+    arena->head = chunk;
+    arena->capacity += size;
+    arena->chunk_count++;
+    return chunk;
+}
+
+/* -----------------------------------------------------------------------------
+ * Arena Operations
+ * -------------------------------------------------------------------------- */
+
+int LevelArena_Init(LevelArena* arena, u64 reserve) {
+    if (!arena) {
+        return -1;
+    }
+    memset(arena, 0, sizeof(LevelArena));
+
+    if (reserve > 0 && !add_chunk(arena, reserve)) {
+        return -1;
+    }
+    return 0;
+}
+
+void* LevelArena_Alloc(LevelArena* arena, u64 size, u32 align) {
+    LevelArenaChunk* chunk;
+    u64 start;
+
+    if (!arena || align == 0 || align > LEVEL_ARENA_ALIGN || (align & (align - 1))) {
+        return NULL;
+    }
+
+    chunk = arena->head;
+    if (chunk) {
+        start = (chunk->used + align - 1) & ~(u64)(align - 1);
+        if (start <= chunk->size && size <= chunk->size - start) {
+            arena->used += start - chunk->used + size;
+            arena->alloc_count++;
+            chunk->used = start + size;
+            return chunk_data(chunk) + start;
+        }
+    }
+
+    /* Out of room - chain a chunk at least half the current reservation,
+     * so a badly underestimated stage still takes few mallocs */
+    {
+        u64 grow = arena->capacity / 2;
+        if (grow < LEVEL_ARENA_MIN_CHUNK) grow = LEVEL_ARENA_MIN_CHUNK;
+        if (grow < size) grow = size;
+        chunk = add_chunk(arena, grow);
+    }
+    if (!chunk) {
+        return NULL;
+    }
+
+    /* Fresh chunk payload is already LEVEL_ARENA_ALIGN aligned */
+    chunk->used = size;
+    arena->used += size;
+    arena->alloc_count++;
+    return chunk_data(chunk);
+}
+
+void LevelArena_Free(LevelArena* arena) {
+    LevelArenaChunk* chunk;
+
+    if (!arena) {
+        return;
+    }
+    chunk = arena->head;
+    while (chunk) {
+        LevelArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    memset(arena, 0, sizeof(LevelArena));
+}
@@ -0,0 +1,57 @@
+/**
+ * level_arena.h - Per-stage bump allocator
+ *
+ * Everything derived from a loaded stage (tile tables, decoded palettes,
+ * collision data, ...) is carved out of one arena owned by its
+ * LevelContext. Level_Load reserves a chunk sized from the stage's assets,
+ * allocations are a pointer bump, and Level_Unload hands the whole thing
+ * back in one call - no per-structure frees, no heap fragmentation across
+ * stage switches, and the stage's footprint is just the arena capacity.
+ *
+ * Allocations never move: when a chunk fills up, a new one is chained on.
+ *
+ * TOOL-ONLY: The original game carved level data out of fixed RAM regions.
+ */
+
+#ifndef LEVEL_ARENA_H
+#define LEVEL_ARENA_H
+
+#include "../psx/types.h"
+
+/* Default alignment for LevelArena_Alloc callers that don't care */
+#define LEVEL_ARENA_ALIGN       16
+
+/* Smallest chunk chained on when the reservation runs out */
+#define LEVEL_ARENA_MIN_CHUNK   (16u * 1024)
+
+typedef struct LevelArenaChunk LevelArenaChunk;
+
+typedef struct {
+    LevelArenaChunk* head;  /* Newest chunk, allocations come from here */
+    u64     capacity;       /* Bytes reserved across all chunks */
+    u64     used;           /* Bytes handed out, including padding */
+    u32     chunk_count;
+    u32     alloc_count;
+} LevelArena;
+
+/**
+ * Reserve the first chunk.
+ * @param reserve       Expected total bytes (0 = reserve on first use)
+ * @return              0 on success, -1 on allocation failure
+ */
+int LevelArena_Init(LevelArena* arena, u64 reserve);
+
+/**
+ * Allocate from the arena. Memory is uninitialised and lives until
+ * LevelArena_Free.
+ * @param align         Power of two, at most LEVEL_ARENA_ALIGN
+ * @return              Pointer, or NULL on allocation failure
+ */
+void* LevelArena_Alloc(LevelArena* arena, u64 size, u32 align);
+
+/**
+ * Release every chunk and reset the arena to empty.
+ */
+void LevelArena_Free(LevelArena* arena);
+
+#endif /* LEVEL_ARENA_H */
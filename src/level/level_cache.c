@@ -0,0 +1,321 @@
+/**
+ * level_cache.c - Cache of loaded stages
+ *
+ * Entries are individually allocated so the LevelContext a caller holds
+ * never moves; the context is the first member, so a caller's pointer
+ * maps straight back to its entry.
+ *
+ * TOOL-ONLY: Not present in original game.
+ */
+
+#include "level_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* -----------------------------------------------------------------------------
+ * Cache structures
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    void*   data;
+    u64     size;
+    void    (*free_fn)(void*);
+} DerivedSlot;
+
+typedef struct {
+    LevelContext ctx;       /* Must stay first */
+    u8      level_index;
+    u8      stage_index;
+    u16     pad;
+    u32     pins;
+    u32     last_use;       /* LRU tick */
+    u64     bytes;          /* Segments + arena + derived */
+    u64     arena_charged;  /* Arena capacity included in bytes */
+    DerivedSlot derived[LEVEL_DERIVED_SLOTS];
+} CacheEntry;
+
+struct LevelCache {
+    const BLBFile* blb;
+    CacheEntry** entries;
+    u32     entry_count;
+    u32     entry_capacity;
+    u32     tick;
+    LevelCacheStats stats;
+};
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+static void free_slot(CacheEntry* entry, u32 slot) {
+    DerivedSlot* d = &entry->derived[slot];
+
+    if (d->data) {
+        if (d->free_fn) {
+            d->free_fn(d->data);
+        } else {
+            free(d->data);
+        }
+    }
+    entry->bytes -= d->size;
+    memset(d, 0, sizeof(DerivedSlot));
+}
+
+static void free_entry(CacheEntry* entry) {
+    u32 slot;
+
+    for (slot = 0; slot < LEVEL_DERIVED_SLOTS; slot++) {
+        free_slot(entry, slot);
+    }
+    Level_Unload(&entry->ctx);
+    free(entry);
+}
+
+/* Bring the entry's charge up to date after its arena grew (lazily
+ * decoded assets) */
+static void charge_arena(LevelCache* cache, CacheEntry* entry) {
+    u64 capacity = Level_GetFootprint(&entry->ctx);
+
+    entry->bytes += capacity - entry->arena_charged;
+    cache->stats.resident += capacity - entry->arena_charged;
+    entry->arena_charged = capacity;
+}
+
+/* Caller's context back to its entry, or NULL if not ours */
+static CacheEntry* find_by_context(const LevelCache* cache, const LevelContext* level) {
+    u32 i;
+
+    if (!cache || !level) {
+        return NULL;
+    }
+    for (i = 0; i < cache->entry_count; i++) {
+        if (&cache->entries[i]->ctx == level) {
+            return cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void remove_at(LevelCache* cache, u32 index) {
+    CacheEntry* entry = cache->entries[index];
+
+    cache->stats.resident -= entry->bytes;
+    cache->entries[index] = cache->entries[--cache->entry_count];
+    cache->stats.entries = cache->entry_count;
+    free_entry(entry);
+}
+
+/* Evict unpinned stages, oldest first, until within budget */
+static void evict_to_budget(LevelCache* cache) {
+    while (cache->stats.resident > cache->stats.budget) {
+        u32 i, victim = cache->entry_count;
+
+        for (i = 0; i < cache->entry_count; i++) {
+            const CacheEntry* e = cache->entries[i];
+            if (e->pins == 0 &&
+                (victim == cache->entry_count || e->last_use < cache->entries[victim]->last_use)) {
+                victim = i;
+            }
+        }
+        if (victim == cache->entry_count) {
+            return;  /* Everything pinned - allowed to overshoot */
+        }
+
+        remove_at(cache, victim);
+        cache->stats.evictions++;
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Cache Operations
+ * -------------------------------------------------------------------------- */
+
+LevelCache* LevelCache_Create(const BLBFile* blb, u64 budget) {
+    LevelCache* cache;
+
+    if (!blb) {
+        return NULL;
+    }
+
+    cache = (LevelCache*)calloc(1, sizeof(LevelCache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->blb = blb;
+    cache->stats.budget = budget ? budget : LEVEL_CACHE_DEFAULT_BUDGET;
+    return cache;
+}
+
+void LevelCache_Destroy(LevelCache* cache) {
+    u32 i;
+
+    if (!cache) {
+        return;
+    }
+    for (i = 0; i < cache->entry_count; i++) {
+        free_entry(cache->entries[i]);
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+const LevelContext* LevelCache_Acquire(LevelCache* cache, u8 level_index, u8 stage_index) {
+    CacheEntry* entry;
+    u32 i;
+
+    if (!cache) {
+        return NULL;
+    }
+
+    for (i = 0; i < cache->entry_count; i++) {
+        entry = cache->entries[i];
+        if (entry->level_index == level_index && entry->stage_index == stage_index) {
+            charge_arena(cache, entry);     /* Lazy decodes since last time */
+            entry->pins++;
+            entry->last_use = ++cache->tick;
+            cache->stats.hits++;
+            return &entry->ctx;
+        }
+    }
+
+    /* Miss - load and charge the segments the stage keeps pinned */
+    if (cache->entry_count >= cache->entry_capacity) {
+        u32 new_cap = cache->entry_capacity ? cache->entry_capacity * 2 : 8;
+        CacheEntry** new_entries = (CacheEntry**)realloc(cache->entries,
+                                                         new_cap * sizeof(CacheEntry*));
+        if (!new_entries) {
+            return NULL;
+        }
+        cache->entries = new_entries;
+        cache->entry_capacity = new_cap;
+    }
+
+    entry = (CacheEntry*)calloc(1, sizeof(CacheEntry));
+    if (!entry) {
+        return NULL;
+    }
+    if (Level_Load(&entry->ctx, cache->blb, level_index, stage_index) != 0) {
+        Level_Unload(&entry->ctx);
+        free(entry);
+        return NULL;
+    }
+
+    entry->level_index = level_index;
+    entry->stage_index = stage_index;
+    entry->pins = 1;
+    entry->last_use = ++cache->tick;
+    entry->arena_charged = Level_GetFootprint(&entry->ctx);
+    entry->bytes = sizeof(CacheEntry) + (u64)entry->ctx.primary_size +
+                   entry->ctx.secondary_size + entry->ctx.tertiary_size +
+                   entry->arena_charged;
+
+    cache->entries[cache->entry_count++] = entry;
+    cache->stats.entries = cache->entry_count;
+    cache->stats.resident += entry->bytes;
+    cache->stats.misses++;
+
+    evict_to_budget(cache);
+    return &entry->ctx;
+}
+
+void LevelCache_Release(LevelCache* cache, const LevelContext* level) {
+    CacheEntry* entry = find_by_context(cache, level);
+
+    if (!entry) {
+        return;
+    }
+    if (entry->pins > 0) {
+        entry->pins--;
+    }
+    charge_arena(cache, entry);
+    evict_to_budget(cache);
+}
+
+void* LevelCache_GetDerived(LevelCache* cache, const LevelContext* level,
+                            u32 slot, u64* out_size) {
+    CacheEntry* entry = find_by_context(cache, level);
+
+    if (out_size) *out_size = 0;
+    if (!entry || slot >= LEVEL_DERIVED_SLOTS) {
+        return NULL;
+    }
+    if (out_size) *out_size = entry->derived[slot].size;
+    return entry->derived[slot].data;
+}
+
+int LevelCache_SetDerived(LevelCache* cache, const LevelContext* level, u32 slot,
+                          void* data, u64 size, void (*free_fn)(void*)) {
+    CacheEntry* entry = find_by_context(cache, level);
+    DerivedSlot* d;
+
+    if (!entry || slot >= LEVEL_DERIVED_SLOTS) {
+        if (data) {
+            if (free_fn) free_fn(data); else free(data);
+        }
+        return -1;
+    }
+
+    cache->stats.resident -= entry->derived[slot].size;
+    free_slot(entry, slot);
+
+    d = &entry->derived[slot];
+    d->data = data;
+    d->size = data ? size : 0;
+    d->free_fn = free_fn;
+    entry->bytes += d->size;
+    cache->stats.resident += d->size;
+
+    /* The stage itself may be unpinned - keep it unless the budget says no */
+    evict_to_budget(cache);
+    return 0;
+}
+
+const u32* LevelCache_GetRGBAPalettes(LevelCache* cache, const LevelContext* level,
+                                      u32* out_count) {
+    if (out_count) *out_count = 0;
+    if (!find_by_context(cache, level) || !level->palette_rgba) {
+        return NULL;
+    }
+
+    /* Level_Load already built the LUTs; they are charged with the stage */
+    if (out_count) *out_count = level->palette_rgba_count;
+    return level->palette_rgba;
+}
+
+const u32* LevelCache_GetTileOffsets(LevelCache* cache, const LevelContext* level,
+                                     u32* out_count) {
+    if (out_count) *out_count = 0;
+    if (!find_by_context(cache, level) || !level->tile_pixels || level->total_tiles == 0) {
+        return NULL;
+    }
+
+    /* Level_Load already built the table; it is charged with the stage */
+    if (out_count) *out_count = level->total_tiles;
+    return level->lut_pixel_offset;
+}
+
+void LevelCache_Clear(LevelCache* cache) {
+    u32 i = 0;
+
+    if (!cache) {
+        return;
+    }
+    while (i < cache->entry_count) {
+        if (cache->entries[i]->pins == 0) {
+            remove_at(cache, i);   /* Swaps the last entry into i */
+        } else {
+            i++;
+        }
+    }
+}
+
+void LevelCache_GetStats(const LevelCache* cache, LevelCacheStats* out_stats) {
+    if (!out_stats) {
+        return;
+    }
+    if (!cache) {
+        memset(out_stats, 0, sizeof(LevelCacheStats));
+        return;
+    }
+    *out_stats = cache->stats;
+}
@@ -0,0 +1,117 @@
+/**
+ * level_cache.h - Cache of loaded stages
+ *
+ * Keeps fully loaded LevelContexts, keyed by (level, stage), together with
+ * data derived from them (atlases, caller tables), so switching back to
+ * a recently viewed stage costs a lookup instead of a Level_Load and a
+ * rebuild of every derived table.
+ *
+ * Entries are charged their segment bytes, level arena and derived data,
+ * and evicted least-recently-used first once the cache is over budget.
+ * Acquired entries are pinned and never evicted.
+ *
+ * Not thread-safe: use one cache per thread, or lock around it.
+ *
+ * TOOL-ONLY: The original game holds a single LevelDataContext.
+ */
+
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include "../psx/types.h"
+#include "level.h"
+
+/* Default budget when 0 is passed to LevelCache_Create */
+#define LEVEL_CACHE_DEFAULT_BUDGET  (64u * 1024 * 1024)
+
+/* Derived data slots per cached stage */
+#define LEVEL_DERIVED_RGBA_PALETTES 0   /* Unused: LUTs live in LevelContext.palette_rgba */
+#define LEVEL_DERIVED_TILE_OFFSETS  1   /* Unused: offsets live in LevelContext.lut_pixel_offset */
+#define LEVEL_DERIVED_ATLAS         2   /* Caller-defined tile atlas */
+#define LEVEL_DERIVED_USER          3   /* First free slot for other callers */
+#define LEVEL_DERIVED_SLOTS         8
+
+typedef struct LevelCache LevelCache;
+
+typedef struct {
+    u32 hits;               /* Acquires served from the cache */
+    u32 misses;             /* Acquires that ran Level_Load */
+    u32 evictions;
+    u32 entries;            /* Stages currently cached */
+    u64 resident;           /* Bytes charged to cached stages */
+    u64 budget;
+} LevelCacheStats;
+
+/**
+ * Create a stage cache over an open archive.
+ * The archive must outlive the cache.
+ * @param budget        Max bytes before evicting (0 = default)
+ * @return              Cache, or NULL on allocation failure
+ */
+LevelCache* LevelCache_Create(const BLBFile* blb, u64 budget);
+
+/**
+ * Free every cached stage and its derived data.
+ * Contexts still acquired become invalid.
+ */
+void LevelCache_Destroy(LevelCache* cache);
+
+/**
+ * Get a loaded stage, loading it on a miss. The context is pinned until
+ * the matching LevelCache_Release.
+ * @return              Loaded context, or NULL if Level_Load failed
+ */
+const LevelContext* LevelCache_Acquire(LevelCache* cache, u8 level_index, u8 stage_index);
+
+/**
+ * Unpin a context from LevelCache_Acquire. It stays cached until the
+ * budget forces it out.
+ */
+void LevelCache_Release(LevelCache* cache, const LevelContext* level);
+
+/**
+ * Get derived data attached to a cached stage.
+ * @param out_size      Output: bytes (optional)
+ * @return              Data, or NULL if the slot is empty
+ */
+void* LevelCache_GetDerived(LevelCache* cache, const LevelContext* level,
+                            u32 slot, u64* out_size);
+
+/**
+ * Attach derived data to a cached stage, replacing the slot's previous
+ * contents. The cache owns data from now on (also on error) and frees it
+ * with free_fn (NULL = free) when the stage is evicted.
+ * @return              0 on success, -1 if level isn't from this cache
+ */
+int LevelCache_SetDerived(LevelCache* cache, const LevelContext* level, u32 slot,
+                          void* data, u64 size, void (*free_fn)(void*));
+
+/**
+ * Get the stage's palettes as RGBA LUTs (the context's own palette_rgba,
+ * kept for existing callers).
+ * @param out_count     Output: palette count (256 entries each)
+ * @return              u32[count * 256], 0xAABBGGRR, or NULL
+ */
+const u32* LevelCache_GetRGBAPalettes(LevelCache* cache, const LevelContext* level,
+                                      u32* out_count);
+
+/**
+ * Get each tile's byte offset into tile_pixels (the context's own
+ * lut_pixel_offset table, kept for existing callers).
+ * @param out_count     Output: tile count
+ * @return              u32[total_tiles], or NULL
+ */
+const u32* LevelCache_GetTileOffsets(LevelCache* cache, const LevelContext* level,
+                                     u32* out_count);
+
+/**
+ * Drop every stage that isn't acquired.
+ */
+void LevelCache_Clear(LevelCache* cache);
+
+/**
+ * Get hit/miss counters and memory use.
+ */
+void LevelCache_GetStats(const LevelCache* cache, LevelCacheStats* out_stats);
+
+#endif /* LEVEL_CACHE_H */
@@ -0,0 +1,575 @@
+/**
+ * level_collision.c - Tile collision queries (Asset 500)
+ *
+ * Sweeps clamp the tiles they would cross to the grid first, so the
+ * inner loops walk the attribute bytes directly with a fixed stride and
+ * no per-cell bounds check. Cells off the grid are empty and never need
+ * visiting.
+ *
+ * Row scans (vertical sweeps, spans, ground) read the class bitplanes
+ * 64 cells at a time: OR the wanted planes' words, mask off the cells
+ * outside the span and take the lowest set bit.
+ */
+
+#include "level_collision.h"
+#include <string.h>
+
+/* -----------------------------------------------------------------------------
+ * Internal helpers
+ * -------------------------------------------------------------------------- */
+
+/* One direction of the grid, in tiles */
+typedef struct {
+    s32 origin;             /* World tile of grid cell 0 */
+    s32 extent;             /* Cells along this direction */
+    s32 stride;             /* Bytes between neighbouring cells */
+} CollisionAxis;
+
+static u8 cell_at(const LevelCollision* col, s32 tile_x, s32 tile_y) {
+    u32 x = (u32)(tile_x - col->offset_x);
+    u32 y = (u32)(tile_y - col->offset_y);
+
+    /* Negative offsets wrap to huge values, so one unsigned compare each */
+    if ((x >= (u32)col->width) | (y >= (u32)col->height)) {
+        return 0;
+    }
+    return col->data[y * (u32)col->width + x];
+}
+
+static u32 lowest_bit(u64 bits) {
+#if defined(__GNUC__)
+    return (u32)__builtin_ctzll(bits);
+#else
+    u32 n = 0;
+
+    while (!(bits & 0xFF)) {
+        bits >>= 8;
+        n += 8;
+    }
+    while (!(bits & 1)) {
+        bits >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* Planes for a class set; returns how many */
+static u32 gather_planes(const LevelCollision* col, u32 classes, const u64** out) {
+    u32 n = 0;
+    u32 c;
+
+    for (c = 0; c < LEVEL_COLLISION_CLASS_COUNT; c++) {
+        if (classes & LEVEL_COLLISION_MASK(c)) {
+            out[n++] = col->planes + c * col->plane_words;
+        }
+    }
+    return n;
+}
+
+/**
+ * First grid column in [x0, x1] of grid row y whose cell is in any of the
+ * gathered planes, or -1. Columns must already be clamped to the grid.
+ */
+static s32 row_scan(const LevelCollision* col, const u64* const* planes, u32 plane_count,
+                    s32 y, s32 x0, s32 x1) {
+    u32 base = (u32)y * col->row_words;
+    u32 w0 = (u32)x0 >> 6;
+    u32 w1 = (u32)x1 >> 6;
+    u32 w, i;
+
+    for (w = w0; w <= w1; w++) {
+        u64 bits = 0;
+
+        for (i = 0; i < plane_count; i++) {
+            bits |= planes[i][base + w];
+        }
+        if (w == w0) bits &= ~(u64)0 << (x0 & 63);
+        if (w == w1) bits &= ~(u64)0 >> (63 - (x1 & 63));
+        if (bits) {
+            return (s32)(w * 64 + lowest_bit(bits));
+        }
+    }
+    return -1;
+}
+
+/* Same for the solid cells of a run of bytes, for grids without planes */
+static s32 span_scan(const LevelCollision* col, const CollisionAxis* along,
+                     const CollisionAxis* across, s32 g, s32 a0, s32 a1) {
+    const u8* p = col->data + g * along->stride + a0 * across->stride;
+    s32 a;
+
+    for (a = a0; a <= a1; a++, p += across->stride) {
+        if (LEVEL_COLLISION_IS_SOLID(*p)) {
+            return a;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Step a box edge along one axis. lead is the leading edge in pixels,
+ * [span_lo, span_hi] the pixels the box covers across the axis. Returns
+ * the distance the edge can travel before entering a solid cell.
+ */
+static s32 sweep(const LevelCollision* col, const CollisionAxis* along,
+                 const CollisionAxis* across, s32 lead, s32 span_lo, s32 span_hi,
+                 s32 delta, s32* out_along, s32* out_across, u8* out_attr) {
+    s32 step = delta > 0 ? 1 : -1;
+    s32 first = (lead >> 4) + step - along->origin;     /* First cell entered */
+    s32 last = ((lead + delta) >> 4) - along->origin;   /* Cell the edge ends in */
+    s32 a0 = (span_lo >> 4) - across->origin;
+    s32 a1 = (span_hi >> 4) - across->origin;
+    const u64* solid;
+    s32 g;
+
+    *out_attr = 0;
+    if (delta == 0 || !col->data) {
+        return delta;
+    }
+
+    /* Clamp to the grid - everything outside it is empty */
+    if (a0 < 0) a0 = 0;
+    if (a1 > across->extent - 1) a1 = across->extent - 1;
+    if (step > 0) {
+        if (first < 0) first = 0;
+        if (last > along->extent - 1) last = along->extent - 1;
+    } else {
+        if (first > along->extent - 1) first = along->extent - 1;
+        if (last < 0) last = 0;
+    }
+    if (a0 > a1) {
+        return delta;
+    }
+
+    /* Stepping rows: the span across is a run of bits in the solid plane */
+    solid = col->planes && along->stride != 1 ? col->planes : NULL;
+
+    for (g = first; step > 0 ? g <= last : g >= last; g += step) {
+        s32 a = solid ? row_scan(col, &solid, 1, g, a0, a1)
+                      : span_scan(col, along, across, g, a0, a1);
+
+        if (a >= 0) {
+            s32 tile = g + along->origin;
+
+            *out_along = tile;
+            *out_across = a + across->origin;
+            *out_attr = col->data[g * along->stride + a * across->stride];
+            /* Stop flush against the cell's near edge */
+            return step > 0 ? tile * 16 - 1 - lead : (tile + 1) * 16 - lead;
+        }
+    }
+    return delta;
+}
+
+static void get_axes(const LevelCollision* col, CollisionAxis* x, CollisionAxis* y) {
+    x->origin = col->offset_x;
+    x->extent = col->width;
+    x->stride = 1;
+    y->origin = col->offset_y;
+    y->extent = col->height;
+    y->stride = col->width;
+}
+
+/* Rays sorted per block in LevelCollision_Raycasts; index fits the key's low bits */
+#define RAY_BLOCK_SHIFT     6
+#define RAY_BLOCK           (1 << RAY_BLOCK_SHIFT)
+
+/* Ray parameter: fraction of the segment in 8.24, so the per-cell adds
+ * in the DDA drift well under a pixel even on long rays */
+#define RAY_T_SHIFT         24
+#define RAY_T_ONE           ((s64)1 << RAY_T_SHIFT)
+#define RAY_T_NEVER         ((s64)1 << 62)
+
+/* One direction of a ray's walk through the grid */
+typedef struct {
+    s32 cell;               /* Current grid cell */
+    s32 step;               /* +1/-1, 0 if the ray doesn't move this way */
+    s64 t_next;             /* Ray parameter at the next cell boundary */
+    s64 t_delta;            /* Parameter between boundaries */
+} RayAxis;
+
+static u32 isqrt64(u64 v) {
+    u64 root = 0;
+    u64 bit = (u64)1 << 62;
+
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (u32)root;
+}
+
+/* Parameter where origin + d * t reaches edge */
+static s64 ray_param(s64 edge, s32 origin, s32 d) {
+    return (edge - origin) * RAY_T_ONE / d;
+}
+
+/* Coordinate at parameter t */
+static s64 ray_at(s32 origin, s32 d, s64 t) {
+    return origin + ((s64)d * t >> RAY_T_SHIFT);
+}
+
+/* Cell-boundary stepping for one axis, from grid cell `cell` */
+static void ray_axis(RayAxis* axis, s32 cell, s32 grid_origin, s32 origin, s32 d) {
+    axis->cell = cell;
+    if (d > 0) {
+        axis->step = 1;
+        axis->t_next = ray_param((s64)(cell + grid_origin + 1) << 20, origin, d);
+        axis->t_delta = ((s64)1 << 20) * RAY_T_ONE / d;
+    } else if (d < 0) {
+        axis->step = -1;
+        axis->t_next = ray_param((s64)(cell + grid_origin) << 20, origin, d);
+        axis->t_delta = ((s64)1 << 20) * RAY_T_ONE / -(s64)d;
+    } else {
+        axis->step = 0;
+        axis->t_next = RAY_T_NEVER;
+        axis->t_delta = 0;
+    }
+}
+
+/**
+ * Clip one axis of a ray to the grid's extent [lo, hi) (16.16 pixels),
+ * narrowing [*t_enter, *t_exit]. Returns 1 if this axis set t_enter,
+ * -1 if the ray can't be on the grid at all.
+ */
+static int ray_clip(s32 origin, s32 d, s64 lo, s64 hi, s64* t_enter, s64* t_exit) {
+    s64 t0, t1;
+    int entered = 0;
+
+    if (d == 0) {
+        return (origin < lo || origin >= hi) ? -1 : 0;
+    }
+    t0 = ray_param(d > 0 ? lo : hi, origin, d);
+    t1 = ray_param(d > 0 ? hi : lo, origin, d);
+    if (t0 > *t_enter) {
+        *t_enter = t0;
+        entered = 1;
+    }
+    if (t1 < *t_exit) {
+        *t_exit = t1;
+    }
+    return entered;
+}
+
+/* Grid cell holding a 16.16 coordinate, clamped to [0, extent) */
+static s32 ray_cell(s64 pos, s32 grid_origin, s32 extent) {
+    s32 cell = (s32)(pos >> 20) - grid_origin;
+
+    if (cell < 0) cell = 0;
+    if (cell > extent - 1) cell = extent - 1;
+    return cell;
+}
+
+static int ray_trace(const LevelCollision* col, u32 classes, const LevelCollisionRay* ray,
+                     LevelCollisionRayHit* hit) {
+    s64 t_enter = 0, t_exit = RAY_T_ONE;
+    s64 t;
+    int clip_x, clip_y;
+    RayAxis ax, ay;
+    s8 nx = 0, ny = 0;
+
+    memset(hit, 0, sizeof(LevelCollisionRayHit));
+    if (!col->data || !classes || col->width <= 0 || col->height <= 0) {
+        return 0;
+    }
+
+    /* Skip straight to where the segment enters the grid */
+    clip_x = ray_clip(ray->origin_x, ray->delta_x, (s64)col->offset_x << 20,
+                      (s64)(col->offset_x + col->width) << 20, &t_enter, &t_exit);
+    clip_y = ray_clip(ray->origin_y, ray->delta_y, (s64)col->offset_y << 20,
+                      (s64)(col->offset_y + col->height) << 20, &t_enter, &t_exit);
+    if (clip_x < 0 || clip_y < 0 || t_enter > t_exit) {
+        return 0;
+    }
+
+    t = t_enter;
+    ray_axis(&ax, ray_cell(ray_at(ray->origin_x, ray->delta_x, t), col->offset_x, col->width),
+             col->offset_x, ray->origin_x, ray->delta_x);
+    ray_axis(&ay, ray_cell(ray_at(ray->origin_y, ray->delta_y, t), col->offset_y, col->height),
+             col->offset_y, ray->origin_y, ray->delta_y);
+    if (t > 0) {
+        /* Started off the grid: the slab clipped last is the face crossed */
+        if (clip_y > 0) {
+            ny = (s8)-ay.step;
+        } else {
+            nx = (s8)-ax.step;
+        }
+    }
+
+    for (;;) {
+        u8 attr = col->data[(u32)ay.cell * (u32)col->width + (u32)ax.cell];
+
+        if (LevelCollision_GetClasses(attr) & classes) {
+            u64 len_sq = (u64)((s64)ray->delta_x * ray->delta_x) +
+                         (u64)((s64)ray->delta_y * ray->delta_y);
+
+            hit->tile_x = ax.cell + col->offset_x;
+            hit->tile_y = ay.cell + col->offset_y;
+            hit->x = (fixed32)ray_at(ray->origin_x, ray->delta_x, t);
+            hit->y = (fixed32)ray_at(ray->origin_y, ray->delta_y, t);
+            /* The face crossed is exact; only the other coordinate rounds */
+            if (nx) hit->x = (hit->tile_x + (nx > 0)) << 20;
+            if (ny) hit->y = (hit->tile_y + (ny > 0)) << 20;
+            hit->fraction = (fixed32)(t >> (RAY_T_SHIFT - 16));
+            hit->distance = (fixed32)(((s64)isqrt64(len_sq) * t) >> RAY_T_SHIFT);
+            hit->normal_x = nx;
+            hit->normal_y = ny;
+            hit->attr = attr;
+            return 1;
+        }
+
+        /* Step into whichever neighbour the ray reaches first */
+        if (ax.t_next < ay.t_next) {
+            t = ax.t_next;
+            ax.cell += ax.step;
+            ax.t_next += ax.t_delta;
+            nx = (s8)-ax.step;
+            ny = 0;
+            if ((u32)ax.cell >= (u32)col->width) return 0;
+        } else {
+            t = ay.t_next;
+            ay.cell += ay.step;
+            ay.t_next += ay.t_delta;
+            nx = 0;
+            ny = (s8)-ay.step;
+            if ((u32)ay.cell >= (u32)col->height) return 0;
+        }
+        if (t > RAY_T_ONE) {
+            return 0;
+        }
+    }
+}
+
+/* -----------------------------------------------------------------------------
+ * Collision Queries
+ * -------------------------------------------------------------------------- */
+
+u8 LevelCollision_GetAttribute(const LevelContext* ctx, s32 pixel_x, s32 pixel_y) {
+    if (!ctx) {
+        return 0;
+    }
+    return cell_at(&ctx->collision, pixel_x >> 4, pixel_y >> 4);
+}
+
+u32 LevelCollision_GetAttributes(const LevelContext* ctx, const LevelCollisionPoint* points,
+                                 u32 count, u8* out_attrs) {
+    LevelCollision col;
+    u32 solid = 0;
+    u32 i;
+
+    if (!ctx || !points || !out_attrs) {
+        return 0;
+    }
+
+    col = ctx->collision;   /* Keep the grid in registers across the loop */
+    for (i = 0; i < count; i++) {
+        u8 attr = cell_at(&col, points[i].x >> 4, points[i].y >> 4);
+
+        out_attrs[i] = attr;
+        solid += LEVEL_COLLISION_IS_SOLID(attr);
+    }
+    return solid;
+}
+
+s32 LevelCollision_SweepX(const LevelContext* ctx, s32 left, s32 top, s32 width, s32 height,
+                          s32 dx, LevelCollisionHit* out_hit) {
+    CollisionAxis ax, ay;
+    LevelCollisionHit hit = {0, 0, 0, {0, 0, 0}};
+    s32 moved;
+
+    if (!ctx || width <= 0 || height <= 0) {
+        if (out_hit) *out_hit = hit;
+        return 0;
+    }
+
+    get_axes(&ctx->collision, &ax, &ay);
+    moved = sweep(&ctx->collision, &ax, &ay, dx > 0 ? left + width - 1 : left,
+                  top, top + height - 1, dx, &hit.tile_x, &hit.tile_y, &hit.attr);
+    if (out_hit) *out_hit = hit;
+    return moved;
+}
+
+s32 LevelCollision_SweepY(const LevelContext* ctx, s32 left, s32 top, s32 width, s32 height,
+                          s32 dy, LevelCollisionHit* out_hit) {
+    CollisionAxis ax, ay;
+    LevelCollisionHit hit = {0, 0, 0, {0, 0, 0}};
+    s32 moved;
+
+    if (!ctx || width <= 0 || height <= 0) {
+        if (out_hit) *out_hit = hit;
+        return 0;
+    }
+
+    get_axes(&ctx->collision, &ax, &ay);
+    moved = sweep(&ctx->collision, &ay, &ax, dy > 0 ? top + height - 1 : top,
+                  left, left + width - 1, dy, &hit.tile_y, &hit.tile_x, &hit.attr);
+    if (out_hit) *out_hit = hit;
+    return moved;
+}
+
+/* -----------------------------------------------------------------------------
+ * Class Queries
+ * -------------------------------------------------------------------------- */
+
+u32 LevelCollision_GetClasses(u8 attr) {
+    u32 classes = 0;
+
+    if (LEVEL_COLLISION_IS_SOLID(attr)) {
+        classes |= LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_SOLID);
+    } else if (attr != LEVEL_COLLISION_EMPTY) {
+        classes |= LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_TRIGGER);
+    }
+    if (attr == 0x5B) {
+        classes |= LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_PLATFORM);
+    }
+    if (attr == 0x2A) {
+        classes |= LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_HAZARD);
+    }
+    if (attr >= 0xDD && attr <= 0xDF) {
+        classes |= LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_BOUNCE);
+    }
+    return classes;
+}
+
+int LevelCollision_IsSpanClear(const LevelContext* ctx, u32 classes,
+                               s32 tile_x, s32 tile_y, s32 count) {
+    const LevelCollision* col;
+    const u64* planes[LEVEL_COLLISION_CLASS_COUNT];
+    u32 plane_count;
+    s32 x0, x1, y;
+
+    if (!ctx || count <= 0) {
+        return 1;
+    }
+    col = &ctx->collision;
+    plane_count = col->planes ? gather_planes(col, classes, planes) : 0;
+    if (plane_count == 0) {
+        return 1;
+    }
+
+    x0 = tile_x - col->offset_x;
+    x1 = x0 + count - 1;
+    y = tile_y - col->offset_y;
+    if (x0 < 0) x0 = 0;
+    if (x1 > col->width - 1) x1 = col->width - 1;
+    if ((u32)y >= (u32)col->height || x0 > x1) {
+        return 1;
+    }
+    return row_scan(col, planes, plane_count, y, x0, x1) < 0;
+}
+
+s32 LevelCollision_FindGround(const LevelContext* ctx, u32 classes, s32 left, s32 width,
+                              s32 pixel_y, s32 max_rows, LevelCollisionHit* out_hit) {
+    LevelCollisionHit hit = {0, 0, 0, {0, 0, 0}};
+    const LevelCollision* col;
+    const u64* planes[LEVEL_COLLISION_CLASS_COUNT];
+    u32 plane_count;
+    s32 x0, x1, y, y_end;
+
+    if (out_hit) *out_hit = hit;
+    if (!ctx || width <= 0) {
+        return -1;
+    }
+    col = &ctx->collision;
+    plane_count = col->planes ? gather_planes(col, classes, planes) : 0;
+    if (plane_count == 0) {
+        return -1;
+    }
+
+    /* Clamp to the grid - everything outside it is empty */
+    x0 = (left >> 4) - col->offset_x;
+    x1 = ((left + width - 1) >> 4) - col->offset_x;
+    y = (pixel_y >> 4) - col->offset_y;
+    y_end = col->height - 1;
+    if (max_rows > 0 && y + max_rows - 1 < y_end) {
+        y_end = y + max_rows - 1;
+    }
+    if (x0 < 0) x0 = 0;
+    if (x1 > col->width - 1) x1 = col->width - 1;
+    if (y < 0) y = 0;
+    if (x0 > x1) {
+        return -1;
+    }
+
+    for (; y <= y_end; y++) {
+        s32 x = row_scan(col, planes, plane_count, y, x0, x1);
+
+        if (x >= 0) {
+            hit.tile_x = x + col->offset_x;
+            hit.tile_y = y + col->offset_y;
+            hit.attr = col->data[(u32)y * (u32)col->width + (u32)x];
+            if (out_hit) *out_hit = hit;
+            return hit.tile_y * 16;
+        }
+    }
+    return -1;
+}
+
+s32 LevelCollision_FindBelow(const LevelContext* ctx, u32 classes, s32 pixel_x, s32 pixel_y,
+                             s32 max_rows, LevelCollisionHit* out_hit) {
+    return LevelCollision_FindGround(ctx, classes, pixel_x, 1, pixel_y, max_rows, out_hit);
+}
+
+/* -----------------------------------------------------------------------------
+ * Ray Queries
+ * -------------------------------------------------------------------------- */
+
+int LevelCollision_Raycast(const LevelContext* ctx, u32 classes,
+                           const LevelCollisionRay* ray, LevelCollisionRayHit* out_hit) {
+    LevelCollisionRayHit hit;
+    int result;
+
+    if (!ctx || !ray) {
+        if (out_hit) memset(out_hit, 0, sizeof(LevelCollisionRayHit));
+        return 0;
+    }
+    result = ray_trace(&ctx->collision, classes, ray, &hit);
+    if (out_hit) *out_hit = hit;
+    return result;
+}
+
+u32 LevelCollision_Raycasts(const LevelContext* ctx, u32 classes,
+                            const LevelCollisionRay* rays, u32 count,
+                            LevelCollisionRayHit* out_hits) {
+    u32 keys[RAY_BLOCK];
+    u32 hits = 0;
+    u32 base;
+
+    if (!ctx || !rays || !out_hits) {
+        return 0;
+    }
+
+    for (base = 0; base < count; base += RAY_BLOCK) {
+        u32 n = count - base < RAY_BLOCK ? count - base : RAY_BLOCK;
+        u32 i, j;
+
+        /* Key: origin tile row, then column (12 bits each), then index */
+        for (i = 0; i < n; i++) {
+            const LevelCollisionRay* ray = &rays[base + i];
+            u32 row = (u32)((ray->origin_y >> 20) + 2048) & 0xFFF;
+            u32 column = (u32)((ray->origin_x >> 20) + 2048) & 0xFFF;
+            u32 key = (((row << 12) | column) << RAY_BLOCK_SHIFT) | i;
+
+            /* Insertion sort - blocks are small and often nearly sorted */
+            for (j = i; j > 0 && keys[j - 1] > key; j--) {
+                keys[j] = keys[j - 1];
+            }
+            keys[j] = key;
+        }
+
+        for (i = 0; i < n; i++) {
+            u32 index = base + (keys[i] & (RAY_BLOCK - 1));
+            hits += (u32)ray_trace(&ctx->collision, classes, &rays[index], &out_hits[index]);
+        }
+    }
+    return hits;
+}
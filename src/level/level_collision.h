@@ -0,0 +1,188 @@
+/**
+ * level_collision.h - Tile collision queries (Asset 500)
+ *
+ * Point, batch and swept-box lookups against the collision grid that
+ * Level_Load resolves into LevelContext.collision. Physics calls these
+ * several times per entity per frame, so none of them allocate and the
+ * per-cell work is a bounds check and a load.
+ *
+ * Coordinates are world pixels; a cell covers 16x16 pixels, as in
+ * GetTileAttributeAtPosition @ 0x800241f4. Cells outside the grid read
+ * as 0 (empty).
+ *
+ * Span and ground queries run on the class bitplanes Level_Load packs
+ * from the grid (LevelCollision.planes): a row of up to 64 cells is one
+ * word per class, so scanning a hitbox's width costs a load, a mask and
+ * a count-trailing-zeros instead of a byte loop.
+ *
+ * TOOL-ONLY: Batch, sweep, span and ray queries; the original game probes
+ * single points (CheckWallCollision @ 0x80059bc8 tests four per side).
+ */
+
+#ifndef LEVEL_COLLISION_H
+#define LEVEL_COLLISION_H
+
+#include "../psx/types.h"
+#include "level.h"
+
+/* Attribute ranges (PlayerCallback @ 0x800638d0: floor if 1..0x3B) */
+#define LEVEL_COLLISION_EMPTY       0x00
+#define LEVEL_COLLISION_SOLID_MAX   0x3B    /* 0x3C+ are trigger zones */
+
+/* True for 0x01..0x3B; one compare, no branch */
+#define LEVEL_COLLISION_IS_SOLID(attr) \
+    ((u8)((attr) - 1) < LEVEL_COLLISION_SOLID_MAX)
+
+/*
+ * Attribute classes, one bitplane each. Classes overlap: 0x2A is solid
+ * and a hazard, 0xDE is a trigger and a bounce surface.
+ */
+#define LEVEL_COLLISION_CLASS_SOLID     0   /* 0x01..0x3B: floors and walls */
+#define LEVEL_COLLISION_CLASS_PLATFORM  1   /* 0x5B: one-way cloud platform */
+#define LEVEL_COLLISION_CLASS_HAZARD    2   /* 0x2A: death zone */
+#define LEVEL_COLLISION_CLASS_BOUNCE    3   /* 0xDD..0xDF (FUN_8005a630) */
+#define LEVEL_COLLISION_CLASS_TRIGGER   4   /* 0x3C+: any trigger zone */
+#define LEVEL_COLLISION_CLASS_COUNT     5
+
+/* Class sets for the span queries */
+#define LEVEL_COLLISION_MASK(cls)       (1u << (cls))
+#define LEVEL_COLLISION_MASK_SOLID      LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_SOLID)
+#define LEVEL_COLLISION_MASK_GROUND     (LEVEL_COLLISION_MASK_SOLID | \
+                                         LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_PLATFORM))
+
+typedef struct {
+    s32 x;
+    s32 y;
+} LevelCollisionPoint;
+
+/* First cell met by a sweep or ground query */
+typedef struct {
+    s32 tile_x;             /* World tile (valid when attr != 0) */
+    s32 tile_y;
+    u8  attr;               /* Its attribute, 0 if nothing was met */
+    u8  pad[3];
+} LevelCollisionHit;
+
+/*
+ * Ray segment in 16.16 world pixels, from origin to origin + delta.
+ * Projectile velocities are already 16.16 (SpawnProjectileEntity), so a
+ * frame's movement can be cast as-is.
+ */
+typedef struct {
+    fixed32 origin_x;
+    fixed32 origin_y;
+    fixed32 delta_x;        /* Segment end minus origin */
+    fixed32 delta_y;
+} LevelCollisionRay;
+
+/* First cell a ray enters */
+typedef struct {
+    s32     tile_x;         /* World tile (valid when attr != 0) */
+    s32     tile_y;
+    fixed32 x;              /* Entry point, 16.16 pixels */
+    fixed32 y;
+    fixed32 fraction;       /* Of delta travelled, 0..ONE_F32 */
+    fixed32 distance;       /* Pixels travelled, 16.16 */
+    s8      normal_x;       /* Face entered through: -1/0/1, 0/0 if the */
+    s8      normal_y;       /* ray started inside the cell */
+    u8      attr;           /* Cell attribute, 0 if the ray missed */
+    u8      pad;
+} LevelCollisionRayHit;
+
+/**
+ * Get the collision attribute under a pixel.
+ * Matches GetTileAttributeAtPosition @ 0x800241f4.
+ * @return              Attribute byte, 0 outside the grid or without Asset 500
+ */
+u8 LevelCollision_GetAttribute(const LevelContext* ctx, s32 pixel_x, s32 pixel_y);
+
+/**
+ * Look up many points in one call.
+ * @param out_attrs     Output: one attribute per point
+ * @return              Number of points on a solid attribute
+ */
+u32 LevelCollision_GetAttributes(const LevelContext* ctx, const LevelCollisionPoint* points,
+                                 u32 count, u8* out_attrs);
+
+/**
+ * Move a box horizontally until it would enter a solid cell.
+ * Steps one tile column at a time; cells the box already overlaps are
+ * ignored, so a box embedded in a wall can still move out of it.
+ * @param left, top     Box position in pixels
+ * @param width, height Box size in pixels (> 0)
+ * @param dx            Requested move in pixels (sign = direction)
+ * @param out_hit       Output: first solid cell (optional)
+ * @return              Pixels the box can move, same sign as dx
+ */
+s32 LevelCollision_SweepX(const LevelContext* ctx, s32 left, s32 top, s32 width, s32 height,
+                          s32 dx, LevelCollisionHit* out_hit);
+
+/**
+ * Move a box vertically until it would enter a solid cell.
+ * Same rules as LevelCollision_SweepX, stepping one tile row at a time.
+ * @param dy            Requested move in pixels (positive = down)
+ * @return              Pixels the box can move, same sign as dy
+ */
+s32 LevelCollision_SweepY(const LevelContext* ctx, s32 left, s32 top, s32 width, s32 height,
+                          s32 dy, LevelCollisionHit* out_hit);
+
+/**
+ * Get the classes an attribute belongs to.
+ * @return              LEVEL_COLLISION_MASK bits, 0 for empty
+ */
+u32 LevelCollision_GetClasses(u8 attr);
+
+/**
+ * Check a horizontal run of cells against a class set.
+ * @param classes       LEVEL_COLLISION_MASK bits to look for
+ * @param tile_x, tile_y First cell, in world tiles
+ * @param count         Cells to the right, including the first
+ * @return              1 if no cell in the run is in any class, else 0
+ */
+int LevelCollision_IsSpanClear(const LevelContext* ctx, u32 classes,
+                               s32 tile_x, s32 tile_y, s32 count);
+
+/**
+ * Find the ground under a hitbox: the first tile row, starting with the
+ * one holding pixel_y and going down, with a cell in any class between
+ * the box's left and right edges.
+ * @param classes       LEVEL_COLLISION_MASK bits, usually _MASK_GROUND
+ * @param left, width   Box columns in pixels (width > 0)
+ * @param pixel_y       Where to start, usually the box's bottom edge
+ * @param max_rows      Rows to search (<= 0 = to the bottom of the grid)
+ * @param out_hit       Output: leftmost matching cell of that row (optional)
+ * @return              Pixel Y of the row's top edge, or -1 if none
+ */
+s32 LevelCollision_FindGround(const LevelContext* ctx, u32 classes, s32 left, s32 width,
+                              s32 pixel_y, s32 max_rows, LevelCollisionHit* out_hit);
+
+/**
+ * Find the first cell in a class set at or below a pixel.
+ * Same as LevelCollision_FindGround for a one-pixel-wide box.
+ */
+s32 LevelCollision_FindBelow(const LevelContext* ctx, u32 classes, s32 pixel_x, s32 pixel_y,
+                             s32 max_rows, LevelCollisionHit* out_hit);
+
+/**
+ * Cast a ray through the grid (Amanatides-Woo DDA, fixed point only) and
+ * stop at the first cell in a class set. The segment is clipped to the grid
+ * first, so long rays cost only the cells they cross on it.
+ * @param classes       LEVEL_COLLISION_MASK bits that block the ray
+ * @param out_hit       Output: first blocking cell (optional)
+ * @return              1 if the ray hit, 0 if its whole length is clear
+ */
+int LevelCollision_Raycast(const LevelContext* ctx, u32 classes,
+                           const LevelCollisionRay* ray, LevelCollisionRayHit* out_hit);
+
+/**
+ * Cast many rays. They are traced in origin order (row, then column) in
+ * blocks, so rays that start close together walk the same grid rows back
+ * to back; results still land at each ray's own index.
+ * @param out_hits      Output: one hit per ray
+ * @return              Number of rays that hit
+ */
+u32 LevelCollision_Raycasts(const LevelContext* ctx, u32 classes,
+                            const LevelCollisionRay* rays, u32 count,
+                            LevelCollisionRayHit* out_hits);
+
+#endif /* LEVEL_COLLISION_H */
@@ -123,29 +123,35 @@ typedef s32 fixed32;    /* 16.16 fixed point */
  * PSX Color Conversion
  * 
  * PSX uses 15-bit BGR format: 0BBBBBGGGGGRRRRR (bit 15 = semi-transparent flag)
- * Each component is 5 bits (0-31), mapping to 8-bit (0-248 with rounding).
+ * Each component is 5 bits (0-31), mapping to 8-bit (0-248).
+ * 
+ * Alpha policy - every RGBA path follows it, through the palette LUTs
+ * built by psx_palette_to_rgba:
+ *   colour 0x0000     transparent (the GPU never draws it from a texture)
+ *   palette index 0   transparent with PSX_RGBA_INDEX0_CLEAR (sprite RLE
+ *                     gaps are index 0 whatever colour it holds)
+ *   bit 15 (STP)      opaque, or alpha 0x80 with PSX_RGBA_SEMI (drawn in a
+ *                     semi-transparent primitive, e.g. Asset 302 bit 0);
+ *                     0x8000 is opaque black, not transparent
  * -------------------------------------------------------------------------- */
 
+#define PSX_RGBA_INDEX0_CLEAR   0x01
+#define PSX_RGBA_SEMI           0x02
+
 /**
  * Convert PSX 15-bit color to 32-bit RGBA.
  * @param psx_color  15-bit PSX color (0BBBBBGGGGGRRRRR)
- * @return           32-bit RGBA (0xAABBGGRR in little-endian)
+ * @return           32-bit RGBA (0xAABBGGRR in little-endian), alpha 0 for
+ *                   0x0000 and 255 otherwise
  */
 static inline u32 psx_color_to_rgba(u16 psx_color)
 {
-    /* Extract 5-bit components */
-    u8 r5 = (psx_color >>  0) & 0x1F;
-    u8 g5 = (psx_color >>  5) & 0x1F;
-    u8 b5 = (psx_color >> 10) & 0x1F;
-    
-    /* Convert to 8-bit: shift left 3 and replicate top bits for rounding */
-    u8 r = (r5 << 3) | (r5 >> 2);
-    u8 g = (g5 << 3) | (g5 >> 2);
-    u8 b = (b5 << 3) | (b5 >> 2);
+    u32 r = (psx_color >>  0) & 0x1F;
+    u32 g = (psx_color >>  5) & 0x1F;
+    u32 b = (psx_color >> 10) & 0x1F;
+    u32 a = (psx_color == 0) ? 0 : 0xFF;
     
-    /* Alpha is always 255 (opaque) for non-transparent pixels */
-    /* Caller handles transparency via color index 0 or semi-trans flag */
-    return (u32)r | ((u32)g << 8) | ((u32)b << 16) | (0xFF << 24);
+    return (r << 3) | (g << 11) | (b << 19) | (a << 24);
 }
 
 /**
@@ -162,6 +168,31 @@ static inline u32 psx_color_to_rgba_alpha(u16 psx_color, int is_transparent)
     return psx_color_to_rgba(psx_color);
 }
 
+/**
+ * Convert a 256-colour palette to an RGBA lookup table, so renderers do
+ * one load per pixel.
+ * @param palette    256 PSX colours (512 bytes, little-endian)
+ * @param flags      PSX_RGBA_* bits
+ * @param out_lut    Output: u32[256], 0xAABBGGRR
+ */
+static inline void psx_palette_to_rgba(const u8* palette, u32 flags, u32* out_lut)
+{
+    u32 i;
+    
+    for (i = 0; i < 256; i++) {
+        u16 color = (u16)(palette[i * 2] | (palette[i * 2 + 1] << 8));
+        u32 rgba = psx_color_to_rgba(color);
+        
+        if ((flags & PSX_RGBA_SEMI) && (color & 0x8000)) {
+            rgba = (rgba & 0x00FFFFFF) | 0x80000000;
+        }
+        out_lut[i] = rgba;
+    }
+    if (flags & PSX_RGBA_INDEX0_CLEAR) {
+        out_lut[0] = 0;
+    }
+}
+
 /**
  * Convert 32-bit RGBA to PSX 15-bit color.
  * @param rgba  32-bit RGBA (0xAABBGGRR)
@@ -5,6 +5,7 @@
  */
 
 #include "render.h"
+#include "render_kernels.h"
 #include <string.h>
 
 /* -----------------------------------------------------------------------------
@@ -33,6 +34,17 @@ const u16* GetPaletteDataPtr(const LevelContext* ctx, u8 palette_index) {
         return NULL;
     }
     
+    /* Original trusts the index; do the same only on a validated archive */
+    if (!BLB_IS_TRUSTED(ctx->blb)) {
+        u32 size;
+        const u8* palette = BLB_GetSubAsset(container, ctx->palette_container_size,
+                                            palette_index, &size);
+        return (palette && size >= 512) ? (const u16*)palette : NULL;
+    }
+    if (palette_index >= ctx->palette_count) {
+        return NULL;
+    }
+    
     /* Sub-TOC entry: 12 bytes per entry, offset at +8 within entry */
     /* First 4 bytes of container is count, entries start at +4 */
     /* Entry[n] at: container + 4 + n * 12 */
@@ -58,6 +70,25 @@ const u16* GetTilemapDataPtr(const LevelContext* ctx, u32 layer_index) {
         return NULL;
     }
     
+    /* Untrusted: entry must exist and hold width * height tiles */
+    if (!BLB_IS_TRUSTED(ctx->blb)) {
+        u32 size;
+        const u8* tilemap = BLB_GetSubAsset(container, ctx->tilemap_container_size,
+                                            layer_index, &size);
+        if (!tilemap) {
+            return NULL;
+        }
+        if (ctx->layer_entries && layer_index < ctx->layer_count &&
+            (u32)ctx->layer_entries[layer_index].width *
+            ctx->layer_entries[layer_index].height * 2 > size) {
+            return NULL;
+        }
+        return (const u16*)tilemap;
+    }
+    if (layer_index >= ctx->tilemap_count) {
+        return NULL;
+    }
+    
     /* Same sub-TOC pattern as palette container */
     /* Entry[n] at: container + 4 + n * 12 */
     /* Offset within entry at: entry + 8 */
@@ -68,31 +99,17 @@ const u16* GetTilemapDataPtr(const LevelContext* ctx, u32 layer_index) {
 
 /* -----------------------------------------------------------------------------
  * GetTilePixelDataPtr
- * Based on CopyTilePixelData @ 0x8007b588 layout calculations
+ * Based on CopyTilePixelData @ 0x8007b588 layout calculations.
+ * The 16x16/8x8 offset split is precomputed per tile by Level_Load.
  * -------------------------------------------------------------------------- */
 
 const u8* GetTilePixelDataPtr(const LevelContext* ctx, u16 tile_index) {
-    u32 count_16x16;
-    u32 idx;
-    const u8* base;
-    
-    if (!ctx->tile_pixels || !ctx->tile_header || tile_index == 0) {
+    if (!ctx->tile_pixels || tile_index == 0 || tile_index > ctx->total_tiles) {
         return NULL;
     }
     
-    base = ctx->tile_pixels;
-    idx = tile_index - 1;  /* tile_index is 1-based */
-    count_16x16 = ctx->tile_header->count_16x16;
-    
-    if (idx < count_16x16) {
-        /* 16x16 tile: 256 bytes each */
-        return base + (idx * 0x100);
-    } else {
-        /* 8x8 tile: 128 bytes each, after all 16x16 tiles */
-        /* Note: Original uses count_16x16 * 0x80 + idx * 0x80 */
-        /* which is equivalent to (count_16x16 + idx - count_16x16) * 0x80 */
-        return base + (count_16x16 * 0x100) + ((idx - count_16x16) * 0x80);
-    }
+    /* tile_index is 1-based */
+    return ctx->tile_pixels + ctx->lut_pixel_offset[tile_index - 1];
 }
 
 /* -----------------------------------------------------------------------------
@@ -110,12 +127,12 @@ const u8* GetTilePixelDataPtr(const LevelContext* ctx, u16 tile_index) {
  *       dest += stride;
  *       src += row_width;
  *   return 1;
+ * 
+ * Source offset and row width come from the Level_Load tile tables.
  * -------------------------------------------------------------------------- */
 
 int CopyTilePixelData(const LevelContext* ctx, u16 tile_index, 
                       u8* dest, u16 dest_stride) {
-    u32 count_16x16;
-    u32 idx;
     const u8* src;
     int row_width;
     u16 row;
@@ -124,20 +141,12 @@ int CopyTilePixelData(const LevelContext* ctx, u16 tile_index,
         return 0;
     }
     
-    if (!ctx->tile_pixels || !ctx->tile_header) {
+    if (!ctx->tile_pixels || tile_index > ctx->total_tiles) {
         return 0;
     }
     
-    idx = tile_index - 1;
-    count_16x16 = ctx->tile_header->count_16x16;
-    
-    if (idx < count_16x16) {
-        src = ctx->tile_pixels + (idx * 0x100);
-        row_width = 16;
-    } else {
-        src = ctx->tile_pixels + (count_16x16 * 0x100) + ((idx - count_16x16) * 0x80);
-        row_width = 8;
-    }
+    src = ctx->tile_pixels + ctx->lut_pixel_offset[tile_index - 1];
+    row_width = ctx->lut_is_8x8[tile_index - 1] ? 8 : 16;
     
     /* Copy 16 rows (8 rows for 8x8 tiles, but we copy 16 anyway per original) */
     for (row = 0; row < 16; row++) {
@@ -154,78 +163,76 @@ int CopyTilePixelData(const LevelContext* ctx, u16 tile_index,
  * Convert indexed tile to RGBA for display (helper for Godot wrapper)
  * -------------------------------------------------------------------------- */
 
-int RenderTileToRGBA(const LevelContext* ctx, u16 tile_index,
-                     u8* out_rgba, int* out_width, int* out_height) {
-    const u8* pixels;
-    const u16* palette;
-    u8 palette_index;
+/* Pixels (16-byte rows), RGBA LUT and edge length of a 1-based tile */
+static int get_tile_source(const LevelContext* ctx, u16 tile_index,
+                           const u8** out_pixels, const u32** out_lut, int* out_size) {
+    u32 idx;
     int is_8x8;
-    int width, height;
-    int x, y;
-    u32 rgba;
     
-    if (!ctx || tile_index == 0 || !out_rgba) {
+    if (!ctx->tile_pixels || tile_index == 0 || tile_index > ctx->total_tiles) {
         return -1;
     }
+    idx = tile_index - 1;
     
-    /* Get palette for this tile */
-    if (!ctx->palette_indices || tile_index > ctx->total_tiles) {
-        return -1;
-    }
-    palette_index = ctx->palette_indices[tile_index - 1];
-    palette = GetPaletteDataPtr(ctx, palette_index);
-    if (!palette) {
+    /* RGBA palette, pixels and size all come from the Level_Load tile tables */
+    *out_lut = ctx->lut_rgba[idx];
+    if (!*out_lut) {
         return -1;
     }
+    *out_pixels = ctx->tile_pixels + ctx->lut_pixel_offset[idx];
+    
+    /* Asset 302 decides the size when present, else the 16x16/8x8 split */
+    is_8x8 = ctx->tile_flags ? (ctx->lut_flags[idx] & TILE_FLAG_8X8) != 0
+                             : ctx->lut_is_8x8[idx];
+    *out_size = is_8x8 ? 8 : 16;
+    return 0;
+}
+
+int RenderTileToRGBA(const LevelContext* ctx, u16 tile_index,
+                     u8* out_rgba, int* out_width, int* out_height) {
+    const u8* pixels;
+    const u32* lut;
+    int size;
     
-    /* Get pixel data */
-    pixels = GetTilePixelDataPtr(ctx, tile_index);
-    if (!pixels) {
+    if (!ctx || !out_rgba || get_tile_source(ctx, tile_index, &pixels, &lut, &size) != 0) {
         return -1;
     }
     
-    /* Determine tile size */
-    is_8x8 = 0;
-    if (ctx->tile_flags && tile_index <= ctx->total_tiles) {
-        is_8x8 = (ctx->tile_flags[tile_index - 1] & TILE_FLAG_8X8) != 0;
-    } else if (ctx->tile_header && (tile_index - 1) >= ctx->tile_header->count_16x16) {
-        is_8x8 = 1;
-    }
+    if (out_width) *out_width = size;
+    if (out_height) *out_height = size;
     
-    width = is_8x8 ? 8 : 16;
-    height = is_8x8 ? 8 : 16;
+    /* Source rows keep a 16-byte stride even for 8x8 */
+    RenderKernel_ExpandRect(pixels, 16, lut, out_rgba, (u32)size * 4, (u32)size, (u32)size, 0);
+    return 0;
+}
+
+int RenderTileRectToRGBA(const LevelContext* ctx, u16 tile_index, int src_x, int src_y,
+                         int width, int height, u8* out_rgba, u32 dst_stride) {
+    const u8* pixels;
+    const u32* lut;
+    u8 coverage;
+    int size;
     
-    if (out_width) *out_width = width;
-    if (out_height) *out_height = height;
+    if (!ctx || !out_rgba || src_x < 0 || src_y < 0 ||
+        get_tile_source(ctx, tile_index, &pixels, &lut, &size) != 0) {
+        return 0;
+    }
+    coverage = ctx->lut_coverage[tile_index - 1];
+    if (coverage == LEVEL_TILE_CLEAR) {
+        return 0;
+    }
     
-    /* Convert indexed pixels to RGBA */
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            u8 color_index;
-            u16 psx_color;
-            int src_offset, dst_offset;
-            
-            /* Source layout: row-major, 8 or 16 bytes per row */
-            if (is_8x8) {
-                src_offset = y * 16 + x;  /* 16-byte stride even for 8x8 */
-            } else {
-                src_offset = y * 16 + x;
-            }
-            
-            color_index = pixels[src_offset];
-            psx_color = palette[color_index];
-            rgba = PSXColorToRGBA(psx_color);
-            
-            /* Output: RGBA format */
-            dst_offset = (y * width + x) * 4;
-            out_rgba[dst_offset + 0] = (rgba >>  0) & 0xFF;  /* R */
-            out_rgba[dst_offset + 1] = (rgba >>  8) & 0xFF;  /* G */
-            out_rgba[dst_offset + 2] = (rgba >> 16) & 0xFF;  /* B */
-            out_rgba[dst_offset + 3] = (rgba >> 24) & 0xFF;  /* A */
-        }
+    if (width > size - src_x) width = size - src_x;
+    if (height > size - src_y) height = size - src_y;
+    if (width <= 0 || height <= 0) {
+        return 0;
     }
     
-    return 0;
+    /* Solid tiles are plain row copies; mixed ones keep the destination
+     * under alpha-0 pixels */
+    RenderKernel_ExpandRect(pixels + src_y * 16 + src_x, 16, lut, out_rgba, dst_stride,
+                            (u32)width, (u32)height, coverage != LEVEL_TILE_SOLID);
+    return 1;
 }
 
 /* -----------------------------------------------------------------------------
@@ -249,17 +256,23 @@ void GetLayerPixelDimensions(const LevelContext* ctx, u32 layer_index,
 
 /* -----------------------------------------------------------------------------
  * RenderLayerToRGBA
- * Render an entire layer to an RGBA buffer
+ * Render an entire layer to an RGBA buffer.
+ * Only the occupied chunks of the layer's chunked view are visited, and
+ * each tile's rows are expanded straight into the buffer.
  * -------------------------------------------------------------------------- */
 
+static u32 min_u32(u32 a, u32 b) {
+    return a < b ? a : b;
+}
+
 int RenderLayerToRGBA(const LevelContext* ctx, u32 layer_index,
                       u8* out_rgba, int buf_width, int buf_height) {
     const u16* tilemap;
     const LayerEntry* layer;
+    const LevelLayerChunks* view;
     u32 lw, lh;
-    u32 tx, ty;
-    u8 tile_rgba[16 * 16 * 4];
-    int tile_w, tile_h;
+    u32 cols, rows, stride;
+    u32 i;
     
     if (!ctx || !out_rgba) return -1;
     
@@ -267,47 +280,40 @@ int RenderLayerToRGBA(const LevelContext* ctx, u32 layer_index,
     if (!layer) return -1;
     
     tilemap = GetTilemapDataPtr(ctx, layer_index);
-    if (!tilemap) return -1;
+    view = Level_GetLayerChunks(ctx, layer_index);
+    if (!tilemap || !view) return -1;
     
     lw = layer->width;
     lh = layer->height;
-    
-    for (ty = 0; ty < lh && (ty * 16) < (u32)buf_height; ty++) {
-        for (tx = 0; tx < lw && (tx * 16) < (u32)buf_width; tx++) {
-            u16 tile_entry;
-            u16 tile_index;
-            int px, py;
-            int x, y;
-            
-            tile_entry = tilemap[ty * lw + tx];
-            tile_index = tile_entry & 0xFFF;  /* bits 0-11 (12 bits) */
-            
-            if (tile_index == 0) continue;  /* transparent */
-            
-            /* Render tile to temporary buffer */
-            if (RenderTileToRGBA(ctx, tile_index, tile_rgba, &tile_w, &tile_h) != 0) {
-                continue;
-            }
-            
-            /* Copy to output image */
-            px = tx * 16;
-            py = ty * 16;
+    if (buf_width <= 0 || buf_height <= 0) return 0;
+    
+    /* Cells that reach the buffer; only the last column and row can clip */
+    cols = min_u32(lw, ((u32)buf_width + 15) / 16);
+    rows = min_u32(lh, ((u32)buf_height + 15) / 16);
+    stride = (u32)buf_width * 4;
+    
+    for (i = 0; i < view->occupied_count; i++) {
+        u32 c = view->occupied[i];
+        const LevelChunk* chunk = &view->chunks[c];
+        u32 base_x = (c % view->chunks_x) << LEVEL_CHUNK_SHIFT;
+        u32 base_y = (c / view->chunks_x) << LEVEL_CHUNK_SHIFT;
+        u32 x0 = base_x + chunk->x0;
+        u32 x1 = min_u32(base_x + chunk->x1 + 1, cols);
+        u32 y1 = min_u32(base_y + chunk->y1 + 1, rows);
+        u32 tx, ty;
+        
+        for (ty = base_y + chunk->y0; ty < y1; ty++) {
+            const u16* row = tilemap + ty * lw;
+            u8* dst = out_rgba + (size_t)ty * 16 * stride;
+            u32 max_h = (u32)buf_height - ty * 16;
             
-            for (y = 0; y < tile_h && (py + y) < buf_height; y++) {
-                for (x = 0; x < tile_w && (px + x) < buf_width; x++) {
-                    int src_idx = (y * tile_w + x) * 4;
-                    int dst_idx = ((py + y) * buf_width + (px + x)) * 4;
-                    u8 a = tile_rgba[src_idx + 3];
-                    
-                    /* Skip fully transparent pixels */
-                    if (a == 0) continue;
-                    
-                    /* Copy RGBA */
-                    out_rgba[dst_idx + 0] = tile_rgba[src_idx + 0];
-                    out_rgba[dst_idx + 1] = tile_rgba[src_idx + 1];
-                    out_rgba[dst_idx + 2] = tile_rgba[src_idx + 2];
-                    out_rgba[dst_idx + 3] = a;
-                }
+            for (tx = x0; tx < x1; tx++) {
+                u16 tile_index = TILEMAP_TILE(row[tx]);
+                
+                if (tile_index == 0) continue;  /* transparent */
+                RenderTileRectToRGBA(ctx, tile_index, 0, 0,
+                                     buf_width - (int)(tx * 16), (int)max_h,
+                                     dst + (size_t)tx * 16 * 4, stride);
             }
         }
     }
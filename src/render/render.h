@@ -113,7 +113,8 @@ const u16* GetPaletteDataPtr(const LevelContext* ctx, u8 palette_index);
  *   return container + *(int *)(container + layer * 0xc + 0xc);
  * 
  * Returns array of u16 values (width * height).
- * Each u16: bits 0-10 = tile index (1-based, 0=transparent)
+ * Each u16: TILEMAP_TILE() = tile index (1-based, 0=transparent),
+ *           TILEMAP_TINT() = color tint selector (level.h)
  */
 const u16* GetTilemapDataPtr(const LevelContext* ctx, u32 layer_index);
 
@@ -157,14 +158,11 @@ int CopyTilePixelData(const LevelContext* ctx, u16 tile_index,
 
 /**
  * Convert PSX 15-bit color to 32-bit RGBA.
- * Color 0 is typically transparent.
+ * Same as psx_color_to_rgba (alpha policy in psx/types.h); per-pixel
+ * paths use the level's palette LUTs instead.
  */
 static inline u32 PSXColorToRGBA(u16 psx_color) {
-    u8 r = ((psx_color >>  0) & 0x1F) << 3;
-    u8 g = ((psx_color >>  5) & 0x1F) << 3;
-    u8 b = ((psx_color >> 10) & 0x1F) << 3;
-    u8 a = (psx_color == 0) ? 0 : 255;
-    return ((u32)r) | ((u32)g << 8) | ((u32)b << 16) | ((u32)a << 24);
+    return psx_color_to_rgba(psx_color);
 }
 
 /**
@@ -180,6 +178,22 @@ static inline u32 PSXColorToRGBA(u16 psx_color) {
 int RenderTileToRGBA(const LevelContext* ctx, u16 tile_index,
                      u8* out_rgba, int* out_width, int* out_height);
 
+/**
+ * Expand part of a tile over an RGBA image (TOOL-ONLY).
+ * Solid tiles are copied row by row, clear ones draw nothing and mixed
+ * ones leave the destination under alpha-0 pixels (LEVEL_TILE_*).
+ * 
+ * @param ctx           Level context
+ * @param tile_index    1-based tile index
+ * @param src_x, src_y  First tile pixel to draw (>= 0)
+ * @param width, height Pixels available at out_rgba; clipped to the tile
+ * @param out_rgba      Destination of the first drawn pixel
+ * @param dst_stride    Bytes between destination rows
+ * @return              1 if anything was drawn, 0 otherwise
+ */
+int RenderTileRectToRGBA(const LevelContext* ctx, u16 tile_index, int src_x, int src_y,
+                         int width, int height, u8* out_rgba, u32 dst_stride);
+
 /**
  * Render an entire layer to an RGBA buffer.
  * 
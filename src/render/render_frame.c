@@ -0,0 +1,596 @@
+/**
+ * render_frame.c - Camera-window frame compositor
+ *
+ * Each layer is drawn by walking the tile window the camera covers, chunk
+ * by chunk so empty chunks cost one flag test. Tiles go straight into the
+ * framebuffer through RenderTileRectToRGBA; only tiles on the frame edge
+ * are clipped.
+ *
+ * The incremental path walks the same window over the layer's slot ring:
+ * a slot whose tag isn't the cell wanted is refilled, then every slot in
+ * view is copied (solid) or blended (mixed) into the framebuffer. When
+ * all layers moved by the same number of pixels, that only happens for
+ * the strips scrolled into view; the rest of the frame is moved as is.
+ */
+
+#include "render_frame.h"
+#include "render.h"
+#include "render_kernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Layer pixel under the camera for a 16.16 parallax factor */
+static s32 scroll_position(s32 camera, u32 factor) {
+    return (s32)(((s64)camera * (s64)factor) >> 16);
+}
+
+static s32 max_s32(s32 a, s32 b) {
+    return a > b ? a : b;
+}
+
+static s32 min_s32(s32 a, s32 b) {
+    return a < b ? a : b;
+}
+
+/* -----------------------------------------------------------------------------
+ * Setup
+ * -------------------------------------------------------------------------- */
+
+/* Insert before the first layer with the same or a higher priority, as
+ * AddLayerToRenderList_Standard @ 0x80021590 does */
+static void insert_layer(RenderFrame* frame, const RenderFrameLayer* layer) {
+    u32 at = 0;
+
+    while (at < frame->layer_count && frame->layers[at].priority < layer->priority) {
+        at++;
+    }
+    memmove(&frame->layers[at + 1], &frame->layers[at],
+            (frame->layer_count - at) * sizeof(RenderFrameLayer));
+    frame->layers[at] = *layer;
+    frame->layer_count++;
+}
+
+int RenderFrame_Init(RenderFrame* frame, const LevelContext* ctx, int width, int height) {
+    u32 count;
+    u32 i;
+
+    if (!frame) {
+        return -1;
+    }
+    memset(frame, 0, sizeof(RenderFrame));
+    if (!ctx || !ctx->tile_header) {
+        return -1;
+    }
+
+    frame->level = ctx;
+    frame->width = width > 0 ? width : RENDER_FRAME_WIDTH;
+    frame->height = height > 0 ? height : RENDER_FRAME_HEIGHT;
+    frame->rgba = (u8*)malloc((size_t)frame->width * frame->height * 4);
+
+    count = ctx->layer_count;
+    frame->layers = (RenderFrameLayer*)malloc((count ? count : 1) * sizeof(RenderFrameLayer));
+    if (!frame->rgba || !frame->layers) {
+        RenderFrame_Free(frame);
+        return -1;
+    }
+
+    Level_GetBackgroundColor(ctx, &frame->background[0], &frame->background[1],
+                             &frame->background[2]);
+    frame->background[3] = 0xFF;
+    frame->level_width = (s32)ctx->tile_header->level_width * 16;
+    frame->level_height = (s32)ctx->tile_header->level_height * 16;
+
+    for (i = 0; i < count; i++) {
+        const LayerEntry* entry = Level_GetLayer(ctx, i);
+        RenderFrameLayer layer;
+
+        /* InitLayersAndTileState @ 0x80024778 skips these */
+        if (!entry || entry->skip_render != 0 || entry->layer_type == 3) {
+            continue;
+        }
+
+        /* Its flags feed the camera clamps; the offsets are as decompiled
+         * (LayerEntry +0x1E sets GameState +0x59, the right clamp, etc.) */
+        if (entry->scroll_left_enable)  frame->clamp_right = 1;
+        if (entry->scroll_right_enable) frame->clamp_bottom = 1;
+        if (entry->scroll_up_enable)    frame->clamp_left = 1;
+        if (entry->scroll_down_enable)  frame->clamp_top = 1;
+
+        memset(&layer, 0, sizeof(layer));
+        layer.index = i;
+        layer.priority = (s16)(entry->render_param & 0xFFFF);
+        layer.origin_x = (s32)entry->x_offset * 16;
+        layer.origin_y = (s32)entry->y_offset * 16;
+        layer.scroll_x = entry->scroll_x;
+        layer.scroll_y = entry->scroll_y;
+        layer.width = entry->width;
+        layer.height = entry->height;
+        layer.tilemap = Level_GetLayerTilemap(ctx, i);
+        layer.chunks = Level_GetLayerChunks(ctx, i);
+        if (!layer.tilemap || !layer.chunks || layer.width == 0 || layer.height == 0) {
+            continue;
+        }
+        insert_layer(frame, &layer);
+    }
+
+    return 0;
+}
+
+void RenderFrame_Free(RenderFrame* frame) {
+    if (!frame) {
+        return;
+    }
+    free(frame->rgba);
+    free(frame->layers);
+    free(frame->cache_slots);
+    free(frame->cache_rgba);
+    memset(frame, 0, sizeof(RenderFrame));
+}
+
+/* -----------------------------------------------------------------------------
+ * Camera
+ * -------------------------------------------------------------------------- */
+
+void RenderFrame_ClampCamera(const RenderFrame* frame, s32* camera_x, s32* camera_y) {
+    if (!frame) {
+        return;
+    }
+
+    /* Same order as the original: a level smaller than the frame ends up
+     * pinned to its right/bottom edge */
+    if (camera_x) {
+        if (frame->clamp_left && *camera_x < 0) {
+            *camera_x = 0;
+        }
+        if (frame->clamp_right && *camera_x > frame->level_width - RENDER_CAMERA_VIEW_WIDTH) {
+            *camera_x = frame->level_width - RENDER_CAMERA_VIEW_WIDTH;
+        }
+    }
+    if (camera_y) {
+        if (frame->clamp_top && *camera_y < 0) {
+            *camera_y = 0;
+        }
+        if (frame->clamp_bottom && *camera_y > frame->level_height - RENDER_CAMERA_VIEW_HEIGHT) {
+            *camera_y = frame->level_height - RENDER_CAMERA_VIEW_HEIGHT;
+        }
+    }
+}
+
+void RenderFrame_GetLayerPosition(const RenderFrame* frame, u32 slot,
+                                  s32 camera_x, s32 camera_y, s32* out_x, s32* out_y) {
+    const RenderFrameLayer* layer;
+
+    if (!frame || slot >= frame->layer_count) {
+        if (out_x) *out_x = 0;
+        if (out_y) *out_y = 0;
+        return;
+    }
+    layer = &frame->layers[slot];
+    if (out_x) *out_x = layer->origin_x - scroll_position(camera_x, layer->scroll_x);
+    if (out_y) *out_y = layer->origin_y - scroll_position(camera_y, layer->scroll_y);
+}
+
+/* -----------------------------------------------------------------------------
+ * Drawing
+ * -------------------------------------------------------------------------- */
+
+/* Part of the frame being composited: [x0, x1) by [y0, y1) */
+typedef struct {
+    s32         x0;
+    s32         y0;
+    s32         x1;
+    s32         y1;
+} FrameRect;
+
+/* rect must not be empty */
+static void fill_background(RenderFrame* frame, const FrameRect* rect) {
+    size_t row_bytes = (size_t)frame->width * 4;
+    size_t span = (size_t)(rect->x1 - rect->x0) * 4;
+    u8* first = frame->rgba + (size_t)rect->y0 * row_bytes + (size_t)rect->x0 * 4;
+    s32 x, y;
+
+    for (x = 0; x < rect->x1 - rect->x0; x++) {
+        memcpy(first + (size_t)x * 4, frame->background, 4);
+    }
+    for (y = 1; y < rect->y1 - rect->y0; y++) {
+        memcpy(first + (size_t)y * row_bytes, first, span);
+    }
+}
+
+/* Tiles of a layer placed at (pos_x, pos_y) that show in rect,
+ * inclusive; 0 if none */
+static int visible_tiles(const RenderFrameLayer* layer, const FrameRect* rect,
+                         s32 pos_x, s32 pos_y, s32* tx0, s32* ty0, s32* tx1, s32* ty1) {
+    /* Layer pixels the rect covers: x0 - pos .. x1 - 1 - pos */
+    *tx0 = max_s32((rect->x0 - pos_x) >> 4, 0);
+    *ty0 = max_s32((rect->y0 - pos_y) >> 4, 0);
+    *tx1 = min_s32((rect->x1 - 1 - pos_x) >> 4, (s32)layer->width - 1);
+    *ty1 = min_s32((rect->y1 - 1 - pos_y) >> 4, (s32)layer->height - 1);
+    return *tx0 <= *tx1 && *ty0 <= *ty1;
+}
+
+/* Draw one layer placed at (pos_x, pos_y) across the frame (all) */
+static void draw_layer(RenderFrame* frame, const RenderFrameLayer* layer, const FrameRect* all,
+                       s32 pos_x, s32 pos_y) {
+    const LevelLayerChunks* view = layer->chunks;
+    u32 stride = (u32)frame->width * 4;
+    s32 tx0, ty0, tx1, ty1;
+    s32 cx, cy;
+
+    if (!visible_tiles(layer, all, pos_x, pos_y, &tx0, &ty0, &tx1, &ty1)) {
+        return;
+    }
+
+    for (cy = ty0 >> LEVEL_CHUNK_SHIFT; cy <= ty1 >> LEVEL_CHUNK_SHIFT; cy++) {
+        for (cx = tx0 >> LEVEL_CHUNK_SHIFT; cx <= tx1 >> LEVEL_CHUNK_SHIFT; cx++) {
+            const LevelChunk* chunk = &view->chunks[cy * view->chunks_x + cx];
+            s32 base_x = cx << LEVEL_CHUNK_SHIFT;
+            s32 base_y = cy << LEVEL_CHUNK_SHIFT;
+            s32 x0, y0, x1, y1, tx, ty;
+
+            if (!(chunk->flags & LEVEL_CHUNK_OCCUPIED)) {
+                continue;
+            }
+            x0 = max_s32(base_x + chunk->x0, tx0);
+            y0 = max_s32(base_y + chunk->y0, ty0);
+            x1 = min_s32(base_x + chunk->x1, tx1);
+            y1 = min_s32(base_y + chunk->y1, ty1);
+
+            for (ty = y0; ty <= y1; ty++) {
+                const u16* row = layer->tilemap + (u32)ty * layer->width;
+                s32 sy = pos_y + ty * 16;
+                s32 src_y = sy < 0 ? -sy : 0;
+                u8* dst_row = frame->rgba + (size_t)(sy + src_y) * stride;
+
+                for (tx = x0; tx <= x1; tx++) {
+                    u16 tile_index = TILEMAP_TILE(row[tx]);
+                    s32 sx, src_x;
+
+                    if (tile_index == 0) continue;
+                    sx = pos_x + tx * 16;
+                    src_x = sx < 0 ? -sx : 0;
+                    RenderTileRectToRGBA(frame->level, tile_index, src_x, src_y,
+                                         frame->width - (sx + src_x),
+                                         frame->height - (sy + src_y),
+                                         dst_row + (size_t)(sx + src_x) * 4, stride);
+                }
+            }
+        }
+    }
+}
+
+int RenderFrame_Draw(RenderFrame* frame, s32 camera_x, s32 camera_y) {
+    FrameRect all;
+    u32 i;
+
+    if (!frame || !frame->rgba || !frame->level) {
+        return -1;
+    }
+
+    all.x0 = 0;
+    all.y0 = 0;
+    all.x1 = frame->width;
+    all.y1 = frame->height;
+    fill_background(frame, &all);
+    for (i = 0; i < frame->layer_count; i++) {
+        s32 pos_x, pos_y;
+
+        RenderFrame_GetLayerPosition(frame, i, camera_x, camera_y, &pos_x, &pos_y);
+        draw_layer(frame, &frame->layers[i], &all, pos_x, pos_y);
+    }
+
+    frame->last_camera_x = camera_x;
+    frame->last_camera_y = camera_y;
+    frame->rgba_current = 1;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Tile Cache
+ * -------------------------------------------------------------------------- */
+
+#define SLOT_BYTES      (16 * 16 * 4)
+#define SLOT_STRIDE     (16 * 4)
+
+/* One slot per tile a frame-sized window can touch at any offset */
+static int alloc_cache(RenderFrame* frame) {
+    u32 per_layer;
+    u32 total;
+    u32 i;
+
+    frame->cache_cols = (u32)(frame->width - 1) / 16 + 2;
+    frame->cache_rows = (u32)(frame->height - 1) / 16 + 2;
+    per_layer = frame->cache_cols * frame->cache_rows;
+    total = per_layer * (frame->layer_count ? frame->layer_count : 1);
+
+    frame->cache_slots = (RenderFrameSlot*)malloc(total * sizeof(RenderFrameSlot));
+    frame->cache_rgba = (u8*)malloc((size_t)total * SLOT_BYTES);
+    if (!frame->cache_slots || !frame->cache_rgba) {
+        free(frame->cache_slots);
+        free(frame->cache_rgba);
+        frame->cache_slots = NULL;
+        frame->cache_rgba = NULL;
+        return -1;
+    }
+    for (i = 0; i < total; i++) {
+        memset(&frame->cache_slots[i], 0, sizeof(RenderFrameSlot));
+        frame->cache_slots[i].tile_x = -1;
+    }
+    return 0;
+}
+
+/* Expand a layer cell into its slot and classify what it drew */
+static void fill_slot(RenderFrame* frame, RenderFrameSlot* slot, u8* rgba,
+                      const RenderFrameLayer* layer, s32 tx, s32 ty) {
+    u16 tile_index = TILEMAP_TILE(layer->tilemap[(u32)ty * layer->width + (u32)tx]);
+    u32 clear = 0;
+    u32 i;
+
+    slot->tile_x = tx;
+    slot->tile_y = ty;
+    slot->tile_index = tile_index;
+    slot->coverage = LEVEL_TILE_CLEAR;
+    frame->cache_redrawn++;
+    if (tile_index == 0) {
+        return;
+    }
+
+    memset(rgba, 0, SLOT_BYTES);
+    if (!RenderTileRectToRGBA(frame->level, tile_index, 0, 0, 16, 16, rgba, SLOT_STRIDE)) {
+        return;
+    }
+    for (i = 0; i < 16 * 16; i++) {
+        clear += rgba[i * 4 + 3] == 0;
+    }
+    if (clear == 0) {
+        slot->coverage = LEVEL_TILE_SOLID;
+    } else if (clear < 16 * 16) {
+        slot->coverage = LEVEL_TILE_MIXED;
+    }
+}
+
+/* Refill the layer's stale slots in rect and composite them there */
+static void update_layer(RenderFrame* frame, u32 index, const FrameRect* rect,
+                         s32 pos_x, s32 pos_y) {
+    const RenderFrameLayer* layer = &frame->layers[index];
+    u32 per_layer = frame->cache_cols * frame->cache_rows;
+    RenderFrameSlot* slots = frame->cache_slots + (size_t)index * per_layer;
+    u8* slot_rgba = frame->cache_rgba + (size_t)index * per_layer * SLOT_BYTES;
+    u32 stride = (u32)frame->width * 4;
+    s32 tx0, ty0, tx1, ty1, tx, ty;
+
+    if (!visible_tiles(layer, rect, pos_x, pos_y, &tx0, &ty0, &tx1, &ty1)) {
+        return;
+    }
+
+    for (ty = ty0; ty <= ty1; ty++) {
+        u32 ring_row = ((u32)ty % frame->cache_rows) * frame->cache_cols;
+        s32 sy = pos_y + ty * 16;
+        s32 src_y = max_s32(rect->y0 - sy, 0);
+        s32 h = min_s32(16 - src_y, rect->y1 - (sy + src_y));
+        u8* dst_row = frame->rgba + (size_t)(sy + src_y) * stride;
+
+        for (tx = tx0; tx <= tx1; tx++) {
+            u32 s = ring_row + (u32)tx % frame->cache_cols;
+            RenderFrameSlot* slot = &slots[s];
+            u8* src = slot_rgba + (size_t)s * SLOT_BYTES;
+            u8* dst;
+            s32 sx, src_x, w, y;
+
+            if (slot->tile_x != tx || slot->tile_y != ty) {
+                fill_slot(frame, slot, src, layer, tx, ty);
+            }
+            if (slot->coverage == LEVEL_TILE_CLEAR) {
+                continue;
+            }
+
+            sx = pos_x + tx * 16;
+            src_x = max_s32(rect->x0 - sx, 0);
+            w = min_s32(16 - src_x, rect->x1 - (sx + src_x));
+            src += src_y * SLOT_STRIDE + src_x * 4;
+            dst = dst_row + (size_t)(sx + src_x) * 4;
+            if (slot->coverage != LEVEL_TILE_SOLID) {
+                RenderKernel_BlendRect(src, SLOT_STRIDE, dst, stride, (u32)w, (u32)h);
+            } else if (w == 16) {
+                /* Fixed size, so the compiler inlines the row copies */
+                for (y = 0; y < h; y++) {
+                    memcpy(dst + (size_t)y * stride, src + y * SLOT_STRIDE, SLOT_STRIDE);
+                }
+            } else {
+                for (y = 0; y < h; y++) {
+                    memcpy(dst + (size_t)y * stride, src + y * SLOT_STRIDE, (size_t)w * 4);
+                }
+            }
+        }
+    }
+}
+
+/* Background and every layer's cached tiles, inside rect only */
+static void update_rect(RenderFrame* frame, const FrameRect* rect, s32 camera_x, s32 camera_y) {
+    u32 i;
+
+    if (rect->x0 >= rect->x1 || rect->y0 >= rect->y1) {
+        return;
+    }
+    fill_background(frame, rect);
+    for (i = 0; i < frame->layer_count; i++) {
+        s32 pos_x, pos_y;
+
+        RenderFrame_GetLayerPosition(frame, i, camera_x, camera_y, &pos_x, &pos_y);
+        update_layer(frame, i, rect, pos_x, pos_y);
+    }
+}
+
+/* How far every layer has moved since rgba was composited, if they all
+ * moved by the same amount; 0 if any moved against the others */
+static int common_shift(const RenderFrame* frame, s32 camera_x, s32 camera_y,
+                        s32* dx, s32* dy) {
+    u32 i;
+
+    *dx = 0;
+    *dy = 0;
+    for (i = 0; i < frame->layer_count; i++) {
+        s32 old_x, old_y, new_x, new_y;
+
+        RenderFrame_GetLayerPosition(frame, i, frame->last_camera_x, frame->last_camera_y,
+                                     &old_x, &old_y);
+        RenderFrame_GetLayerPosition(frame, i, camera_x, camera_y, &new_x, &new_y);
+        if (i == 0) {
+            *dx = new_x - old_x;
+            *dy = new_y - old_y;
+        } else if (new_x - old_x != *dx || new_y - old_y != *dy) {
+            return 0;
+        }
+    }
+    return abs(*dx) < frame->width && abs(*dy) < frame->height;
+}
+
+/* Move the framebuffer contents by (dx, dy). What moves in is left as it
+ * was, for the caller to composite. */
+static void shift_frame(RenderFrame* frame, s32 dx, s32 dy) {
+    size_t row_bytes = (size_t)frame->width * 4;
+    size_t span = (size_t)(frame->width - abs(dx)) * 4;
+    u8* dst = frame->rgba + (size_t)max_s32(dx, 0) * 4;
+    const u8* src = frame->rgba + (size_t)max_s32(-dx, 0) * 4;
+    s32 rows = frame->height - abs(dy);
+    s32 y;
+
+    if (dy > 0) {
+        dst += (size_t)dy * row_bytes;
+    } else {
+        src += (size_t)-dy * row_bytes;
+    }
+    if (dx == 0) {
+        memmove(dst, src, (size_t)rows * row_bytes);
+    } else if (dy > 0) {
+        /* Bottom up, so rows aren't overwritten before they move */
+        for (y = rows - 1; y >= 0; y--) {
+            memmove(dst + (size_t)y * row_bytes, src + (size_t)y * row_bytes, span);
+        }
+    } else {
+        for (y = 0; y < rows; y++) {
+            memmove(dst + (size_t)y * row_bytes, src + (size_t)y * row_bytes, span);
+        }
+    }
+}
+
+int RenderFrame_Update(RenderFrame* frame, s32 camera_x, s32 camera_y) {
+    FrameRect rect;
+    s32 dx, dy;
+
+    if (!frame || !frame->rgba || !frame->level) {
+        return -1;
+    }
+    if (!frame->cache_slots && alloc_cache(frame) != 0) {
+        return -1;
+    }
+
+    frame->cache_redrawn = 0;
+    if (frame->rgba_current &&
+        camera_x == frame->last_camera_x && camera_y == frame->last_camera_y) {
+        return 0;
+    }
+
+    if (frame->rgba_current && common_shift(frame, camera_x, camera_y, &dx, &dy)) {
+        /* The layers kept their places relative to each other: scroll
+         * what is already composited and fill in the edges. Nothing to
+         * do if no layer's pixel position changed. */
+        if (dx != 0 || dy != 0) {
+            shift_frame(frame, dx, dy);
+        }
+        rect.x0 = dx > 0 ? 0 : frame->width + dx;
+        rect.x1 = dx > 0 ? dx : frame->width;
+        rect.y0 = 0;
+        rect.y1 = frame->height;
+        update_rect(frame, &rect, camera_x, camera_y);
+        rect.x0 = dx > 0 ? dx : 0;
+        rect.x1 = dx > 0 ? frame->width : frame->width + dx;
+        rect.y0 = dy > 0 ? 0 : frame->height + dy;
+        rect.y1 = dy > 0 ? dy : frame->height;
+        update_rect(frame, &rect, camera_x, camera_y);
+    } else {
+        rect.x0 = 0;
+        rect.y0 = 0;
+        rect.x1 = frame->width;
+        rect.y1 = frame->height;
+        update_rect(frame, &rect, camera_x, camera_y);
+    }
+
+    frame->last_camera_x = camera_x;
+    frame->last_camera_y = camera_y;
+    frame->rgba_current = 1;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Invalidation
+ * -------------------------------------------------------------------------- */
+
+void RenderFrame_InvalidateTile(RenderFrame* frame, u16 tile_index) {
+    u32 total;
+    u32 i;
+
+    if (!frame) {
+        return;
+    }
+    /* rgba may come from RenderFrame_Draw, which fills no slots */
+    frame->rgba_current = 0;
+    if (tile_index == 0) {
+        return;
+    }
+    total = frame->cache_cols * frame->cache_rows * frame->layer_count;
+    for (i = 0; frame->cache_slots && i < total; i++) {
+        if (frame->cache_slots[i].tile_index == tile_index) {
+            frame->cache_slots[i].tile_x = -1;
+        }
+    }
+}
+
+void RenderFrame_InvalidatePalette(RenderFrame* frame, u8 palette_index) {
+    const LevelContext* ctx;
+    const u32* rgba;
+    const u32* rgba_semi;
+    u32 total;
+    u32 i;
+
+    if (!frame) {
+        return;
+    }
+    frame->rgba_current = 0;
+    ctx = frame->level;
+    if (!ctx || !ctx->palette_rgba || palette_index >= ctx->palette_rgba_count) {
+        return;
+    }
+
+    /* Match slots by the LUT their tile expands through, as Level_Load
+     * resolved it, rather than re-reading Asset 301 */
+    rgba = ctx->palette_rgba + palette_index * 256;
+    rgba_semi = ctx->palette_rgba_semi ? ctx->palette_rgba_semi + palette_index * 256 : NULL;
+    total = frame->cache_cols * frame->cache_rows * frame->layer_count;
+    for (i = 0; frame->cache_slots && i < total; i++) {
+        u16 tile_index = frame->cache_slots[i].tile_index;
+        const u32* lut;
+
+        if (tile_index == 0 || tile_index > ctx->total_tiles) {
+            continue;
+        }
+        lut = ctx->lut_rgba[tile_index - 1];
+        if (lut && (lut == rgba || lut == rgba_semi)) {
+            frame->cache_slots[i].tile_x = -1;
+        }
+    }
+}
+
+void RenderFrame_InvalidateAll(RenderFrame* frame) {
+    u32 total;
+    u32 i;
+
+    if (!frame) {
+        return;
+    }
+    total = frame->cache_cols * frame->cache_rows * frame->layer_count;
+    for (i = 0; frame->cache_slots && i < total; i++) {
+        frame->cache_slots[i].tile_x = -1;
+    }
+    frame->rgba_current = 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * render_frame.h - Camera-window frame compositor
+ *
+ * Renders what the camera sees of every tile layer into one RGBA
+ * framebuffer (320x240 by default), so a stage can be stepped and checked
+ * headless without Godot.
+ *
+ * Follows the layer setup in InitLayersAndTileState @ 0x80024778:
+ * - layers with layer_type 3 or skip_render != 0 are not drawn;
+ * - layers draw in ascending priority, (short)render_param, with ties
+ *   ordered as AddLayerToRenderList_* inserts them (later layer first);
+ * - a layer's scroll_x/scroll_y enable flags set the camera clamps
+ *   (RenderFrame_ClampCamera), as UpdateCameraPosition @ 0x800233c0 uses
+ *   them.
+ *
+ * A layer is placed at (x_offset, y_offset) tiles and scrolls by its
+ * 16.16 parallax factors (docs/systems/camera.md):
+ *   layer_x = camera_x * scroll_x >> 16
+ * Only the tiles inside the window are visited, and only in occupied
+ * chunks. Colour tints (TILEMAP_TINT) are not applied, as in
+ * RenderLayerToRGBA.
+ *
+ * RenderFrame_Update produces the same image incrementally. Each layer
+ * keeps its expanded tiles in a ring of 16x16 slots, indexed by tile
+ * column and row modulo the window size, so scrolling only expands the
+ * columns and rows that come into view. If every layer's pixel position
+ * moved by the same amount (none, or layers that all scroll with the
+ * camera), the last frame is scrolled in place and only the strips that
+ * came into view are composited. Layers moving against each other are
+ * recomposited from their slots: a row copy for solid tiles, an alpha
+ * merge for the rest, with no palette lookups. Animated or recoloured
+ * tiles (Level_SetPalette) are not detected: invalidate them explicitly.
+ *
+ * TOOL-ONLY: The original game builds SPRT_16 primitives per visible tile
+ * and leaves compositing to the GPU.
+ */
+
+#ifndef RENDER_FRAME_H
+#define RENDER_FRAME_H
+
+#include "../psx/types.h"
+#include "../level/level.h"
+
+#define RENDER_FRAME_WIDTH      320
+#define RENDER_FRAME_HEIGHT     240
+
+/* View UpdateCameraPosition clamps the camera for (docs/systems/camera.md),
+ * whatever size the frame is */
+#define RENDER_CAMERA_VIEW_WIDTH    320
+#define RENDER_CAMERA_VIEW_HEIGHT   256
+
+/* One cached tile of a layer (RenderFrame_Update) */
+typedef struct {
+    s32         tile_x;         /* Layer tile held, -1 if the slot is stale */
+    s32         tile_y;
+    u16         tile_index;     /* TILEMAP_TILE of that cell, 0 if empty */
+    u8          coverage;       /* LEVEL_TILE_SOLID if no pixel is clear */
+    u8          pad;
+} RenderFrameSlot;
+
+/* A layer the frame draws, resolved once by RenderFrame_Init */
+typedef struct {
+    u32         index;          /* Layer index in the stage */
+    s16         priority;       /* (short)render_param */
+    u16         pad;
+    s32         origin_x;       /* x_offset/y_offset in pixels */
+    s32         origin_y;
+    u32         scroll_x;       /* 16.16 parallax factors */
+    u32         scroll_y;
+    u32         width;          /* In tiles */
+    u32         height;
+    const u16*  tilemap;
+    const LevelLayerChunks* chunks;
+} RenderFrameLayer;
+
+typedef struct {
+    const LevelContext* level;
+    u8*         rgba;           /* width * height * 4, RGBA */
+    int         width;
+    int         height;
+    u8          background[4];  /* Tile header colour, opaque */
+
+    RenderFrameLayer* layers;   /* Drawn layers, back to front */
+    u32         layer_count;
+
+    /* Camera clamps from the layers' scroll enable flags */
+    u8          clamp_left;
+    u8          clamp_right;
+    u8          clamp_top;
+    u8          clamp_bottom;
+    s32         level_width;    /* Tile header size in pixels */
+    s32         level_height;
+
+    /* Tile ring caches, allocated by the first RenderFrame_Update */
+    u32         cache_cols;     /* Slots per layer: cache_cols * cache_rows */
+    u32         cache_rows;
+    RenderFrameSlot* cache_slots;   /* [layer_count][cols * rows] */
+    u8*         cache_rgba;     /* 16x16 RGBA per slot, same order */
+    u32         cache_redrawn;  /* Slots refilled by the last update */
+    s32         last_camera_x;  /* Camera rgba was last composited for */
+    s32         last_camera_y;
+    u8          rgba_current;   /* rgba matches last_camera and the caches */
+} RenderFrame;
+
+/**
+ * Set up a frame for a loaded stage and allocate its framebuffer.
+ * The frame refers to the level's tables: free it before Level_Unload.
+ * @param width, height Framebuffer size (<= 0 = RENDER_FRAME_WIDTH/HEIGHT)
+ * @return              0 on success, -1 on error
+ */
+int RenderFrame_Init(RenderFrame* frame, const LevelContext* ctx, int width, int height);
+
+/**
+ * Free the framebuffer and layer list.
+ */
+void RenderFrame_Free(RenderFrame* frame);
+
+/**
+ * Clamp a camera position to the level as UpdateCameraPosition does,
+ * on the sides the stage's layers enable. The right and bottom limits
+ * are level size minus RENDER_CAMERA_VIEW_WIDTH/HEIGHT, as in the game,
+ * so a 240-row frame at the bottom limit stops 16 rows above the edge.
+ */
+void RenderFrame_ClampCamera(const RenderFrame* frame, s32* camera_x, s32* camera_y);
+
+/**
+ * Get where a layer's pixel (0, 0) lands in the frame.
+ * @param slot          Index into frame->layers
+ */
+void RenderFrame_GetLayerPosition(const RenderFrame* frame, u32 slot,
+                                  s32 camera_x, s32 camera_y, s32* out_x, s32* out_y);
+
+/**
+ * Render the frame for a camera position (GameState camera_x/camera_y):
+ * background colour, then every layer's visible tiles.
+ * @return              0 on success, -1 on error
+ */
+int RenderFrame_Draw(RenderFrame* frame, s32 camera_x, s32 camera_y);
+
+/**
+ * Render the frame for a camera position, reusing the tile caches.
+ * Same image as RenderFrame_Draw; tiles are only expanded when they
+ * scroll into view or were invalidated. Unless something was invalidated
+ * since the last update or draw, layers that kept their places relative
+ * to each other only cost the strips that scrolled in, and if no layer
+ * moved rgba is left as it is.
+ * @return              0 on success, -1 on error
+ */
+int RenderFrame_Update(RenderFrame* frame, s32 camera_x, s32 camera_y);
+
+/**
+ * Drop every cached copy of a tile, e.g. after an animation step.
+ * The next update recomposites even if the tile isn't cached.
+ * @param tile_index    1-based tile index
+ */
+void RenderFrame_InvalidateTile(RenderFrame* frame, u16 tile_index);
+
+/**
+ * Drop every cached tile drawn with a palette (Asset 301 index), e.g.
+ * after Level_SetPalette has applied a colour cycling step.
+ */
+void RenderFrame_InvalidatePalette(RenderFrame* frame, u8 palette_index);
+
+/**
+ * Drop all cached tiles, and force the next update to recomposite (after
+ * drawing over rgba, for instance).
+ */
+void RenderFrame_InvalidateAll(RenderFrame* frame);
+
+#endif /* RENDER_FRAME_H */
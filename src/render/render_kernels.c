@@ -0,0 +1,298 @@
+/**
+ * render_kernels.c - Indexed-to-RGBA pixel kernels
+ *
+ * The LUT lookup is a gather: AVX2 does eight at once with
+ * vpgatherdd, SSE2 assembles four from scalar loads and stores them as
+ * one vector. The masked kernels compare alpha against zero per lane and
+ * blend with the destination, skipping the store when a whole vector is
+ * transparent (common along sprite and tile edges). The RGBA blend is the
+ * same test without the gather.
+ *
+ * x86 kernels are compiled with target attributes, so the library needs
+ * no special compiler flags; the CPU is only asked once, via
+ * pthread_once, so concurrent renderers can't race on the selection.
+ */
+
+#include "render_kernels.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*ExpandFn)(const u8* indices, const u32* lut, u8* out_rgba, u32 count);
+typedef void (*BlendFn)(const u8* src_rgba, u8* dst_rgba, u32 count);
+
+typedef struct {
+    const char* name;
+    ExpandFn    expand;
+    ExpandFn    expand_masked;
+    BlendFn     blend;
+} KernelSet;
+
+/* -----------------------------------------------------------------------------
+ * Portable kernels
+ * -------------------------------------------------------------------------- */
+
+static void expand_portable(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    u32 i;
+
+    for (i = 0; i < count; i++, out_rgba += 4) {
+        u32 rgba = lut[indices[i]];
+
+        out_rgba[0] = (u8)(rgba >>  0);
+        out_rgba[1] = (u8)(rgba >>  8);
+        out_rgba[2] = (u8)(rgba >> 16);
+        out_rgba[3] = (u8)(rgba >> 24);
+    }
+}
+
+static void expand_masked_portable(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    u32 i;
+
+    for (i = 0; i < count; i++, out_rgba += 4) {
+        u32 rgba = lut[indices[i]];
+
+        if ((rgba >> 24) == 0) {
+            continue;
+        }
+        out_rgba[0] = (u8)(rgba >>  0);
+        out_rgba[1] = (u8)(rgba >>  8);
+        out_rgba[2] = (u8)(rgba >> 16);
+        out_rgba[3] = (u8)(rgba >> 24);
+    }
+}
+
+static void blend_portable(const u8* src_rgba, u8* dst_rgba, u32 count) {
+    u32 i;
+
+    /* A select rather than a branch: in a mixed tile alpha is unpredictable */
+    for (i = 0; i < count; i++, src_rgba += 4, dst_rgba += 4) {
+        u32 keep = (u32)(src_rgba[3] == 0) - 1u;
+        u32 s, d;
+
+        memcpy(&s, src_rgba, 4);
+        memcpy(&d, dst_rgba, 4);
+        d = (s & keep) | (d & ~keep);
+        memcpy(dst_rgba, &d, 4);
+    }
+}
+
+#ifdef KERNELS_X86
+
+/* -----------------------------------------------------------------------------
+ * SSE2 kernels (x86 stores are little-endian, so a u32 lane is R,G,B,A)
+ * -------------------------------------------------------------------------- */
+
+__attribute__((target("sse2")))
+static __m128i gather4_sse2(const u8* indices, const u32* lut) {
+    return _mm_set_epi32((int)lut[indices[3]], (int)lut[indices[2]],
+                         (int)lut[indices[1]], (int)lut[indices[0]]);
+}
+
+__attribute__((target("sse2")))
+static void expand_sse2(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    u32 i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(out_rgba + i * 4), gather4_sse2(indices + i, lut));
+    }
+    expand_portable(indices + i, lut, out_rgba + i * 4, count - i);
+}
+
+__attribute__((target("sse2")))
+static void expand_masked_sse2(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    const __m128i zero = _mm_setzero_si128();
+    u32 i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i* dst = (__m128i*)(out_rgba + i * 4);
+        __m128i v = gather4_sse2(indices + i, lut);
+        __m128i clear = _mm_cmpeq_epi32(_mm_srli_epi32(v, 24), zero);
+        int mask = _mm_movemask_epi8(clear);
+
+        if (mask == 0xFFFF) {
+            continue;
+        }
+        if (mask != 0) {
+            __m128i d = _mm_loadu_si128(dst);
+            v = _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, v));
+        }
+        _mm_storeu_si128(dst, v);
+    }
+    expand_masked_portable(indices + i, lut, out_rgba + i * 4, count - i);
+}
+
+__attribute__((target("sse2")))
+static void blend_sse2(const u8* src_rgba, u8* dst_rgba, u32 count) {
+    const __m128i zero = _mm_setzero_si128();
+    u32 i = 0;
+
+    /* Solid and clear slots never get here (RenderFrame copies or skips
+     * them), so always merge rather than branch on the alpha mask */
+    for (; i + 4 <= count; i += 4) {
+        __m128i* dst = (__m128i*)(dst_rgba + i * 4);
+        __m128i v = _mm_loadu_si128((const __m128i*)(src_rgba + i * 4));
+        __m128i clear = _mm_cmpeq_epi32(_mm_srli_epi32(v, 24), zero);
+        __m128i d = _mm_loadu_si128(dst);
+
+        _mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, v)));
+    }
+    blend_portable(src_rgba + i * 4, dst_rgba + i * 4, count - i);
+}
+
+/* -----------------------------------------------------------------------------
+ * AVX2 kernels
+ * -------------------------------------------------------------------------- */
+
+__attribute__((target("avx2")))
+static __m256i gather8_avx2(const u8* indices, const u32* lut) {
+    __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)indices));
+
+    return _mm256_i32gather_epi32((const int*)lut, idx, 4);
+}
+
+__attribute__((target("avx2")))
+static void expand_avx2(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    u32 i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i*)(out_rgba + i * 4), gather8_avx2(indices + i, lut));
+    }
+    expand_sse2(indices + i, lut, out_rgba + i * 4, count - i);
+}
+
+__attribute__((target("avx2")))
+static void expand_masked_avx2(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    const __m256i zero = _mm256_setzero_si256();
+    u32 i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i* dst = (__m256i*)(out_rgba + i * 4);
+        __m256i v = gather8_avx2(indices + i, lut);
+        __m256i clear = _mm256_cmpeq_epi32(_mm256_srli_epi32(v, 24), zero);
+        int mask = _mm256_movemask_epi8(clear);
+
+        if (mask == -1) {
+            continue;
+        }
+        if (mask != 0) {
+            v = _mm256_blendv_epi8(v, _mm256_loadu_si256(dst), clear);
+        }
+        _mm256_storeu_si256(dst, v);
+    }
+    expand_masked_sse2(indices + i, lut, out_rgba + i * 4, count - i);
+}
+
+__attribute__((target("avx2")))
+static void blend_avx2(const u8* src_rgba, u8* dst_rgba, u32 count) {
+    const __m256i zero = _mm256_setzero_si256();
+    u32 i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i* dst = (__m256i*)(dst_rgba + i * 4);
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src_rgba + i * 4));
+        __m256i clear = _mm256_cmpeq_epi32(_mm256_srli_epi32(v, 24), zero);
+
+        _mm256_storeu_si256(dst, _mm256_blendv_epi8(v, _mm256_loadu_si256(dst), clear));
+    }
+    blend_sse2(src_rgba + i * 4, dst_rgba + i * 4, count - i);
+}
+
+#endif /* KERNELS_X86 */
+
+/* -----------------------------------------------------------------------------
+ * Selection
+ * -------------------------------------------------------------------------- */
+
+static const KernelSet s_sets[RENDER_KERNEL_COUNT] = {
+    { "portable", expand_portable, expand_masked_portable, blend_portable },
+#ifdef KERNELS_X86
+    { "sse2",     expand_sse2,     expand_masked_sse2,     blend_sse2 },
+    { "avx2",     expand_avx2,     expand_masked_avx2,     blend_avx2 },
+#else
+    { "sse2",     expand_portable, expand_masked_portable, blend_portable },
+    { "avx2",     expand_portable, expand_masked_portable, blend_portable },
+#endif
+};
+
+static pthread_once_t s_detect_once = PTHREAD_ONCE_INIT;
+static int s_best_level = RENDER_KERNEL_PORTABLE;
+static const KernelSet* s_active = &s_sets[RENDER_KERNEL_PORTABLE];
+
+static void detect_level(void) {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        s_best_level = RENDER_KERNEL_AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        s_best_level = RENDER_KERNEL_SSE2;
+    }
+#endif
+    s_active = &s_sets[s_best_level];
+}
+
+static const KernelSet* active_set(void) {
+    pthread_once(&s_detect_once, detect_level);
+    return s_active;
+}
+
+/* -----------------------------------------------------------------------------
+ * Kernel Entry Points
+ * -------------------------------------------------------------------------- */
+
+void RenderKernel_ExpandRow(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    active_set()->expand(indices, lut, out_rgba, count);
+}
+
+void RenderKernel_ExpandRowMasked(const u8* indices, const u32* lut, u8* out_rgba, u32 count) {
+    active_set()->expand_masked(indices, lut, out_rgba, count);
+}
+
+void RenderKernel_ExpandRect(const u8* indices, u32 src_stride, const u32* lut,
+                             u8* out_rgba, u32 dst_stride, u32 width, u32 height, int masked) {
+    const KernelSet* set = active_set();
+    ExpandFn fn = masked ? set->expand_masked : set->expand;
+    u32 y;
+
+    for (y = 0; y < height; y++) {
+        fn(indices + y * src_stride, lut, out_rgba + y * dst_stride, width);
+    }
+}
+
+void RenderKernel_BlendRect(const u8* src_rgba, u32 src_stride, u8* dst_rgba, u32 dst_stride,
+                            u32 width, u32 height) {
+    BlendFn fn = active_set()->blend;
+    u32 y;
+
+    for (y = 0; y < height; y++) {
+        fn(src_rgba + y * src_stride, dst_rgba + y * dst_stride, width);
+    }
+}
+
+int RenderKernel_GetLevel(void) {
+    return (int)(active_set() - s_sets);
+}
+
+int RenderKernel_GetBestLevel(void) {
+    pthread_once(&s_detect_once, detect_level);
+    return s_best_level;
+}
+
+int RenderKernel_SetLevel(int level) {
+    int best = RenderKernel_GetBestLevel();
+
+    if (level < RENDER_KERNEL_PORTABLE) level = RENDER_KERNEL_PORTABLE;
+    if (level > best) level = best;
+    s_active = &s_sets[level];
+    return level;
+}
+
+const char* RenderKernel_GetLevelName(int level) {
+    if (level < 0 || level >= RENDER_KERNEL_COUNT) {
+        return "unknown";
+    }
+    return s_sets[level].name;
+}
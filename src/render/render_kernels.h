@@ -0,0 +1,82 @@
+/**
+ * render_kernels.h - Indexed-to-RGBA pixel kernels
+ *
+ * The inner loop of every tile and sprite renderer: expand a run of 8bpp
+ * palette indices through a u32[256] LUT (psx_palette_to_rgba) into RGBA
+ * bytes, or blend already expanded RGBA. Each kernel has a portable
+ * version and, on x86, SSE2 and AVX2 versions; the best one the CPU
+ * supports is picked on first use.
+ *
+ * Output is RGBA byte order (R, G, B, A) whatever the host endianness,
+ * matching RenderTileToRGBA.
+ *
+ * TOOL-ONLY: The original game hands 4/8bpp textures and CLUTs to the GPU.
+ */
+
+#ifndef RENDER_KERNELS_H
+#define RENDER_KERNELS_H
+
+#include "../psx/types.h"
+
+/* Kernel sets, in order of preference */
+#define RENDER_KERNEL_PORTABLE  0
+#define RENDER_KERNEL_SSE2      1
+#define RENDER_KERNEL_AVX2      2
+#define RENDER_KERNEL_COUNT     3
+
+/**
+ * Expand count indices to RGBA.
+ * @param indices       8bpp palette indices
+ * @param lut           u32[256], 0xAABBGGRR
+ * @param out_rgba      Output: count * 4 bytes
+ */
+void RenderKernel_ExpandRow(const u8* indices, const u32* lut, u8* out_rgba, u32 count);
+
+/**
+ * Expand count indices over existing RGBA, leaving the destination pixel
+ * alone wherever the LUT entry has alpha 0 (the RenderLayerToRGBA blend).
+ */
+void RenderKernel_ExpandRowMasked(const u8* indices, const u32* lut, u8* out_rgba, u32 count);
+
+/**
+ * Expand a block of rows with independent strides, e.g. a tile (16-byte
+ * source rows, 8 of them used for 8x8 tiles) into a layer image.
+ * @param src_stride    Bytes between source rows
+ * @param dst_stride    Bytes between destination rows
+ * @param masked        Nonzero to skip alpha-0 pixels
+ */
+void RenderKernel_ExpandRect(const u8* indices, u32 src_stride, const u32* lut,
+                             u8* out_rgba, u32 dst_stride, u32 width, u32 height, int masked);
+
+/**
+ * Copy a block of RGBA pixels over another, leaving the destination pixel
+ * alone wherever the source has alpha 0 (the RenderFrame tile cache).
+ * @param src_stride    Bytes between source rows
+ * @param dst_stride    Bytes between destination rows
+ */
+void RenderKernel_BlendRect(const u8* src_rgba, u32 src_stride, u8* dst_rgba, u32 dst_stride,
+                            u32 width, u32 height);
+
+/**
+ * Get the kernel set in use (RENDER_KERNEL_*).
+ */
+int RenderKernel_GetLevel(void);
+
+/**
+ * Get the best kernel set this CPU supports.
+ */
+int RenderKernel_GetBestLevel(void);
+
+/**
+ * Force a kernel set, for benchmarks and testing. Clamped to what the
+ * CPU supports. Not thread-safe: call before rendering starts.
+ * @return              Level actually selected
+ */
+int RenderKernel_SetLevel(int level);
+
+/**
+ * Get a kernel set's name ("portable", "sse2", "avx2").
+ */
+const char* RenderKernel_GetLevelName(int level);
+
+#endif /* RENDER_KERNELS_H */
@@ -12,6 +12,7 @@
  */
 
 #include "sprite.h"
+#include "render_kernels.h"
 #include <string.h>
 
 /* -----------------------------------------------------------------------------
@@ -93,16 +94,44 @@ void DecodeRLESprite(u8* out_buffer, RLEDecodeContext* ctx)
 /* -----------------------------------------------------------------------------
  * TOOL CODE: DecodeSpriteFrame
  * 
- * High-level helper to decode a sprite frame to RGBA.
+ * High-level helpers to decode a sprite frame to RGBA through a palette
+ * LUT built once per sprite.
  * NOT from original game - this is tooling code.
  * -------------------------------------------------------------------------- */
 
+void GetSpritePaletteRGBA(const u8* sprite, u32* out_lut)
+{
+    const SpriteHeader* hdr = (const SpriteHeader*)sprite;
+    
+    psx_palette_to_rgba(sprite + hdr->palette_offset, PSX_RGBA_INDEX0_CLEAR, out_lut);
+}
+
 int DecodeSpriteFrame(const u8* sprite, 
                       int anim_idx, 
                       int frame_idx,
                       u8* out_rgba,
                       int* out_width,
                       int* out_height)
+{
+    u32 lut[256];
+    
+    if (!sprite) return 0;
+    
+    /* Dimensions-only calls skip the palette */
+    if (out_rgba) {
+        GetSpritePaletteRGBA(sprite, lut);
+    }
+    return DecodeSpriteFrameLUT(sprite, anim_idx, frame_idx, lut,
+                                out_rgba, out_width, out_height);
+}
+
+int DecodeSpriteFrameLUT(const u8* sprite,
+                         int anim_idx,
+                         int frame_idx,
+                         const u32* lut,
+                         u8* out_rgba,
+                         int* out_width,
+                         int* out_height)
 {
     if (!sprite) return 0;
     
@@ -151,9 +180,6 @@ int DecodeSpriteFrame(const u8* sprite,
     const u16* cmd_ptr = (const u16*)(frame_rle + 2);
     const u8* pixel_ptr = (const u8*)(cmd_ptr + cmd_count);
     
-    /* Get palette (256 x 16-bit PSX colors) */
-    const u16* palette = (const u16*)(sprite + hdr->palette_offset);
-    
     /* Allocate temporary indexed buffer */
     /* Note: caller should provide large enough out_rgba buffer */
     int pixel_count = width * height;
@@ -174,14 +200,17 @@ int DecodeSpriteFrame(const u8* sprite,
     /* Decode RLE to indexed */
     DecodeRLESprite(indexed, &ctx);
     
-    /* Convert indexed to RGBA in-place (backwards to avoid overwriting) */
-    u32* rgba_out = (u32*)out_rgba;
-    for (int i = pixel_count - 1; i >= 0; i--) {
-        u8 color_idx = indexed[i];
-        u16 psx_color = palette[color_idx];
-        /* Index 0 is transparent by convention */
-        int is_transparent = (color_idx == 0);
-        rgba_out[i] = psx_color_to_rgba_alpha(psx_color, is_transparent);
+    /* Convert indexed to RGBA in-place, backwards a block at a time: each
+     * block's indices are copied out first, and its RGBA lands at or past
+     * them, never over indices still to come. The LUT clears index 0. */
+    int end = pixel_count;
+    while (end > 0) {
+        u8 block[256];
+        int start = end > (int)sizeof(block) ? end - (int)sizeof(block) : 0;
+        
+        memcpy(block, indexed + start, (size_t)(end - start));
+        RenderKernel_ExpandRow(block, lut, out_rgba + (size_t)start * 4, (u32)(end - start));
+        end = start;
     }
     
     return 1;
@@ -254,6 +254,33 @@ int DecodeSpriteFrame(const u8* sprite,
                       int* out_width,
                       int* out_height);
 
+/**
+ * GetSpritePaletteRGBA - Convert a sprite's embedded palette to a LUT
+ * TOOL FUNCTION (not in original game)
+ * 
+ * Index 0 is transparent (PSX_RGBA_INDEX0_CLEAR), like the RLE gaps.
+ * Build once per sprite and pass to DecodeSpriteFrameLUT for every frame.
+ * 
+ * @param sprite     Pointer to sprite data (header)
+ * @param out_lut    Output: u32[256], 0xAABBGGRR
+ */
+void GetSpritePaletteRGBA(const u8* sprite, u32* out_lut);
+
+/**
+ * DecodeSpriteFrameLUT - DecodeSpriteFrame with a prebuilt palette LUT
+ * TOOL FUNCTION (not in original game)
+ * 
+ * @param lut        From GetSpritePaletteRGBA (or any u32[256] LUT)
+ * @return 1 on success, 0 on failure
+ */
+int DecodeSpriteFrameLUT(const u8* sprite,
+                         int anim_idx,
+                         int frame_idx,
+                         const u32* lut,
+                         u8* out_rgba,
+                         int* out_width,
+                         int* out_height);
+
 /**
  * GetSpriteFrameInfo - Get frame dimensions without decoding
  * TOOL FUNCTION (not in original game)
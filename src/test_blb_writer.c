@@ -0,0 +1,439 @@
+/**
+ * test_blb_writer.c - Write archives and read them back
+ *
+ * Writes a small two-stage archive with the in-memory and the streaming
+ * writer, without a template header, then reopens each file with
+ * BLB_Open and compares the level table and every asset byte with what
+ * was written. Also checks segment and asset dedup (with alignment), the
+ * .blbidx sidecar and BLB_PatchSegment. Needs no GAME.BLB; scratch files go to the
+ * current directory.
+ *
+ * Exit status is the number of failed checks (capped at 255).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blb/blb.h"
+
+#define MEM_PATH        "test_blb_writer_mem.blb"
+#define STREAM_PATH     "test_blb_writer_stream.blb"
+#define PATCH_PATH      "test_blb_writer_patch.blb"
+#define STAGE_COUNT     2
+
+typedef struct {
+    u32         id;
+    const u8*   data;
+    u32         size;
+} TestAsset;
+
+typedef struct {
+    u8          type;           /* 0=primary, 1=secondary, 2=tertiary */
+    u8          stage;
+    const TestAsset* assets;
+    u32         count;
+} TestSegment;
+
+static u8 g_sprites[300];
+static u8 g_sounds[4];
+static u8 g_tile_header[36];
+static u8 g_pixels[512];
+static u8 g_layers[92];
+static u8 g_entities[48];
+static u8 g_tilemap[5000];      /* Spans several sectors */
+static int g_bad;
+
+static const TestAsset s_primary[] = {
+    { 600, g_sprites, sizeof(g_sprites) },
+    { 601, g_sounds, sizeof(g_sounds) },
+};
+
+/* Written for both stages: the second copy shares the first run */
+static const TestAsset s_secondary[] = {
+    { 100, g_tile_header, sizeof(g_tile_header) },
+    { 300, g_pixels, sizeof(g_pixels) },
+};
+
+/* 502 and 503 are identical: one copy, two TOC entries */
+static const TestAsset s_tertiary0[] = {
+    { 201, g_layers, sizeof(g_layers) },
+    { 501, g_entities, sizeof(g_entities) },
+    { 502, g_sprites, sizeof(g_sprites) },
+    { 503, g_sprites, sizeof(g_sprites) },
+};
+
+static const TestAsset s_tertiary1[] = {
+    { 200, g_tilemap, sizeof(g_tilemap) },
+    { 201, g_layers, sizeof(g_layers) },
+};
+
+static const TestSegment s_segments[] = {
+    { 0, 0, s_primary, 2 },
+    { 1, 0, s_secondary, 2 },
+    { 1, 1, s_secondary, 2 },
+    { 2, 0, s_tertiary0, 4 },
+    { 2, 1, s_tertiary1, 2 },
+};
+
+#define SEGMENT_COUNT   (sizeof(s_segments) / sizeof(s_segments[0]))
+
+/* Outgrows the primary's one sector: appended */
+static const TestAsset s_patch_primary[] = {
+    { 600, g_tilemap, sizeof(g_tilemap) },
+    { 601, g_sounds, sizeof(g_sounds) },
+};
+
+/* Fits the old run, but stage 0 shares it: appended */
+static const TestAsset s_patch_secondary[] = {
+    { 100, g_tile_header, sizeof(g_tile_header) },
+    { 300, g_sprites, sizeof(g_sprites) },
+};
+
+/* Smaller than the old run: rewritten in place */
+static const TestAsset s_patch_tertiary[] = {
+    { 200, g_entities, sizeof(g_entities) },
+    { 201, g_layers, sizeof(g_layers) },
+};
+
+static const TestSegment s_patches[] = {
+    { 0, 0, s_patch_primary, 2 },
+    { 1, 1, s_patch_secondary, 2 },
+    { 2, 1, s_patch_tertiary, 2 },
+};
+
+#define PATCH_COUNT     (sizeof(s_patches) / sizeof(s_patches[0]))
+
+static void check(int ok, const char* what) {
+    if (!ok && g_bad++ < 20) {
+        printf("  FAIL: %s\n", what);
+    }
+}
+
+static void fill_inputs(void) {
+    u32 seed = 1;
+    u8* buffers[] = { g_sprites, g_sounds, g_tile_header, g_pixels,
+                      g_layers, g_entities, g_tilemap };
+    u32 sizes[] = { sizeof(g_sprites), sizeof(g_sounds), sizeof(g_tile_header),
+                    sizeof(g_pixels), sizeof(g_layers), sizeof(g_entities),
+                    sizeof(g_tilemap) };
+    u32 i, j;
+
+    for (i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        for (j = 0; j < sizes[i]; j++) {
+            seed = seed * 1103515245u + 12345u;
+            buffers[i][j] = (u8)(seed >> 16);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Writing
+ * ------------------------------------------------------------------------ */
+
+static int build_segment(SegmentBuilder* builder, const TestSegment* seg) {
+    u32 a;
+
+    if (BLB_SegmentBuilder_Init(builder) != 0) {
+        return -1;
+    }
+    for (a = 0; a < seg->count; a++) {
+        if (BLB_SegmentBuilder_AddAsset(builder, seg->assets[a].id,
+                                        seg->assets[a].data, seg->assets[a].size) != 0) {
+            BLB_SegmentBuilder_Free(builder);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* A sector-aligned duplicate must not end up sharing a 4-aligned copy */
+static void check_dedup_alignment(void) {
+    SegmentBuilder builder;
+
+    if (BLB_SegmentBuilder_Init(&builder) != 0) {
+        check(0, "builder init");
+        return;
+    }
+    if (BLB_SegmentBuilder_AddAssetRef(&builder, 601, g_sounds, sizeof(g_sounds), 0) != 0 ||
+        BLB_SegmentBuilder_AddAssetRef(&builder, 600, g_sprites, sizeof(g_sprites), 0) != 0 ||
+        BLB_SegmentBuilder_AddAssetRef(&builder, 602, g_sounds, sizeof(g_sounds),
+                                       BLB_ASSET_ALIGN_SECTOR) != 0 ||
+        BLB_SegmentBuilder_Layout(&builder, NULL, NULL) == 0) {
+        check(0, "aligned duplicate added");
+    } else {
+        check(builder.entries[2].offset == builder.entries[0].offset &&
+              builder.entries[2].offset % BLB_SECTOR_SIZE == 0, "aligned duplicate shared");
+    }
+    BLB_SegmentBuilder_Free(&builder);
+}
+
+/* Primary through Finalize + BLB_WriteSegment, the rest gathered */
+static int write_segments(BLBFile* blb) {
+    u32 s;
+
+    if (BLB_SetLevelMetadata(blb, 0, "TEST", "Writer", STAGE_COUNT) != 0) {
+        return -1;
+    }
+    for (s = 0; s < SEGMENT_COUNT; s++) {
+        const TestSegment* seg = &s_segments[s];
+        SegmentBuilder builder;
+        int result;
+
+        if (build_segment(&builder, seg) != 0) {
+            return -1;
+        }
+        if (seg->type == 0) {
+            u32 size = 0;
+            u8* data = BLB_SegmentBuilder_Finalize(&builder, &size);
+
+            result = data ? BLB_WriteSegment(blb, 0, seg->stage, data, size, seg->type) : -1;
+            free(data);
+        } else {
+            result = BLB_WriteSegmentFromBuilder(blb, 0, seg->stage, &builder, seg->type);
+        }
+        BLB_SegmentBuilder_Free(&builder);
+        if (result != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int write_archive(const char* path, int stream) {
+    BLBFile* blb = stream ? BLB_CreateStream(path, 1) : BLB_Create(1);
+    BLBWriteStats stats;
+    int result;
+
+    if (!blb) {
+        return -1;
+    }
+    result = write_segments(blb);
+    if (result == 0) {
+        check(BLB_GetWriteStats(blb, &stats) == 0 &&
+              stats.segments_written == SEGMENT_COUNT - 1 && stats.segments_shared == 1,
+              "segment dedup stats");
+        result = BLB_WriteToFile(blb, stream ? NULL : path);
+    }
+    BLB_Close(blb);
+    free(blb);
+    return result;
+}
+
+/* ---------------------------------------------------------------------------
+ * Reading back
+ * ------------------------------------------------------------------------ */
+
+static u16 segment_sector(const BLBFile* blb, const TestSegment* seg) {
+    if (seg->type == 0) return BLB_GetPrimarySectorOffset(blb, 0);
+    if (seg->type == 1) return BLB_GetSecondarySectorOffset(blb, 0, seg->stage);
+    return BLB_GetTertiarySectorOffset(blb, 0, seg->stage);
+}
+
+static u16 segment_count(const BLBFile* blb, const TestSegment* seg) {
+    if (seg->type == 0) return BLB_GetPrimarySectorCount(blb, 0);
+    if (seg->type == 1) return BLB_GetSecondarySectorCount(blb, 0, seg->stage);
+    return BLB_GetTertiarySectorCount(blb, 0, seg->stage);
+}
+
+/* Every asset of one segment, byte for byte */
+static void check_segment(const BLBFile* blb, const TestSegment* seg) {
+    u16 sector = segment_sector(blb, seg);
+    u32 size = 0;
+    u32 count = 0;
+    const u8* data = BLB_AcquireSegment(blb, sector, segment_count(blb, seg), &size);
+    u32 a;
+
+    check(data != NULL && sector >= BLB_HEADER_SIZE / BLB_SECTOR_SIZE, "segment readable");
+    check(BLB_GetSegmentAssets(blb, sector, &count) != NULL && count == seg->count,
+          "segment indexed with every asset");
+    if (!data) {
+        return;
+    }
+    for (a = 0; a < seg->count; a++) {
+        const TestAsset* asset = &seg->assets[a];
+        const BLBIndexEntry* entry = BLB_LookupAsset(blb, sector, asset->id);
+
+        check(entry && entry->size == asset->size &&
+              entry->offset <= size && entry->size <= size - entry->offset &&
+              memcmp(data + entry->offset, asset->data, asset->size) == 0,
+              "asset bytes");
+    }
+    BLB_ReleaseSegment(blb, data);
+}
+
+static void check_contents(const BLBFile* blb) {
+    const char* level_id;
+    u32 s;
+
+    check(blb->level_count == 1 && !blb->is_jp, "PAL layout with one level");
+    if (blb->level_count != 1) {
+        return;
+    }
+    level_id = BLB_GetLevelID(blb, 0);
+    check(BLB_GetStageCount(blb, 0) == STAGE_COUNT, "stage count");
+    check(level_id && strcmp(level_id, "TEST") == 0, "level ID");
+    check(segment_sector(blb, &s_segments[1]) == segment_sector(blb, &s_segments[2]),
+          "identical secondaries share a run");
+
+    for (s = 0; s < SEGMENT_COUNT; s++) {
+        check_segment(blb, &s_segments[s]);
+    }
+
+    {
+        u16 sector = segment_sector(blb, &s_segments[3]);
+        const BLBIndexEntry* first = BLB_LookupAsset(blb, sector, 502);
+        const BLBIndexEntry* second = BLB_LookupAsset(blb, sector, 503);
+
+        check(first && second && first->offset == second->offset, "identical assets share bytes");
+    }
+}
+
+static void check_reopen(const char* path) {
+    BLBFile blb;
+
+    if (BLB_Open(path, &blb) != 0) {
+        check(0, "reopen");
+        return;
+    }
+    check_contents(&blb);
+    BLB_Close(&blb);
+}
+
+static int file_exists(const char* path) {
+    FILE* f = fopen(path, "rb");
+
+    if (f) {
+        fclose(f);
+    }
+    return f != NULL;
+}
+
+/* Cold start writes the catalog; a warm start must index the same */
+static void check_sidecar(const char* path) {
+    char sidecar[256];
+    BLBFile cold, warm;
+    u32 s;
+
+    sprintf(sidecar, "%s%s", path, BLB_SIDECAR_SUFFIX);
+    remove(sidecar);
+    if (BLB_OpenEx(path, &cold, BLB_OPEN_WRITE_SIDECAR) != 0) {
+        check(0, "cold open");
+        return;
+    }
+    check(file_exists(sidecar), "sidecar written");
+    if (BLB_Open(path, &warm) != 0) {
+        check(0, "warm open");
+        BLB_Close(&cold);
+        return;
+    }
+    for (s = 0; s < SEGMENT_COUNT; s++) {
+        u16 sector = segment_sector(&cold, &s_segments[s]);
+        u32 cold_count = 0, warm_count = 0;
+        const BLBIndexEntry* a = BLB_GetSegmentAssets(&cold, sector, &cold_count);
+        const BLBIndexEntry* b = BLB_GetSegmentAssets(&warm, sector, &warm_count);
+
+        check(a && b && cold_count == warm_count &&
+              memcmp(a, b, cold_count * sizeof(BLBIndexEntry)) == 0, "sidecar index");
+    }
+    check_contents(&warm);
+    BLB_Close(&warm);
+    BLB_Close(&cold);
+
+    /* Replacing the archive drops its catalog */
+    check(write_archive(path, 0) == 0 && !file_exists(sidecar), "sidecar removed on rewrite");
+}
+
+/* ---------------------------------------------------------------------------
+ * Patching
+ * ------------------------------------------------------------------------ */
+
+static long file_size(const char* path) {
+    FILE* f = fopen(path, "rb");
+    long size;
+
+    if (!f) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+/* Patch three segments, then reopen and compare every asset */
+static void check_patch(const char* path) {
+    u16 old_sector[PATCH_COUNT];
+    long end_sector, size_before;
+    BLBFile blb;
+    u32 p;
+
+    if (write_archive(path, 0) != 0 || BLB_Open(path, &blb) != 0) {
+        check(0, "write and open for patching");
+        return;
+    }
+    for (p = 0; p < PATCH_COUNT; p++) {
+        old_sector[p] = segment_sector(&blb, &s_patches[p]);
+    }
+    BLB_Close(&blb);
+
+    for (p = 0; p < PATCH_COUNT; p++) {
+        const TestSegment* seg = &s_patches[p];
+        SegmentBuilder builder;
+        u32 sector = 0;
+        u32 size = 0;
+        u8* data = NULL;
+
+        if (build_segment(&builder, seg) == 0) {
+            data = BLB_SegmentBuilder_Finalize(&builder, &size);
+            BLB_SegmentBuilder_Free(&builder);
+        }
+        size_before = file_size(path);
+        end_sector = (size_before + BLB_SECTOR_SIZE - 1) / BLB_SECTOR_SIZE;
+        check(data && BLB_PatchSegment(path, 0, seg->stage, data, size, seg->type, &sector) == 0,
+              "patch");
+        if (seg->type == 2) {
+            check(sector == old_sector[p] && file_size(path) == size_before, "patched in place");
+        } else {
+            check(sector == (u32)end_sector, "patch appended");
+        }
+        free(data);
+    }
+
+    if (BLB_Open(path, &blb) != 0) {
+        check(0, "reopen after patch");
+        return;
+    }
+    for (p = 0; p < PATCH_COUNT; p++) {
+        check_segment(&blb, &s_patches[p]);
+    }
+    /* Stage 0 kept the secondary run it shared with stage 1 */
+    check_segment(&blb, &s_segments[1]);
+    check_segment(&blb, &s_segments[3]);
+    check(segment_sector(&blb, &s_segments[1]) == old_sector[1], "shared run left alone");
+    BLB_Close(&blb);
+}
+
+int main(void) {
+    printf("=== Evil Engine BLB Writer Test ===\n");
+
+    fill_inputs();
+    check_dedup_alignment();
+
+    check(write_archive(MEM_PATH, 0) == 0, "in-memory write");
+    check_reopen(MEM_PATH);
+
+    check(write_archive(STREAM_PATH, 1) == 0, "streaming write");
+    check_reopen(STREAM_PATH);
+
+    check_sidecar(MEM_PATH);
+
+    check_patch(PATCH_PATH);
+
+    printf("%s: %d failed checks\n", g_bad ? "FAIL" : "OK", g_bad);
+
+    remove(MEM_PATH);
+    remove(STREAM_PATH);
+    remove(PATCH_PATH);
+    remove(MEM_PATH BLB_SIDECAR_SUFFIX);
+    return g_bad > 255 ? 255 : g_bad;
+}
@@ -0,0 +1,413 @@
+/**
+ * test_collision.c - Check the collision queries against brute force
+ *
+ * Builds a one-stage archive in memory whose only real content is a
+ * random Asset 500 grid, loads it with Level_Load, and compares the
+ * sweep, span, ground and ray queries with per-pixel / per-cell
+ * references that read the grid bytes directly. Needs no GAME.BLB.
+ *
+ * Exit status is the number of mismatches (capped at 255).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blb/blb.h"
+#include "level/level.h"
+#include "level/level_collision.h"
+
+/* Grid wider than one bitplane word, not at the world origin */
+#define GRID_X      3
+#define GRID_Y      2
+#define GRID_W      150
+#define GRID_H      45
+
+static u8 g_grid[GRID_W * GRID_H];
+static u32 g_seed = 1;
+static int g_bad;
+
+static u32 next_rand(void) {
+    g_seed = g_seed * 1103515245u + 12345u;
+    return (g_seed >> 8) & 0xFFFFFF;
+}
+
+/* Uniform in [lo, hi) */
+static s32 rand_range(s32 lo, s32 hi) {
+    return lo + (s32)(next_rand() % (u32)(hi - lo));
+}
+
+static void report(const char* what, int i) {
+    if (g_bad++ < 10) {
+        printf("  MISMATCH: %s (case %d)\n", what, i);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Synthetic archive
+ * ------------------------------------------------------------------------ */
+
+static void put_u16(u8* p, u16 v) {
+    p[0] = (u8)v;
+    p[1] = (u8)(v >> 8);
+}
+
+static void put_u32(u8* p, u32 v) {
+    put_u16(p, (u16)v);
+    put_u16(p + 2, (u16)(v >> 16));
+}
+
+/* Segment with one TOC entry per asset; returns its size */
+static u32 build_segment(u8* out, const u32* ids, const u8* const* data,
+                         const u32* sizes, u32 count) {
+    u32 offset = 4 + count * 12;
+    u32 i;
+
+    put_u32(out, count);
+    for (i = 0; i < count; i++) {
+        put_u32(out + 4 + i * 12, ids[i]);
+        put_u32(out + 8 + i * 12, sizes[i]);
+        put_u32(out + 12 + i * 12, offset);
+        memcpy(out + offset, data[i], sizes[i]);
+        offset = (offset + sizes[i] + 3) & ~3u;
+    }
+    return offset;
+}
+
+static int build_archive(BLBFile** out_blb) {
+    static const u8 attrs[] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x02, 0x09, 0x2A, 0x5B, 0x3D, 0xDE, 0xDF, 0x65
+    };
+    static u8 asset500[8 + GRID_W * GRID_H];
+    static u8 segment[sizeof(asset500) + 256];
+    static u8 template_header[BLB_HEADER_SIZE];
+    u8 tile_header[36] = {0};
+    u8 dummy[4] = {0};
+    u32 ids[1];
+    const u8* data[1];
+    u32 sizes[1];
+    BLBFile template_blb;
+    BLBFile* blb;
+    u32 i, size;
+
+    for (i = 0; i < GRID_W * GRID_H; i++) {
+        g_grid[i] = attrs[next_rand() % sizeof(attrs)];
+    }
+    put_u16(asset500, GRID_X);
+    put_u16(asset500 + 2, GRID_Y);
+    put_u16(asset500 + 4, GRID_W);
+    put_u16(asset500 + 6, GRID_H);
+    memcpy(asset500 + 8, g_grid, sizeof(g_grid));
+
+    /* PAL layout: an A-Z code byte (see detect_jp_layout) */
+    template_header[BLB_OFF_LAYOUT_CODE] = 'A';
+    if (BLB_OpenMem(template_header, BLB_HEADER_SIZE, &template_blb) != 0) {
+        return -1;
+    }
+    blb = BLB_Create(1);
+    if (!blb || BLB_CopyHeaderTables(blb, &template_blb) != 0 ||
+        BLB_SetLevelMetadata(blb, 0, "TEST", "Collision", 1) != 0) {
+        BLB_Close(&template_blb);
+        return -1;
+    }
+    BLB_Close(&template_blb);
+
+    ids[0] = 602; data[0] = dummy; sizes[0] = sizeof(dummy);
+    size = build_segment(segment, ids, data, sizes, 1);
+    if (BLB_WriteSegment(blb, 0, 0, segment, size, 0) != 0) return -1;
+
+    ids[0] = 100; data[0] = tile_header; sizes[0] = sizeof(tile_header);
+    size = build_segment(segment, ids, data, sizes, 1);
+    if (BLB_WriteSegment(blb, 0, 0, segment, size, 1) != 0) return -1;
+
+    ids[0] = 500; data[0] = asset500; sizes[0] = sizeof(asset500);
+    size = build_segment(segment, ids, data, sizes, 1);
+    if (BLB_WriteSegment(blb, 0, 0, segment, size, 2) != 0) return -1;
+
+    *out_blb = blb;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * References: read g_grid directly
+ * ------------------------------------------------------------------------ */
+
+static s32 floor_div16(s32 v) {
+    return v >= 0 ? v / 16 : -((15 - v) / 16);
+}
+
+static u8 ref_cell(s32 tile_x, s32 tile_y) {
+    s32 x = tile_x - GRID_X;
+    s32 y = tile_y - GRID_Y;
+
+    if (x < 0 || y < 0 || x >= GRID_W || y >= GRID_H) {
+        return 0;
+    }
+    return g_grid[y * GRID_W + x];
+}
+
+static u8 ref_attr(s32 pixel_x, s32 pixel_y) {
+    return ref_cell(floor_div16(pixel_x), floor_div16(pixel_y));
+}
+
+static int ref_in(u32 classes, s32 tile_x, s32 tile_y) {
+    return (LevelCollision_GetClasses(ref_cell(tile_x, tile_y)) & classes) != 0;
+}
+
+/* Step one pixel at a time; only columns the leading edge enters count */
+static s32 ref_sweep_x(s32 left, s32 top, s32 width, s32 height, s32 dx) {
+    s32 step = dx > 0 ? 1 : -1;
+    s32 moved = 0;
+
+    while (moved != dx) {
+        s32 edge = step > 0 ? left + moved + step + width - 1 : left + moved + step;
+        s32 prev = step > 0 ? left + moved + width - 1 : left + moved;
+        s32 y;
+
+        if (floor_div16(edge) != floor_div16(prev)) {
+            for (y = top; y < top + height; y++) {
+                if (LEVEL_COLLISION_IS_SOLID(ref_attr(edge, y))) {
+                    return moved;
+                }
+            }
+        }
+        moved += step;
+    }
+    return moved;
+}
+
+static s32 ref_sweep_y(s32 left, s32 top, s32 width, s32 height, s32 dy) {
+    s32 step = dy > 0 ? 1 : -1;
+    s32 moved = 0;
+
+    while (moved != dy) {
+        s32 edge = step > 0 ? top + moved + step + height - 1 : top + moved + step;
+        s32 prev = step > 0 ? top + moved + height - 1 : top + moved;
+        s32 x;
+
+        if (floor_div16(edge) != floor_div16(prev)) {
+            for (x = left; x < left + width; x++) {
+                if (LEVEL_COLLISION_IS_SOLID(ref_attr(x, edge))) {
+                    return moved;
+                }
+            }
+        }
+        moved += step;
+    }
+    return moved;
+}
+
+/* Every pixel column of the box, every row down from pixel_y */
+static s32 ref_ground(u32 classes, s32 left, s32 width, s32 pixel_y, s32 max_rows,
+                      s32* out_tile_x) {
+    s32 row = floor_div16(pixel_y);
+    s32 last = max_rows > 0 ? row + max_rows - 1 : GRID_Y + GRID_H - 1;
+    s32 x;
+
+    for (; row <= last; row++) {
+        for (x = left; x < left + width; x++) {
+            if (ref_in(classes, floor_div16(x), row)) {
+                *out_tile_x = floor_div16(x);
+                return row * 16;
+            }
+        }
+    }
+    return -1;
+}
+
+/*
+ * Earliest entry over every cell in the class set (slab test). *out_span
+ * is how long the ray stays in that cell, so grazes can be told apart.
+ */
+static double ref_ray(u32 classes, const LevelCollisionRay* ray,
+                      s32* out_x, s32* out_y, double* out_span) {
+    double ox = ray->origin_x / 65536.0, oy = ray->origin_y / 65536.0;
+    double dx = ray->delta_x / 65536.0, dy = ray->delta_y / 65536.0;
+    double best = 2.0;
+    s32 x, y;
+
+    for (y = GRID_Y; y < GRID_Y + GRID_H; y++) {
+        for (x = GRID_X; x < GRID_X + GRID_W; x++) {
+            double enter = 0.0, leave = 1.0, a, b;
+
+            if (!ref_in(classes, x, y)) continue;
+
+            if (dx == 0.0) {
+                if (ox < x * 16.0 || ox >= x * 16.0 + 16.0) continue;
+            } else {
+                a = (x * 16.0 - ox) / dx;
+                b = (x * 16.0 + 16.0 - ox) / dx;
+                if (a > b) { double t = a; a = b; b = t; }
+                if (a > enter) enter = a;
+                if (b < leave) leave = b;
+            }
+            if (dy == 0.0) {
+                if (oy < y * 16.0 || oy >= y * 16.0 + 16.0) continue;
+            } else {
+                a = (y * 16.0 - oy) / dy;
+                b = (y * 16.0 + 16.0 - oy) / dy;
+                if (a > b) { double t = a; a = b; b = t; }
+                if (a > enter) enter = a;
+                if (b < leave) leave = b;
+            }
+            if ((enter < leave || (enter == leave && enter == 0.0)) && enter < best) {
+                best = enter;
+                *out_x = x;
+                *out_y = y;
+                *out_span = leave - enter;
+            }
+        }
+    }
+    return best;
+}
+
+static double abs_d(double v) {
+    return v < 0.0 ? -v : v;
+}
+
+/* ---------------------------------------------------------------------------
+ * Checks
+ * ------------------------------------------------------------------------ */
+
+static void check_points(const LevelContext* ctx) {
+    int i;
+
+    for (i = 0; i < 20000; i++) {
+        s32 x = rand_range(-100, (GRID_X + GRID_W) * 16 + 100);
+        s32 y = rand_range(-100, (GRID_Y + GRID_H) * 16 + 100);
+
+        if (LevelCollision_GetAttribute(ctx, x, y) != ref_attr(x, y)) {
+            report("GetAttribute", i);
+        }
+    }
+}
+
+static void check_sweeps(const LevelContext* ctx) {
+    int i;
+
+    for (i = 0; i < 20000; i++) {
+        s32 left = rand_range(-100, 2500), top = rand_range(-100, 800);
+        s32 width = rand_range(1, 40), height = rand_range(1, 40);
+        s32 d = rand_range(-150, 150);
+        LevelCollisionHit hit;
+        s32 got;
+
+        got = LevelCollision_SweepX(ctx, left, top, width, height, d, &hit);
+        if (got != ref_sweep_x(left, top, width, height, d) || (hit.attr != 0) != (got != d)) {
+            report("SweepX", i);
+        }
+        got = LevelCollision_SweepY(ctx, left, top, width, height, d, &hit);
+        if (got != ref_sweep_y(left, top, width, height, d) || (hit.attr != 0) != (got != d)) {
+            report("SweepY", i);
+        }
+    }
+}
+
+static void check_spans(const LevelContext* ctx) {
+    int i;
+
+    for (i = 0; i < 20000; i++) {
+        u32 classes = (u32)rand_range(1, 32);
+        s32 tile_x = rand_range(-20, GRID_X + GRID_W + 20);
+        s32 tile_y = rand_range(-10, GRID_Y + GRID_H + 10);
+        s32 count = rand_range(-5, 140);
+        s32 left = rand_range(-200, 2600), width = rand_range(1, 300);
+        s32 pixel_y = rand_range(-200, 900), max_rows = rand_range(-3, 20);
+        LevelCollisionHit hit;
+        s32 ref_x = 0, ref, got, k;
+        int clear = 1;
+
+        for (k = 0; k < count; k++) {
+            if (ref_in(classes, tile_x + k, tile_y)) clear = 0;
+        }
+        if (LevelCollision_IsSpanClear(ctx, classes, tile_x, tile_y, count) != clear) {
+            report("IsSpanClear", i);
+        }
+
+        got = LevelCollision_FindGround(ctx, classes, left, width, pixel_y, max_rows, &hit);
+        ref = ref_ground(classes, left, width, pixel_y, max_rows, &ref_x);
+        if (got != ref || (got >= 0 && (hit.tile_x != ref_x || hit.tile_y * 16 != got ||
+                                        hit.attr != ref_cell(ref_x, hit.tile_y)))) {
+            report("FindGround", i);
+        }
+    }
+}
+
+static void check_rays(const LevelContext* ctx) {
+    static LevelCollisionRay rays[3000];
+    static LevelCollisionRayHit batch[3000];
+    static const u32 class_sets[3] = {
+        LEVEL_COLLISION_MASK_SOLID,
+        LEVEL_COLLISION_MASK_GROUND | LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_BOUNCE),
+        LEVEL_COLLISION_MASK(LEVEL_COLLISION_CLASS_HAZARD)
+    };
+    u32 c;
+    int i;
+
+    for (i = 0; i < 3000; i++) {
+        int kind = rand_range(0, 4);
+
+        rays[i].origin_x = rand_range(-600, 3000) * 65536 + rand_range(0, 65536);
+        rays[i].origin_y = rand_range(-300, 1100) * 65536 + rand_range(0, 65536);
+        rays[i].delta_x = kind == 0 ? 0 : rand_range(-600, 600) * 65536 + rand_range(0, 65536);
+        rays[i].delta_y = kind == 1 ? 0 : rand_range(-600, 600) * 65536 + rand_range(0, 65536);
+    }
+
+    for (c = 0; c < 3; c++) {
+        LevelCollision_Raycasts(ctx, class_sets[c], rays, 3000, batch);
+
+        for (i = 0; i < 3000; i++) {
+            LevelCollisionRayHit hit;
+            s32 ref_x = 0, ref_y = 0;
+            double span = 0.0, t;
+            int got, ref;
+
+            got = LevelCollision_Raycast(ctx, class_sets[c], &rays[i], &hit);
+            if (memcmp(&hit, &batch[i], sizeof(hit)) != 0) {
+                report("Raycasts vs Raycast", i);
+            }
+
+            t = ref_ray(class_sets[c], &rays[i], &ref_x, &ref_y, &span);
+            ref = t <= 1.0;
+            if (got != ref || (got && (hit.tile_x != ref_x || hit.tile_y != ref_y ||
+                                       abs_d(hit.fraction / 65536.0 - t) > 1e-3))) {
+                /* Grazing a corner or ending on an edge is within rounding */
+                if (span < 1e-3 || abs_d(t - 1.0) < 1e-3) continue;
+                report("Raycast", i);
+            }
+        }
+    }
+}
+
+int main(void) {
+    BLBFile* writer = NULL;
+    BLBFile blb;
+    LevelContext ctx;
+
+    printf("=== Evil Engine Collision Test ===\n");
+
+    if (build_archive(&writer) != 0 ||
+        BLB_OpenMem(writer->data, writer->size, &blb) != 0) {
+        printf("ERROR: Failed to build the synthetic archive\n");
+        return 1;
+    }
+    if (Level_Load(&ctx, &blb, 0, 0) != 0 || !ctx.collision.planes) {
+        printf("ERROR: Level_Load failed on the synthetic archive\n");
+        return 1;
+    }
+    printf("Grid: %dx%d at (%d, %d)\n", ctx.collision.width, ctx.collision.height,
+           ctx.collision.offset_x, ctx.collision.offset_y);
+
+    check_points(&ctx);
+    check_sweeps(&ctx);
+    check_spans(&ctx);
+    check_rays(&ctx);
+
+    printf("%s: %d mismatches\n", g_bad ? "FAIL" : "OK", g_bad);
+
+    Level_Unload(&ctx);
+    BLB_Close(&blb);
+    BLB_Close(writer);
+    free(writer);
+    return g_bad > 255 ? 255 : g_bad;
+}
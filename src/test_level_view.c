@@ -12,66 +12,21 @@
 #include "level/level.h"
 #include "render/render.h"
 
-/* Render a single layer to an RGBA buffer */
+/* Render a single layer over the RGBA buffer */
 static void render_layer(const LevelContext* ctx, u32 layer_index,
                          u8* rgba, int img_width, int img_height) {
-    const u16* tilemap;
     const LayerEntry* layer;
-    u32 lw, lh;
-    u32 tx, ty;
-    u8 tile_rgba[16 * 16 * 4];
-    int tile_w, tile_h;
+    const LevelLayerChunks* view;
     
     layer = Level_GetLayer(ctx, layer_index);
-    if (!layer) return;
-    
-    tilemap = GetTilemapDataPtr(ctx, layer_index);
-    if (!tilemap) return;
-    
-    lw = layer->width;
-    lh = layer->height;
-    
-    printf("  Layer %u: %ux%u tiles\n", layer_index, lw, lh);
-    
-    for (ty = 0; ty < lh && (ty * 16) < (u32)img_height; ty++) {
-        for (tx = 0; tx < lw && (tx * 16) < (u32)img_width; tx++) {
-            u16 tile_entry;
-            u16 tile_index;
-            int px, py;
-            int x, y;
-            
-            tile_entry = tilemap[ty * lw + tx];
-            tile_index = tile_entry & 0x7FF;  /* bits 0-10 */
-            
-            if (tile_index == 0) continue;  /* transparent */
-            
-            /* Render tile to temporary buffer */
-            if (RenderTileToRGBA(ctx, tile_index, tile_rgba, &tile_w, &tile_h) != 0) {
-                continue;
-            }
-            
-            /* Copy to output image */
-            px = tx * 16;
-            py = ty * 16;
-            
-            for (y = 0; y < tile_h && (py + y) < img_height; y++) {
-                for (x = 0; x < tile_w && (px + x) < img_width; x++) {
-                    int src_idx = (y * tile_w + x) * 4;
-                    int dst_idx = ((py + y) * img_width + (px + x)) * 4;
-                    u8 a = tile_rgba[src_idx + 3];
-                    
-                    /* Skip fully transparent pixels (color index 0) */
-                    if (a == 0) continue;
-                    
-                    /* Copy RGB */
-                    rgba[dst_idx + 0] = tile_rgba[src_idx + 0];
-                    rgba[dst_idx + 1] = tile_rgba[src_idx + 1];
-                    rgba[dst_idx + 2] = tile_rgba[src_idx + 2];
-                    rgba[dst_idx + 3] = 255;
-                }
-            }
-        }
-    }
+    view = Level_GetLayerChunks(ctx, layer_index);
+    if (!layer || !view) return;
+    
+    printf("  Layer %u: %ux%u tiles, %u/%u chunks occupied\n", layer_index,
+           layer->width, layer->height,
+           view->occupied_count, (u32)view->chunks_x * view->chunks_y);
+    
+    RenderLayerToRGBA(ctx, layer_index, rgba, img_width, img_height);
 }
 
 static void write_ppm(const char* filename, const u8* rgba, int width, int height) {
@@ -1,7 +1,7 @@
 /**
  * blb_info.c - CLI tool to display BLB archive information
  * 
- * Usage: blb_info <path/to/GAME.BLB>
+ * Usage: blb_info <path/to/GAME.BLB> [--validate [threads]]
  * 
  * This tool demonstrates using the evil_engine library standalone
  * without any Godot dependencies.
@@ -10,15 +10,21 @@
 #include "../evil_engine.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 int main(int argc, char** argv) {
     BLBFile* blb = NULL;
     int level_count, i;
+    int validate = 0, threads = 0;
     
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <path/to/GAME.BLB>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <path/to/GAME.BLB> [--validate [threads]]\n", argv[0]);
         return 1;
     }
+    if (argc >= 3 && strcmp(argv[2], "--validate") == 0) {
+        validate = 1;
+        threads = argc >= 4 ? atoi(argv[3]) : 0;
+    }
     
     /* Open BLB file */
     printf("Opening BLB: %s\n", argv[1]);
@@ -27,6 +33,31 @@ int main(int argc, char** argv) {
         return 1;
     }
     
+    /* Whole-archive validation pass */
+    if (validate) {
+        BLBValidateReport report;
+        int ok = EvilEngine_ValidateBLB(blb, threads, &report) == 0;
+        double seconds = report.elapsed_us / 1e6;
+        
+        printf("\nValidation:\n");
+        printf("-----------\n");
+        printf("Segments: %u checked, %u failed (%u assets)\n",
+               report.segments_checked, report.segments_failed, report.assets_checked);
+        printf("Bytes: %.2f MB on %u thread(s) in %.3f ms",
+               report.bytes_checked / (1024.0 * 1024.0), report.thread_count,
+               seconds * 1000.0);
+        if (seconds > 0.0) {
+            printf(" (%.1f MB/s)", report.bytes_checked / (1024.0 * 1024.0) / seconds);
+        }
+        printf("\n");
+        if (ok) {
+            printf("Result: OK - archive trusted\n");
+        } else {
+            printf("Result: FAILED at sector %u, asset %u\n",
+                   report.first_bad_sector, report.first_bad_asset);
+        }
+    }
+    
     /* Get basic info */
     level_count = EvilEngine_GetLevelCount(blb);
     printf("\nBLB Archive Information:\n");
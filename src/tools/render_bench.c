@@ -0,0 +1,568 @@
+/**
+ * render_bench.c - Microbenchmark for the indexed-to-RGBA kernels
+ *
+ * Usage: render_bench [megapixels] [game.blb [level [stage]] | synthetic]
+ *
+ * Runs each kernel set the CPU supports over synthetic tiles and sprite
+ * rows and prints pixels/second. "portable" is the scalar loop the
+ * renderers used before the vector kernels; every set's output is
+ * checked against it first.
+ *
+ * Given an archive, also pans a RenderFrame across the stage and prints
+ * frames/second per kernel set, redrawn from scratch (RenderFrame_Draw)
+ * and from the tile caches (RenderFrame_Update). Before timing, each set
+ * checks that Update matches Draw byte for byte along a camera path with
+ * palette cycling steps, and the exit status is 1 if not. "synthetic"
+ * does the same on a stage built in memory (three parallax layers, 8x8
+ * and 16x16 tiles, semi-transparent palettes), so it runs without
+ * GAME.BLB, then again with the layers locked to the camera.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* clock_gettime */
+#endif
+
+#include "../render/render_kernels.h"
+#include "../render/render_frame.h"
+#include "../blb/blb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TILE_POOL       256         /* Distinct 16x16 tiles (64 KB of indices) */
+#define IMAGE_WIDTH     1024        /* Layer image the tiles blend into */
+#define IMAGE_HEIGHT    256
+#define SPRITE_WIDTH    96
+#define PAN_FRAMES      4096        /* Frames per frame-rate measurement */
+#define CHECK_FRAMES    512         /* Frames compared, update against draw */
+#define CHECK_CYCLE     64          /* Frames between palette cycling steps */
+
+/* Synthetic stage: level size in tiles and tile counts */
+#define SYN_WIDTH       256
+#define SYN_HEIGHT      64
+#define SYN_TILES_16    48
+#define SYN_TILES_8     16
+#define SYN_LAYERS      3
+
+typedef struct {
+    const char* name;
+    u32 width;              /* Pixels per row */
+    u32 height;             /* Rows per call */
+    u32 src_stride;
+    int masked;
+} Workload;
+
+static const Workload s_workloads[] = {
+    { "tile 16x16",         16, 16, 16, 0 },
+    { "tile 8x8",            8,  8, 16, 0 },
+    { "sprite row",         SPRITE_WIDTH, 1, SPRITE_WIDTH, 0 },
+    { "layer blend 16x16",  16, 16, 16, 1 },
+    { "layer blend 8x8",     8,  8, 16, 1 },
+};
+
+static u8* s_indices;
+static u32 s_lut[256];
+static u8* s_image;
+
+static double now_seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Deterministic data: a quarter of the LUT is transparent, like the
+ * background colour runs in real tiles */
+static void fill_inputs(void) {
+    u32 seed = 12345;
+    u32 i;
+
+    for (i = 0; i < TILE_POOL * 256; i++) {
+        seed = seed * 1103515245 + 12345;
+        s_indices[i] = (u8)(seed >> 16);
+    }
+    for (i = 0; i < 256; i++) {
+        seed = seed * 1103515245 + 12345;
+        s_lut[i] = (i % 4 == 0) ? 0 : ((seed >> 8) | 0xFF000000u);
+    }
+}
+
+/* One pass of a workload over the tile pool, into the layer image */
+static u32 run_pass(const Workload* w) {
+    u32 block = w->src_stride * w->height;     /* Source bytes per call */
+    u32 calls = (TILE_POOL * 256) / block;
+    u32 per_row = IMAGE_WIDTH / w->width;
+    u32 i;
+
+    for (i = 0; i < calls; i++) {
+        const u8* src = s_indices + (size_t)i * block;
+        u32 x = (i % per_row) * w->width;
+        u32 y = ((i / per_row) * w->height) % (IMAGE_HEIGHT - w->height + 1);
+
+        RenderKernel_ExpandRect(src, w->src_stride, s_lut,
+                                s_image + ((size_t)y * IMAGE_WIDTH + x) * 4,
+                                IMAGE_WIDTH * 4, w->width, w->height, w->masked);
+    }
+    return calls * w->width * w->height;
+}
+
+static int outputs_match(const Workload* w, int level) {
+    size_t bytes = (size_t)IMAGE_WIDTH * IMAGE_HEIGHT * 4;
+    u8* expected = (u8*)malloc(bytes);
+    int match;
+
+    if (!expected) {
+        return 0;
+    }
+    RenderKernel_SetLevel(RENDER_KERNEL_PORTABLE);
+    memset(s_image, 0x5A, bytes);
+    run_pass(w);
+    memcpy(expected, s_image, bytes);
+
+    RenderKernel_SetLevel(level);
+    memset(s_image, 0x5A, bytes);
+    run_pass(w);
+    match = memcmp(expected, s_image, bytes) == 0;
+
+    free(expected);
+    return match;
+}
+
+static double measure(const Workload* w, int level, double megapixels) {
+    double start, elapsed;
+    u64 pixels = 0;
+
+    RenderKernel_SetLevel(level);
+    run_pass(w);    /* Warm caches */
+
+    start = now_seconds();
+    while (pixels < (u64)(megapixels * 1e6)) {
+        pixels += run_pass(w);
+    }
+    elapsed = now_seconds() - start;
+    return elapsed > 0.0 ? pixels / elapsed : 0.0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Synthetic stage
+ * -------------------------------------------------------------------------- */
+
+static void put_u16(u8* p, u32 v) {
+    p[0] = (u8)v;
+    p[1] = (u8)(v >> 8);
+}
+
+static void put_u32(u8* p, u32 v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+/* TOC (u32 count, then id/size/offset per entry) with 4-byte aligned data;
+ * segments and sub-TOC containers share the layout */
+static u32 put_toc(u8* out, u32 count, const u32* ids, const u8* const* data,
+                   const u32* sizes) {
+    u32 offset = 4 + count * 12;
+    u32 i;
+
+    put_u32(out, count);
+    for (i = 0; i < count; i++) {
+        put_u32(out + 4 + i * 12, ids[i]);
+        put_u32(out + 8 + i * 12, sizes[i]);
+        put_u32(out + 12 + i * 12, offset);
+        memcpy(out + offset, data[i], sizes[i]);
+        offset = (offset + sizes[i] + 3) & ~3u;
+    }
+    return offset;
+}
+
+/*
+ * One level, one stage. Layer 0 is a half-speed backdrop, layer 1 the
+ * full-speed playfield, layer 2 a sparse 1.25x foreground; the playfield
+ * and foreground share a priority, so the tie order is exercised.
+ */
+static BLBFile* build_synthetic(int locked) {
+    static u8 template_header[BLB_HEADER_SIZE];
+    static const u32 parallax[SYN_LAYERS] = { 0x8000, 0x10000, 0x14000 };
+    static const u16 priority[SYN_LAYERS] = { 100, 950, 950 };
+    enum { TOTAL_TILES = SYN_TILES_16 + SYN_TILES_8 };
+    u32 pixel_bytes = SYN_TILES_16 * 256 + SYN_TILES_8 * 128;
+    u32 map_bytes = SYN_WIDTH * SYN_HEIGHT * 2;
+    u8 tile_header[36], palette_index[TOTAL_TILES], flags[TOTAL_TILES];
+    u8 palettes[2][512], layers[SYN_LAYERS * 92];
+    u8 *pixels, *maps, *palette_toc, *map_toc, *segment;
+    u32 ids[SYN_LAYERS + 2], sizes[SYN_LAYERS + 2];
+    const u8* data[SYN_LAYERS + 2];
+    u32 seed = 777, i, l, size, palette_toc_size, map_toc_size;
+    BLBFile template_blb;
+    BLBFile* blb = NULL;
+
+    pixels = (u8*)malloc(pixel_bytes);
+    maps = (u8*)malloc((size_t)map_bytes * SYN_LAYERS);
+    palette_toc = (u8*)malloc(4 + 2 * 12 + sizeof(palettes));
+    map_toc = (u8*)malloc(4 + SYN_LAYERS * 12 + (size_t)map_bytes * SYN_LAYERS);
+    segment = (u8*)malloc(4 + 8 * 12 + pixel_bytes + (size_t)map_bytes * SYN_LAYERS + 4096);
+    if (!pixels || !maps || !palette_toc || !map_toc || !segment) {
+        goto done;
+    }
+
+    memset(tile_header, 0, sizeof(tile_header));
+    tile_header[0] = 0x20; tile_header[1] = 0x30; tile_header[2] = 0x60;
+    put_u16(tile_header + 0x08, SYN_WIDTH);
+    put_u16(tile_header + 0x0A, SYN_HEIGHT);
+    put_u16(tile_header + 0x10, SYN_TILES_16);
+    put_u16(tile_header + 0x12, SYN_TILES_8);
+
+    /* Tiles: some solid, some with transparent (index 0) holes and runs */
+    for (i = 0; i < pixel_bytes; i++) {
+        u32 tile = i < SYN_TILES_16 * 256 ? i / 256 : SYN_TILES_16 + (i - SYN_TILES_16 * 256) / 128;
+
+        seed = seed * 1103515245 + 12345;
+        pixels[i] = (tile % 3 == 0) ? (u8)(1 + (seed >> 16) % 255) :
+                    (tile % 3 == 1) ? (u8)((seed >> 16) % 4 ? (seed >> 20) : 0) :
+                                      (u8)((i & 15) < 8 ? 0 : (seed >> 16));
+    }
+    for (i = 0; i < TOTAL_TILES; i++) {
+        palette_index[i] = (u8)(i & 1);
+        flags[i] = (u8)((i % 5 == 0 ? 0x01 : 0) | (i >= SYN_TILES_16 ? 0x02 : 0));
+    }
+    for (i = 0; i < 256; i++) {
+        seed = seed * 1103515245 + 12345;
+        put_u16(palettes[0] + i * 2, i ? ((seed >> 8) & 0x7FFF) | 1 : 0);
+        put_u16(palettes[1] + i * 2, i ? ((seed >> 12) & 0xFFFF) | 1 : 0);
+    }
+
+    for (l = 0; l < SYN_LAYERS; l++) {
+        u8* layer = layers + l * 92;
+        u8* map = maps + (size_t)l * map_bytes;
+
+        memset(layer, 0, 92);
+        put_u16(layer + 0x04, SYN_WIDTH);
+        put_u16(layer + 0x06, SYN_HEIGHT);
+        put_u16(layer + 0x08, SYN_WIDTH);
+        put_u16(layer + 0x0A, SYN_HEIGHT);
+        put_u32(layer + 0x0C, priority[l]);
+        put_u32(layer + 0x10, locked ? 0x10000 : parallax[l]);
+        put_u32(layer + 0x14, locked ? 0x10000 : parallax[l]);
+        if (l == 1) {
+            layer[0x1E] = layer[0x1F] = layer[0x20] = layer[0x21] = 1;
+        }
+        for (i = 0; i < SYN_WIDTH * SYN_HEIGHT; i++) {
+            u32 x = i % SYN_WIDTH, y = i / SYN_WIDTH;
+            int empty = (l == 1 && y < 20 && (x / 8 + y / 4) % 3 == 0) ||
+                        (l == 2 && ((x / 4 + y / 2) % 7 != 0 || (x / 64) % 2 == 1));
+
+            put_u16(map + i * 2, empty ? 0 : 1 + (x * 7 + y * 3 + l * 11) % TOTAL_TILES);
+        }
+    }
+
+    for (i = 0; i < 2; i++) {
+        ids[i] = i;
+        data[i] = palettes[i];
+        sizes[i] = 512;
+    }
+    palette_toc_size = put_toc(palette_toc, 2, ids, data, sizes);
+    for (l = 0; l < SYN_LAYERS; l++) {
+        ids[l] = l;
+        data[l] = maps + (size_t)l * map_bytes;
+        sizes[l] = map_bytes;
+    }
+    map_toc_size = put_toc(map_toc, SYN_LAYERS, ids, data, sizes);
+
+    /* PAL layout: an A-Z code byte at 0xCD3 */
+    template_header[0xCD3] = 'A';
+    if (BLB_OpenMem(template_header, BLB_HEADER_SIZE, &template_blb) != 0) {
+        goto done;
+    }
+    blb = BLB_Create(1);
+    if (!blb || BLB_CopyHeaderTables(blb, &template_blb) != 0 ||
+        BLB_SetLevelMetadata(blb, 0, "SYNT", "Synthetic", 1) != 0) {
+        goto fail;
+    }
+
+    ids[0] = 602; data[0] = palettes[0]; sizes[0] = 4;
+    size = put_toc(segment, 1, ids, data, sizes);
+    if (BLB_WriteSegment(blb, 0, 0, segment, size, 0) != 0) goto fail;
+
+    ids[0] = 100; data[0] = tile_header;    sizes[0] = sizeof(tile_header);
+    ids[1] = 300; data[1] = pixels;         sizes[1] = pixel_bytes;
+    ids[2] = 301; data[2] = palette_index;  sizes[2] = TOTAL_TILES;
+    ids[3] = 302; data[3] = flags;          sizes[3] = TOTAL_TILES;
+    ids[4] = 400; data[4] = palette_toc;    sizes[4] = palette_toc_size;
+    size = put_toc(segment, 5, ids, data, sizes);
+    if (BLB_WriteSegment(blb, 0, 0, segment, size, 1) != 0) goto fail;
+
+    ids[0] = 200; data[0] = map_toc;        sizes[0] = map_toc_size;
+    ids[1] = 201; data[1] = layers;         sizes[1] = sizeof(layers);
+    size = put_toc(segment, 2, ids, data, sizes);
+    if (BLB_WriteSegment(blb, 0, 0, segment, size, 2) != 0) goto fail;
+
+    BLB_Close(&template_blb);
+    goto done;
+
+fail:
+    BLB_Close(&template_blb);
+    if (blb) {
+        BLB_Close(blb);
+        free(blb);
+        blb = NULL;
+    }
+done:
+    free(pixels);
+    free(maps);
+    free(palette_toc);
+    free(map_toc);
+    free(segment);
+    return blb;
+}
+
+/* -----------------------------------------------------------------------------
+ * Frame-rate measurement
+ * -------------------------------------------------------------------------- */
+
+/* Camera for frame i of a pan that zig-zags across the level */
+static void pan_camera(const RenderFrame* frame, u32 i, s32* camera_x, s32* camera_y) {
+    s32 range_x = frame->level_width - frame->width;
+    s32 range_y = frame->level_height - frame->height;
+    s32 x = (s32)(i * 3);
+    s32 y = (s32)(i * 1);
+
+    if (range_x > 0) {
+        x %= 2 * range_x;
+        *camera_x = x < range_x ? x : 2 * range_x - x;
+    } else {
+        *camera_x = 0;
+    }
+    if (range_y > 0) {
+        y %= 2 * range_y;
+        *camera_y = y < range_y ? y : 2 * range_y - y;
+    } else {
+        *camera_y = 0;
+    }
+}
+
+/* Rotate a palette's colours 1-255 by step from the archive ones, as an
+ * Asset 401 colour cycle does, and apply it with Level_SetPalette */
+static void cycle_palette(LevelContext* ctx, u8 palette, u32 step) {
+    u16 colors[256];
+    const u8* src;
+    u32 size = 0;
+    u32 i;
+
+    src = ctx->palette_container ?
+        BLB_GetSubAsset(ctx->palette_container, ctx->palette_container_size, palette, &size) : NULL;
+    if (!src || size < sizeof(colors)) {
+        return;
+    }
+    memcpy(colors, src, sizeof(colors));
+    for (i = 1; i < 256; i++) {
+        u32 from = 1 + (i - 1 + step) % 255;
+
+        colors[i] = (u16)(src[from * 2] | (src[from * 2 + 1] << 8));
+    }
+    Level_SetPalette(ctx, palette, colors);
+}
+
+/**
+ * Pan the camera and compare RenderFrame_Update against RenderFrame_Draw
+ * byte for byte on every frame. Every CHECK_CYCLE frames a palette is
+ * cycled and invalidated with the camera held still, so a stale cache or
+ * a skipped recomposite shows up as a mismatch.
+ * @return              Index of the first mismatching frame, or -1
+ */
+static int check_frames(LevelContext* ctx, RenderFrame* frame, u8* scratch) {
+    size_t bytes = (size_t)frame->width * frame->height * 4;
+    s32 camera_x = 0, camera_y = 0;
+    u32 i;
+
+    RenderFrame_InvalidateAll(frame);
+    for (i = 0; i < CHECK_FRAMES; i++) {
+        if (i % CHECK_CYCLE == CHECK_CYCLE - 1 && ctx->palette_rgba_count > 0) {
+            u8 palette = (u8)((i / CHECK_CYCLE) % ctx->palette_rgba_count);
+
+            cycle_palette(ctx, palette, i / CHECK_CYCLE + 1);
+            RenderFrame_InvalidatePalette(frame, palette);
+        } else {
+            /* Coarse steps, so tiles wrap around the ring caches */
+            pan_camera(frame, i * 5, &camera_x, &camera_y);
+        }
+        RenderFrame_Update(frame, camera_x, camera_y);
+        memcpy(scratch, frame->rgba, bytes);
+        RenderFrame_Draw(frame, camera_x, camera_y);
+        if (memcmp(scratch, frame->rgba, bytes) != 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int bench_frames(const BLBFile* blb, const char* name, int level_index, int stage_index) {
+    LevelContext ctx;
+    RenderFrame frame;
+    int best = RenderKernel_GetBestLevel();
+    int result = 0;
+    u8* scratch;
+    int level;
+
+    Level_Init(&ctx);
+    if (Level_Load(&ctx, blb, level_index, stage_index) != 0 ||
+        RenderFrame_Init(&frame, &ctx, 0, 0) != 0) {
+        fprintf(stderr, "Error: cannot load level %d stage %d\n", level_index, stage_index);
+        Level_Unload(&ctx);
+        return 1;
+    }
+    scratch = (u8*)malloc((size_t)frame.width * frame.height * 4);
+    if (!scratch) {
+        fprintf(stderr, "Error: out of memory\n");
+        RenderFrame_Free(&frame);
+        Level_Unload(&ctx);
+        return 1;
+    }
+
+    printf("\nFrames: %s level %d stage %d, %dx%d, %u layers, %u panned frames\n",
+           name, level_index, stage_index, frame.width, frame.height,
+           frame.layer_count, PAN_FRAMES);
+    printf("%-20s%14s%14s%14s\n", "Kernel set", "draw", "update", "tiles/update");
+    for (level = RENDER_KERNEL_PORTABLE; level <= best; level++) {
+        double rate[2];
+        u64 redrawn = 0;
+        int mismatch;
+        int pass;
+
+        RenderKernel_SetLevel(level);
+        mismatch = check_frames(&ctx, &frame, scratch);
+        if (mismatch >= 0) {
+            printf("%-20s%14s (update differs from draw at frame %d)\n",
+                   RenderKernel_GetLevelName(level), "MISMATCH", mismatch);
+            result = 1;
+            continue;
+        }
+        RenderFrame_InvalidateAll(&frame);
+        for (pass = 0; pass < 2; pass++) {
+            double start = now_seconds();
+            s32 camera_x, camera_y;
+            double elapsed;
+            u32 i;
+
+            for (i = 0; i < PAN_FRAMES; i++) {
+                pan_camera(&frame, i, &camera_x, &camera_y);
+                if (pass == 0) {
+                    RenderFrame_Draw(&frame, camera_x, camera_y);
+                } else {
+                    RenderFrame_Update(&frame, camera_x, camera_y);
+                    redrawn += frame.cache_redrawn;
+                }
+            }
+            elapsed = now_seconds() - start;
+            rate[pass] = elapsed > 0.0 ? PAN_FRAMES / elapsed : 0.0;
+        }
+        printf("%-20s%10.0f fps%10.0f fps%14.1f\n", RenderKernel_GetLevelName(level),
+               rate[0], rate[1], (double)redrawn / PAN_FRAMES);
+    }
+
+    free(scratch);
+    RenderFrame_Free(&frame);
+    Level_Unload(&ctx);
+    return result;
+}
+
+/* The synthetic stage with its parallax layers, then with every layer
+ * scrolling with the camera, where updates only scroll the frame */
+static int bench_synthetic(void) {
+    static const char* names[2] = { "synthetic", "synthetic (locked layers)" };
+    int result = 0;
+    int locked;
+
+    for (locked = 0; locked < 2; locked++) {
+        BLBFile* synthetic = build_synthetic(locked);
+        BLBFile blb;
+
+        if (!synthetic || BLB_OpenMem(synthetic->data, synthetic->size, &blb) != 0) {
+            fprintf(stderr, "Error: cannot build the synthetic stage\n");
+            if (synthetic) {
+                BLB_Close(synthetic);
+                free(synthetic);
+            }
+            return 1;
+        }
+        result |= bench_frames(&blb, names[locked], 0, 0);
+        BLB_Close(&blb);
+        BLB_Close(synthetic);
+        free(synthetic);
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    double megapixels = argc >= 2 ? atof(argv[1]) : 200.0;
+    int best = RenderKernel_GetBestLevel();
+    size_t w;
+    int level;
+
+    if (megapixels <= 0.0) {
+        fprintf(stderr, "Usage: %s [megapixels] [game.blb [level [stage]] | synthetic]\n",
+                argv[0]);
+        return 1;
+    }
+
+    s_indices = (u8*)malloc(TILE_POOL * 256);
+    s_image = (u8*)calloc((size_t)IMAGE_WIDTH * IMAGE_HEIGHT, 4);
+    if (!s_indices || !s_image) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    fill_inputs();
+
+    printf("Kernel sets: ");
+    for (level = RENDER_KERNEL_PORTABLE; level <= best; level++) {
+        printf("%s%s", RenderKernel_GetLevelName(level), level < best ? ", " : "\n");
+    }
+    printf("%.0f Mpixels per measurement\n\n", megapixels);
+
+    printf("%-20s", "Workload");
+    for (level = RENDER_KERNEL_PORTABLE; level <= best; level++) {
+        printf("%14s", RenderKernel_GetLevelName(level));
+    }
+    printf("%10s\n", "speedup");
+
+    for (w = 0; w < sizeof(s_workloads) / sizeof(s_workloads[0]); w++) {
+        const Workload* wl = &s_workloads[w];
+        double before = 0.0, after = 0.0;
+
+        printf("%-20s", wl->name);
+        for (level = RENDER_KERNEL_PORTABLE; level <= best; level++) {
+            double rate;
+
+            if (!outputs_match(wl, level)) {
+                printf("%14s", "MISMATCH");
+                continue;
+            }
+            rate = measure(wl, level, megapixels);
+            if (level == RENDER_KERNEL_PORTABLE) before = rate;
+            after = rate;
+            printf("%9.1f Mp/s", rate / 1e6);
+        }
+        printf("%9.2fx\n", before > 0.0 ? after / before : 0.0);
+    }
+
+    free(s_image);
+    free(s_indices);
+
+    if (argc >= 3 && strcmp(argv[2], "synthetic") == 0) {
+        return bench_synthetic();
+    }
+    if (argc >= 3) {
+        BLBFile blb;
+        int result;
+
+        if (BLB_Open(argv[2], &blb) != 0) {
+            fprintf(stderr, "Error: cannot open %s\n", argv[2]);
+            return 1;
+        }
+        result = bench_frames(&blb, argv[2], argc >= 4 ? atoi(argv[3]) : 0,
+                              argc >= 5 ? atoi(argv[4]) : 0);
+        BLB_Close(&blb);
+        return result;
+    }
+    return 0;
+}